@@ -117,11 +117,10 @@ CZMQ_EXPORT void
 CZMQ_EXPORT void
     zloop_set_ticket_delay (zloop_t *self, size_t ticket_delay);
 
-//  Set hard limit on number of timers allowed. Setting more than a small  
-//  number of timers (10-100) can have a dramatic impact on the performance
-//  of the reactor. For high-volume cases, use ticket timers. If the hard  
-//  limit is reached, the reactor stops creating new timers and logs an    
-//  error.                                                                 
+//  Set hard limit on number of timers allowed. Timers are kept in a heap, 
+//  so thousands of them are cheap; ticket timers are still faster for     
+//  expiry timers that are reset often. If the hard limit is reached, the  
+//  reactor stops creating new timers and logs an error.                   
 CZMQ_EXPORT void
     zloop_set_max_timers (zloop_t *self, size_t max_timers);
 
@@ -18,11 +18,17 @@
     once-off or repeated timers. Its resolution is 1 msec. It uses a tickless
     timer to reduce CPU interrupts in inactive processes.
 @discuss
+    Timers are kept in a heap ordered by expiry time, and sockets and FDs
+    stay registered with a libzmq poller for as long as the reactor runs,
+    so waking up costs the same however many timers, readers and pollers
+    there are. With a libzmq that lacks the zmq_poller API, the reactor
+    falls back to zmq_poll.
 @end
 */
 
 #include "../include/czmq.h"
 
+typedef struct _s_source_t s_source_t;
 typedef struct _s_reader_t s_reader_t;
 typedef struct _s_poller_t s_poller_t;
 typedef struct _s_timer_t s_timer_t;
@@ -31,28 +37,43 @@ typedef struct _s_ticket_t s_ticket_t;
 //  Structure of our class
 
 struct _zloop_t {
-    zlistx_t *readers;          //  List of socket readers
-    zlistx_t *pollers;          //  List of poll items
-    zlistx_t *timers;           //  List of timers
+    zhashx_t *sockets;          //  Sources by libzmq socket
+    zhashx_t *fds;              //  Sources by FD
+    zhashx_t *timers;           //  Timers by timer id
+    s_timer_t **timer_heap;     //  Timers ordered by expiry, as a heap
+    size_t timer_heap_size;     //  Number of timers in heap
+    size_t timer_heap_limit;    //  Allocated size of heap
     zlistx_t *tickets;          //  List of tickets
     int last_timer_id;          //  Most recent timer id
     size_t max_timers;          //  Limit on number of timers
     size_t ticket_delay;        //  Ticket delay value
+#ifdef ZMQ_HAVE_POLLER
+    void *poller;               //  libzmq poller, while running
+#else
     size_t poll_size;           //  Size of poll set
     zmq_pollitem_t *pollset;    //  zmq_poll set
-    s_reader_t *readact;        //  Readers for this poll set
-    s_poller_t *pollact;        //  Pollers for this poll set
-    bool need_rebuild;          //  True if pollset needs rebuilding
+    s_source_t **pollact;       //  Sources for this poll set
+#endif
+    bool changed;               //  True if readers or pollers changed
     bool verbose;               //  True if verbose tracing wanted
-    bool terminated;            //  True when stopped running
     bool ignore_interrupts;     //  True when this loop should ingnore intterupts
-    zlistx_t *zombies;          //  List of timers to kill
 };
 
 //  Reactor elements are held as structures of their own
 
+//  All readers and pollers of one socket or FD hang off a single source,
+//  which is polled for the events any of them wants
+
+struct _s_source_t {
+    void *socket;               //  libzmq socket, or NULL
+    SOCKET fd;                  //  File descriptor, if no socket
+    short events;               //  Events polled for
+    s_reader_t *readers;        //  Readers, in order of registration
+    s_poller_t *pollers;        //  Pollers, in order of registration
+};
+
 struct _s_reader_t {
-    void *list_handle;          //  Handle into list
+    s_reader_t *next;           //  Next reader of same source
     zsock_t *sock;              //  Socket to read from
     zloop_reader_fn *handler;   //  Function to execute
     void *arg;                  //  Application argument to poll item
@@ -61,7 +82,7 @@ struct _s_reader_t {
 };
 
 struct _s_poller_t {
-    void *list_handle;          //  Handle into list
+    s_poller_t *next;           //  Next poller of same source
     zmq_pollitem_t item;        //  ZeroMQ socket or file descriptor
     zloop_fn *handler;          //  Function to execute
     void *arg;                  //  Application argument to poll item
@@ -70,13 +91,16 @@ struct _s_poller_t {
 };
 
 struct _s_timer_t {
-    void *list_handle;          //  Handle into list
+    size_t heap_index;          //  Position in heap
+    s_timer_t *next;            //  Next timer due, while executing
     int timer_id;               //  Unique timer id, used to cancel timer
     zloop_timer_fn *handler;    //  Function to execute
     size_t delay;               //  Delay (ms) between executing
     size_t times;               //  Number of times to repeat, 0 for forever
     void *arg;                  //  Application argument to timer
     int64_t when;               //  Clock time when alarm goes off
+    bool due;                   //  Taken off heap to be executed
+    bool deleted;               //  Flag as deleted (to clean up later)
 };
 
 //  As we pass void * to/from the caller for working with tickets, we
@@ -99,6 +123,43 @@ s_next_timer_id (zloop_t *self)
     return ++self->last_timer_id;
 }
 
+//  Sources and timers are hashed by libzmq socket, FD, or timer id, which
+//  serve as keys themselves. As keys may not be NULL, FDs are offset by 1;
+//  timer ids start at 1 anyhow.
+
+static size_t
+s_key_hash (const void *key)
+{
+    return (size_t) key;
+}
+
+static int
+s_key_compare (const void *key1, const void *key2)
+{
+    return key1 == key2? 0: key1 < key2? -1: 1;
+}
+
+static void
+s_key_setup (zhashx_t *table)
+{
+    zhashx_set_key_destructor (table, NULL);
+    zhashx_set_key_duplicator (table, NULL);
+    zhashx_set_key_comparator (table, s_key_compare);
+    zhashx_set_key_hasher (table, s_key_hash);
+}
+
+static void *
+s_fd_key (SOCKET fd)
+{
+    return (byte *) NULL + fd + 1;
+}
+
+static void *
+s_timer_key (int timer_id)
+{
+    return (byte *) NULL + timer_id;
+}
+
 static s_reader_t *
 s_reader_new (zsock_t *sock, zloop_reader_fn handler, void *arg)
 {
@@ -147,6 +208,38 @@ s_poller_destroy (s_poller_t **self_p)
     }
 }
 
+static s_source_t *
+s_source_new (void *socket, SOCKET fd)
+{
+    s_source_t *self = (s_source_t *) zmalloc (sizeof (s_source_t));
+    if (self) {
+        self->socket = socket;
+        self->fd = fd;
+    }
+    return self;
+}
+
+static void
+s_source_destroy (s_source_t **self_p)
+{
+    assert (self_p);
+    s_source_t *self = *self_p;
+    if (self) {
+        while (self->readers) {
+            s_reader_t *reader = self->readers;
+            self->readers = reader->next;
+            s_reader_destroy (&reader);
+        }
+        while (self->pollers) {
+            s_poller_t *poller = self->pollers;
+            self->pollers = poller->next;
+            s_poller_destroy (&poller);
+        }
+        free (self);
+        *self_p = NULL;
+    }
+}
+
 
 static s_timer_t *
 s_timer_new (int timer_id, size_t delay, size_t times, zloop_timer_fn handler, void *arg)
@@ -174,16 +267,13 @@ s_timer_destroy (s_timer_t **self_p)
     }
 }
 
-static int
-s_timer_comparator (s_timer_t *timer1, s_timer_t *timer2)
+//  Timers that expire at the same time run in the order they were created
+
+static bool
+s_timer_before (s_timer_t *timer1, s_timer_t *timer2)
 {
-    if (timer1->when > timer2->when)
-        return 1;
-    else
-    if (timer1->when < timer2->when)
-        return -1;
-    else
-        return 0;
+    return timer1->when < timer2->when
+        || (timer1->when == timer2->when && timer1->timer_id < timer2->timer_id);
 }
 
 static s_ticket_t *
@@ -224,90 +314,395 @@ s_ticket_comparator (s_ticket_t *ticket1, s_ticket_t *ticket2)
         return 0;
 }
 
-//  Remove timer with specified id, if it exists
+
+//  The timer heap holds the earliest timer at index 0, and each timer knows
+//  its own index, so that it can be taken out without a search.
+
+static void
+s_timer_heap_set (zloop_t *self, size_t index, s_timer_t *timer)
+{
+    self->timer_heap [index] = timer;
+    timer->heap_index = index;
+}
+
+static void
+s_timer_sift_up (zloop_t *self, size_t index)
+{
+    s_timer_t *timer = self->timer_heap [index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!s_timer_before (timer, self->timer_heap [parent]))
+            break;
+        s_timer_heap_set (self, index, self->timer_heap [parent]);
+        index = parent;
+    }
+    s_timer_heap_set (self, index, timer);
+}
 
 static void
-s_timer_remove (zloop_t *self, int timer_id)
+s_timer_sift_down (zloop_t *self, size_t index)
 {
-    s_timer_t *timer = (s_timer_t *) zlistx_first (self->timers);
-    while (timer) {
-        if (timer->timer_id == timer_id) {
-            zlistx_delete (self->timers, timer->list_handle);
+    s_timer_t *timer = self->timer_heap [index];
+    while (true) {
+        size_t child = 2 * index + 1;
+        if (child >= self->timer_heap_size)
             break;
+        if (child + 1 < self->timer_heap_size
+        &&  s_timer_before (self->timer_heap [child + 1], self->timer_heap [child]))
+            child++;
+        if (!s_timer_before (self->timer_heap [child], timer))
+            break;
+        s_timer_heap_set (self, index, self->timer_heap [child]);
+        index = child;
+    }
+    s_timer_heap_set (self, index, timer);
+}
+
+//  Add timer to heap. Returns 0 on success, -1 on failure.
+
+static int
+s_timer_push (zloop_t *self, s_timer_t *timer)
+{
+    if (self->timer_heap_size == self->timer_heap_limit) {
+        size_t limit = self->timer_heap_limit? self->timer_heap_limit * 2: 16;
+        s_timer_t **heap = (s_timer_t **) realloc (
+            self->timer_heap, limit * sizeof (s_timer_t *));
+        if (!heap)
+            return -1;
+        self->timer_heap = heap;
+        self->timer_heap_limit = limit;
+    }
+    self->timer_heap [self->timer_heap_size] = timer;
+    s_timer_sift_up (self, self->timer_heap_size++);
+    return 0;
+}
+
+//  Take timer off heap
+
+static void
+s_timer_pull (zloop_t *self, s_timer_t *timer)
+{
+    size_t index = timer->heap_index;
+    s_timer_t *last = self->timer_heap [--self->timer_heap_size];
+    if (last != timer) {
+        s_timer_heap_set (self, index, last);
+        if (index > 0 && s_timer_before (last, self->timer_heap [(index - 1) / 2]))
+            s_timer_sift_up (self, index);
+        else
+            s_timer_sift_down (self, index);
+    }
+}
+
+//  Remove timer with specified id, if it exists. A timer that is due is
+//  only flagged, as we may be executing it.
+
+static void
+s_timer_remove (zloop_t *self, int timer_id)
+{
+    s_timer_t *timer = (s_timer_t *) zhashx_lookup (self->timers, s_timer_key (timer_id));
+    if (timer) {
+        if (timer->due)
+            timer->deleted = true;
+        else {
+            s_timer_pull (self, timer);
+            zhashx_delete (self->timers, s_timer_key (timer_id));
+        }
+    }
+}
+
+//  Execute all timers that have expired, in order. Handlers may create and
+//  cancel timers freely, as the due ones are off the heap meanwhile. Returns
+//  -1 if a handler signaled break, leaving the remaining timers due, else 0.
+
+static int
+s_timers_execute (zloop_t *self, int64_t time_now)
+{
+    s_timer_t *due = NULL;
+    s_timer_t **tail_p = &due;
+    while (self->timer_heap_size && self->timer_heap [0]->when <= time_now) {
+        s_timer_t *timer = self->timer_heap [0];
+        s_timer_pull (self, timer);
+        timer->due = true;
+        timer->next = NULL;
+        *tail_p = timer;
+        tail_p = &timer->next;
+    }
+    int rc = 0;
+    while (due) {
+        s_timer_t *timer = due;
+        due = timer->next;
+        if (rc != -1 && !timer->deleted) {
+            if (self->verbose)
+                zsys_debug ("zloop: call timer handler id=%d", timer->timer_id);
+            rc = timer->handler (self, timer->timer_id, timer->arg);
+            if (rc != -1) {
+                if (timer->times && --timer->times == 0)
+                    timer->deleted = true;
+                else
+                    timer->when += timer->delay;
+            }
+        }
+        timer->due = false;
+        if (timer->deleted || s_timer_push (self, timer))
+            zhashx_delete (self->timers, s_timer_key (timer->timer_id));
+    }
+    return rc;
+}
+
+
+//  Find source for libzmq socket or, if socket is NULL, for FD
+
+static s_source_t *
+s_source_lookup (zloop_t *self, void *socket, SOCKET fd)
+{
+    if (socket)
+        return (s_source_t *) zhashx_lookup (self->sockets, socket);
+    else
+        return (s_source_t *) zhashx_lookup (self->fds, s_fd_key (fd));
+}
+
+#ifdef ZMQ_HAVE_POLLER
+//  Sources are added to and removed from the poller as they come and go,
+//  while the reactor is running. Returns 0 on success, -1 on failure.
+
+static int
+s_source_attach (zloop_t *self, s_source_t *source)
+{
+    if (!self->poller)
+        return 0;
+    if (source->socket)
+        return zmq_poller_add (self->poller, source->socket, source, source->events);
+    else
+        return zmq_poller_add_fd (self->poller, source->fd, source, source->events);
+}
+
+static int
+s_source_attach_all (zloop_t *self, zhashx_t *table)
+{
+    s_source_t *source = (s_source_t *) zhashx_first (table);
+    while (source) {
+        if (s_source_attach (self, source))
+            return -1;
+        source = (s_source_t *) zhashx_next (table);
+    }
+    return 0;
+}
+
+static void
+s_source_detach (zloop_t *self, s_source_t *source)
+{
+    if (!self->poller)
+        return;
+    if (source->socket)
+        zmq_poller_remove (self->poller, source->socket);
+    else
+        zmq_poller_remove_fd (self->poller, source->fd);
+}
+
+static int
+s_source_modify (zloop_t *self, s_source_t *source)
+{
+    if (!self->poller)
+        return 0;
+    if (source->socket)
+        return zmq_poller_modify (self->poller, source->socket, source->events);
+    else
+        return zmq_poller_modify_fd (self->poller, source->fd, source->events);
+}
+#endif
+
+//  Find or create source for libzmq socket or FD. Returns NULL on failure.
+
+static s_source_t *
+s_source_require (zloop_t *self, void *socket, SOCKET fd)
+{
+    s_source_t *source = s_source_lookup (self, socket, fd);
+    if (source)
+        return source;
+
+    source = s_source_new (socket, fd);
+    if (!source)
+        return NULL;
+    int rc;
+    if (socket)
+        rc = zhashx_insert (self->sockets, socket, source);
+    else
+        rc = zhashx_insert (self->fds, s_fd_key (fd), source);
+    if (rc) {
+        s_source_destroy (&source);
+        return NULL;
+    }
+#ifdef ZMQ_HAVE_POLLER
+    if (s_source_attach (self, source)) {
+        if (socket)
+            zhashx_delete (self->sockets, socket);
+        else
+            zhashx_delete (self->fds, s_fd_key (fd));
+        return NULL;
+    }
+#endif
+    return source;
+}
+
+//  Poll source for the events its readers and pollers want, or drop it if
+//  it has none left. Returns 0 on success, -1 on failure.
+
+static int
+s_source_update (zloop_t *self, s_source_t *source)
+{
+    int rc = 0;
+    self->changed = true;
+    if (source->readers || source->pollers) {
+        short events = source->readers? ZMQ_POLLIN: 0;
+        s_poller_t *poller;
+        for (poller = source->pollers; poller; poller = poller->next)
+            events |= poller->item.events;
+        if (events != source->events) {
+            source->events = events;
+#ifdef ZMQ_HAVE_POLLER
+            rc = s_source_modify (self, source);
+#endif
         }
-        timer = (s_timer_t *) zlistx_next (self->timers);
     }
+    else {
+#ifdef ZMQ_HAVE_POLLER
+        s_source_detach (self, source);
+#endif
+        if (source->socket)
+            zhashx_delete (self->sockets, source->socket);
+        else
+            zhashx_delete (self->fds, s_fd_key (source->fd));
+    }
+    return rc;
 }
 
+//  Call readers and pollers of a source that is ready. Stops after any
+//  handler that changes readers or pollers, as the source may be gone;
+//  the poller will report what is left again. Returns -1 if a handler
+//  signaled break.
 
-//  We hold an array of pollers that matches the pollset, so we can
-//  register/cancel pollers orthogonally to executing the pollset
-//  activity on pollers. Returns 0 on success, -1 on failure.
+static int
+s_source_execute (zloop_t *self, s_source_t *source, short revents)
+{
+    int rc = 0;
+    s_reader_t *reader = source->readers;
+    while (reader && (revents & (ZMQ_POLLIN | ZMQ_POLLERR))) {
+        if ((revents & ZMQ_POLLERR) && !reader->tolerant) {
+            if (self->verbose)
+                zsys_warning ("zloop: can't read %s socket: %s",
+                              zsock_type_str (reader->sock),
+                              zmq_strerror (zmq_errno ()));
+            //  Give handler one chance to handle error, then kill
+            //  reader because it'll disrupt the reactor otherwise.
+            if (reader->errors++) {
+                zloop_reader_end (self, reader->sock);
+                return 0;
+            }
+        }
+        else
+            reader->errors = 0;     //  A non-error happened
+
+        if (self->verbose)
+            zsys_debug ("zloop: call %s socket handler",
+                        zsock_type_str (reader->sock));
+        rc = reader->handler (self, reader->sock, reader->arg);
+        if (rc == -1 || self->changed)
+            return rc;
+        reader = reader->next;
+    }
+    s_poller_t *poller = source->pollers;
+    while (poller) {
+        //  Each poller sees only the events it asked for
+        zmq_pollitem_t item = poller->item;
+        item.revents = revents & (item.events | ZMQ_POLLERR);
+        if (item.revents) {
+            if ((item.revents & ZMQ_POLLERR) && !poller->tolerant) {
+                if (self->verbose)
+                    zsys_warning ("zloop: can't poll %s socket (%p, %d): %s",
+                                  item.socket?
+                                  zsys_sockname (zsock_type (item.socket)): "FD",
+                                  item.socket, item.fd,
+                                  zmq_strerror (zmq_errno ()));
+                //  Give handler one chance to handle error, then kill
+                //  poller because it'll disrupt the reactor otherwise.
+                if (poller->errors++) {
+                    zloop_poller_end (self, &item);
+                    return 0;
+                }
+            }
+            else
+                poller->errors = 0;     //  A non-error happened
+
+            if (self->verbose)
+                zsys_debug ("zloop: call %s socket handler (%p, %d)",
+                            item.socket?
+                            zsys_sockname (zsock_type (item.socket)): "FD",
+                            item.socket, item.fd);
+            rc = poller->handler (self, &item, poller->arg);
+            if (rc == -1 || self->changed)
+                return rc;
+        }
+        poller = poller->next;
+    }
+    return rc;
+}
+
+
+#ifndef ZMQ_HAVE_POLLER
+//  We hold an array of sources that matches the pollset, so we can
+//  register/cancel readers and pollers orthogonally to executing the
+//  pollset activity. Returns 0 on success, -1 on failure.
 
 static int
 s_rebuild_pollset (zloop_t *self)
 {
     free (self->pollset);
-    free (self->readact);
     free (self->pollact);
     self->pollset = NULL;
-    self->readact = NULL;
     self->pollact = NULL;
 
-    self->poll_size = zlistx_size (self->readers) + zlistx_size (self->pollers);
+    self->poll_size = zhashx_size (self->sockets) + zhashx_size (self->fds);
     self->pollset = (zmq_pollitem_t *) zmalloc (self->poll_size * sizeof (zmq_pollitem_t));
     if (!self->pollset)
         return -1;
 
-    self->readact = (s_reader_t *) zmalloc (self->poll_size * sizeof (s_reader_t));
-    if (!self->readact)
-        return -1;
-
-    self->pollact = (s_poller_t *) zmalloc (self->poll_size * sizeof (s_poller_t));
+    self->pollact = (s_source_t **) zmalloc (self->poll_size * sizeof (s_source_t *));
     if (!self->pollact)
         return -1;
 
-    s_reader_t *reader = (s_reader_t *) zlistx_first (self->readers);
     uint item_nbr = 0;
-    while (reader) {
-        zmq_pollitem_t poll_item = { zsock_resolve (reader->sock), 0, ZMQ_POLLIN };
-        self->pollset [item_nbr] = poll_item;
-        self->readact [item_nbr] = *reader;
-        item_nbr++;
-        reader = (s_reader_t *) zlistx_next (self->readers);
-    }
-    s_poller_t *poller = (s_poller_t *) zlistx_first (self->pollers);
-    while (poller) {
-        self->pollset [item_nbr] = poller->item;
-        self->pollact [item_nbr] = *poller;
-        item_nbr++;
-        poller = (s_poller_t *) zlistx_next (self->pollers);
+    zhashx_t *table = self->sockets;
+    while (table) {
+        s_source_t *source = (s_source_t *) zhashx_first (table);
+        while (source) {
+            zmq_pollitem_t poll_item = { source->socket, source->fd, source->events };
+            self->pollset [item_nbr] = poll_item;
+            self->pollact [item_nbr] = source;
+            item_nbr++;
+            source = (s_source_t *) zhashx_next (table);
+        }
+        table = table == self->sockets? self->fds: NULL;
     }
-    self->need_rebuild = false;
+    self->changed = false;
     return 0;
 }
+#endif
 
 static long
 s_tickless (zloop_t *self)
 {
     //  Calculate tickless timer, up to 1 hour
-    int64_t tickless = zclock_mono () + 1000 * 3600;
-
-    //  Scan timers, which are not sorted
-    //  TODO: sort timers properly on insertion
-    s_timer_t *timer = (s_timer_t *) zlistx_first (self->timers);
-    while (timer) {
-        //  Find earliest timer
-        if (tickless > timer->when)
-            tickless = timer->when;
-        timer = (s_timer_t *) zlistx_next (self->timers);
-    }
-    //  Tickets are sorted, so check first ticket
+    int64_t time_now = zclock_mono ();
+    int64_t tickless = time_now + 1000 * 3600;
+
+    //  Earliest timer is on top of heap, and tickets are sorted
+    if (self->timer_heap_size && tickless > self->timer_heap [0]->when)
+        tickless = self->timer_heap [0]->when;
     s_ticket_t *ticket = (s_ticket_t *) zlistx_first (self->tickets);
     if (ticket && tickless > ticket->when)
         tickless = ticket->when;
 
-    long timeout = (long) (tickless - zclock_mono ());
+    long timeout = (long) (tickless - time_now);
     if (timeout < 0)
         timeout = 0;
     if (self->verbose)
@@ -330,21 +725,21 @@ zloop_new (void)
     if (!self)
         return NULL;
 
-    self->readers = zlistx_new ();
-    if (self->readers)
-        self->pollers = zlistx_new ();
-    if (self->pollers)
-        self->timers = zlistx_new ();
+    self->sockets = zhashx_new ();
+    if (self->sockets)
+        self->fds = zhashx_new ();
+    if (self->fds)
+        self->timers = zhashx_new ();
     if (self->timers)
-        self->zombies = zlistx_new ();
-    if (self->zombies)
         self->tickets = zlistx_new ();
     if (self->tickets) {
         self->last_timer_id = 0;
-        zlistx_set_destructor (self->readers, (czmq_destructor *) s_reader_destroy);
-        zlistx_set_destructor (self->pollers, (czmq_destructor *) s_poller_destroy);
-        zlistx_set_destructor (self->timers, (czmq_destructor *) s_timer_destroy);
-        zlistx_set_comparator (self->timers, (czmq_comparator *) s_timer_comparator);
+        s_key_setup (self->sockets);
+        s_key_setup (self->fds);
+        s_key_setup (self->timers);
+        zhashx_set_destructor (self->sockets, (zhashx_destructor_fn *) s_source_destroy);
+        zhashx_set_destructor (self->fds, (zhashx_destructor_fn *) s_source_destroy);
+        zhashx_set_destructor (self->timers, (zhashx_destructor_fn *) s_timer_destroy);
         zlistx_set_destructor (self->tickets, (czmq_destructor *) s_ticket_destroy);
         zlistx_set_comparator (self->tickets, (czmq_comparator *) s_ticket_comparator);
     }
@@ -363,22 +758,15 @@ zloop_destroy (zloop_t **self_p)
     assert (self_p);
     if (*self_p) {
         zloop_t *self = *self_p;
-
-        //  If we never started the loop, yet manipulated timers, we'll have
-        //  a zombie list
-        while (zlistx_first (self->zombies)) {
-            //  Get timer_id back from pointer
-            ptrdiff_t timer_id = (byte *) zlistx_detach (self->zombies, NULL) - (byte *) NULL;
-            s_timer_remove (self, (int) timer_id);
-        }
-        zlistx_destroy (&self->zombies);
-        zlistx_destroy (&self->readers);
-        zlistx_destroy (&self->pollers);
-        zlistx_destroy (&self->timers);
+        zhashx_destroy (&self->sockets);
+        zhashx_destroy (&self->fds);
+        zhashx_destroy (&self->timers);
         zlistx_destroy (&self->tickets);
+        free (self->timer_heap);
+#ifndef ZMQ_HAVE_POLLER
         free (self->pollset);
-        free (self->readact);
         free (self->pollact);
+#endif
         free (self);
         *self_p = NULL;
     }
@@ -397,20 +785,30 @@ zloop_reader (zloop_t *self, zsock_t *sock, zloop_reader_fn handler, void *arg)
     assert (self);
     assert (sock);
 
+    void *socket = zsock_resolve (sock);
+    if (!socket)
+        return -1;
+    s_source_t *source = s_source_require (self, socket, 0);
+    if (!source)
+        return -1;
+
     s_reader_t *reader = s_reader_new (sock, handler, arg);
     if (reader) {
-        reader->list_handle = zlistx_add_end (self->readers, reader);
-        if (!reader->list_handle) {
-            s_reader_destroy (&reader);
-            return -1;
+        s_reader_t **tail_p = &source->readers;
+        while (*tail_p)
+            tail_p = &(*tail_p)->next;
+        *tail_p = reader;
+        if (s_source_update (self, source) == 0) {
+            if (self->verbose)
+                zsys_debug ("zloop: register %s reader", zsock_type_str (sock));
+            return 0;
         }
-        self->need_rebuild = true;
-        if (self->verbose)
-            zsys_debug ("zloop: register %s reader", zsock_type_str (sock));
-        return 0;
+        *tail_p = NULL;
+        s_reader_destroy (&reader);
     }
-    else
-        return -1;
+    //  Restore source, or drop it if we just created it
+    s_source_update (self, source);
+    return -1;
 }
 
 
@@ -424,13 +822,20 @@ zloop_reader_end (zloop_t *self, zsock_t *sock)
     assert (self);
     assert (sock);
 
-    s_reader_t *reader = (s_reader_t *) zlistx_first (self->readers);
-    while (reader) {
-        if (reader->sock == sock) {
-            zlistx_delete (self->readers, reader->list_handle);
-            self->need_rebuild = true;
+    void *socket = zsock_resolve (sock);
+    s_source_t *source = socket? s_source_lookup (self, socket, 0): NULL;
+    if (source) {
+        s_reader_t **reader_p = &source->readers;
+        while (*reader_p) {
+            s_reader_t *reader = *reader_p;
+            if (reader->sock == sock) {
+                *reader_p = reader->next;
+                s_reader_destroy (&reader);
+            }
+            else
+                reader_p = &reader->next;
         }
-        reader = (s_reader_t *) zlistx_next (self->readers);
+        s_source_update (self, source);
     }
     if (self->verbose)
         zsys_debug ("zloop: cancel %s reader", zsock_type_str (sock));
@@ -447,11 +852,13 @@ zloop_reader_set_tolerant (zloop_t *self, zsock_t *sock)
     assert (self);
     assert (sock);
 
-    s_reader_t *reader = (s_reader_t *) zlistx_first (self->readers);
-    while (reader) {
-        if (reader->sock == sock)
-            reader->tolerant = true;
-        reader = (s_reader_t *) zlistx_next (self->readers);
+    void *socket = zsock_resolve (sock);
+    s_source_t *source = socket? s_source_lookup (self, socket, 0): NULL;
+    if (source) {
+        s_reader_t *reader;
+        for (reader = source->readers; reader; reader = reader->next)
+            if (reader->sock == sock)
+                reader->tolerant = true;
     }
 }
 
@@ -472,22 +879,29 @@ zloop_poller (zloop_t *self, zmq_pollitem_t *item, zloop_fn handler, void *arg)
     &&  streq (zsys_sockname (zsock_type (item->socket)), "UNKNOWN"))
         return -1;
 
+    s_source_t *source = s_source_require (self, item->socket, item->fd);
+    if (!source)
+        return -1;
+
     s_poller_t *poller = s_poller_new (item, handler, arg);
     if (poller) {
-        poller->list_handle = zlistx_add_end (self->pollers, poller);
-        if (!poller->list_handle) {
-            s_poller_destroy (&poller);
-            return -1;
+        s_poller_t **tail_p = &source->pollers;
+        while (*tail_p)
+            tail_p = &(*tail_p)->next;
+        *tail_p = poller;
+        if (s_source_update (self, source) == 0) {
+            if (self->verbose)
+                zsys_debug ("zloop: register %s poller (%p, %d)",
+                            item->socket? zsys_sockname (zsock_type (item->socket)): "FD",
+                            item->socket, item->fd);
+            return 0;
         }
-        self->need_rebuild = true;
-        if (self->verbose)
-            zsys_debug ("zloop: register %s poller (%p, %d)",
-                        item->socket? zsys_sockname (zsock_type (item->socket)): "FD",
-                        item->socket, item->fd);
-        return 0;
+        *tail_p = NULL;
+        s_poller_destroy (&poller);
     }
-    else
-        return -1;
+    //  Restore source, or drop it if we just created it
+    s_source_update (self, source);
+    return -1;
 }
 
 
@@ -501,23 +915,14 @@ zloop_poller_end (zloop_t *self, zmq_pollitem_t *item)
 {
     assert (self);
 
-    s_poller_t *poller = (s_poller_t *) zlistx_first (self->pollers);
-    while (poller) {
-        bool match = false;
-        if (item->socket) {
-            if (item->socket == poller->item.socket)
-                match = true;
-        }
-        else {
-            if (item->fd == poller->item.fd)
-                match = true;
-        }
-        if (match) {
-            zlistx_delete (self->pollers, poller->list_handle);
-            //  Force rebuild to avoid reading from freed poller
-            self->need_rebuild = true;
+    s_source_t *source = s_source_lookup (self, item->socket, item->fd);
+    if (source && source->pollers) {
+        while (source->pollers) {
+            s_poller_t *poller = source->pollers;
+            source->pollers = poller->next;
+            s_poller_destroy (&poller);
         }
-        poller = (s_poller_t *) zlistx_next (self->pollers);
+        s_source_update (self, source);
     }
     if (self->verbose)
         zsys_debug ("zloop: cancel %s poller (%p, %d)",
@@ -536,21 +941,11 @@ zloop_poller_set_tolerant (zloop_t *self, zmq_pollitem_t *item)
     assert (self);
 
     //  Find matching poller(s) and mark as tolerant
-    s_poller_t *poller = (s_poller_t *) zlistx_first (self->pollers);
-    while (poller) {
-        bool match = false;
-        if (item->socket) {
-            if (item->socket == poller->item.socket)
-                match = true;
-        }
-        else {
-            if (item->fd == poller->item.fd)
-                match = true;
-        }
-        if (match)
+    s_source_t *source = s_source_lookup (self, item->socket, item->fd);
+    if (source) {
+        s_poller_t *poller;
+        for (poller = source->pollers; poller; poller = poller->next)
             poller->tolerant = true;
-
-        poller = (s_poller_t *) zlistx_next (self->pollers);
     }
 }
 
@@ -560,28 +955,27 @@ zloop_poller_set_tolerant (zloop_t *self, zmq_pollitem_t *item)
 //  times. At each expiry, will call the handler, passing the arg. To run a
 //  timer forever, use 0 times. Returns a timer_id that is used to cancel the
 //  timer in the future. Returns -1 if there was an error.
-//
-//  TODO: if we returned a void *handle to the timer then we could work
-//  directly into the list rather than scanning... how to do this without
-//  breaking the API or making the code horribly complex?
 
 int
 zloop_timer (zloop_t *self, size_t delay, size_t times, zloop_timer_fn handler, void *arg)
 {
     assert (self);
     //  Catch excessive use of timers
-    if (self->max_timers && zlistx_size (self->timers) == self->max_timers) {
+    if (self->max_timers && zhashx_size (self->timers) == self->max_timers) {
         zsys_error ("zloop: timer limit reached (max=%d)", self->max_timers);
         return -1;
     }
     int timer_id = s_next_timer_id (self);
     s_timer_t *timer = s_timer_new (timer_id, delay, times, handler, arg);
     if (timer) {
-        timer->list_handle = zlistx_add_end (self->timers, timer);
-        if (!timer->list_handle) {
+        if (zhashx_insert (self->timers, s_timer_key (timer_id), timer)) {
             s_timer_destroy (&timer);
             return -1;
         }
+        if (s_timer_push (self, timer)) {
+            zhashx_delete (self->timers, s_timer_key (timer_id));
+            return -1;
+        }
         if (self->verbose)
             zsys_debug ("zloop: register timer id=%d delay=%d times=%d",
                         timer_id, (int) delay, (int) times);
@@ -601,16 +995,7 @@ zloop_timer_end (zloop_t *self, int timer_id)
 {
     assert (self);
 
-    if (self->terminated)
-        s_timer_remove (self, timer_id);
-    else
-    //  We cannot touch self->timers because we may be executing that
-    //  from inside the poll loop. So, we hold the arg on the zombie
-    //  list, and process that list when we're done executing timers.
-    //  This hack lets us store an integer timer ID as a pointer
-    if (zlistx_add_end (self->zombies, (byte *) NULL + timer_id) == NULL)
-        return -1;
-
+    s_timer_remove (self, timer_id);
     if (self->verbose)
         zsys_debug ("zloop: cancel timer id=%d", timer_id);
 
@@ -710,11 +1095,10 @@ zloop_ignore_interrupts (zloop_t *self)
 
 
 //  --------------------------------------------------------------------------
-//  Set hard limit on number of timers allowed. Setting more than a small
-//  number of timers (10-100) can have a dramatic impact on the performance
-//  of the reactor. For high-volume cases, use ticket timers. If the hard
-//  limit is reached, the reactor stops creating new timers and logs an
-//  error.
+//  Set hard limit on number of timers allowed. Timers are kept in a heap,
+//  so thousands of them are cheap; ticket timers are still faster for
+//  expiry timers that are reset often. If the hard limit is reached, the
+//  reactor stops creating new timers and logs an error.
 
 void
 zloop_set_max_timers (zloop_t *self, size_t max_timers)
@@ -737,9 +1121,39 @@ zloop_start (zloop_t *self)
     assert (self);
     int rc = 0;
 
+#ifdef ZMQ_HAVE_POLLER
+    //  The poller holds on to sockets only while we run, so that the
+    //  application may destroy them once the reactor has returned
+    self->poller = zmq_poller_new ();
+    if (!self->poller
+    ||  s_source_attach_all (self, self->sockets)
+    ||  s_source_attach_all (self, self->fds)) {
+        if (self->poller)
+            zmq_poller_close (self->poller);
+        self->poller = NULL;
+        return -1;
+    }
+#endif
     //  Main reactor loop
     while (self->ignore_interrupts || !zsys_interrupted) {
-        if (self->need_rebuild) {
+#ifdef ZMQ_HAVE_POLLER
+        //  The poller tells us about one ready source at a time
+        zmq_poller_event_t event;
+        bool ready = false;
+        long timeout = s_tickless (self);
+        if (zhashx_size (self->sockets) || zhashx_size (self->fds)) {
+            rc = zmq_poller_wait (self->poller, &event, timeout);
+            ready = rc == 0;
+            if (rc == -1 && zmq_errno () == ETIMEDOUT)
+                rc = 0;
+        }
+        else {
+            //  An empty poller returns at once, so just wait for timers
+            zclock_sleep ((int) (timeout / ZMQ_POLL_MSEC));
+            rc = 0;
+        }
+#else
+        if (self->changed) {
             //  If s_rebuild_pollset() fails, break out of the loop and
             //  return its error
             rc = s_rebuild_pollset (self);
@@ -747,30 +1161,19 @@ zloop_start (zloop_t *self)
                 break;
         }
         rc = zmq_poll (self->pollset, (int) self->poll_size, s_tickless (self));
+#endif
         if (rc == -1 || (!self->ignore_interrupts && zsys_interrupted)) {
             if (self->verbose)
                 zsys_debug ("zloop: interrupted");
             rc = 0;
             break;              //  Context has been shut down
         }
+        //  Ready sources stay valid until readers or pollers change
+        self->changed = false;
 
         //  Handle any timers that have now expired
         int64_t time_now = zclock_mono ();
-        s_timer_t *timer = (s_timer_t *) zlistx_first (self->timers);
-        while (timer) {
-            if (time_now >= timer->when) {
-                if (self->verbose)
-                    zsys_debug ("zloop: call timer handler id=%d", timer->timer_id);
-                rc = timer->handler (self, timer->timer_id, timer->arg);
-                if (rc == -1)
-                    break;      //  Timer handler signaled break
-                if (timer->times && --timer->times == 0)
-                    zlistx_delete (self->timers, timer->list_handle);
-                else
-                    timer->when += timer->delay;
-            }
-            timer = (s_timer_t *) zlistx_next (self->timers);
-        }
+        rc = s_timers_execute (self, time_now);
 
         //  Handle any tickets that have now expired
         s_ticket_t *ticket = (s_ticket_t *) zlistx_first (self->tickets);
@@ -791,82 +1194,26 @@ zloop_start (zloop_t *self)
             ticket = (s_ticket_t *) zlistx_last (self->tickets);
         }
 
-        //  Handle any readers and pollers that are ready
+        //  Handle any readers and pollers that are ready. If the timers
+        //  changed them, we leave that to the next round.
+#ifdef ZMQ_HAVE_POLLER
+        if (ready && rc != -1 && !self->changed)
+            rc = s_source_execute (self, (s_source_t *) event.user_data, event.events);
+#else
         size_t item_nbr;
-        for (item_nbr = 0; item_nbr < self->poll_size && rc >= 0; item_nbr++) {
-            s_reader_t *reader = &self->readact [item_nbr];
-            if (reader->handler) {
-                if ((self->pollset [item_nbr].revents & ZMQ_POLLERR)
-                && !reader->tolerant) {
-                    if (self->verbose)
-                        zsys_warning ("zloop: can't read %s socket: %s",
-                                      zsock_type_str (reader->sock),
-                                      zmq_strerror (zmq_errno ()));
-                    //  Give handler one chance to handle error, then kill
-                    //  reader because it'll disrupt the reactor otherwise.
-                    if (reader->errors++) {
-                        zloop_reader_end (self, reader->sock);
-                        self->pollset [item_nbr].revents = 0;
-                    }
-                }
-                else
-                    reader->errors = 0;     //  A non-error happened
-
-                if (self->pollset [item_nbr].revents) {
-                    if (self->verbose)
-                        zsys_debug ("zloop: call %s socket handler",
-                                    zsock_type_str (reader->sock));
-                    rc = reader->handler (self, reader->sock, reader->arg);
-                    if (rc == -1 || self->need_rebuild)
-                        break;
-                }
-            }
-            else {
-                s_poller_t *poller = &self->pollact [item_nbr];
-                assert (self->pollset [item_nbr].socket == poller->item.socket);
-
-                if ((self->pollset [item_nbr].revents & ZMQ_POLLERR)
-                && !poller->tolerant) {
-                    if (self->verbose)
-                        zsys_warning ("zloop: can't poll %s socket (%p, %d): %s",
-                                      poller->item.socket?
-                                      zsys_sockname (zsock_type (poller->item.socket)): "FD",
-                                      poller->item.socket, poller->item.fd,
-                                      zmq_strerror (zmq_errno ()));
-                    //  Give handler one chance to handle error, then kill
-                    //  poller because it'll disrupt the reactor otherwise.
-                    if (poller->errors++) {
-                        zloop_poller_end (self, &poller->item);
-                        self->pollset [item_nbr].revents = 0;
-                    }
-                }
-                else
-                    poller->errors = 0;     //  A non-error happened
-
-                if (self->pollset [item_nbr].revents) {
-                    if (self->verbose)
-                        zsys_debug ("zloop: call %s socket handler (%p, %d)",
-                                    poller->item.socket?
-                                    zsys_sockname (zsock_type (poller->item.socket)): "FD",
-                                    poller->item.socket, poller->item.fd);
-                    rc = poller->handler (self, &self->pollset [item_nbr], poller->arg);
-                    if (rc == -1 || self->need_rebuild)
-                        break;
-                }
-            }
-        }
-        //  Now handle any timer zombies
-        //  This is going to be slow if we have many timers; we might use
-        //  a faster lookup on the timer list.
-        while (zlistx_first (self->zombies)) {
-            //  Get timer_id back from pointer
-            ptrdiff_t timer_id = (byte *) zlistx_detach (self->zombies, NULL) - (byte *) NULL;
-            s_timer_remove (self, (int) timer_id);
-        }
+        for (item_nbr = 0; item_nbr < self->poll_size
+                        && rc != -1 && !self->changed; item_nbr++)
+            if (self->pollset [item_nbr].revents)
+                rc = s_source_execute (self, self->pollact [item_nbr],
+                                       self->pollset [item_nbr].revents);
+#endif
         if (rc == -1)
             break;
     }
-    self->terminated = true;
+#ifdef ZMQ_HAVE_POLLER
+    zmq_poller_close (self->poller);
+    self->poller = NULL;
+#endif
     return rc;
 }
 
@@ -905,6 +1252,37 @@ s_timer_event3 (zloop_t *loop, int timer_id, void *called)
     return -1;
 }
 
+static int
+s_timer_count_event (zloop_t *loop, int timer_id, void *count)
+{
+    (*(int *) count)++;
+    return 0;
+}
+
+static int
+s_timer_last_event (zloop_t *loop, int timer_id, void *count)
+{
+    //  End the reactor on the third call
+    return ++*(int *) count == 3? -1: 0;
+}
+
+static int
+s_socket_count_event (zloop_t *loop, zsock_t *handle, void *count)
+{
+    (*(int *) count)++;
+    return 0;
+}
+
+static int
+s_poller_recv_event (zloop_t *loop, zmq_pollitem_t *item, void *arg)
+{
+    char *message = zstr_recv (item->socket);
+    assert (message);
+    zstr_free (&message);
+    //  End the reactor
+    return -1;
+}
+
 void
 zloop_test (bool verbose)
 {
@@ -965,6 +1343,48 @@ zloop_test (bool verbose)
     //  zloop runs the handler which will terminate the loop
     assert (timer_event_called);
     zsys_interrupted = 0;
+    zloop_destroy (&loop);
+
+    //  Timers fire in order of expiry, so the one-shot timers have all
+    //  fired by the third time the 5 msec timer does; cancelled timers
+    //  never fire
+    loop = zloop_new ();
+    int timer_events = 0;
+    int timer_ids [1000];
+    int index;
+    for (index = 0; index < 1000; index++) {
+        timer_ids [index] = zloop_timer (loop, 1 + index % 10, 1,
+                                         s_timer_count_event, &timer_events);
+        assert (timer_ids [index] != -1);
+    }
+    for (index = 0; index < 1000; index += 2)
+        zloop_timer_end (loop, timer_ids [index]);
+    int last_events = 0;
+    zloop_timer (loop, 5, 3, s_timer_last_event, &last_events);
+    zloop_start (loop);
+    assert (timer_events == 500);
+    assert (last_events == 3);
+    zloop_destroy (&loop);
+
+    //  Readers and pollers of the same socket are all called, and
+    //  cancelling the readers leaves the poller in place
+    loop = zloop_new ();
+    int reader_events = 0;
+    rc = zloop_reader (loop, input, s_socket_count_event, &reader_events);
+    assert (rc == 0);
+    rc = zloop_reader (loop, input, s_socket_count_event, &reader_events);
+    assert (rc == 0);
+    zmq_pollitem_t item = { zsock_resolve (input), 0, ZMQ_POLLIN };
+    rc = zloop_poller (loop, &item, s_poller_recv_event, NULL);
+    assert (rc == 0);
+    zstr_send (output, "PING");
+    zloop_start (loop);
+    assert (reader_events == 2);
+
+    zloop_reader_end (loop, input);
+    zstr_send (output, "PING");
+    zloop_start (loop);
+    assert (reader_events == 2);
 
     //  cleanup
     zloop_destroy (&loop);
@@ -0,0 +1,146 @@
+/*
+    zloop_bench
+
+    Measures how the cost of the zloop reactor grows with the number of
+    readers and timers it handles. A message is passed around a ring of
+    PULL sockets, each registered as a reader that forwards the message to
+    the next one, for one second. Meanwhile repeating timers with delays
+    spread between 10 and 1009 msecs fire in the background.
+
+    Usage: zloop_bench [readers timers]
+
+    Without arguments, runs a set of typical combinations.
+
+    Copyright (c) the Contributors as noted in the AUTHORS file.
+    This file is part of CZMQ, the high-level C binding for 0MQ:
+    http://czmq.zeromq.org.
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "../include/czmq.h"
+
+typedef struct {
+    size_t messages;            //  Messages passed on by readers
+    size_t timer_events;        //  Timer handlers called
+} s_counters_t;
+
+typedef struct {
+    s_counters_t *counters;
+    zsock_t *next;              //  Socket to pass the message on to
+} s_node_t;
+
+
+static int
+s_node_event (zloop_t *loop, zsock_t *reader, void *arg)
+{
+    s_node_t *node = (s_node_t *) arg;
+    zframe_t *frame = zframe_recv (reader);
+    if (!frame)
+        return -1;
+    node->counters->messages++;
+    return zframe_send (&frame, node->next, 0);
+}
+
+static int
+s_timer_event (zloop_t *loop, int timer_id, void *arg)
+{
+    ((s_counters_t *) arg)->timer_events++;
+    return 0;
+}
+
+static int
+s_stop_event (zloop_t *loop, int timer_id, void *arg)
+{
+    return -1;
+}
+
+
+static void
+s_bench (size_t readers, size_t timers)
+{
+    //  Endpoints of closed sockets are released asynchronously, so each
+    //  run uses its own
+    static int run = 0;
+    run++;
+
+    zsock_t **inputs = (zsock_t **) zmalloc (readers * sizeof (zsock_t *));
+    zsock_t **outputs = (zsock_t **) zmalloc (readers * sizeof (zsock_t *));
+    s_node_t *nodes = (s_node_t *) zmalloc (readers * sizeof (s_node_t));
+    assert (inputs && outputs && nodes);
+    s_counters_t counters = { 0, 0 };
+
+    zloop_t *loop = zloop_new ();
+    assert (loop);
+
+    size_t index;
+    for (index = 0; index < readers; index++) {
+        inputs [index] = zsock_new (ZMQ_PULL);
+        assert (inputs [index]);
+        int rc = zsock_bind (inputs [index], "inproc://zloop.bench.%d.%d", run, (int) index);
+        assert (rc == 0);
+        outputs [index] = zsock_new (ZMQ_PUSH);
+        assert (outputs [index]);
+        rc = zsock_connect (outputs [index], "inproc://zloop.bench.%d.%d", run, (int) index);
+        assert (rc == 0);
+    }
+    for (index = 0; index < readers; index++) {
+        nodes [index].counters = &counters;
+        nodes [index].next = outputs [(index + 1) % readers];
+        int rc = zloop_reader (loop, inputs [index], s_node_event, &nodes [index]);
+        assert (rc == 0);
+    }
+    for (index = 0; index < timers; index++) {
+        int timer_id = zloop_timer (loop, 10 + index % 1000, 0, s_timer_event, &counters);
+        assert (timer_id != -1);
+    }
+    zloop_timer (loop, 1000, 1, s_stop_event, NULL);
+
+    zstr_send (outputs [0], "M");
+    int64_t start = zclock_usecs ();
+    zloop_start (loop);
+    int64_t elapsed = zclock_usecs () - start;
+
+    printf ("%8d %8d %12.2f %12d\n", (int) readers, (int) timers,
+            counters.messages? (double) elapsed / counters.messages: 0.0,
+            (int) counters.timer_events);
+
+    zloop_destroy (&loop);
+    for (index = 0; index < readers; index++) {
+        zsock_destroy (&inputs [index]);
+        zsock_destroy (&outputs [index]);
+    }
+    free (inputs);
+    free (outputs);
+    free (nodes);
+}
+
+
+int
+main (int argc, char *argv [])
+{
+    //  Each reader takes two sockets
+    zsys_set_max_sockets (0);
+
+    printf ("%8s %8s %12s %12s\n", "readers", "timers", "usecs/msg", "timer events");
+    if (argc == 3)
+        s_bench ((size_t) atoi (argv [1]), (size_t) atoi (argv [2]));
+    else
+    if (argc == 1) {
+        s_bench (1, 0);
+        s_bench (10, 0);
+        s_bench (100, 0);
+        s_bench (1000, 0);
+        s_bench (1, 100);
+        s_bench (1, 1000);
+        s_bench (1, 10000);
+        s_bench (1000, 10000);
+    }
+    else {
+        printf ("usage: zloop_bench [readers timers]\n");
+        return 1;
+    }
+    return 0;
+}
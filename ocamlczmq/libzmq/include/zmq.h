@@ -182,6 +182,11 @@ ZMQ_EXPORT void zmq_version (int *major, int *minor, int *patch);
 #define ZMQ_SOCKET_LIMIT 3
 #define ZMQ_THREAD_PRIORITY 3
 #define ZMQ_THREAD_SCHED_POLICY 4
+#define ZMQ_MSG_POOL 5
+#define ZMQ_IO_REBALANCE_IVL 6
+#define ZMQ_MEMORY_BUDGET 7
+#define ZMQ_IO_EVENTS 8
+#define ZMQ_IO_THREAD_AFFINITY 9
 
 /*  Default for new contexts                                                  */
 #define ZMQ_IO_THREADS_DFLT  1
@@ -194,6 +199,10 @@ ZMQ_EXPORT int zmq_ctx_term (void *context);
 ZMQ_EXPORT int zmq_ctx_shutdown (void *ctx_);
 ZMQ_EXPORT int zmq_ctx_set (void *context, int option, int optval);
 ZMQ_EXPORT int zmq_ctx_get (void *context, int option);
+ZMQ_EXPORT int zmq_ctx_set_ext (void *context, int option,
+    const void *optval, size_t optvallen);
+ZMQ_EXPORT int zmq_ctx_get_ext (void *context, int option,
+    void *optval, size_t *optvallen);
 
 /*  Old (legacy) API                                                          */
 ZMQ_EXPORT void *zmq_init (int io_threads);
@@ -330,11 +339,28 @@ ZMQ_EXPORT uint32_t zmq_msg_routing_id (zmq_msg_t *msg);
 #define ZMQ_VMCI_BUFFER_MIN_SIZE 86
 #define ZMQ_VMCI_BUFFER_MAX_SIZE 87
 #define ZMQ_VMCI_CONNECT_TIMEOUT 88
+#define ZMQ_BUSY_POLL 89
+#define ZMQ_GATHER_THRESHOLD 90
+#define ZMQ_SNDHWM_BYTES 91
+#define ZMQ_RCVHWM_BYTES 92
+#define ZMQ_TCP_SHARDED_ACCEPT 93
+#define ZMQ_ZEROCOPY_THRESHOLD 94
+#define ZMQ_XPUB_CONFLATE_TOPICS 95
+#define ZMQ_RCVPRIORITY 96
+#define ZMQ_INBOUND_POLL_RATE 97
+#define ZMQ_MAX_COMMAND_DELAY 98
+#define ZMQ_ADAPTIVE_BATCH 99
+#define ZMQ_COALESCE_IVL 100
+#define ZMQ_COALESCE_BYTES 101
+#define ZMQ_COMPRESS_THRESHOLD 102
+#define ZMQ_CURVE_RESUME 103
+#define ZMQ_MEDIUM_MSG_SIZE 104
 
 /*  Message options                                                           */
 #define ZMQ_MORE 1
 #define ZMQ_SRCFD 2
 #define ZMQ_SHARED 3
+#define ZMQ_PRIORITY 4
 
 /*  Send/recv options.                                                        */
 #define ZMQ_DONTWAIT 1
@@ -391,6 +417,75 @@ ZMQ_EXPORT int zmq_send_const (void *s, const void *buf, size_t len, int flags);
 ZMQ_EXPORT int zmq_recv (void *s, void *buf, size_t len, int flags);
 ZMQ_EXPORT int zmq_socket_monitor (void *s, const char *addr, int events);
 
+/*  Socket capture                                                            */
+
+#define ZMQ_CAPTURE_SEND 1
+#define ZMQ_CAPTURE_RECV 2
+
+ZMQ_EXPORT int zmq_socket_capture (void *s, void *capture, int flags);
+
+/*  Socket statistics                                                         */
+
+typedef struct zmq_socket_stats_t
+{
+    /*  Message parts and their payload bytes passed through the socket.      */
+    uint64_t msgs_in;
+    uint64_t msgs_out;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    /*  Sends that could not proceed immediately because of the HWM.          */
+    uint64_t hwm_stalls;
+    /*  Message parts dropped by fan-out or by load-balancing.                */
+    uint64_t drops;
+    /*  Attached pipes and messages currently queued in them.                 */
+    uint64_t pipes;
+    uint64_t queued_in;
+    uint64_t queued_out;
+    /*  Traffic and system calls of the socket's TCP and IPC connections.     */
+    uint64_t wire_bytes_in;
+    uint64_t wire_bytes_out;
+    uint64_t read_calls;
+    uint64_t write_calls;
+    /*  Bytes currently held in the connections' decoders and encoders.       */
+    uint64_t decoder_bytes;
+    uint64_t encoder_bytes;
+    /*  Message parts carved from medium message buffers, and parts that fit  */
+    /*  them but went to the heap as the next slot was still in use.          */
+    uint64_t medium_msgs;
+    uint64_t medium_misses;
+} zmq_socket_stats_t;
+
+ZMQ_EXPORT int zmq_socket_stats (void *s, zmq_socket_stats_t *stats);
+
+/*  Message tracing                                                           */
+
+#define ZMQ_TRACE_SEND 1
+#define ZMQ_TRACE_PIPE_WRITE 2
+#define ZMQ_TRACE_ENCODE 3
+#define ZMQ_TRACE_WRITE 4
+#define ZMQ_TRACE_READ 5
+#define ZMQ_TRACE_DECODE 6
+#define ZMQ_TRACE_RECV 7
+
+typedef struct zmq_trace_event_t
+{
+    /*  Monotonic time in nanoseconds.                                        */
+    uint64_t time;
+    /*  Address of the socket, pipe or connection that recorded the event.    */
+    uint64_t object;
+    /*  Part size for SEND, PIPE_WRITE and RECV, offset of the frame in the   */
+    /*  connection's byte stream for ENCODE and DECODE, and bytes transferred */
+    /*  by the connection so far for WRITE and READ.                          */
+    uint64_t value;
+    /*  Index of the recording thread and one of ZMQ_TRACE_*.                 */
+    uint32_t thread;
+    uint32_t point;
+} zmq_trace_event_t;
+
+ZMQ_EXPORT int zmq_trace_start (size_t events_per_thread);
+ZMQ_EXPORT int zmq_trace_stop (void);
+ZMQ_EXPORT int zmq_trace_dump (zmq_trace_event_t *events, size_t *count);
+
 /******************************************************************************/
 /*  I/O multiplexing.                                                         */
 /******************************************************************************/
@@ -0,0 +1,230 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Compares fixed and adaptive batches (ZMQ_ADAPTIVE_BATCH) over the
+//  loopback interface in two regimes: sustained traffic, where a PUSH
+//  socket sends <message-count> messages of <message-size> bytes to a
+//  PULL socket as fast as it can, and sparse traffic, where two PAIR
+//  sockets bounce a message <roundtrip-count> times. Both runs start
+//  from batches of <batch-size> bytes.
+
+static int message_size;
+static int message_count;
+static int roundtrip_count;
+static int batch_size;
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+static void set_int (void *socket_, int option_, int value_)
+{
+    int rc = zmq_setsockopt (socket_, option_, &value_, sizeof (value_));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+}
+
+//  Creates a pair of sockets of the given types connected through
+//  endpoint_.
+static void connect_pair (void *ctx_, const char *endpoint_, int bind_type_,
+    int connect_type_, bool adaptive_, void **bound_, void **connected_)
+{
+    *bound_ = zmq_socket (ctx_, bind_type_);
+    if (!*bound_)
+        fail ("zmq_socket");
+    *connected_ = zmq_socket (ctx_, connect_type_);
+    if (!*connected_)
+        fail ("zmq_socket");
+
+    void *sockets [] = {*bound_, *connected_};
+    for (int i = 0; i != 2; i++) {
+        set_int (sockets [i], ZMQ_ADAPTIVE_BATCH, adaptive_);
+        set_int (sockets [i], ZMQ_TCP_RECV_BUFFER, batch_size);
+        set_int (sockets [i], ZMQ_TCP_SEND_BUFFER, batch_size);
+    }
+
+    int rc = zmq_bind (*bound_, endpoint_);
+    if (rc != 0)
+        fail ("zmq_bind");
+    rc = zmq_connect (*connected_, endpoint_);
+    if (rc != 0)
+        fail ("zmq_connect");
+}
+
+static void close_pair (void *bound_, void *connected_)
+{
+    int rc = zmq_close (connected_);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_close (bound_);
+    if (rc != 0)
+        fail ("zmq_close");
+}
+
+static void sender (void *push_)
+{
+    zmq_msg_t msg;
+    for (int i = 0; i != message_count; i++) {
+        int rc = zmq_msg_init_size (&msg, message_size);
+        if (rc != 0)
+            fail ("zmq_msg_init_size");
+        rc = zmq_msg_send (&msg, push_, 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+    }
+}
+
+static void bouncer (void *pair_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_init");
+    for (int i = 0; i != roundtrip_count; i++) {
+        rc = zmq_msg_recv (&msg, pair_, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+        rc = zmq_msg_send (&msg, pair_, 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+    }
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+}
+
+static void run (const char *name_, bool adaptive_)
+{
+    void *ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+
+    //  Sustained traffic.
+    void *pull;
+    void *push;
+    connect_pair (ctx, "tcp://127.0.0.1:5602", ZMQ_PULL, ZMQ_PUSH,
+        adaptive_, &pull, &push);
+
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_init");
+    rc = zmq_msg_send (&msg, push, 0);
+    if (rc < 0)
+        fail ("zmq_msg_send");
+    rc = zmq_msg_recv (&msg, pull, 0);
+    if (rc < 0)
+        fail ("zmq_msg_recv");
+
+    void *thread = zmq_threadstart (sender, push);
+    void *watch = zmq_stopwatch_start ();
+    for (int i = 0; i != message_count; i++) {
+        rc = zmq_msg_recv (&msg, pull, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+    }
+    unsigned long elapsed = zmq_stopwatch_stop (watch);
+    if (elapsed == 0)
+        elapsed = 1;
+    zmq_threadclose (thread);
+    close_pair (pull, push);
+
+    double throughput = (double) message_count / elapsed * 1000000;
+    double megabits = throughput * message_size * 8 / 1000000;
+
+    //  Sparse traffic.
+    void *pair;
+    void *peer;
+    connect_pair (ctx, "tcp://127.0.0.1:5603", ZMQ_PAIR, ZMQ_PAIR,
+        adaptive_, &pair, &peer);
+    thread = zmq_threadstart (bouncer, peer);
+
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+    rc = zmq_msg_init_size (&msg, message_size);
+    if (rc != 0)
+        fail ("zmq_msg_init_size");
+    watch = zmq_stopwatch_start ();
+    for (int i = 0; i != roundtrip_count; i++) {
+        rc = zmq_msg_send (&msg, pair, 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+        rc = zmq_msg_recv (&msg, pair, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+    }
+    elapsed = zmq_stopwatch_stop (watch);
+    zmq_threadclose (thread);
+    close_pair (pair, peer);
+
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+
+    printf ("%s: %.0f [msg/s], %.3f [Mb/s], latency %.3f [us]\n", name_,
+        throughput, megabits, (double) elapsed / (roundtrip_count * 2));
+
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 5) {
+        printf ("usage: adaptive_batch <message-size> <message-count> "
+            "<roundtrip-count> <batch-size>\n");
+        return 1;
+    }
+    message_size = atoi (argv [1]);
+    message_count = atoi (argv [2]);
+    roundtrip_count = atoi (argv [3]);
+    batch_size = atoi (argv [4]);
+    if (message_count < 1 || roundtrip_count < 1 || batch_size < 1) {
+        printf ("counts and batch size must be at least 1\n");
+        return 1;
+    }
+
+    printf ("message size: %d [B]\n", message_size);
+    printf ("message count: %d\n", message_count);
+    printf ("roundtrip count: %d\n", roundtrip_count);
+    printf ("batch size: %d [B]\n", batch_size);
+    run ("fixed", false);
+    run ("adaptive", true);
+    return 0;
+}
@@ -0,0 +1,536 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.hpp"
+
+#if defined ZMQ_HAVE_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+//  Benchmark suite for comparing transport and allocator changes. Each run
+//  measures one scenario over a sweep of message sizes and prints one CSV
+//  row per size, with throughput, throughput per CPU second consumed by the
+//  process and the latency distribution.
+//
+//  pairs   N REQ/REP pairs doing roundtrips in parallel. Latency is half
+//          the roundtrip time.
+//  fanout  One XPUB publishing to N SUB sockets, each in its own thread.
+//          Latency is the delivery time of each copy, including queueing.
+//  router  One ROUTER echoing requests from N DEALER peers, all driven
+//          from a single thread one request per peer at a time.
+//  skew    Same as pairs, but each busy pair is followed by three idle
+//          pairs, so that the connections are spread over the I/O threads
+//          by number rather than by traffic. Run it with several I/O threads
+//          and with and without rebalancing to see the difference.
+//
+//  Messages shorter than 8 bytes cannot carry a timestamp, so latency is
+//  only reported for larger messages.
+
+static const char *transport;
+static int message_count;
+static int parallelism;
+
+//  Monotonic time in nanoseconds, comparable across threads.
+static uint64_t now_ns ()
+{
+#if defined ZMQ_HAVE_WINDOWS
+    LARGE_INTEGER ticks, frequency;
+    QueryPerformanceCounter (&ticks);
+    QueryPerformanceFrequency (&frequency);
+    return (uint64_t) (ticks.QuadPart * 1000000000.0 / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+//  CPU time consumed by the process in nanoseconds.
+static uint64_t cpu_ns ()
+{
+#if defined ZMQ_HAVE_WINDOWS
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes (GetCurrentProcess (), &creation, &exit, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 100;
+#else
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    return ((uint64_t) usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+        * 1000000000 + ((uint64_t) usage.ru_utime.tv_usec
+        + usage.ru_stime.tv_usec) * 1000;
+#endif
+}
+
+static void fail (const char *what_)
+{
+    printf ("error in %s: %s\n", what_, zmq_strerror (errno));
+    exit (1);
+}
+
+static void endpoint (char *buf_, size_t size_, int index_)
+{
+    if (strcmp (transport, "inproc") == 0)
+        snprintf (buf_, size_, "inproc://benchmark-%d", index_);
+    else
+    if (strcmp (transport, "ipc") == 0)
+        snprintf (buf_, size_, "ipc:///tmp/zmq-benchmark-%d", index_);
+    else
+        snprintf (buf_, size_, "tcp://127.0.0.1:%d", 5700 + index_);
+}
+
+//  Latency samples of one thread.
+struct samples_t
+{
+    uint64_t *values;
+    int count;
+};
+
+static void samples_init (samples_t *samples_, int capacity_)
+{
+    samples_->values = (uint64_t *) malloc (capacity_ * sizeof (uint64_t));
+    if (!samples_->values) {
+        printf ("error in malloc\n");
+        exit (1);
+    }
+    samples_->count = 0;
+}
+
+static int compare_uint64 (const void *a_, const void *b_)
+{
+    uint64_t a = *(const uint64_t *) a_;
+    uint64_t b = *(const uint64_t *) b_;
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static void stamp (zmq_msg_t *msg_)
+{
+    if (zmq_msg_size (msg_) >= sizeof (uint64_t)) {
+        uint64_t now = now_ns ();
+        memcpy (zmq_msg_data (msg_), &now, sizeof now);
+    }
+}
+
+static void record (samples_t *samples_, zmq_msg_t *msg_)
+{
+    if (zmq_msg_size (msg_) >= sizeof (uint64_t)) {
+        uint64_t sent;
+        memcpy (&sent, zmq_msg_data (msg_), sizeof sent);
+        samples_->values [samples_->count++] = now_ns () - sent;
+    }
+}
+
+static void send_msg (void *s_, zmq_msg_t *msg_, size_t size_, int flags_)
+{
+    int rc = zmq_msg_init_size (msg_, size_);
+    if (rc != 0)
+        fail ("zmq_msg_init_size");
+    memset (zmq_msg_data (msg_), 0, size_);
+    stamp (msg_);
+    rc = zmq_msg_send (msg_, s_, flags_);
+    if (rc < 0)
+        fail ("zmq_msg_send");
+}
+
+static void recv_msg (void *s_, zmq_msg_t *msg_)
+{
+    int rc = zmq_msg_recv (msg_, s_, 0);
+    if (rc < 0)
+        fail ("zmq_msg_recv");
+}
+
+struct worker_t
+{
+    void *socket;
+    size_t message_size;
+    int count;
+    samples_t samples;
+    uint64_t elapsed;
+    void *thread;
+};
+
+static void pair_server (void *arg_)
+{
+    worker_t *w = (worker_t *) arg_;
+    zmq_msg_t msg;
+    zmq_msg_init (&msg);
+    for (int i = 0; i != w->count + 1; i++) {
+        recv_msg (w->socket, &msg);
+        if (zmq_msg_send (&msg, w->socket, 0) < 0)
+            fail ("zmq_msg_send");
+    }
+    zmq_msg_close (&msg);
+}
+
+static void pair_client (void *arg_)
+{
+    worker_t *w = (worker_t *) arg_;
+    zmq_msg_t msg;
+
+    //  Warm up, so that connection setup is not measured.
+    send_msg (w->socket, &msg, w->message_size, 0);
+    recv_msg (w->socket, &msg);
+    zmq_msg_close (&msg);
+
+    uint64_t start = now_ns ();
+    for (int i = 0; i != w->count; i++) {
+        send_msg (w->socket, &msg, w->message_size, 0);
+        recv_msg (w->socket, &msg);
+        record (&w->samples, &msg);
+        zmq_msg_close (&msg);
+    }
+    w->elapsed = now_ns () - start;
+
+    //  Report one-way latency.
+    for (int i = 0; i != w->samples.count; i++)
+        w->samples.values [i] /= 2;
+}
+
+static void subscriber (void *arg_)
+{
+    worker_t *w = (worker_t *) arg_;
+    zmq_msg_t msg;
+    zmq_msg_init (&msg);
+    for (int i = 0; i != w->count; i++) {
+        recv_msg (w->socket, &msg);
+        record (&w->samples, &msg);
+    }
+    zmq_msg_close (&msg);
+}
+
+static void router_echo (void *arg_)
+{
+    worker_t *w = (worker_t *) arg_;
+    zmq_msg_t identity, msg;
+    zmq_msg_init (&identity);
+    zmq_msg_init (&msg);
+    for (int i = 0; i != w->count; i++) {
+        recv_msg (w->socket, &identity);
+        recv_msg (w->socket, &msg);
+        if (zmq_msg_send (&identity, w->socket, ZMQ_SNDMORE) < 0)
+            fail ("zmq_msg_send");
+        if (zmq_msg_send (&msg, w->socket, 0) < 0)
+            fail ("zmq_msg_send");
+    }
+    zmq_msg_close (&identity);
+    zmq_msg_close (&msg);
+}
+
+static void close_socket (void *s_)
+{
+    int linger = 0;
+    zmq_setsockopt (s_, ZMQ_LINGER, &linger, sizeof linger);
+    if (zmq_close (s_) != 0)
+        fail ("zmq_close");
+}
+
+static void *make_socket (void *ctx_, int type_)
+{
+    void *s = zmq_socket (ctx_, type_);
+    if (!s)
+        fail ("zmq_socket");
+    return s;
+}
+
+//  Connects an idle REQ/REP pair, storing the sockets in sockets_.
+static void idle_pair (void *ctx_, int index_, void **sockets_)
+{
+    char addr [64];
+    endpoint (addr, sizeof addr, index_);
+    sockets_ [0] = make_socket (ctx_, ZMQ_REP);
+    if (zmq_bind (sockets_ [0], addr) != 0)
+        fail ("zmq_bind");
+    sockets_ [1] = make_socket (ctx_, ZMQ_REQ);
+    if (zmq_connect (sockets_ [1], addr) != 0)
+        fail ("zmq_connect");
+}
+
+//  Runs N REQ/REP pairs, each followed by idle_ idle pairs, returns the
+//  number of messages transferred.
+static uint64_t run_pairs (void *ctx_, size_t size_, worker_t *clients_,
+    int idle_)
+{
+    worker_t *servers = (worker_t *) calloc (parallelism, sizeof (worker_t));
+    void **idle = (void **) malloc ((parallelism * idle_ * 2 + 1) *
+        sizeof (void *));
+    char addr [64];
+    for (int i = 0; i != parallelism; i++) {
+        endpoint (addr, sizeof addr, i * (idle_ + 1));
+        servers [i].socket = make_socket (ctx_, ZMQ_REP);
+        if (zmq_bind (servers [i].socket, addr) != 0)
+            fail ("zmq_bind");
+        servers [i].count = message_count;
+        clients_ [i].socket = make_socket (ctx_, ZMQ_REQ);
+        if (zmq_connect (clients_ [i].socket, addr) != 0)
+            fail ("zmq_connect");
+        clients_ [i].message_size = size_;
+        clients_ [i].count = message_count;
+        samples_init (&clients_ [i].samples, message_count);
+        for (int j = 0; j != idle_; j++)
+            idle_pair (ctx_, i * (idle_ + 1) + j + 1,
+                idle + (i * idle_ + j) * 2);
+    }
+
+    for (int i = 0; i != parallelism; i++) {
+        servers [i].thread = zmq_threadstart (pair_server, &servers [i]);
+        clients_ [i].thread = zmq_threadstart (pair_client, &clients_ [i]);
+    }
+    for (int i = 0; i != parallelism; i++) {
+        zmq_threadclose (clients_ [i].thread);
+        zmq_threadclose (servers [i].thread);
+        close_socket (clients_ [i].socket);
+        close_socket (servers [i].socket);
+    }
+    for (int i = 0; i != parallelism * idle_ * 2; i++)
+        close_socket (idle [i]);
+    free (idle);
+    free (servers);
+    return (uint64_t) message_count * parallelism * 2;
+}
+
+//  Publishes to N subscribers, returns the number of messages delivered.
+static uint64_t run_fanout (void *ctx_, size_t size_, worker_t *subs_)
+{
+    char addr [64];
+    endpoint (addr, sizeof addr, 0);
+
+    //  Block the publisher at the HWM rather than dropping messages, and
+    //  see every subscription so we know when all subscribers are there.
+    void *pub = make_socket (ctx_, ZMQ_XPUB);
+    int on = 1;
+    if (zmq_setsockopt (pub, ZMQ_XPUB_NODROP, &on, sizeof on) != 0
+    ||  zmq_setsockopt (pub, ZMQ_XPUB_VERBOSE, &on, sizeof on) != 0)
+        fail ("zmq_setsockopt");
+    if (zmq_bind (pub, addr) != 0)
+        fail ("zmq_bind");
+
+    for (int i = 0; i != parallelism; i++) {
+        subs_ [i].socket = make_socket (ctx_, ZMQ_SUB);
+        if (zmq_setsockopt (subs_ [i].socket, ZMQ_SUBSCRIBE, "", 0) != 0)
+            fail ("zmq_setsockopt");
+        if (zmq_connect (subs_ [i].socket, addr) != 0)
+            fail ("zmq_connect");
+        subs_ [i].count = message_count;
+        samples_init (&subs_ [i].samples, message_count);
+    }
+
+    //  Wait for all the subscriptions to arrive.
+    zmq_msg_t msg;
+    zmq_msg_init (&msg);
+    for (int i = 0; i != parallelism; i++)
+        recv_msg (pub, &msg);
+    zmq_msg_close (&msg);
+
+    uint64_t start = now_ns ();
+    for (int i = 0; i != parallelism; i++)
+        subs_ [i].thread = zmq_threadstart (subscriber, &subs_ [i]);
+    for (int i = 0; i != message_count; i++)
+        send_msg (pub, &msg, size_, 0);
+    for (int i = 0; i != parallelism; i++) {
+        zmq_threadclose (subs_ [i].thread);
+        subs_ [i].elapsed = now_ns () - start;
+        close_socket (subs_ [i].socket);
+    }
+    close_socket (pub);
+    return (uint64_t) message_count * parallelism;
+}
+
+//  Drives N DEALER peers of one ROUTER, returns the number of messages
+//  transferred.
+static uint64_t run_router (void *ctx_, size_t size_, worker_t *client_)
+{
+    char addr [64];
+    endpoint (addr, sizeof addr, 0);
+
+    worker_t server;
+    server.socket = make_socket (ctx_, ZMQ_ROUTER);
+    int hwm = 0;
+    if (zmq_setsockopt (server.socket, ZMQ_SNDHWM, &hwm, sizeof hwm) != 0)
+        fail ("zmq_setsockopt");
+    if (zmq_bind (server.socket, addr) != 0)
+        fail ("zmq_bind");
+    server.count = (message_count + 1) * parallelism;
+
+    void **peers = (void **) malloc (parallelism * sizeof (void *));
+    for (int i = 0; i != parallelism; i++) {
+        peers [i] = make_socket (ctx_, ZMQ_DEALER);
+        if (zmq_connect (peers [i], addr) != 0)
+            fail ("zmq_connect");
+    }
+    samples_init (&client_->samples, message_count * parallelism);
+    server.thread = zmq_threadstart (router_echo, &server);
+
+    //  Warm up every connection first.
+    zmq_msg_t request, reply;
+    zmq_msg_init (&reply);
+    for (int i = 0; i != parallelism; i++)
+        send_msg (peers [i], &request, size_, 0);
+    for (int i = 0; i != parallelism; i++)
+        recv_msg (peers [i], &reply);
+
+    uint64_t start = now_ns ();
+    for (int round = 0; round != message_count; round++) {
+        for (int i = 0; i != parallelism; i++)
+            send_msg (peers [i], &request, size_, 0);
+        for (int i = 0; i != parallelism; i++) {
+            recv_msg (peers [i], &reply);
+            record (&client_->samples, &reply);
+        }
+    }
+    client_->elapsed = now_ns () - start;
+    zmq_msg_close (&reply);
+
+    zmq_threadclose (server.thread);
+    for (int i = 0; i != parallelism; i++)
+        close_socket (peers [i]);
+    free (peers);
+    close_socket (server.socket);
+    return (uint64_t) message_count * parallelism * 2;
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc < 6 || argc > 8) {
+        printf ("usage: benchmark <pairs|fanout|router|skew> "
+            "<inproc|ipc|tcp> <message-sizes> <message-count> <parallelism> "
+            "[io-threads] [rebalance-ivl]\n"
+            "  message-sizes is a comma-separated list, e.g. 8,256,65536\n"
+            "  rebalance-ivl sets ZMQ_IO_REBALANCE_IVL in milliseconds\n");
+        return 1;
+    }
+    const char *scenario = argv [1];
+    transport = argv [2];
+    message_count = atoi (argv [4]);
+    parallelism = atoi (argv [5]);
+    int io_threads = argc >= 7 ? atoi (argv [6]) : 1;
+    int rebalance_ivl = argc == 8 ? atoi (argv [7]) : 0;
+
+    if (strcmp (scenario, "pairs") != 0 && strcmp (scenario, "fanout") != 0
+    &&  strcmp (scenario, "router") != 0 && strcmp (scenario, "skew") != 0) {
+        printf ("unknown scenario: %s\n", scenario);
+        return 1;
+    }
+    if (message_count <= 0 || parallelism <= 0 || io_threads < 0
+    ||  rebalance_ivl < 0) {
+        printf ("message count and parallelism must be positive\n");
+        return 1;
+    }
+
+    printf ("scenario,transport,io_threads,rebalance_ivl,parallelism,"
+        "message_size,"
+        "messages,elapsed_s,msgs_per_s,msgs_per_cpu_s,"
+        "p50_us,p99_us,p99_9_us,max_us\n");
+
+    char *sizes = argv [3];
+    for (char *size_str = strtok (sizes, ","); size_str;
+          size_str = strtok (NULL, ",")) {
+        size_t size = (size_t) atoi (size_str);
+
+        void *ctx = zmq_ctx_new ();
+        if (!ctx)
+            fail ("zmq_ctx_new");
+        if (zmq_ctx_set (ctx, ZMQ_IO_THREADS, io_threads) != 0
+        ||  zmq_ctx_set (ctx, ZMQ_IO_REBALANCE_IVL, rebalance_ivl) != 0)
+            fail ("zmq_ctx_set");
+
+        int workers_count = strcmp (scenario, "router") == 0 ? 1 : parallelism;
+        worker_t *workers =
+            (worker_t *) calloc (workers_count, sizeof (worker_t));
+
+        uint64_t cpu_start = cpu_ns ();
+        uint64_t messages;
+        if (strcmp (scenario, "pairs") == 0)
+            messages = run_pairs (ctx, size, workers, 0);
+        else
+        if (strcmp (scenario, "skew") == 0)
+            messages = run_pairs (ctx, size, workers, 3);
+        else
+        if (strcmp (scenario, "fanout") == 0)
+            messages = run_fanout (ctx, size, workers);
+        else
+            messages = run_router (ctx, size, workers);
+        uint64_t cpu = cpu_ns () - cpu_start;
+
+        if (zmq_ctx_term (ctx) != 0)
+            fail ("zmq_ctx_term");
+
+        //  Merge the samples of all the workers. The run took as long as
+        //  the slowest worker.
+        uint64_t elapsed = 0;
+        int total = 0;
+        for (int i = 0; i != workers_count; i++) {
+            if (workers [i].elapsed > elapsed)
+                elapsed = workers [i].elapsed;
+            total += workers [i].samples.count;
+        }
+        uint64_t *all = (uint64_t *) malloc ((total + 1) * sizeof (uint64_t));
+        total = 0;
+        for (int i = 0; i != workers_count; i++) {
+            memcpy (all + total, workers [i].samples.values,
+                workers [i].samples.count * sizeof (uint64_t));
+            total += workers [i].samples.count;
+            free (workers [i].samples.values);
+        }
+        free (workers);
+
+        double seconds = elapsed / 1e9;
+        printf ("%s,%s,%d,%d,%d,%d,%llu,%.6f,%.0f,%.0f", scenario,
+            transport, io_threads, rebalance_ivl, parallelism, (int) size,
+            (unsigned long long) messages, seconds,
+            seconds > 0 ? messages / seconds : 0.0,
+            cpu > 0 ? messages / (cpu / 1e9) : 0.0);
+        if (total > 0) {
+            qsort (all, total, sizeof (uint64_t), compare_uint64);
+            printf (",%.3f,%.3f,%.3f,%.3f\n", all [total / 2] / 1e3,
+                all [(int) (total * 0.99)] / 1e3,
+                all [(int) (total * 0.999)] / 1e3,
+                all [total - 1] / 1e3);
+        }
+        else
+            printf (",,,,\n");
+        fflush (stdout);
+        free (all);
+    }
+
+    return 0;
+}
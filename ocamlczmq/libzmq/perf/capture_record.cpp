@@ -0,0 +1,224 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/zmq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "platform.hpp"
+
+#if defined ZMQ_HAVE_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//  Records the messages published by a capture socket, see
+//  zmq_socket_capture(3), into a log that capture_replay can re-inject.
+//  A PULL or SUB socket connects to <endpoint> and <message-count>
+//  multi-part messages are recorded, or all of them until interrupted if
+//  <message-count> is 0.
+//
+//  The log starts with the 8 byte magic "ZMQCAP1\0", followed by one record
+//  per multi-part message: the time the first part was received, in
+//  microseconds since the recording started, as a 64 bit integer, the
+//  number of parts as a 32 bit integer and, for each part, its size as a
+//  32 bit integer followed by its bytes. Integers are in network byte order.
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_interrupt (int)
+{
+    interrupted = 1;
+}
+
+static uint64_t now_us ()
+{
+#if defined ZMQ_HAVE_WINDOWS
+    LARGE_INTEGER ticks, frequency;
+    QueryPerformanceCounter (&ticks);
+    QueryPerformanceFrequency (&frequency);
+    return (uint64_t) (ticks.QuadPart * 1000000.0 / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static void put_u32 (unsigned char *buffer_, uint32_t value_)
+{
+    buffer_ [0] = (unsigned char) (value_ >> 24);
+    buffer_ [1] = (unsigned char) (value_ >> 16);
+    buffer_ [2] = (unsigned char) (value_ >> 8);
+    buffer_ [3] = (unsigned char) value_;
+}
+
+static void put_u64 (unsigned char *buffer_, uint64_t value_)
+{
+    put_u32 (buffer_, (uint32_t) (value_ >> 32));
+    put_u32 (buffer_ + 4, (uint32_t) value_);
+}
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+int main (int argc, char *argv [])
+{
+    const char *endpoint;
+    int type;
+    FILE *log;
+    int message_count;
+    void *ctx;
+    void *s;
+    zmq_msg_t parts [64];
+    unsigned char header [12];
+    uint64_t start;
+    uint64_t received;
+    uint64_t bytes;
+    int count;
+    int more;
+    int rc;
+    int i;
+
+    if (argc != 5) {
+        printf ("usage: capture_record <endpoint> <pull|sub> <log-file> "
+            "<message-count>\n");
+        return 1;
+    }
+    endpoint = argv [1];
+    if (strcmp (argv [2], "pull") == 0)
+        type = ZMQ_PULL;
+    else
+    if (strcmp (argv [2], "sub") == 0)
+        type = ZMQ_SUB;
+    else {
+        printf ("socket type must be pull or sub\n");
+        return 1;
+    }
+    message_count = atoi (argv [4]);
+
+    log = fopen (argv [3], "wb");
+    if (!log) {
+        printf ("cannot open %s\n", argv [3]);
+        return 1;
+    }
+    if (fwrite ("ZMQCAP1", 1, 8, log) != 8) {
+        printf ("cannot write %s\n", argv [3]);
+        return 1;
+    }
+
+    ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+    s = zmq_socket (ctx, type);
+    if (!s)
+        fail ("zmq_socket");
+    if (type == ZMQ_SUB) {
+        rc = zmq_setsockopt (s, ZMQ_SUBSCRIBE, "", 0);
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+    }
+    rc = zmq_connect (s, endpoint);
+    if (rc != 0)
+        fail ("zmq_connect");
+
+    signal (SIGINT, on_interrupt);
+    signal (SIGTERM, on_interrupt);
+
+    start = now_us ();
+    bytes = 0;
+    for (count = 0; message_count == 0 || count != message_count; count++) {
+
+        //  Gather the whole multi-part message before writing it out.
+        received = 0;
+        more = 1;
+        for (i = 0; more; i++) {
+            if (i == (int) (sizeof parts / sizeof parts [0])) {
+                printf ("message has too many parts\n");
+                return 1;
+            }
+            rc = zmq_msg_init (&parts [i]);
+            if (rc != 0)
+                fail ("zmq_msg_init");
+            rc = zmq_msg_recv (&parts [i], s, 0);
+            if (rc < 0 && errno == EINTR && interrupted) {
+                zmq_msg_close (&parts [i]);
+                break;
+            }
+            if (rc < 0)
+                fail ("zmq_msg_recv");
+            if (i == 0)
+                received = now_us () - start;
+            more = zmq_msg_more (&parts [i]);
+        }
+        if (more) {
+            //  Interrupted in the middle of a message; drop what we have.
+            while (i-- != 0)
+                zmq_msg_close (&parts [i]);
+            break;
+        }
+
+        put_u64 (header, received);
+        put_u32 (header + 8, (uint32_t) i);
+        if (fwrite (header, 1, 12, log) != 12) {
+            printf ("cannot write %s\n", argv [3]);
+            return 1;
+        }
+        for (int j = 0; j != i; j++) {
+            size_t size = zmq_msg_size (&parts [j]);
+            put_u32 (header, (uint32_t) size);
+            if (fwrite (header, 1, 4, log) != 4 ||
+                  fwrite (zmq_msg_data (&parts [j]), 1, size, log) != size) {
+                printf ("cannot write %s\n", argv [3]);
+                return 1;
+            }
+            bytes += size;
+            zmq_msg_close (&parts [j]);
+        }
+    }
+
+    if (fclose (log) != 0) {
+        printf ("cannot write %s\n", argv [3]);
+        return 1;
+    }
+
+    printf ("messages recorded: %d\n", count);
+    printf ("payload bytes: %lu\n", (unsigned long) bytes);
+    printf ("duration [ms]: %.3f\n", (now_us () - start) / 1000.0);
+
+    zmq_close (s);
+    zmq_ctx_term (ctx);
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/zmq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.hpp"
+
+#if defined ZMQ_HAVE_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//  Re-injects the messages recorded by capture_record. A socket of type
+//  <push|pub|dealer> connects to <endpoint> and sends the messages in the
+//  log, each one at its recorded time, counted from the first message,
+//  divided by <rate-scale>: 1 replays at the original rate, 2 twice as
+//  fast and 0 as fast as possible.
+//  Reports the rate achieved and how late the messages were sent against
+//  their schedule.
+
+static uint64_t now_us ()
+{
+#if defined ZMQ_HAVE_WINDOWS
+    LARGE_INTEGER ticks, frequency;
+    QueryPerformanceCounter (&ticks);
+    QueryPerformanceFrequency (&frequency);
+    return (uint64_t) (ticks.QuadPart * 1000000.0 / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static uint32_t get_u32 (const unsigned char *buffer_)
+{
+    return ((uint32_t) buffer_ [0] << 24) | ((uint32_t) buffer_ [1] << 16) |
+        ((uint32_t) buffer_ [2] << 8) | buffer_ [3];
+}
+
+static uint64_t get_u64 (const unsigned char *buffer_)
+{
+    return ((uint64_t) get_u32 (buffer_) << 32) | get_u32 (buffer_ + 4);
+}
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+//  Waits until the given time; sleeps while it is far away and spins for
+//  the last millisecond, as sleeping is not precise enough for that.
+static void wait_until (uint64_t deadline_)
+{
+    while (true) {
+        uint64_t now = now_us ();
+        if (now >= deadline_)
+            return;
+        if (deadline_ - now > 2000)
+            zmq_poll (NULL, 0, (long) ((deadline_ - now) / 1000 - 1));
+    }
+}
+
+int main (int argc, char *argv [])
+{
+    const char *endpoint;
+    int type;
+    FILE *log;
+    double rate_scale;
+    void *ctx;
+    void *s;
+    zmq_msg_t part;
+    unsigned char header [12];
+    char magic [8];
+    uint64_t start;
+    uint64_t first;
+    uint64_t scheduled;
+    uint64_t late;
+    uint64_t late_total;
+    uint64_t late_max;
+    uint64_t bytes;
+    uint64_t elapsed;
+    uint32_t part_count;
+    uint32_t size;
+    int count;
+    int rc;
+
+    if (argc != 5) {
+        printf ("usage: capture_replay <log-file> <endpoint> "
+            "<push|pub|dealer> <rate-scale>\n");
+        return 1;
+    }
+    endpoint = argv [2];
+    if (strcmp (argv [3], "push") == 0)
+        type = ZMQ_PUSH;
+    else
+    if (strcmp (argv [3], "pub") == 0)
+        type = ZMQ_PUB;
+    else
+    if (strcmp (argv [3], "dealer") == 0)
+        type = ZMQ_DEALER;
+    else {
+        printf ("socket type must be push, pub or dealer\n");
+        return 1;
+    }
+    rate_scale = atof (argv [4]);
+    if (rate_scale < 0) {
+        printf ("rate-scale must not be negative\n");
+        return 1;
+    }
+
+    log = fopen (argv [1], "rb");
+    if (!log) {
+        printf ("cannot open %s\n", argv [1]);
+        return 1;
+    }
+    if (fread (magic, 1, 8, log) != 8 || memcmp (magic, "ZMQCAP1", 8) != 0) {
+        printf ("%s is not a capture log\n", argv [1]);
+        return 1;
+    }
+
+    ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+    s = zmq_socket (ctx, type);
+    if (!s)
+        fail ("zmq_socket");
+    rc = zmq_connect (s, endpoint);
+    if (rc != 0)
+        fail ("zmq_connect");
+
+    //  Give subscribers time to connect and subscribe, or the first
+    //  messages would be lost.
+    if (type == ZMQ_PUB)
+        zmq_sleep (1);
+
+    start = now_us ();
+    first = 0;
+    late_total = 0;
+    late_max = 0;
+    bytes = 0;
+    for (count = 0; fread (header, 1, 12, log) == 12; count++) {
+        part_count = get_u32 (header + 8);
+        if (part_count == 0) {
+            printf ("corrupt capture log\n");
+            return 1;
+        }
+
+        if (count == 0)
+            first = get_u64 (header);
+        if (rate_scale > 0) {
+            scheduled = start +
+                (uint64_t) ((get_u64 (header) - first) / rate_scale);
+            wait_until (scheduled);
+            late = now_us () - scheduled;
+            late_total += late;
+            if (late > late_max)
+                late_max = late;
+        }
+
+        for (uint32_t i = 0; i != part_count; i++) {
+            if (fread (header, 1, 4, log) != 4) {
+                printf ("corrupt capture log\n");
+                return 1;
+            }
+            size = get_u32 (header);
+            rc = zmq_msg_init_size (&part, size);
+            if (rc != 0)
+                fail ("zmq_msg_init_size");
+            if (fread (zmq_msg_data (&part), 1, size, log) != size) {
+                printf ("corrupt capture log\n");
+                return 1;
+            }
+            rc = zmq_msg_send (&part, s,
+                i + 1 != part_count ? ZMQ_SNDMORE : 0);
+            if (rc < 0)
+                fail ("zmq_msg_send");
+            bytes += size;
+        }
+    }
+    elapsed = now_us () - start;
+    fclose (log);
+
+    printf ("messages replayed: %d\n", count);
+    printf ("payload bytes: %lu\n", (unsigned long) bytes);
+    printf ("duration [ms]: %.3f\n", elapsed / 1000.0);
+    if (elapsed != 0)
+        printf ("mean throughput [msg/s]: %.0f\n",
+            count * 1000000.0 / elapsed);
+    if (rate_scale > 0 && count != 0) {
+        printf ("mean lateness [us]: %.1f\n", (double) late_total / count);
+        printf ("max lateness [us]: %lu\n", (unsigned long) late_max);
+    }
+
+    zmq_close (s);
+    zmq_ctx_term (ctx);
+    return 0;
+}
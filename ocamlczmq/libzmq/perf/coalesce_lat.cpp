@@ -0,0 +1,241 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//  Compares writing output at once with coalescing it (ZMQ_COALESCE_IVL)
+//  over the loopback interface. A PUSH socket sends a trickle of
+//  <message-count> messages of <message-size> bytes, one every <gap-us>
+//  microseconds, and the write system calls its connection took per
+//  message are reported. Then a PAIR socket bounces a message
+//  <message-count> times off a peer that does not coalesce, showing the
+//  latency coalescing adds. Coalescing holds batches back for up to
+//  <coalesce-ivl> milliseconds.
+
+static int message_size;
+static int message_count;
+static int gap;
+static int coalesce_ivl;
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+static void set_int (void *socket_, int option_, int value_)
+{
+    int rc = zmq_setsockopt (socket_, option_, &value_, sizeof (value_));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+}
+
+//  Creates a pair of sockets of the given types connected through
+//  endpoint_, the connecting one holding its output back for ivl_
+//  milliseconds.
+static void connect_pair (void *ctx_, const char *endpoint_, int bind_type_,
+    int connect_type_, int ivl_, void **bound_, void **connected_)
+{
+    *bound_ = zmq_socket (ctx_, bind_type_);
+    if (!*bound_)
+        fail ("zmq_socket");
+    *connected_ = zmq_socket (ctx_, connect_type_);
+    if (!*connected_)
+        fail ("zmq_socket");
+    set_int (*connected_, ZMQ_COALESCE_IVL, ivl_);
+
+    int rc = zmq_bind (*bound_, endpoint_);
+    if (rc != 0)
+        fail ("zmq_bind");
+    rc = zmq_connect (*connected_, endpoint_);
+    if (rc != 0)
+        fail ("zmq_connect");
+}
+
+static void close_pair (void *bound_, void *connected_)
+{
+    int rc = zmq_close (connected_);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_close (bound_);
+    if (rc != 0)
+        fail ("zmq_close");
+}
+
+static void sender (void *push_)
+{
+    struct timespec pause;
+    pause.tv_sec = gap / 1000000;
+    pause.tv_nsec = (long) (gap % 1000000) * 1000;
+
+    zmq_msg_t msg;
+    for (int i = 0; i != message_count; i++) {
+        int rc = zmq_msg_init_size (&msg, message_size);
+        if (rc != 0)
+            fail ("zmq_msg_init_size");
+        rc = zmq_msg_send (&msg, push_, 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+        if (gap)
+            nanosleep (&pause, NULL);
+    }
+}
+
+static void bouncer (void *pair_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_init");
+    for (int i = 0; i != message_count; i++) {
+        rc = zmq_msg_recv (&msg, pair_, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+        rc = zmq_msg_send (&msg, pair_, 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+    }
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+}
+
+static void run (const char *name_, const char *trickle_endpoint_,
+    const char *bounce_endpoint_, int ivl_)
+{
+    void *ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+
+    //  Trickle.
+    void *pull;
+    void *push;
+    connect_pair (ctx, trickle_endpoint_, ZMQ_PULL, ZMQ_PUSH, ivl_,
+        &pull, &push);
+
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_init");
+    rc = zmq_msg_send (&msg, push, 0);
+    if (rc < 0)
+        fail ("zmq_msg_send");
+    rc = zmq_msg_recv (&msg, pull, 0);
+    if (rc < 0)
+        fail ("zmq_msg_recv");
+
+    zmq_socket_stats_t before;
+    rc = zmq_socket_stats (push, &before);
+    if (rc != 0)
+        fail ("zmq_socket_stats");
+    void *thread = zmq_threadstart (sender, push);
+    for (int i = 0; i != message_count; i++) {
+        rc = zmq_msg_recv (&msg, pull, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+    }
+    zmq_threadclose (thread);
+    zmq_socket_stats_t after;
+    rc = zmq_socket_stats (push, &after);
+    if (rc != 0)
+        fail ("zmq_socket_stats");
+    close_pair (pull, push);
+
+    double writes = (double) (after.write_calls - before.write_calls)
+        / message_count;
+
+    //  Round trips.
+    void *pair;
+    void *peer;
+    connect_pair (ctx, bounce_endpoint_, ZMQ_PAIR, ZMQ_PAIR, ivl_,
+        &peer, &pair);
+    thread = zmq_threadstart (bouncer, peer);
+
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+    rc = zmq_msg_init_size (&msg, message_size);
+    if (rc != 0)
+        fail ("zmq_msg_init_size");
+    void *watch = zmq_stopwatch_start ();
+    for (int i = 0; i != message_count; i++) {
+        rc = zmq_msg_send (&msg, pair, 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+        rc = zmq_msg_recv (&msg, pair, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+    }
+    unsigned long elapsed = zmq_stopwatch_stop (watch);
+    zmq_threadclose (thread);
+    close_pair (peer, pair);
+
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+
+    printf ("%s: %.3f [writes/msg], round trip %.3f [us]\n", name_,
+        writes, (double) elapsed / message_count);
+
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 5) {
+        printf ("usage: coalesce_lat <message-size> <message-count> "
+            "<gap-us> <coalesce-ivl>\n");
+        return 1;
+    }
+    message_size = atoi (argv [1]);
+    message_count = atoi (argv [2]);
+    gap = atoi (argv [3]);
+    coalesce_ivl = atoi (argv [4]);
+    if (message_count < 1 || gap < 0 || coalesce_ivl < 1) {
+        printf ("message count and coalesce interval must be at least 1\n");
+        return 1;
+    }
+
+    printf ("message size: %d [B]\n", message_size);
+    printf ("message count: %d\n", message_count);
+    printf ("gap: %d [us]\n", gap);
+    printf ("coalesce interval: %d [ms]\n", coalesce_ivl);
+    run ("immediate", "tcp://127.0.0.1:5608", "tcp://127.0.0.1:5609", 0);
+    run ("coalesced", "tcp://127.0.0.1:5610", "tcp://127.0.0.1:5611",
+        coalesce_ivl);
+    return 0;
+}
@@ -0,0 +1,343 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined _WIN32
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+//  Measures what ZMQ_COMPRESS_THRESHOLD gains over a link of limited
+//  bandwidth. A PUSH socket sends <message-count> messages of
+//  <message-size> bytes of text resembling counterexample traces to a
+//  PULL socket through a relay that forwards the traffic over the
+//  loopback interface at <link-mbps> megabits per second. The bytes that
+//  went on the wire per message and the end-to-end throughput are
+//  reported without compression and with frames of 256 bytes or more
+//  compressed.
+
+#if !defined _WIN32
+
+static int message_size;
+static int message_count;
+static double link_rate;
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+static double now ()
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void write_all (int fd_, const char *data_, ssize_t size_)
+{
+    while (size_ > 0) {
+        const ssize_t n = write (fd_, data_, size_);
+        if (n <= 0)
+            fail ("write");
+        data_ += n;
+        size_ -= n;
+    }
+}
+
+struct relay_t
+{
+    int listener;
+    int server_port;
+};
+
+//  Accepts a single connection and forwards it to the server port, the
+//  client to server direction being limited to link_rate bytes per
+//  second by a token bucket. Returns once either side closes.
+static void relay (void *arg_)
+{
+    relay_t *relay = (relay_t *) arg_;
+    const int client = accept (relay->listener, NULL, NULL);
+    if (client == -1)
+        fail ("accept");
+
+    const int server = socket (AF_INET, SOCK_STREAM, 0);
+    if (server == -1)
+        fail ("socket");
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons (relay->server_port);
+    addr.sin_addr.s_addr = inet_addr ("127.0.0.1");
+    if (connect (server, (struct sockaddr *) &addr, sizeof addr) == -1)
+        fail ("connect");
+
+    const double burst = 16384;
+    double tokens = burst;
+    double last = now ();
+    char buffer [16384];
+    while (true) {
+        const double t = now ();
+        tokens += (t - last) * link_rate;
+        if (tokens > burst)
+            tokens = burst;
+        last = t;
+
+        //  Stop reading from the client until there is room for a chunk.
+        struct pollfd items [2];
+        items [0].fd = server;
+        items [0].events = POLLIN;
+        items [1].fd = client;
+        items [1].events = tokens >= 1024 ? POLLIN : 0;
+        const int timeout = tokens >= 1024 ? -1 :
+            (int) ((1024 - tokens) / link_rate * 1000) + 1;
+        if (poll (items, 2, timeout) == -1)
+            fail ("poll");
+
+        if (items [0].revents) {
+            const ssize_t n = read (server, buffer, sizeof buffer);
+            if (n <= 0)
+                break;
+            write_all (client, buffer, n);
+        }
+        if (items [1].revents) {
+            const ssize_t n = read (client, buffer, (size_t) tokens);
+            if (n <= 0)
+                break;
+            write_all (server, buffer, n);
+            tokens -= n;
+        }
+    }
+    close (client);
+    close (server);
+}
+
+struct sender_t
+{
+    void *push;
+    zmq_msg_t *msgs;
+};
+
+static void sender (void *arg_)
+{
+    sender_t *sender = (sender_t *) arg_;
+    for (int i = 0; i != message_count; i++) {
+        int rc = zmq_msg_send (&sender->msgs [i], sender->push, 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+    }
+}
+
+//  Fills data_ with lines of a counterexample trace: a step number
+//  followed by the values of some state variables.
+static void fill (char *data_, size_t size_, unsigned seed_)
+{
+    static const char *vars [] = {"counter", "ok", "mode", "x_1", "x_2",
+        "timer", "req", "ack"};
+    size_t pos = 0;
+    for (int step = 0; pos < size_; step++) {
+        char line [256];
+        int len = sprintf (line, "(step %d", step);
+        for (int i = 0; i != 8; i++) {
+            seed_ = seed_ * 1103515245 + 12345;
+            const unsigned value = (seed_ >> 16) % (i % 3 == 1 ? 2 : 100);
+            if (i % 3 == 1)
+                len += sprintf (line + len, " (%s %s)", vars [i],
+                    value ? "true" : "false");
+            else
+                len += sprintf (line + len, " (%s %u)", vars [i], value);
+        }
+        len += sprintf (line + len, ")\n");
+        const size_t n = (size_t) len < size_ - pos ? len : size_ - pos;
+        memcpy (data_ + pos, line, n);
+        pos += n;
+    }
+}
+
+static void run (const char *name_, int threshold_, int relay_port_,
+    int server_port_)
+{
+    relay_t relay_args;
+    relay_args.listener = socket (AF_INET, SOCK_STREAM, 0);
+    if (relay_args.listener == -1)
+        fail ("socket");
+    int flag = 1;
+    setsockopt (relay_args.listener, SOL_SOCKET, SO_REUSEADDR, &flag,
+        sizeof flag);
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons (relay_port_);
+    addr.sin_addr.s_addr = inet_addr ("127.0.0.1");
+    if (bind (relay_args.listener, (struct sockaddr *) &addr, sizeof addr)
+          == -1)
+        fail ("bind");
+    if (listen (relay_args.listener, 1) == -1)
+        fail ("listen");
+    relay_args.server_port = server_port_;
+    void *thread = zmq_threadstart (relay, &relay_args);
+
+    void *ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    if (!pull)
+        fail ("zmq_socket");
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    if (!push)
+        fail ("zmq_socket");
+    void *sockets [] = {pull, push};
+    for (int i = 0; i != 2; i++) {
+        int rc = zmq_setsockopt (sockets [i], ZMQ_COMPRESS_THRESHOLD,
+            &threshold_, sizeof threshold_);
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+    }
+
+    char endpoint [64];
+    sprintf (endpoint, "tcp://127.0.0.1:%d", server_port_);
+    int rc = zmq_bind (pull, endpoint);
+    if (rc != 0)
+        fail ("zmq_bind");
+    sprintf (endpoint, "tcp://127.0.0.1:%d", relay_port_);
+    rc = zmq_connect (push, endpoint);
+    if (rc != 0)
+        fail ("zmq_connect");
+
+    //  Messages are prepared up front, so that only the transfer is
+    //  timed.
+    zmq_msg_t *msgs = (zmq_msg_t *) malloc (message_count * sizeof (zmq_msg_t));
+    if (!msgs)
+        fail ("malloc");
+    for (int i = 0; i != message_count; i++) {
+        rc = zmq_msg_init_size (&msgs [i], message_size);
+        if (rc != 0)
+            fail ("zmq_msg_init_size");
+        fill ((char *) zmq_msg_data (&msgs [i]), message_size, i);
+    }
+
+    zmq_msg_t msg;
+    rc = zmq_msg_init (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_init");
+    rc = zmq_msg_send (&msg, push, 0);
+    if (rc < 0)
+        fail ("zmq_msg_send");
+    rc = zmq_msg_recv (&msg, pull, 0);
+    if (rc < 0)
+        fail ("zmq_msg_recv");
+
+    zmq_socket_stats_t before;
+    rc = zmq_socket_stats (push, &before);
+    if (rc != 0)
+        fail ("zmq_socket_stats");
+    sender_t sender_args = {push, msgs};
+    void *watch = zmq_stopwatch_start ();
+    void *sender_thread = zmq_threadstart (sender, &sender_args);
+    for (int i = 0; i != message_count; i++) {
+        rc = zmq_msg_recv (&msg, pull, 0);
+        if (rc != message_size)
+            fail ("zmq_msg_recv");
+    }
+    unsigned long elapsed = zmq_stopwatch_stop (watch);
+    if (elapsed == 0)
+        elapsed = 1;
+    zmq_threadclose (sender_thread);
+    zmq_socket_stats_t after;
+    rc = zmq_socket_stats (push, &after);
+    if (rc != 0)
+        fail ("zmq_socket_stats");
+
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+    free (msgs);
+    rc = zmq_close (push);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_close (pull);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+    zmq_threadclose (thread);
+    close (relay_args.listener);
+
+    double wire = (double) (after.wire_bytes_out - before.wire_bytes_out)
+        / message_count;
+    double throughput = (double) message_count / elapsed * 1000000;
+    double megabits = throughput * message_size * 8 / 1000000;
+    printf ("%s: %.0f [B/msg on the wire], %.0f [msg/s], %.3f [Mb/s]\n",
+        name_, wire, throughput, megabits);
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 4) {
+        printf ("usage: compress_thr <message-size> <message-count> "
+            "<link-mbps>\n");
+        return 1;
+    }
+    message_size = atoi (argv [1]);
+    message_count = atoi (argv [2]);
+    link_rate = atof (argv [3]) * 1000000 / 8;
+    if (message_size < 1 || message_count < 1 || link_rate <= 0) {
+        printf ("message size, count and link rate must be positive\n");
+        return 1;
+    }
+
+    printf ("message size: %d [B]\n", message_size);
+    printf ("message count: %d\n", message_count);
+    printf ("link: %s [Mb/s]\n", argv [3]);
+    run ("plain", 0, 5616, 5615);
+    run ("compressed", 256, 5618, 5617);
+    return 0;
+}
+
+#else
+
+int main (void)
+{
+    printf ("compress_thr is not supported on this platform\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Measures how fast a ROUTER socket takes on new TCP connections in a
+//  connection storm. <connection-count> DEALER sockets in a separate
+//  context connect to the ROUTER at once and send it one message each.
+//  The time is taken from the first connect until the ROUTER has received
+//  all the messages. Both contexts run <io-threads> I/O threads; if
+//  <sharded> is 1 the ROUTER binds with ZMQ_TCP_SHARDED_ACCEPT.
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+int main (int argc, char *argv [])
+{
+    int io_threads;
+    int connection_count;
+    int sharded;
+    void *server_ctx;
+    void *client_ctx;
+    void *router;
+    void **dealers;
+    char endpoint [256];
+    size_t endpoint_size;
+    char buffer [256];
+    int rc;
+    int i;
+    unsigned long elapsed;
+    unsigned long rate;
+
+    if (argc != 4) {
+        printf ("usage: connect_rate <io-threads> <connection-count> "
+            "<sharded>\n");
+        return 1;
+    }
+    io_threads = atoi (argv [1]);
+    connection_count = atoi (argv [2]);
+    sharded = atoi (argv [3]);
+    if (io_threads < 1 || connection_count < 1) {
+        printf ("io-threads and connection-count must be positive\n");
+        return 1;
+    }
+
+    server_ctx = zmq_ctx_new ();
+    client_ctx = zmq_ctx_new ();
+    if (!server_ctx || !client_ctx)
+        fail ("zmq_ctx_new");
+    rc = zmq_ctx_set (server_ctx, ZMQ_IO_THREADS, io_threads);
+    if (rc != 0)
+        fail ("zmq_ctx_set");
+    rc = zmq_ctx_set (client_ctx, ZMQ_IO_THREADS, io_threads);
+    if (rc != 0)
+        fail ("zmq_ctx_set");
+    rc = zmq_ctx_set (client_ctx, ZMQ_MAX_SOCKETS, connection_count + 16);
+    if (rc != 0)
+        fail ("zmq_ctx_set");
+
+    router = zmq_socket (server_ctx, ZMQ_ROUTER);
+    if (!router)
+        fail ("zmq_socket");
+    rc = zmq_setsockopt (router, ZMQ_TCP_SHARDED_ACCEPT, &sharded,
+        sizeof (sharded));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+
+    //  Make room in the listen backlog for the whole storm, so that the
+    //  kernel doesn't drop connection requests and slow the peers down
+    //  with retransmissions.
+    rc = zmq_setsockopt (router, ZMQ_BACKLOG, &connection_count,
+        sizeof (connection_count));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+    rc = zmq_bind (router, "tcp://127.0.0.1:*");
+    if (rc != 0)
+        fail ("zmq_bind");
+    endpoint_size = sizeof (endpoint);
+    rc = zmq_getsockopt (router, ZMQ_LAST_ENDPOINT, endpoint,
+        &endpoint_size);
+    if (rc != 0)
+        fail ("zmq_getsockopt");
+
+    dealers = (void**) malloc (connection_count * sizeof (void*));
+    if (!dealers) {
+        printf ("error in malloc\n");
+        return -1;
+    }
+    for (i = 0; i != connection_count; i++) {
+        dealers [i] = zmq_socket (client_ctx, ZMQ_DEALER);
+        if (!dealers [i])
+            fail ("zmq_socket");
+    }
+
+    void *watch = zmq_stopwatch_start ();
+
+    for (i = 0; i != connection_count; i++) {
+        rc = zmq_connect (dealers [i], endpoint);
+        if (rc != 0)
+            fail ("zmq_connect");
+        rc = zmq_send (dealers [i], "hello", 5, 0);
+        if (rc < 0)
+            fail ("zmq_send");
+    }
+    for (i = 0; i != connection_count; i++) {
+        rc = zmq_recv (router, buffer, sizeof (buffer), 0);
+        if (rc < 0)
+            fail ("zmq_recv");
+        rc = zmq_recv (router, buffer, sizeof (buffer), 0);
+        if (rc < 0)
+            fail ("zmq_recv");
+    }
+
+    elapsed = zmq_stopwatch_stop (watch);
+    if (elapsed == 0)
+        elapsed = 1;
+
+    rate = (unsigned long)
+        ((double) connection_count / (double) elapsed * 1000000);
+
+    printf ("io threads: %d\n", io_threads);
+    printf ("sharded accept: %d\n", sharded);
+    printf ("connection count: %d\n", connection_count);
+    printf ("connection rate: %d [conn/s]\n", (int) rate);
+    printf ("mean setup time: %.3f [us/conn]\n",
+        (double) elapsed / connection_count);
+
+    for (i = 0; i != connection_count; i++) {
+        rc = zmq_close (dealers [i]);
+        if (rc != 0)
+            fail ("zmq_close");
+    }
+    free (dealers);
+    rc = zmq_close (router);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_ctx_term (client_ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+    rc = zmq_ctx_term (server_ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+
+    return 0;
+}
@@ -0,0 +1,275 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Measures the cost of a reconnect storm over CURVE. <peer-count> DEALER
+//  sockets connect to a ROUTER authenticating them with a ZAP handler, then
+//  all disconnect and connect again, <round-count> times. Each round is
+//  timed until the ROUTER got a message over every new session. The storm
+//  runs without and with session resumption (ZMQ_CURVE_RESUME); the first
+//  round, in which resuming peers get their tickets, is not timed.
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+static char client_public [41];
+static char client_secret [41];
+static char server_public [41];
+static char server_secret [41];
+
+//  Approves all the requests.
+static void zap_handler (void *handler_)
+{
+    zmq_msg_t frame;
+    char version [8];
+    char sequence [32];
+    int version_size;
+    int sequence_size;
+    int more;
+    size_t more_size;
+    int rc;
+
+    while (true) {
+        //  The version and the request id are echoed, the other frames
+        //  are dropped.
+        version_size = zmq_recv (handler_, version, sizeof version, 0);
+        if (version_size < 0)
+            break;
+        sequence_size = zmq_recv (handler_, sequence, sizeof sequence, 0);
+        if (sequence_size < 0)
+            break;
+        more = 1;
+        while (more) {
+            rc = zmq_msg_init (&frame);
+            if (rc != 0)
+                fail ("zmq_msg_init");
+            rc = zmq_msg_recv (&frame, handler_, 0);
+            if (rc < 0)
+                fail ("zmq_msg_recv");
+            zmq_msg_close (&frame);
+            more_size = sizeof more;
+            rc = zmq_getsockopt (handler_, ZMQ_RCVMORE, &more, &more_size);
+            if (rc != 0)
+                fail ("zmq_getsockopt");
+        }
+
+        if (zmq_send (handler_, version, version_size, ZMQ_SNDMORE) < 0
+        ||  zmq_send (handler_, sequence, sequence_size, ZMQ_SNDMORE) < 0
+        ||  zmq_send (handler_, "200", 3, ZMQ_SNDMORE) < 0
+        ||  zmq_send (handler_, "OK", 2, ZMQ_SNDMORE) < 0
+        ||  zmq_send (handler_, "", 0, ZMQ_SNDMORE) < 0
+        ||  zmq_send (handler_, "", 0, 0) < 0)
+            fail ("zmq_send");
+    }
+    zmq_close (handler_);
+}
+
+//  Runs the storm and returns the mean time of a round in microseconds.
+static unsigned long storm (void *ctx_, const char *endpoint_,
+    int peer_count_, int round_count_, int resume_)
+{
+    void *router;
+    void **peers;
+    char buffer [256];
+    int as_server;
+    int round;
+    int rc;
+    int i;
+    void *watch;
+    unsigned long elapsed;
+
+    router = zmq_socket (ctx_, ZMQ_ROUTER);
+    if (!router)
+        fail ("zmq_socket");
+    as_server = 1;
+    rc = zmq_setsockopt (router, ZMQ_CURVE_SERVER, &as_server,
+        sizeof (as_server));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+    rc = zmq_setsockopt (router, ZMQ_CURVE_SECRETKEY, server_secret, 41);
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+    rc = zmq_setsockopt (router, ZMQ_CURVE_RESUME, &resume_,
+        sizeof (resume_));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+    rc = zmq_bind (router, endpoint_);
+    if (rc != 0)
+        fail ("zmq_bind");
+
+    peers = (void**) malloc (peer_count_ * sizeof (void*));
+    if (!peers) {
+        printf ("error in malloc\n");
+        exit (1);
+    }
+    for (i = 0; i != peer_count_; i++) {
+        peers [i] = zmq_socket (ctx_, ZMQ_DEALER);
+        if (!peers [i])
+            fail ("zmq_socket");
+        rc = zmq_setsockopt (peers [i], ZMQ_CURVE_SERVERKEY, server_public,
+            41);
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+        rc = zmq_setsockopt (peers [i], ZMQ_CURVE_PUBLICKEY, client_public,
+            41);
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+        rc = zmq_setsockopt (peers [i], ZMQ_CURVE_SECRETKEY, client_secret,
+            41);
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+        rc = zmq_setsockopt (peers [i], ZMQ_CURVE_RESUME, &resume_,
+            sizeof (resume_));
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+    }
+
+    elapsed = 0;
+    for (round = 0; round <= round_count_; round++) {
+        watch = zmq_stopwatch_start ();
+        for (i = 0; i != peer_count_; i++) {
+            rc = zmq_connect (peers [i], endpoint_);
+            if (rc != 0)
+                fail ("zmq_connect");
+            rc = zmq_send (peers [i], "hello", 5, 0);
+            if (rc < 0)
+                fail ("zmq_send");
+        }
+        for (i = 0; i != peer_count_; i++) {
+            //  Identity and body.
+            rc = zmq_recv (router, buffer, sizeof buffer, 0);
+            if (rc < 0)
+                fail ("zmq_recv");
+            rc = zmq_recv (router, buffer, sizeof buffer, 0);
+            if (rc < 0)
+                fail ("zmq_recv");
+        }
+        if (round == 0)
+            zmq_stopwatch_stop (watch);
+        else
+            elapsed += zmq_stopwatch_stop (watch);
+
+        for (i = 0; i != peer_count_; i++) {
+            rc = zmq_disconnect (peers [i], endpoint_);
+            if (rc != 0)
+                fail ("zmq_disconnect");
+        }
+    }
+
+    for (i = 0; i != peer_count_; i++) {
+        rc = zmq_close (peers [i]);
+        if (rc != 0)
+            fail ("zmq_close");
+    }
+    rc = zmq_close (router);
+    if (rc != 0)
+        fail ("zmq_close");
+    free (peers);
+
+    return elapsed / round_count_;
+}
+
+int main (int argc, char *argv [])
+{
+    int peer_count;
+    int round_count;
+    void *ctx;
+    void *handler;
+    void *thread;
+    unsigned long full;
+    unsigned long resumed;
+    int rc;
+
+    if (argc != 3) {
+        printf ("usage: curve_reconnect <peer-count> <round-count>\n");
+        return 1;
+    }
+    peer_count = atoi (argv [1]);
+    round_count = atoi (argv [2]);
+    if (peer_count < 1 || round_count < 1) {
+        printf ("peer-count and round-count must be positive\n");
+        return 1;
+    }
+
+    rc = zmq_curve_keypair (client_public, client_secret);
+    if (rc != 0)
+        fail ("zmq_curve_keypair");
+    rc = zmq_curve_keypair (server_public, server_secret);
+    if (rc != 0)
+        fail ("zmq_curve_keypair");
+
+    ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+    //  The sockets of the first storm may not be reaped yet when the
+    //  second one starts.
+    rc = zmq_ctx_set (ctx, ZMQ_MAX_SOCKETS, 2 * peer_count + 16);
+    if (rc != 0)
+        fail ("zmq_ctx_set");
+
+    handler = zmq_socket (ctx, ZMQ_REP);
+    if (!handler)
+        fail ("zmq_socket");
+    rc = zmq_bind (handler, "inproc://zeromq.zap.01");
+    if (rc != 0)
+        fail ("zmq_bind");
+    thread = zmq_threadstart (zap_handler, handler);
+
+    full = storm (ctx, "tcp://127.0.0.1:5624", peer_count, round_count, 0);
+    resumed = storm (ctx, "tcp://127.0.0.1:5625", peer_count, round_count,
+        60000);
+    if (full == 0)
+        full = 1;
+    if (resumed == 0)
+        resumed = 1;
+
+    printf ("peer count: %d\n", peer_count);
+    printf ("round count: %d\n", round_count);
+    printf ("full handshakes: %d [us/round], %d [handshakes/s]\n",
+        (int) full, (int) ((double) peer_count / full * 1000000));
+    printf ("resumed sessions: %d [us/round], %d [handshakes/s]\n",
+        (int) resumed, (int) ((double) peer_count / resumed * 1000000));
+    printf ("resumed cost: %.1f [%% of full]\n",
+        (double) resumed / full * 100);
+
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+    zmq_threadclose (thread);
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//  Measures the cost of CURVE encryption against the NULL mechanism.
+//  A PUSH socket sends <message-count> messages of <message-size> bytes
+//  to a PULL socket over the loopback interface, first with NULL and then
+//  with CURVE security, and the throughput and CPU time of both runs are
+//  printed.
+
+static int message_count;
+static size_t message_size;
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+static void receiver (void *socket_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_init");
+    for (int i = 0; i != message_count; i++) {
+        rc = zmq_msg_recv (&msg, socket_, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+        if ((size_t) rc != message_size) {
+            printf ("message of incorrect size received\n");
+            exit (1);
+        }
+    }
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+}
+
+static void run (const char *mechanism_, bool curve_)
+{
+    void *ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    if (!push)
+        fail ("zmq_socket");
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    if (!pull)
+        fail ("zmq_socket");
+
+    if (curve_) {
+        char server_public [41];
+        char server_secret [41];
+        char client_public [41];
+        char client_secret [41];
+        int rc = zmq_curve_keypair (server_public, server_secret);
+        if (rc != 0)
+            fail ("zmq_curve_keypair");
+        rc = zmq_curve_keypair (client_public, client_secret);
+        if (rc != 0)
+            fail ("zmq_curve_keypair");
+
+        int as_server = 1;
+        rc = zmq_setsockopt (push, ZMQ_CURVE_SERVER, &as_server,
+            sizeof (as_server));
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+        rc = zmq_setsockopt (push, ZMQ_CURVE_SECRETKEY, server_secret, 41);
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+        rc = zmq_setsockopt (pull, ZMQ_CURVE_SERVERKEY, server_public, 41);
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+        rc = zmq_setsockopt (pull, ZMQ_CURVE_PUBLICKEY, client_public, 41);
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+        rc = zmq_setsockopt (pull, ZMQ_CURVE_SECRETKEY, client_secret, 41);
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+    }
+
+    int rc = zmq_bind (push, "tcp://127.0.0.1:5597");
+    if (rc != 0)
+        fail ("zmq_bind");
+    rc = zmq_connect (pull, "tcp://127.0.0.1:5597");
+    if (rc != 0)
+        fail ("zmq_connect");
+
+    //  All the messages share one constant body, so that nothing but the
+    //  transfer itself is measured on the sending side.
+    char *body = (char*) malloc (message_size);
+    if (!body) {
+        printf ("error in malloc\n");
+        exit (1);
+    }
+    memset (body, 'x', message_size);
+
+    void *thread = zmq_threadstart (receiver, pull);
+    clock_t cpu = clock ();
+    void *watch = zmq_stopwatch_start ();
+
+    for (int i = 0; i != message_count; i++) {
+        zmq_msg_t msg;
+        rc = zmq_msg_init_data (&msg, body, message_size, NULL, NULL);
+        if (rc != 0)
+            fail ("zmq_msg_init_data");
+        rc = zmq_msg_send (&msg, push, 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+    }
+    zmq_threadclose (thread);
+
+    unsigned long elapsed = zmq_stopwatch_stop (watch);
+    if (elapsed == 0)
+        elapsed = 1;
+    cpu = clock () - cpu;
+    double megabytes = (double) message_size * message_count / 1000000;
+
+    printf ("%s: %.0f [msg/s], %.1f [MB/s], cpu time %.3f [ms/MB]\n",
+        mechanism_, (double) message_count * 1000000 / elapsed,
+        megabytes * 1000000 / elapsed,
+        (double) cpu * 1000 / CLOCKS_PER_SEC / megabytes);
+
+    rc = zmq_close (pull);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_close (push);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+    free (body);
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 3) {
+        printf ("usage: curve_thr <message-size> <message-count>\n");
+        return 1;
+    }
+    message_size = atoi (argv [1]);
+    message_count = atoi (argv [2]);
+
+    if (!zmq_has ("curve")) {
+        printf ("CURVE is not available in this build\n");
+        return 1;
+    }
+
+    printf ("message size: %d [B]\n", (int) message_size);
+    printf ("message count: %d\n", message_count);
+    run ("NULL", false);
+    run ("CURVE", true);
+    return 0;
+}
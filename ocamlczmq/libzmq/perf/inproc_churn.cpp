@@ -0,0 +1,159 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Measures how fast short-lived inproc connections can be set up, as in
+//  designs running an actor per task. Each of <thread-count> threads
+//  creates <pair-count> pairs of PAIR sockets one after the other,
+//  binding one to an address of its own and connecting the other,
+//  bounces a message through the pair and closes both sockets. Every
+//  other pair connects before binding, which takes the pending
+//  connection path. Meanwhile <resident-count> sockets stay bound to
+//  addresses of their own, like long-lived actors.
+
+static void *ctx;
+static int pair_count;
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+static void worker (void *id_)
+{
+    const int id = (int) (size_t) id_;
+    char endpoint [64];
+    char buffer [1];
+    for (int i = 0; i != pair_count; i++) {
+        sprintf (endpoint, "inproc://churn-%d-%d", id, i);
+        void *bound = zmq_socket (ctx, ZMQ_PAIR);
+        if (!bound)
+            fail ("zmq_socket");
+        void *connected = zmq_socket (ctx, ZMQ_PAIR);
+        if (!connected)
+            fail ("zmq_socket");
+
+        if (i % 2) {
+            if (zmq_connect (connected, endpoint) != 0)
+                fail ("zmq_connect");
+            if (zmq_bind (bound, endpoint) != 0)
+                fail ("zmq_bind");
+        }
+        else {
+            if (zmq_bind (bound, endpoint) != 0)
+                fail ("zmq_bind");
+            if (zmq_connect (connected, endpoint) != 0)
+                fail ("zmq_connect");
+        }
+
+        if (zmq_send (connected, "x", 1, 0) != 1)
+            fail ("zmq_send");
+        if (zmq_recv (bound, buffer, 1, 0) != 1)
+            fail ("zmq_recv");
+
+        if (zmq_close (connected) != 0)
+            fail ("zmq_close");
+        if (zmq_close (bound) != 0)
+            fail ("zmq_close");
+    }
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 4) {
+        printf ("usage: inproc_churn <thread-count> <pair-count> "
+            "<resident-count>\n");
+        return 1;
+    }
+    const int thread_count = atoi (argv [1]);
+    pair_count = atoi (argv [2]);
+    const int resident_count = atoi (argv [3]);
+    if (thread_count < 1 || pair_count < 1 || resident_count < 0) {
+        printf ("thread count and pair count must be at least 1\n");
+        return 1;
+    }
+
+    ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+    //  Sockets are closed asynchronously, so more of them may be open
+    //  than the threads are using at any time.
+    int rc = zmq_ctx_set (ctx, ZMQ_MAX_SOCKETS, 65536);
+    if (rc != 0)
+        fail ("zmq_ctx_set");
+
+    void **residents = (void **) malloc (resident_count * sizeof (void *));
+    if (!residents && resident_count)
+        fail ("malloc");
+    for (int i = 0; i != resident_count; i++) {
+        char endpoint [64];
+        sprintf (endpoint, "inproc://resident-%d", i);
+        residents [i] = zmq_socket (ctx, ZMQ_PAIR);
+        if (!residents [i])
+            fail ("zmq_socket");
+        if (zmq_bind (residents [i], endpoint) != 0)
+            fail ("zmq_bind");
+    }
+
+    void **threads = (void **) malloc (thread_count * sizeof (void *));
+    if (!threads)
+        fail ("malloc");
+    void *watch = zmq_stopwatch_start ();
+    for (int i = 0; i != thread_count; i++)
+        threads [i] = zmq_threadstart (worker, (void *) (size_t) i);
+    for (int i = 0; i != thread_count; i++)
+        zmq_threadclose (threads [i]);
+    unsigned long elapsed = zmq_stopwatch_stop (watch);
+    if (elapsed == 0)
+        elapsed = 1;
+    free (threads);
+
+    for (int i = 0; i != resident_count; i++)
+        if (zmq_close (residents [i]) != 0)
+            fail ("zmq_close");
+    free (residents);
+
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+
+    const double pairs = (double) thread_count * pair_count;
+    printf ("thread count: %d\n", thread_count);
+    printf ("pair count: %d\n", pair_count);
+    printf ("resident count: %d\n", resident_count);
+    printf ("pairs per second: %.0f\n", pairs / elapsed * 1000000);
+    return 0;
+}
@@ -45,6 +45,14 @@
 
 static size_t message_size;
 static int roundtrip_count;
+static int busy_poll;
+
+static int compare_ulong (const void *a_, const void *b_)
+{
+    unsigned long a = *(const unsigned long *) a_;
+    unsigned long b = *(const unsigned long *) b_;
+    return a < b ? -1 : a > b ? 1 : 0;
+}
 
 #if defined ZMQ_HAVE_WINDOWS
 static unsigned int __stdcall worker (void *ctx_)
@@ -63,6 +71,12 @@ static void *worker (void *ctx_)
         exit (1);
     }
 
+    rc = zmq_setsockopt (s, ZMQ_BUSY_POLL, &busy_poll, sizeof (int));
+    if (rc != 0) {
+        printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+        exit (1);
+    }
+
     rc = zmq_connect (s, "inproc://lat_test");
     if (rc != 0) {
         printf ("error in zmq_connect: %s\n", zmq_strerror (errno));
@@ -120,16 +134,26 @@ int main (int argc, char *argv [])
     int i;
     zmq_msg_t msg;
     void *watch;
+    void *rtt_watch;
     unsigned long elapsed;
+    unsigned long *rtts;
     double latency;
 
-    if (argc != 3) {
-        printf ("usage: inproc_lat <message-size> <roundtrip-count>\n");
+    if (argc != 3 && argc != 4) {
+        printf ("usage: inproc_lat <message-size> <roundtrip-count> "
+            "[busy-poll-us]\n");
         return 1;
     }
 
     message_size = atoi (argv [1]);
     roundtrip_count = atoi (argv [2]);
+    busy_poll = argc == 4 ? atoi (argv [3]) : 0;
+
+    rtts = (unsigned long *) malloc (roundtrip_count * sizeof (unsigned long));
+    if (!rtts) {
+        printf ("error in malloc\n");
+        return -1;
+    }
 
     ctx = zmq_init (1);
     if (!ctx) {
@@ -143,6 +167,12 @@ int main (int argc, char *argv [])
         return -1;
     }
 
+    rc = zmq_setsockopt (s, ZMQ_BUSY_POLL, &busy_poll, sizeof (int));
+    if (rc != 0) {
+        printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
     rc = zmq_bind (s, "inproc://lat_test");
     if (rc != 0) {
         printf ("error in zmq_bind: %s\n", zmq_strerror (errno));
@@ -173,10 +203,12 @@ int main (int argc, char *argv [])
 
     printf ("message size: %d [B]\n", (int) message_size);
     printf ("roundtrip count: %d\n", (int) roundtrip_count);
+    printf ("busy poll: %d [us]\n", busy_poll);
 
     watch = zmq_stopwatch_start ();
 
     for (i = 0; i != roundtrip_count; i++) {
+        rtt_watch = zmq_stopwatch_start ();
         rc = zmq_sendmsg (s, &msg, 0);
         if (rc < 0) {
             printf ("error in zmq_sendmsg: %s\n", zmq_strerror (errno));
@@ -191,6 +223,7 @@ int main (int argc, char *argv [])
             printf ("message of incorrect size received\n");
             return -1;
         }
+        rtts [i] = zmq_stopwatch_stop (rtt_watch);
     }
 
     elapsed = zmq_stopwatch_stop (watch);
@@ -224,6 +257,18 @@ int main (int argc, char *argv [])
 
     printf ("average latency: %.3f [us]\n", (double) latency);
 
+    //  Roundtrip percentiles, halved to match the one-way average above.
+    qsort (rtts, roundtrip_count, sizeof (unsigned long), compare_ulong);
+    printf ("p50 latency: %.1f [us]\n",
+        rtts [roundtrip_count / 2] / 2.0);
+    printf ("p99 latency: %.1f [us]\n",
+        rtts [(int) (roundtrip_count * 0.99)] / 2.0);
+    printf ("p99.9 latency: %.1f [us]\n",
+        rtts [(int) (roundtrip_count * 0.999)] / 2.0);
+    printf ("max latency: %.1f [us]\n",
+        rtts [roundtrip_count - 1] / 2.0);
+    free (rtts);
+
     rc = zmq_close (s);
     if (rc != 0) {
         printf ("error in zmq_close: %s\n", zmq_strerror (errno));
@@ -47,6 +47,7 @@
 
 static int message_count;
 static size_t message_size;
+static int medium_size = -1;
 
 #if defined ZMQ_HAVE_WINDOWS
 static unsigned int __stdcall worker (void *ctx_)
@@ -58,6 +59,8 @@ static void *worker (void *ctx_)
     int rc;
     int i;
     zmq_msg_t msg;
+    char *buf = NULL;
+    zmq_socket_stats_t stats;
 
     s = zmq_socket (ctx_, ZMQ_PUSH);
     if (!s) {
@@ -65,6 +68,22 @@ static void *worker (void *ctx_)
         exit (1);
     }
 
+    //  With a medium message size given, messages are sent with zmq_send,
+    //  which can carve them from the socket's medium message buffer.
+    if (medium_size >= 0) {
+        rc = zmq_setsockopt (s, ZMQ_MEDIUM_MSG_SIZE, &medium_size,
+            sizeof medium_size);
+        if (rc != 0) {
+            printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+            exit (1);
+        }
+        buf = (char *) calloc (1, message_size + 1);
+        if (!buf) {
+            printf ("error in calloc\n");
+            exit (1);
+        }
+    }
+
     rc = zmq_connect (s, "inproc://thr_test");
     if (rc != 0) {
         printf ("error in zmq_connect: %s\n", zmq_strerror (errno));
@@ -73,6 +92,15 @@ static void *worker (void *ctx_)
 
     for (i = 0; i != message_count; i++) {
 
+        if (buf) {
+            rc = zmq_send (s, buf, message_size, 0);
+            if (rc < 0) {
+                printf ("error in zmq_send: %s\n", zmq_strerror (errno));
+                exit (1);
+            }
+            continue;
+        }
+
         rc = zmq_msg_init_size (&msg, message_size);
         if (rc != 0) {
             printf ("error in zmq_msg_init_size: %s\n", zmq_strerror (errno));
@@ -94,6 +122,18 @@ static void *worker (void *ctx_)
         }
     }
 
+    if (buf) {
+        free (buf);
+        rc = zmq_socket_stats (s, &stats);
+        if (rc != 0) {
+            printf ("error in zmq_socket_stats: %s\n", zmq_strerror (errno));
+            exit (1);
+        }
+        printf ("medium messages: %d\n", (int) stats.medium_msgs);
+        printf ("medium messages on the heap: %d\n",
+            (int) stats.medium_misses);
+    }
+
     rc = zmq_close (s);
     if (rc != 0) {
         printf ("error in zmq_close: %s\n", zmq_strerror (errno));
@@ -124,13 +164,16 @@ int main (int argc, char *argv [])
     unsigned long throughput;
     double megabits;
 
-    if (argc != 3) {
-        printf ("usage: inproc_thr <message-size> <message-count>\n");
+    if (argc != 3 && argc != 4) {
+        printf ("usage: inproc_thr <message-size> <message-count> "
+            "[medium-size]\n");
         return 1;
     }
 
     message_size = atoi (argv [1]);
     message_count = atoi (argv [2]);
+    if (argc == 4)
+        medium_size = atoi (argv [3]);
 
     ctx = zmq_init (1);
     if (!ctx) {
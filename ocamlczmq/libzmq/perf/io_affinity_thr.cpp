@@ -0,0 +1,197 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Measures throughput between two contexts over the loopback interface
+//  with their I/O threads running on any CPU and then pinned with
+//  ZMQ_IO_THREAD_AFFINITY. The sender's I/O thread and application thread
+//  are pinned to <sender-cpus>, the receiver's to <receiver-cpus>, given
+//  as CPU lists such as "0-3". Running it with both lists on one NUMA node
+//  and then with the lists on different nodes shows the cost of the
+//  traffic between the nodes, which pinning avoids.
+
+static int message_size;
+static int message_count;
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+//  Pins the calling thread to the CPUs in the list, "" meaning any.
+static void pin (const char *cpus_)
+{
+#if defined __linux__
+    cpu_set_t cpus;
+    CPU_ZERO (&cpus);
+    if (!*cpus_) {
+        for (int cpu = 0; cpu != CPU_SETSIZE; cpu++)
+            CPU_SET (cpu, &cpus);
+    }
+    else {
+        const char *pos = cpus_;
+        while (*pos) {
+            char *end;
+            int first = (int) strtol (pos, &end, 10);
+            int last = first;
+            if (*end == '-')
+                last = (int) strtol (end + 1, &end, 10);
+            for (int cpu = first; cpu <= last; cpu++)
+                CPU_SET (cpu, &cpus);
+            pos = *end == ',' ? end + 1 : end;
+            if (end == pos && *end)
+                break;
+        }
+    }
+    pthread_setaffinity_np (pthread_self (), sizeof (cpus), &cpus);
+#else
+    (void) cpus_;
+#endif
+}
+
+static void *new_context (const char *cpus_)
+{
+    void *ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+    int rc = zmq_ctx_set_ext (ctx, ZMQ_IO_THREAD_AFFINITY, cpus_,
+        strlen (cpus_));
+    if (rc != 0)
+        fail ("zmq_ctx_set_ext");
+    return ctx;
+}
+
+static void sender (void *cpus_)
+{
+    pin ((const char*) cpus_);
+    void *ctx = new_context ((const char*) cpus_);
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    if (!push)
+        fail ("zmq_socket");
+    int rc = zmq_connect (push, "tcp://127.0.0.1:5605");
+    if (rc != 0)
+        fail ("zmq_connect");
+
+    zmq_msg_t msg;
+    for (int i = 0; i != message_count + 1; i++) {
+        rc = zmq_msg_init_size (&msg, message_size);
+        if (rc != 0)
+            fail ("zmq_msg_init_size");
+        rc = zmq_msg_send (&msg, push, 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+    }
+
+    rc = zmq_close (push);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+}
+
+static void run (const char *name_, const char *sender_cpus_,
+    const char *receiver_cpus_)
+{
+    pin (receiver_cpus_);
+    void *ctx = new_context (receiver_cpus_);
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    if (!pull)
+        fail ("zmq_socket");
+    int rc = zmq_bind (pull, "tcp://127.0.0.1:5605");
+    if (rc != 0)
+        fail ("zmq_bind");
+
+    void *thread = zmq_threadstart (sender, (void*) sender_cpus_);
+
+    //  Start timing on the first message.
+    zmq_msg_t msg;
+    rc = zmq_msg_init (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_init");
+    rc = zmq_msg_recv (&msg, pull, 0);
+    if (rc < 0)
+        fail ("zmq_msg_recv");
+
+    void *watch = zmq_stopwatch_start ();
+    for (int i = 0; i != message_count; i++) {
+        rc = zmq_msg_recv (&msg, pull, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+    }
+    unsigned long elapsed = zmq_stopwatch_stop (watch);
+    if (elapsed == 0)
+        elapsed = 1;
+    zmq_threadclose (thread);
+
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+    rc = zmq_close (pull);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+
+    double throughput = (double) message_count / elapsed * 1000000;
+    printf ("%s: %.0f [msg/s], %.3f [Mb/s]\n", name_, throughput,
+        throughput * message_size * 8 / 1000000);
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 5) {
+        printf ("usage: io_affinity_thr <message-size> <message-count> "
+            "<sender-cpus> <receiver-cpus>\n");
+        return 1;
+    }
+    message_size = atoi (argv [1]);
+    message_count = atoi (argv [2]);
+
+    printf ("message size: %d [B]\n", message_size);
+    printf ("message count: %d\n", message_count);
+    run ("any CPU", "", "");
+    run ("pinned", argv [3], argv [4]);
+    return 0;
+}
@@ -37,20 +37,22 @@ int main (int argc, char *argv [])
     const char *bind_to;
     int roundtrip_count;
     size_t message_size;
+    int busy_poll;
     void *ctx;
     void *s;
     int rc;
     int i;
     zmq_msg_t msg;
 
-    if (argc != 4) {
+    if (argc != 4 && argc != 5) {
         printf ("usage: local_lat <bind-to> <message-size> "
-            "<roundtrip-count>\n");
+            "<roundtrip-count> [busy-poll-us]\n");
         return 1;
     }
     bind_to = argv [1];
     message_size = atoi (argv [2]);
     roundtrip_count = atoi (argv [3]);
+    busy_poll = argc == 5 ? atoi (argv [4]) : 0;
 
     ctx = zmq_init (1);
     if (!ctx) {
@@ -64,6 +66,12 @@ int main (int argc, char *argv [])
         return -1;
     }
 
+    rc = zmq_setsockopt (s, ZMQ_BUSY_POLL, &busy_poll, sizeof (int));
+    if (rc != 0) {
+        printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
     rc = zmq_bind (s, bind_to);
     if (rc != 0) {
         printf ("error in zmq_bind: %s\n", zmq_strerror (errno));
@@ -37,6 +37,8 @@ int main (int argc, char *argv [])
     const char *bind_to;
     int message_count;
     size_t message_size;
+    int medium_size;
+    zmq_socket_stats_t stats;
     void *ctx;
     void *s;
     int rc;
@@ -47,13 +49,15 @@ int main (int argc, char *argv [])
     unsigned long throughput;
     double megabits;
 
-    if (argc != 4) {
-        printf ("usage: local_thr <bind-to> <message-size> <message-count>\n");
+    if (argc != 4 && argc != 5) {
+        printf ("usage: local_thr <bind-to> <message-size> <message-count> "
+            "[medium-size]\n");
         return 1;
     }
     bind_to = argv [1];
     message_size = atoi (argv [2]);
     message_count = atoi (argv [3]);
+    medium_size = argc == 5? atoi (argv [4]): 0;
 
     ctx = zmq_init (1);
     if (!ctx) {
@@ -70,6 +74,13 @@ int main (int argc, char *argv [])
     //  Add your socket options here.
     //  For example ZMQ_RATE, ZMQ_RECOVERY_IVL and ZMQ_MCAST_LOOP for PGM.
 
+    rc = zmq_setsockopt (s, ZMQ_MEDIUM_MSG_SIZE, &medium_size,
+        sizeof medium_size);
+    if (rc != 0) {
+        printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
     rc = zmq_bind (s, bind_to);
     if (rc != 0) {
         printf ("error in zmq_bind: %s\n", zmq_strerror (errno));
@@ -125,6 +136,14 @@ int main (int argc, char *argv [])
     printf ("mean throughput: %d [msg/s]\n", (int) throughput);
     printf ("mean throughput: %.3f [Mb/s]\n", (double) megabits);
 
+    rc = zmq_socket_stats (s, &stats);
+    if (rc != 0) {
+        printf ("error in zmq_socket_stats: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+    printf ("medium messages: %d\n", (int) stats.medium_msgs);
+    printf ("medium messages on the heap: %d\n", (int) stats.medium_misses);
+
     rc = zmq_close (s);
     if (rc != 0) {
         printf ("error in zmq_close: %s\n", zmq_strerror (errno));
@@ -0,0 +1,190 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Measures the cost of waiting for one ready socket among many idle ones.
+//  <socket-count> PULL sockets are polled, of which <active-count> have a
+//  PUSH peer. Each round sends one message to an active socket, waits for
+//  it to be reported and receives it. The same rounds are timed with
+//  zmq_poller_wait, which keeps its registrations across calls, and with
+//  zmq_poll, which is handed the whole item array on every call.
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+int main (int argc, char *argv [])
+{
+    int socket_count;
+    int active_count;
+    int round_count;
+    void *ctx;
+    void **sinks;
+    void **vents;
+    zmq_pollitem_t *items;
+    void *poller;
+    zmq_poller_event_t event;
+    char endpoint [32];
+    char buffer [1];
+    void *watch;
+    unsigned long poller_elapsed;
+    unsigned long poll_elapsed;
+    int rc;
+    int i;
+
+    if (argc != 4) {
+        printf ("usage: poller_wait <socket-count> <active-count> "
+            "<round-count>\n");
+        return 1;
+    }
+    socket_count = atoi (argv [1]);
+    active_count = atoi (argv [2]);
+    round_count = atoi (argv [3]);
+    if (active_count < 1 || active_count > socket_count) {
+        printf ("active-count must be between 1 and socket-count\n");
+        return 1;
+    }
+
+    ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+    rc = zmq_ctx_set (ctx, ZMQ_MAX_SOCKETS, socket_count + active_count + 16);
+    if (rc != 0)
+        fail ("zmq_ctx_set");
+
+    sinks = (void**) malloc (socket_count * sizeof (void*));
+    vents = (void**) malloc (active_count * sizeof (void*));
+    items = (zmq_pollitem_t*) malloc (socket_count * sizeof (zmq_pollitem_t));
+    if (!sinks || !vents || !items) {
+        printf ("error in malloc\n");
+        return -1;
+    }
+
+    poller = zmq_poller_new ();
+    if (!poller)
+        fail ("zmq_poller_new");
+    for (i = 0; i != socket_count; i++) {
+        sinks [i] = zmq_socket (ctx, ZMQ_PULL);
+        if (!sinks [i])
+            fail ("zmq_socket");
+        sprintf (endpoint, "inproc://sink-%d", i);
+        rc = zmq_bind (sinks [i], endpoint);
+        if (rc != 0)
+            fail ("zmq_bind");
+        rc = zmq_poller_add (poller, sinks [i], NULL, ZMQ_POLLIN);
+        if (rc != 0)
+            fail ("zmq_poller_add");
+        items [i].socket = sinks [i];
+        items [i].fd = 0;
+        items [i].events = ZMQ_POLLIN;
+        items [i].revents = 0;
+    }
+
+    //  Spread the active sockets evenly over the set.
+    for (i = 0; i != active_count; i++) {
+        vents [i] = zmq_socket (ctx, ZMQ_PUSH);
+        if (!vents [i])
+            fail ("zmq_socket");
+        sprintf (endpoint, "inproc://sink-%d",
+            (int) ((long) i * socket_count / active_count));
+        rc = zmq_connect (vents [i], endpoint);
+        if (rc != 0)
+            fail ("zmq_connect");
+    }
+
+    watch = zmq_stopwatch_start ();
+    for (i = 0; i != round_count; i++) {
+        rc = zmq_send (vents [i % active_count], "x", 1, 0);
+        if (rc != 1)
+            fail ("zmq_send");
+        rc = zmq_poller_wait (poller, &event, -1);
+        if (rc != 0)
+            fail ("zmq_poller_wait");
+        rc = zmq_recv (event.socket, buffer, 1, 0);
+        if (rc != 1)
+            fail ("zmq_recv");
+    }
+    poller_elapsed = zmq_stopwatch_stop (watch);
+
+    watch = zmq_stopwatch_start ();
+    for (i = 0; i != round_count; i++) {
+        rc = zmq_send (vents [i % active_count], "x", 1, 0);
+        if (rc != 1)
+            fail ("zmq_send");
+        rc = zmq_poll (items, socket_count, -1);
+        if (rc < 1)
+            fail ("zmq_poll");
+        int j = (int) ((long) (i % active_count) * socket_count / active_count);
+        if (!(items [j].revents & ZMQ_POLLIN)) {
+            printf ("zmq_poll did not report the active socket\n");
+            return -1;
+        }
+        rc = zmq_recv (sinks [j], buffer, 1, 0);
+        if (rc != 1)
+            fail ("zmq_recv");
+    }
+    poll_elapsed = zmq_stopwatch_stop (watch);
+
+    printf ("socket count: %d\n", socket_count);
+    printf ("active count: %d\n", active_count);
+    printf ("round count: %d\n", round_count);
+    printf ("zmq_poller_wait: %.3f [us/round]\n",
+        (double) poller_elapsed / round_count);
+    printf ("zmq_poll: %.3f [us/round]\n",
+        (double) poll_elapsed / round_count);
+
+    rc = zmq_poller_close (poller);
+    if (rc != 0)
+        fail ("zmq_poller_close");
+    for (i = 0; i != active_count; i++) {
+        rc = zmq_close (vents [i]);
+        if (rc != 0)
+            fail ("zmq_close");
+    }
+    for (i = 0; i != socket_count; i++) {
+        rc = zmq_close (sinks [i]);
+        if (rc != 0)
+            fail ("zmq_close");
+    }
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+
+    free (sinks);
+    free (vents);
+    free (items);
+    return 0;
+}
@@ -0,0 +1,233 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+//  Measures the latency of control messages on a connection saturated
+//  with data messages. A PUSH socket sends <control-count> control
+//  messages, each after 100 data messages of <message-size> bytes, to a
+//  PULL socket over the loopback interface. The receiver spends
+//  <work-usec> on every data message, so the queues stay full. The run
+//  is made with the control messages sent as ordinary messages and then
+//  as priority messages. The kernel socket buffers are kept small, as
+//  queued bytes there can't be overtaken.
+
+static int message_size;
+static int control_count;
+static int work_usec;
+
+//  Busy loop iterations per microsecond of work.
+static unsigned long spins_per_usec;
+
+//  Data messages sent ahead of each control message.
+static const int data_per_control = 100;
+
+//  First byte of every message.
+enum { data_kind = 'd', control_kind = 'c', end_kind = 'e' };
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+static void spin (unsigned long count_)
+{
+    volatile unsigned long counter = 0;
+    while (counter != count_)
+        counter++;
+}
+
+static void calibrate ()
+{
+    const unsigned long count = 10000000;
+    void *watch = zmq_stopwatch_start ();
+    spin (count);
+    unsigned long elapsed = zmq_stopwatch_stop (watch);
+    if (elapsed == 0)
+        elapsed = 1;
+    spins_per_usec = count / elapsed;
+    if (spins_per_usec == 0)
+        spins_per_usec = 1;
+}
+
+static void send_kind (void *socket_, char kind_, void *watch_, bool priority_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init_size (&msg, message_size);
+    if (rc != 0)
+        fail ("zmq_msg_init_size");
+    char *data = (char*) zmq_msg_data (&msg);
+    memset (data, 0, message_size);
+    data [0] = kind_;
+    memcpy (data + 1, &watch_, sizeof (watch_));
+    if (priority_) {
+        rc = zmq_msg_set (&msg, ZMQ_PRIORITY, 1);
+        if (rc != 0)
+            fail ("zmq_msg_set");
+    }
+    rc = zmq_msg_send (&msg, socket_, 0);
+    if (rc < 0)
+        fail ("zmq_msg_send");
+}
+
+struct sender_args_t
+{
+    void *socket;
+    bool priority;
+};
+
+static void sender (void *args_)
+{
+    sender_args_t *args = (sender_args_t*) args_;
+    for (int i = 0; i != control_count; i++) {
+        for (int j = 0; j != data_per_control; j++)
+            send_kind (args->socket, data_kind, NULL, false);
+
+        //  The stopwatch is read by the receiver, in this same process.
+        send_kind (args->socket, control_kind, zmq_stopwatch_start (),
+            args->priority);
+    }
+    send_kind (args->socket, end_kind, NULL, false);
+}
+
+static void run (const char *name_, bool priority_)
+{
+    void *ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    if (!push)
+        fail ("zmq_socket");
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    if (!pull)
+        fail ("zmq_socket");
+
+    int buffer = 8192;
+    int rc = zmq_setsockopt (push, ZMQ_SNDBUF, &buffer, sizeof (buffer));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+    rc = zmq_setsockopt (pull, ZMQ_RCVBUF, &buffer, sizeof (buffer));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+    //  Asks the sender to flag priority messages on the wire.
+    int rcvpriority = 1;
+    rc = zmq_setsockopt (pull, ZMQ_RCVPRIORITY, &rcvpriority,
+        sizeof (rcvpriority));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+
+    rc = zmq_bind (pull, "tcp://127.0.0.1:5598");
+    if (rc != 0)
+        fail ("zmq_bind");
+    rc = zmq_connect (push, "tcp://127.0.0.1:5598");
+    if (rc != 0)
+        fail ("zmq_connect");
+
+    sender_args_t args = {push, priority_};
+    void *thread = zmq_threadstart (sender, &args);
+
+    std::vector <unsigned long> latencies;
+    zmq_msg_t msg;
+    rc = zmq_msg_init (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_init");
+    while (true) {
+        rc = zmq_msg_recv (&msg, pull, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+        const char *data = (const char*) zmq_msg_data (&msg);
+        if (data [0] == data_kind)
+            spin (spins_per_usec * work_usec);
+        else
+        if (data [0] == control_kind) {
+            void *watch;
+            memcpy (&watch, data + 1, sizeof (watch));
+            latencies.push_back (zmq_stopwatch_stop (watch));
+        }
+        else
+            break;
+    }
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+    zmq_threadclose (thread);
+
+    std::sort (latencies.begin (), latencies.end ());
+    double total = 0;
+    for (size_t i = 0; i != latencies.size (); i++)
+        total += latencies [i];
+    printf ("%s: mean %.0f [us], median %lu [us], 99th %lu [us], "
+        "max %lu [us]\n", name_, total / latencies.size (),
+        latencies [latencies.size () / 2],
+        latencies [latencies.size () * 99 / 100],
+        latencies.back ());
+
+    rc = zmq_close (pull);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_close (push);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 4) {
+        printf ("usage: priority_lat <message-size> <control-count> "
+            "<work-usec>\n");
+        return 1;
+    }
+    message_size = atoi (argv [1]);
+    control_count = atoi (argv [2]);
+    work_usec = atoi (argv [3]);
+    if (message_size < (int) (1 + sizeof (void*)) || control_count < 1) {
+        printf ("message size must be at least %d [B], control count at "
+            "least 1\n", (int) (1 + sizeof (void*)));
+        return 1;
+    }
+
+    calibrate ();
+    printf ("message size: %d [B]\n", message_size);
+    printf ("control count: %d\n", control_count);
+    printf ("work per data message: %d [us]\n", work_usec);
+    run ("ordinary", false);
+    run ("priority", true);
+    return 0;
+}
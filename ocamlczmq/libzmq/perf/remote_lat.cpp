@@ -33,28 +33,45 @@
 #include <stdlib.h>
 #include <string.h>
 
+static int compare_ulong (const void *a_, const void *b_)
+{
+    unsigned long a = *(const unsigned long *) a_;
+    unsigned long b = *(const unsigned long *) b_;
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
 int main (int argc, char *argv [])
 {
     const char *connect_to;
     int roundtrip_count;
     size_t message_size;
+    int busy_poll;
     void *ctx;
     void *s;
     int rc;
     int i;
     zmq_msg_t msg;
     void *watch;
+    void *rtt_watch;
     unsigned long elapsed;
+    unsigned long *rtts;
     double latency;
 
-    if (argc != 4) {
+    if (argc != 4 && argc != 5) {
         printf ("usage: remote_lat <connect-to> <message-size> "
-            "<roundtrip-count>\n");
+            "<roundtrip-count> [busy-poll-us]\n");
         return 1;
     }
     connect_to = argv [1];
     message_size = atoi (argv [2]);
     roundtrip_count = atoi (argv [3]);
+    busy_poll = argc == 5 ? atoi (argv [4]) : 0;
+
+    rtts = (unsigned long *) malloc (roundtrip_count * sizeof (unsigned long));
+    if (!rtts) {
+        printf ("error in malloc\n");
+        return -1;
+    }
 
     ctx = zmq_init (1);
     if (!ctx) {
@@ -68,6 +85,12 @@ int main (int argc, char *argv [])
         return -1;
     }
 
+    rc = zmq_setsockopt (s, ZMQ_BUSY_POLL, &busy_poll, sizeof (int));
+    if (rc != 0) {
+        printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
     rc = zmq_connect (s, connect_to);
     if (rc != 0) {
         printf ("error in zmq_connect: %s\n", zmq_strerror (errno));
@@ -84,6 +107,7 @@ int main (int argc, char *argv [])
     watch = zmq_stopwatch_start ();
 
     for (i = 0; i != roundtrip_count; i++) {
+        rtt_watch = zmq_stopwatch_start ();
         rc = zmq_sendmsg (s, &msg, 0);
         if (rc < 0) {
             printf ("error in zmq_sendmsg: %s\n", zmq_strerror (errno));
@@ -98,6 +122,7 @@ int main (int argc, char *argv [])
             printf ("message of incorrect size received\n");
             return -1;
         }
+        rtts [i] = zmq_stopwatch_stop (rtt_watch);
     }
 
     elapsed = zmq_stopwatch_stop (watch);
@@ -112,8 +137,21 @@ int main (int argc, char *argv [])
 
     printf ("message size: %d [B]\n", (int) message_size);
     printf ("roundtrip count: %d\n", (int) roundtrip_count);
+    printf ("busy poll: %d [us]\n", busy_poll);
     printf ("average latency: %.3f [us]\n", (double) latency);
 
+    //  Roundtrip percentiles, halved to match the one-way average above.
+    qsort (rtts, roundtrip_count, sizeof (unsigned long), compare_ulong);
+    printf ("p50 latency: %.1f [us]\n",
+        rtts [roundtrip_count / 2] / 2.0);
+    printf ("p99 latency: %.1f [us]\n",
+        rtts [(int) (roundtrip_count * 0.99)] / 2.0);
+    printf ("p99.9 latency: %.1f [us]\n",
+        rtts [(int) (roundtrip_count * 0.999)] / 2.0);
+    printf ("max latency: %.1f [us]\n",
+        rtts [roundtrip_count - 1] / 2.0);
+    free (rtts);
+
     rc = zmq_close (s);
     if (rc != 0) {
         printf ("error in zmq_close: %s\n", zmq_strerror (errno));
@@ -0,0 +1,217 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Measures the cost of routing messages by identity on a ROUTER socket
+//  as the number of peers grows. <peer-count> DEALER sockets with
+//  distinct identities connect to the ROUTER over inproc, and the ROUTER
+//  sends <message-count> messages to peers picked in pseudo-random order.
+//  Only the sends are timed; the peers are drained between batches.
+
+#define BATCH_SIZE 10000
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+static size_t make_identity (char *identity_, int peer_)
+{
+    return sprintf (identity_, "peer-%08d", peer_);
+}
+
+int main (int argc, char *argv [])
+{
+    int peer_count;
+    size_t message_size;
+    int message_count;
+    void *ctx;
+    void *router;
+    void **peers;
+    int *pending;
+    char identity [32];
+    size_t identity_size;
+    char *buffer;
+    unsigned int seed;
+    int hwm;
+    int mandatory;
+    int sent;
+    int batch;
+    int peer;
+    int rc;
+    int i;
+    unsigned long elapsed;
+    unsigned long throughput;
+
+    if (argc != 4) {
+        printf ("usage: router_peers <peer-count> <message-size> "
+            "<message-count>\n");
+        return 1;
+    }
+    peer_count = atoi (argv [1]);
+    message_size = atoi (argv [2]);
+    message_count = atoi (argv [3]);
+    if (peer_count < 1) {
+        printf ("peer-count must be positive\n");
+        return 1;
+    }
+
+    ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+    rc = zmq_ctx_set (ctx, ZMQ_MAX_SOCKETS, peer_count + 16);
+    if (rc != 0)
+        fail ("zmq_ctx_set");
+
+    router = zmq_socket (ctx, ZMQ_ROUTER);
+    if (!router)
+        fail ("zmq_socket");
+    hwm = 0;
+    rc = zmq_setsockopt (router, ZMQ_SNDHWM, &hwm, sizeof (hwm));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+    mandatory = 1;
+    rc = zmq_setsockopt (router, ZMQ_ROUTER_MANDATORY, &mandatory,
+        sizeof (mandatory));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+    rc = zmq_bind (router, "inproc://router_peers");
+    if (rc != 0)
+        fail ("zmq_bind");
+
+    peers = (void**) malloc (peer_count * sizeof (void*));
+    pending = (int*) calloc (peer_count, sizeof (int));
+    buffer = (char*) malloc (message_size + 1);
+    if (!peers || !pending || !buffer) {
+        printf ("error in malloc\n");
+        return -1;
+    }
+    memset (buffer, 'x', message_size);
+
+    for (i = 0; i != peer_count; i++) {
+        peers [i] = zmq_socket (ctx, ZMQ_DEALER);
+        if (!peers [i])
+            fail ("zmq_socket");
+        rc = zmq_setsockopt (peers [i], ZMQ_RCVHWM, &hwm, sizeof (hwm));
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+        identity_size = make_identity (identity, i);
+        rc = zmq_setsockopt (peers [i], ZMQ_IDENTITY, identity,
+            identity_size);
+        if (rc != 0)
+            fail ("zmq_setsockopt");
+        rc = zmq_connect (peers [i], "inproc://router_peers");
+        if (rc != 0)
+            fail ("zmq_connect");
+    }
+
+    //  Wait until the ROUTER knows every peer. With ZMQ_ROUTER_MANDATORY
+    //  a send to a peer not yet attached fails with EHOSTUNREACH.
+    for (i = 0; i != peer_count; i++) {
+        identity_size = make_identity (identity, i);
+        while (true) {
+            rc = zmq_send (router, identity, identity_size, ZMQ_SNDMORE);
+            if (rc >= 0)
+                break;
+            if (errno != EHOSTUNREACH)
+                fail ("zmq_send");
+        }
+        rc = zmq_send (router, buffer, message_size, 0);
+        if (rc < 0)
+            fail ("zmq_send");
+        rc = zmq_recv (peers [i], buffer, message_size, 0);
+        if (rc < 0)
+            fail ("zmq_recv");
+    }
+
+    sent = 0;
+    elapsed = 0;
+    seed = 1;
+    while (sent != message_count) {
+        batch = message_count - sent < BATCH_SIZE ?
+            message_count - sent : BATCH_SIZE;
+
+        void *watch = zmq_stopwatch_start ();
+        for (i = 0; i != batch; i++, sent++) {
+            seed = seed * 1103515245 + 12345;
+            peer = (int) ((seed >> 8) % (unsigned int) peer_count);
+            identity_size = make_identity (identity, peer);
+            rc = zmq_send (router, identity, identity_size, ZMQ_SNDMORE);
+            if (rc < 0)
+                fail ("zmq_send");
+            rc = zmq_send (router, buffer, message_size, 0);
+            if (rc < 0)
+                fail ("zmq_send");
+            pending [peer]++;
+        }
+        elapsed += zmq_stopwatch_stop (watch);
+
+        for (peer = 0; peer != peer_count; peer++)
+            for (; pending [peer]; pending [peer]--) {
+                rc = zmq_recv (peers [peer], buffer, message_size, 0);
+                if (rc < 0)
+                    fail ("zmq_recv");
+            }
+    }
+    if (elapsed == 0)
+        elapsed = 1;
+
+    throughput = (unsigned long)
+        ((double) message_count / (double) elapsed * 1000000);
+
+    printf ("peer count: %d\n", peer_count);
+    printf ("message size: %d [B]\n", (int) message_size);
+    printf ("message count: %d\n", message_count);
+    printf ("mean throughput: %d [msg/s]\n", (int) throughput);
+    printf ("mean cost: %.3f [us/msg]\n",
+        (double) elapsed / message_count);
+
+    for (i = 0; i != peer_count; i++) {
+        rc = zmq_close (peers [i]);
+        if (rc != 0)
+            fail ("zmq_close");
+    }
+    rc = zmq_close (router);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+
+    free (peers);
+    free (pending);
+    free (buffer);
+    return 0;
+}
@@ -0,0 +1,241 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Measures the cost of subscription matching. An XPUB socket publishes
+//  to a SUB socket over inproc, with <subscription-count> distinct topics
+//  of <topic-length> bytes subscribed. Topics share long prefixes, as
+//  hierarchical topic names do. Every message is matched against the
+//  subscriptions twice, in XPUB and in SUB.
+
+//  Messages are sent in batches and drained between batches to keep
+//  the pipes short.
+#define BATCH_SIZE 1000
+
+static void make_topic (char *topic_, size_t topic_length_, unsigned int id_)
+{
+    //  Pseudo-random filler from a small alphabet followed by the topic id.
+    unsigned int seed = 12345 + (id_ & 0xf);
+    for (size_t i = 0; i != topic_length_ - 8; i++) {
+        seed = seed * 1103515245 + 12345;
+        topic_ [i] = "abcd" [(seed >> 16) & 3];
+    }
+    char id [9];
+    sprintf (id, "%08x", id_);
+    memcpy (topic_ + topic_length_ - 8, id, 8);
+}
+
+int main (int argc, char *argv [])
+{
+    int subscription_count;
+    size_t topic_length;
+    int message_count;
+    void *ctx;
+    void *pub;
+    void *sub;
+    int rc;
+    int i;
+    int hwm;
+    int sent;
+    int matched;
+    int expected;
+    int batch;
+    char *topics;
+    char *buffer;
+    void *watch;
+    unsigned long elapsed;
+    unsigned long throughput;
+
+    if (argc != 4) {
+        printf ("usage: sub_match <subscription-count> <topic-length> "
+            "<message-count>\n");
+        return 1;
+    }
+    subscription_count = atoi (argv [1]);
+    topic_length = atoi (argv [2]);
+    message_count = atoi (argv [3]);
+    if (subscription_count < 1 || topic_length < 8) {
+        printf ("subscription-count must be positive, topic-length "
+            "at least 8\n");
+        return 1;
+    }
+
+    ctx = zmq_init (1);
+    if (!ctx) {
+        printf ("error in zmq_init: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
+    pub = zmq_socket (ctx, ZMQ_XPUB);
+    if (!pub) {
+        printf ("error in zmq_socket: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+    //  Both messages and subscriptions are dropped rather than blocked at
+    //  the high-water mark, so lift the limits in both directions.
+    hwm = 0;
+    rc = zmq_setsockopt (pub, ZMQ_SNDHWM, &hwm, sizeof (hwm));
+    if (rc != 0) {
+        printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+    rc = zmq_setsockopt (pub, ZMQ_RCVHWM, &hwm, sizeof (hwm));
+    if (rc != 0) {
+        printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
+    rc = zmq_bind (pub, "inproc://sub_match");
+    if (rc != 0) {
+        printf ("error in zmq_bind: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
+    sub = zmq_socket (ctx, ZMQ_SUB);
+    if (!sub) {
+        printf ("error in zmq_socket: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+    rc = zmq_setsockopt (sub, ZMQ_SNDHWM, &hwm, sizeof (hwm));
+    if (rc != 0) {
+        printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+    rc = zmq_setsockopt (sub, ZMQ_RCVHWM, &hwm, sizeof (hwm));
+    if (rc != 0) {
+        printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
+    rc = zmq_connect (sub, "inproc://sub_match");
+    if (rc != 0) {
+        printf ("error in zmq_connect: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
+    //  Subscribe and wait until the publisher has seen all subscriptions.
+    topics = (char*) malloc (subscription_count * topic_length);
+    buffer = (char*) malloc (topic_length + 16);
+    if (!topics || !buffer) {
+        printf ("error in malloc\n");
+        return -1;
+    }
+    for (i = 0; i != subscription_count; i++) {
+        make_topic (topics + i * topic_length, topic_length, i);
+        rc = zmq_setsockopt (sub, ZMQ_SUBSCRIBE, topics + i * topic_length,
+            topic_length);
+        if (rc != 0) {
+            printf ("error in zmq_setsockopt: %s\n", zmq_strerror (errno));
+            return -1;
+        }
+    }
+    for (i = 0; i != subscription_count; i++) {
+        rc = zmq_recv (pub, buffer, topic_length + 16, 0);
+        if (rc < 0) {
+            printf ("error in zmq_recv: %s\n", zmq_strerror (errno));
+            return -1;
+        }
+    }
+
+    sent = 0;
+    matched = 0;
+    watch = zmq_stopwatch_start ();
+
+    //  Every other message matches a subscription, the rest fall through
+    //  after a long shared prefix.
+    while (sent != message_count) {
+        batch = message_count - sent < BATCH_SIZE ?
+            message_count - sent : BATCH_SIZE;
+        expected = 0;
+        for (i = 0; i != batch; i++, sent++) {
+            memcpy (buffer, topics + (sent % subscription_count) *
+                topic_length, topic_length);
+            if (sent % 2)
+                buffer [topic_length - 1] = 'z';
+            else
+                expected++;
+            memcpy (buffer + topic_length, "payload", 8);
+            rc = zmq_send (pub, buffer, topic_length + 8, 0);
+            if (rc < 0) {
+                printf ("error in zmq_send: %s\n", zmq_strerror (errno));
+                return -1;
+            }
+        }
+        for (i = 0; i != expected; i++, matched++) {
+            rc = zmq_recv (sub, buffer, topic_length + 16, 0);
+            if (rc < 0) {
+                printf ("error in zmq_recv: %s\n", zmq_strerror (errno));
+                return -1;
+            }
+        }
+    }
+
+    elapsed = zmq_stopwatch_stop (watch);
+    if (elapsed == 0)
+        elapsed = 1;
+
+    throughput = (unsigned long)
+        ((double) message_count / (double) elapsed * 1000000);
+
+    printf ("subscription count: %d\n", subscription_count);
+    printf ("topic length: %d [B]\n", (int) topic_length);
+    printf ("message count: %d\n", message_count);
+    printf ("messages matched: %d\n", matched);
+    printf ("mean throughput: %d [msg/s]\n", (int) throughput);
+    printf ("mean cost: %.3f [us/msg]\n",
+        (double) elapsed / message_count);
+
+    free (topics);
+    free (buffer);
+
+    rc = zmq_close (sub);
+    if (rc != 0) {
+        printf ("error in zmq_close: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
+    rc = zmq_close (pub);
+    if (rc != 0) {
+        printf ("error in zmq_close: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
+    rc = zmq_term (ctx);
+    if (rc != 0) {
+        printf ("error in zmq_term: %s\n", zmq_strerror (errno));
+        return -1;
+    }
+
+    return 0;
+}
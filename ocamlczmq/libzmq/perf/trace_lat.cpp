@@ -0,0 +1,326 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+//  Breaks the latency of messages down into the stages of their path using
+//  message tracing (zmq_trace_start). A PUSH socket sends <message-count>
+//  messages of <message-size> bytes, one every <gap-us> microseconds, to a
+//  PULL socket over the loopback interface. The trace is then matched up
+//  message by message: parts are counted at the sockets, the pipe and the
+//  codecs, and located in the byte stream for the write and read system
+//  calls, which carry many messages or a part of one. Percentiles of each
+//  stage and the slowest messages are reported.
+
+static int message_size;
+static int message_count;
+static int gap;
+
+enum
+{
+    stage_pipe,
+    stage_encode,
+    stage_write,
+    stage_read,
+    stage_decode,
+    stage_recv,
+    stages
+};
+
+static const char *stage_names [stages] = {
+    "send -> pipe",
+    "pipe -> encode",
+    "encode -> write",
+    "write -> read",
+    "read -> decode",
+    "decode -> recv"
+};
+
+//  Times a message passed each point, in nanoseconds.
+struct breakdown_t
+{
+    uint64_t sent;
+    uint64_t at [stages];
+
+    uint64_t total () const
+    {
+        return at [stages - 1] - sent;
+    }
+
+    uint64_t stage (int stage_) const
+    {
+        return at [stage_] - (stage_ ? at [stage_ - 1] : sent);
+    }
+};
+
+static void fail (const char *call_)
+{
+    printf ("error in %s: %s\n", call_, zmq_strerror (errno));
+    exit (1);
+}
+
+static void sender (void *push_)
+{
+    struct timespec pause;
+    pause.tv_sec = gap / 1000000;
+    pause.tv_nsec = (long) (gap % 1000000) * 1000;
+
+    zmq_msg_t msg;
+    for (int i = 0; i != message_count; i++) {
+        int rc = zmq_msg_init_size (&msg, message_size);
+        if (rc != 0)
+            fail ("zmq_msg_init_size");
+        rc = zmq_msg_send (&msg, push_, 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+        if (gap)
+            nanosleep (&pause, NULL);
+    }
+}
+
+typedef std::vector <const zmq_trace_event_t *> events_t;
+
+//  Events of the given kind, optionally only those of one thread or of
+//  one object.
+static events_t filter (const std::vector <zmq_trace_event_t> &trace_,
+    uint32_t point_, const uint32_t *thread_, const uint64_t *object_)
+{
+    events_t events;
+    for (size_t i = 0; i != trace_.size (); i++) {
+        const zmq_trace_event_t &event = trace_ [i];
+        if (event.point == point_
+        &&  (!thread_ || event.thread == *thread_)
+        &&  (!object_ || event.object == *object_))
+            events.push_back (&event);
+    }
+    return events;
+}
+
+//  Matches up the trace of a single connection that carried messages in
+//  one direction only. Returns false if the trace is incomplete.
+static bool reconstruct (const std::vector <zmq_trace_event_t> &trace_,
+    std::vector <breakdown_t> &messages_)
+{
+    const events_t sends = filter (trace_, ZMQ_TRACE_SEND, NULL, NULL);
+    const events_t encodes = filter (trace_, ZMQ_TRACE_ENCODE, NULL, NULL);
+    const events_t decodes = filter (trace_, ZMQ_TRACE_DECODE, NULL, NULL);
+    const events_t recvs = filter (trace_, ZMQ_TRACE_RECV, NULL, NULL);
+    if (sends.empty () || encodes.empty () || decodes.empty ())
+        return false;
+
+    //  The receiving side writes into a pipe of its own, in an I/O thread.
+    const events_t pipes =
+        filter (trace_, ZMQ_TRACE_PIPE_WRITE, &sends [0]->thread, NULL);
+
+    //  The receiving connection writes the handshake only and the sending
+    //  one reads it, so the system calls are those of the codecs' engines.
+    const events_t writes =
+        filter (trace_, ZMQ_TRACE_WRITE, NULL, &encodes [0]->object);
+    const events_t reads =
+        filter (trace_, ZMQ_TRACE_READ, NULL, &decodes [0]->object);
+
+    const size_t count = sends.size ();
+    if (pipes.size () != count || encodes.size () != count
+    ||  decodes.size () != count || recvs.size () != count)
+        return false;
+
+    size_t write = 0;
+    size_t read = 0;
+    for (size_t i = 0; i != count; i++) {
+        breakdown_t message;
+        message.sent = sends [i]->time;
+        message.at [stage_pipe] = pipes [i]->time;
+        message.at [stage_encode] = encodes [i]->time;
+
+        //  A message is written by the first write past its start...
+        while (write != writes.size ()
+               && writes [write]->value <= encodes [i]->value)
+            write++;
+        if (write == writes.size ())
+            return false;
+        message.at [stage_write] = writes [write]->time;
+
+        //  ... and read by the read that completes it.
+        while (read != reads.size () && reads [read]->value < decodes [i]->value)
+            read++;
+        if (read == reads.size ())
+            return false;
+        message.at [stage_read] = reads [read]->time;
+
+        message.at [stage_decode] = decodes [i]->time;
+        message.at [stage_recv] = recvs [i]->time;
+        messages_.push_back (message);
+    }
+    return true;
+}
+
+static double percentile (std::vector <uint64_t> &values_, int percent_)
+{
+    std::sort (values_.begin (), values_.end ());
+    size_t index = values_.size () * percent_ / 100;
+    if (index == values_.size ())
+        index--;
+    return values_ [index] / 1000.0;
+}
+
+static void print_row (const char *name_, std::vector <uint64_t> &values_)
+{
+    printf ("%-16s %10.3f %10.3f %10.3f %10.3f\n", name_,
+        percentile (values_, 50), percentile (values_, 90),
+        percentile (values_, 99), percentile (values_, 100));
+}
+
+static bool slower (const breakdown_t &a_, const breakdown_t &b_)
+{
+    return a_.total () > b_.total ();
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 4) {
+        printf ("usage: trace_lat <message-size> <message-count> "
+            "<gap-us>\n");
+        return 1;
+    }
+    message_size = atoi (argv [1]);
+    message_count = atoi (argv [2]);
+    gap = atoi (argv [3]);
+
+    void *ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    if (!pull)
+        fail ("zmq_socket");
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    if (!push)
+        fail ("zmq_socket");
+    int rc = zmq_bind (pull, "tcp://127.0.0.1:5620");
+    if (rc != 0)
+        fail ("zmq_bind");
+    rc = zmq_connect (push, "tcp://127.0.0.1:5620");
+    if (rc != 0)
+        fail ("zmq_connect");
+
+    //  Complete the handshake before tracing.
+    zmq_msg_t msg;
+    rc = zmq_msg_init (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_init");
+    rc = zmq_msg_send (&msg, push, 0);
+    if (rc < 0)
+        fail ("zmq_msg_send");
+    rc = zmq_msg_recv (&msg, pull, 0);
+    if (rc < 0)
+        fail ("zmq_msg_recv");
+
+    //  Every message leaves up to 5 events in the I/O thread, which runs
+    //  both connections, and fewer in the others.
+    rc = zmq_trace_start ((size_t) message_count * 5);
+    if (rc != 0)
+        fail ("zmq_trace_start");
+    void *thread = zmq_threadstart (sender, push);
+    for (int i = 0; i != message_count; i++) {
+        rc = zmq_msg_recv (&msg, pull, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+    }
+    zmq_threadclose (thread);
+    rc = zmq_trace_stop ();
+    if (rc != 0)
+        fail ("zmq_trace_stop");
+
+    size_t count;
+    rc = zmq_trace_dump (NULL, &count);
+    if (rc != 0)
+        fail ("zmq_trace_dump");
+    std::vector <zmq_trace_event_t> trace (count);
+    rc = zmq_trace_dump (count ? &trace [0] : NULL, &count);
+    if (rc != 0)
+        fail ("zmq_trace_dump");
+    trace.resize (count);
+
+    rc = zmq_msg_close (&msg);
+    if (rc != 0)
+        fail ("zmq_msg_close");
+    rc = zmq_close (push);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_close (pull);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+
+    std::vector <breakdown_t> messages;
+    if (!reconstruct (trace, messages)) {
+        printf ("error: the trace of %d messages is incomplete\n",
+            message_count);
+        return 1;
+    }
+
+    printf ("message size: %d [B]\n", message_size);
+    printf ("message count: %d\n", message_count);
+    printf ("trace events: %d\n", (int) trace.size ());
+    printf ("%-16s %10s %10s %10s %10s\n", "[us]", "p50", "p90", "p99",
+        "max");
+    std::vector <uint64_t> values (messages.size ());
+    for (int stage = 0; stage != stages; stage++) {
+        for (size_t i = 0; i != messages.size (); i++)
+            values [i] = messages [i].stage (stage);
+        print_row (stage_names [stage], values);
+    }
+    for (size_t i = 0; i != messages.size (); i++)
+        values [i] = messages [i].total ();
+    print_row ("total", values);
+
+    //  Where the outliers spent their time.
+    std::vector <breakdown_t> slowest (messages);
+    std::sort (slowest.begin (), slowest.end (), slower);
+    if (slowest.size () > 5)
+        slowest.resize (5);
+    printf ("slowest messages [us]:\n");
+    for (size_t i = 0; i != slowest.size (); i++) {
+        printf ("%10.3f =", slowest [i].total () / 1000.0);
+        for (int stage = 0; stage != stages; stage++)
+            printf (" %.3f", slowest [i].stage (stage) / 1000.0);
+        printf ("\n");
+    }
+
+    return 0;
+}
@@ -48,6 +48,7 @@ void zmq::client_t::xattach_pipe (pipe_t *pipe_, bool subscribe_to_all_)
 
     zmq_assert (pipe_);
 
+    fq.set_priority (options.rcvpriority);
     fq.attach (pipe_);
     lb.attach (pipe_);
 }
@@ -88,6 +89,11 @@ bool zmq::client_t::xhas_out ()
     return lb.has_out ();
 }
 
+uint64_t zmq::client_t::xdrops ()
+{
+    return lb.get_drops ();
+}
+
 zmq::blob_t zmq::client_t::get_credential () const
 {
     return fq.get_credential ();
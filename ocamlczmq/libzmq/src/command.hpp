@@ -40,6 +40,8 @@ namespace zmq
     struct i_engine;
     class pipe_t;
     class socket_base_t;
+    class session_base_t;
+    class stream_engine_t;
 
     //  This structure defines the commands that can be sent between threads.
 
@@ -70,6 +72,7 @@ namespace zmq
             reap,
             reaped,
             inproc_connected,
+            migrate,
             done
         } type;
 
@@ -108,16 +111,19 @@ namespace zmq
             } activate_read;
 
             //  Sent by pipe reader to inform pipe writer about how many
-            //  messages it has read so far.
+            //  messages and bytes it has read so far.
             struct {
                 uint64_t msgs_read;
+                uint64_t bytes_read;
             } activate_write;
 
             //  Sent by pipe reader to writer after creating a new inpipe.
-            //  The parameter is actually of type pipe_t::upipe_t, however,
-            //  its definition is private so we'll have to do with void*.
+            //  The parameters are actually of types pipe_t::upipe_t and
+            //  pipe_t::prio_lane_t, however, their definitions are private
+            //  so we'll have to do with void*.
             struct {
                 void *pipe;
+                void *prio;
             } hiccup;
 
             //  Sent by pipe reader to pipe writer to ask it to terminate
@@ -155,6 +161,13 @@ namespace zmq
             struct {
             } reaped;
 
+            //  Sent to I/O thread to hand over a session and its engine,
+            //  detached from the I/O thread they lived in so far.
+            struct {
+                zmq::session_base_t *session;
+                zmq::stream_engine_t *engine;
+            } migrate;
+
             //  Sent by reaper thread to the term thread when all the sockets
             //  are successfully deallocated.
             struct {
@@ -42,6 +42,11 @@ namespace zmq
         //  memory allocation by approximately 99.6%
         message_pipe_granularity = 256,
 
+        //  Messages in the priority lane of a message pipe per allocation
+        //  event. Priority messages are expected to be few, so the lane is
+        //  kept small.
+        priority_pipe_granularity = 8,
+
         //  Commands in pipe per allocation event.
         command_pipe_granularity = 16,
 
@@ -50,25 +55,69 @@ namespace zmq
         //  socket will process 100 inbound messages before doing the poll.
         //  If there are no unprocessed messages available, poll is done
         //  immediately. Decreasing the value trades overall latency for more
-        //  real-time behaviour (less latency peaks).
+        //  real-time behaviour (less latency peaks). This is the default of
+        //  ZMQ_INBOUND_POLL_RATE.
         inbound_poll_rate = 100,
 
+        //  With ZMQ_ADAPTIVE_BATCH, a socket receiving messages in a row
+        //  doubles its inbound poll rate, up to this many times
+        //  ZMQ_INBOUND_POLL_RATE, each time a poll finds no command.
+        adaptive_poll_factor = 16,
+
         //  Maximal batching size for engines with receiving functionality.
         //  So, if there are 10 messages that fit into the batch size, all of
         //  them may be read by a single 'recv' system call, thus avoiding
-        //  unnecessary network stack traversals.
+        //  unnecessary network stack traversals. Used by the multicast
+        //  engines; stream engines use ZMQ_TCP_RECV_BUFFER instead.
         in_batch_size = 8192,
 
+        //  With ZMQ_ADAPTIVE_BATCH, stream engines double a batch that was
+        //  filled completely, up to this many times ZMQ_TCP_RECV_BUFFER or
+        //  ZMQ_TCP_SEND_BUFFER, and halve it again after this many batches
+        //  in a row filled to less than a quarter.
+        adaptive_batch_factor = 32,
+        adaptive_batch_shrink = 8,
+
+        //  Number of shards of a context's registry of inproc endpoints,
+        //  a power of 2. Sockets binding and connecting to addresses in
+        //  different shards don't contend for a lock.
+        inproc_shards = 16,
+
         //  Maximal delta between high and low watermark.
         max_wm_delta = 1024,
 
+        //  Number of CPUs ZMQ_IO_THREAD_AFFINITY can refer to, as the size
+        //  of the Linux CPU set.
+        max_cpus = 1024,
+
         //  Maximum number of events the I/O thread can process in one go.
+        //  This is the default of ZMQ_IO_EVENTS.
         max_io_events = 256,
 
+        //  I/O threads move engines between themselves only if the busiest
+        //  one handles at least this many I/O events per second more than
+        //  the least busy one. See ZMQ_IO_REBALANCE_IVL.
+        rebalance_min_rate = 1000,
+
+        //  Maximal time in milliseconds a TCP connection being closed waits
+        //  for the kernel to be done with messages sent with MSG_ZEROCOPY.
+        //  See ZMQ_ZEROCOPY_THRESHOLD.
+        zerocopy_linger = 100,
+
+        //  Maximal size in bytes of a buffer medium messages are carved
+        //  from, and largest medium message. See ZMQ_MEDIUM_MSG_SIZE.
+        mmsg_buffer_size = 4 * 1024 * 1024,
+        mmsg_max_size = 8192,
+
+        //  Maximal number of CURVE session tickets a context keeps, as
+        //  server and as client each. See ZMQ_CURVE_RESUME.
+        curve_tickets_max = 65536,
+
         //  Maximal delay to process command in API thread (in CPU ticks).
         //  3,000,000 ticks equals to 1 - 2 milliseconds on current CPUs.
         //  Note that delay is only applied when there is continuous stream of
         //  messages to process. If not so, commands are processed immediately.
+        //  This is the default of ZMQ_MAX_COMMAND_DELAY.
         max_command_delay = 3000000,
 
         //  Low-precision clock precision in CPU ticks. 1ms. Value of 1000000
@@ -46,6 +46,7 @@
 #include "pipe.hpp"
 #include "err.hpp"
 #include "msg.hpp"
+#include "msg_pool.hpp"
 
 #ifdef HAVE_LIBSODIUM
 #ifdef HAVE_TWEETNACL
@@ -53,6 +54,7 @@
 #else
 #include "sodium.h"
 #endif
+#include "curve_tickets.hpp"
 #endif
 
 #ifdef ZMQ_HAVE_VMCI
@@ -83,7 +85,14 @@ zmq::ctx_t::ctx_t () :
     blocky (true),
     ipv6 (false),
     thread_priority (ZMQ_THREAD_PRIORITY_DFLT),
-    thread_sched_policy (ZMQ_THREAD_SCHED_POLICY_DFLT)
+    thread_sched_policy (ZMQ_THREAD_SCHED_POLICY_DFLT),
+    msg_pool (false),
+    io_rebalance_ivl (0),
+    rebalance_ivl (0),
+    memory_budget (0),
+    memory_budget_kb (0),
+    io_events (max_io_events),
+    io_thread_events (max_io_events)
 {
 #ifdef HAVE_FORK
     pid = getpid();
@@ -92,6 +101,9 @@ zmq::ctx_t::ctx_t () :
     vmci_fd = -1;
     vmci_family = -1;
 #endif
+#ifdef HAVE_LIBSODIUM
+    curve_tickets = NULL;
+#endif
 }
 
 bool zmq::ctx_t::check_tag ()
@@ -123,9 +135,13 @@ zmq::ctx_t::~ctx_t ()
     //  corresponding io_thread/socket objects.
     free (slots);
 
+    if (msg_pool)
+        msg_pool_t::disable ();
+
     //  If we've done any Curve encryption, we may have a file handle
     //  to /dev/urandom open that needs to be cleaned up.
 #ifdef HAVE_LIBSODIUM
+    LIBZMQ_DELETE(curve_tickets);
     randombytes_close();
 #endif
 
@@ -141,10 +157,19 @@ int zmq::ctx_t::terminate ()
 	terminating = false;
 
 	// Connect up any pending inproc connections, otherwise we will hang
-    pending_connections_t copy = pending_connections;
-    for (pending_connections_t::iterator p = copy.begin (); p != copy.end (); ++p) {
+    std::vector <std::string> pending;
+    for (int i = 0; i != inproc_shards; i++) {
+        endpoint_shard_t &shard = endpoint_shards [i];
+        shard.sync.lock ();
+        for (pending_connections_t::iterator p =
+              shard.pending_connections.begin ();
+              p != shard.pending_connections.end (); ++p)
+            pending.push_back (p->first);
+        shard.sync.unlock ();
+    }
+    for (size_t i = 0; i != pending.size (); i++) {
         zmq::socket_base_t *s = create_socket (ZMQ_PAIR);
-        s->bind (p->first.c_str ());
+        s->bind (pending [i].c_str ());
         s->close ();
     }
 	terminating = saveTerminating;
@@ -265,6 +290,137 @@ int zmq::ctx_t::set (int option_, int optval_)
         blocky = (optval_ != 0);
         opt_sync.unlock ();
     }
+    else
+    if (option_ == ZMQ_IO_REBALANCE_IVL && optval_ >= 0) {
+        opt_sync.lock ();
+        io_rebalance_ivl = optval_;
+        opt_sync.unlock ();
+    }
+    else
+    if (option_ == ZMQ_MEMORY_BUDGET && optval_ >= 0) {
+        opt_sync.lock ();
+        memory_budget = optval_;
+        opt_sync.unlock ();
+    }
+    else
+    if (option_ == ZMQ_IO_EVENTS && optval_ >= 1) {
+        opt_sync.lock ();
+        io_events = optval_;
+        opt_sync.unlock ();
+    }
+    else
+    if (option_ == ZMQ_MSG_POOL && optval_ >= 0) {
+        opt_sync.lock ();
+        if ((optval_ != 0) != msg_pool) {
+            msg_pool = (optval_ != 0);
+            if (msg_pool)
+                msg_pool_t::enable ();
+            else
+                msg_pool_t::disable ();
+        }
+        opt_sync.unlock ();
+    }
+    else {
+        errno = EINVAL;
+        rc = -1;
+    }
+    return rc;
+}
+
+//  Parses a number at pos_ in value_, advancing pos_ past it.
+static bool parse_cpu (const std::string &value_, size_t &pos_, int &cpu_)
+{
+    const size_t start = pos_;
+    cpu_ = 0;
+    while (pos_ != value_.size () && value_ [pos_] >= '0'
+          && value_ [pos_] <= '9') {
+        cpu_ = cpu_ * 10 + (value_ [pos_] - '0');
+        if (cpu_ >= zmq::max_cpus)
+            return false;
+        pos_++;
+    }
+    return pos_ != start;
+}
+
+//  Parses the CPU lists of ZMQ_IO_THREAD_AFFINITY, one per I/O thread,
+//  separated by semicolons. A list holds CPU numbers and ranges of them
+//  separated by commas, such as "0,2-3", or nothing.
+static bool parse_cpu_lists (const std::string &value_,
+    std::vector <std::set <int> > &cpus_)
+{
+    cpus_.clear ();
+    if (value_.empty ())
+        return true;
+
+    cpus_.push_back (std::set <int> ());
+    size_t pos = 0;
+    while (pos != value_.size ()) {
+        if (value_ [pos] == ';') {
+            cpus_.push_back (std::set <int> ());
+            pos++;
+            continue;
+        }
+        if (!cpus_.back ().empty ()) {
+            if (value_ [pos] != ',')
+                return false;
+            pos++;
+        }
+        int first;
+        if (!parse_cpu (value_, pos, first))
+            return false;
+        int last = first;
+        if (pos != value_.size () && value_ [pos] == '-') {
+            pos++;
+            if (!parse_cpu (value_, pos, last) || last < first)
+                return false;
+        }
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus_.back ().insert (cpu);
+    }
+    return true;
+}
+
+int zmq::ctx_t::set_ext (int option_, const void *optval_, size_t optvallen_)
+{
+    int rc = 0;
+    if (option_ == ZMQ_IO_THREAD_AFFINITY && (optval_ || !optvallen_)) {
+        const std::string value ((const char *) optval_, optvallen_);
+        cpu_sets_t cpus;
+        if (value.find ('\0') == std::string::npos
+        &&  parse_cpu_lists (value, cpus)) {
+            opt_sync.lock ();
+            io_thread_affinity = value;
+            io_thread_cpus = cpus;
+            opt_sync.unlock ();
+        }
+        else {
+            errno = EINVAL;
+            rc = -1;
+        }
+    }
+    else {
+        errno = EINVAL;
+        rc = -1;
+    }
+    return rc;
+}
+
+int zmq::ctx_t::get_ext (int option_, void *optval_, size_t *optvallen_)
+{
+    int rc = 0;
+    if (option_ == ZMQ_IO_THREAD_AFFINITY) {
+        opt_sync.lock ();
+        if (*optvallen_ >= io_thread_affinity.size () + 1) {
+            memcpy (optval_, io_thread_affinity.c_str (),
+                io_thread_affinity.size () + 1);
+            *optvallen_ = io_thread_affinity.size () + 1;
+        }
+        else {
+            errno = EINVAL;
+            rc = -1;
+        }
+        opt_sync.unlock ();
+    }
     else {
         errno = EINVAL;
         rc = -1;
@@ -289,6 +445,18 @@ int zmq::ctx_t::get (int option_)
     else
     if (option_ == ZMQ_BLOCKY)
         rc = blocky;
+    else
+    if (option_ == ZMQ_MSG_POOL)
+        rc = msg_pool;
+    else
+    if (option_ == ZMQ_IO_REBALANCE_IVL)
+        rc = io_rebalance_ivl;
+    else
+    if (option_ == ZMQ_MEMORY_BUDGET)
+        rc = memory_budget;
+    else
+    if (option_ == ZMQ_IO_EVENTS)
+        rc = io_events;
     else {
         errno = EINVAL;
         rc = -1;
@@ -307,6 +475,10 @@ zmq::socket_base_t *zmq::ctx_t::create_socket (int type_)
         opt_sync.lock ();
         int mazmq = max_sockets;
         int ios = io_thread_count;
+        cpu_sets_t cpus = io_thread_cpus;
+        rebalance_ivl = ios > 1 ? io_rebalance_ivl : 0;
+        memory_budget_kb = memory_budget;
+        io_thread_events = io_events;
         opt_sync.unlock ();
         slot_count = mazmq + ios + 2;
         slots = (i_mailbox **) malloc (sizeof (i_mailbox*) * slot_count);
@@ -323,7 +495,9 @@ zmq::socket_base_t *zmq::ctx_t::create_socket (int type_)
 
         //  Create I/O thread objects and launch them.
         for (int i = 2; i != ios + 2; i++) {
-            io_thread_t *io_thread = new (std::nothrow) io_thread_t (this, i);
+            io_thread_t *io_thread = new (std::nothrow) io_thread_t (this, i,
+                rebalance_ivl, i - 2 < (int) cpus.size () ?
+                    cpus [i - 2] : std::set <int> ());
             alloc_assert (io_thread);
             io_threads.push_back (io_thread);
             slots [i] = io_thread->get_mailbox ();
@@ -393,19 +567,78 @@ void zmq::ctx_t::destroy_socket (class socket_base_t *socket_)
     slot_sync.unlock ();
 }
 
+zmq::io_thread_t *zmq::ctx_t::choose_idle_io_thread (io_thread_t *busy_,
+    uint32_t *rate_)
+{
+    io_thread_t *selected_io_thread = NULL;
+    for (io_threads_t::size_type i = 0; i != io_threads.size (); i++) {
+        if (io_threads [i] == busy_)
+            continue;
+        const uint32_t rate = io_threads [i]->get_rate ();
+        if (!selected_io_thread || rate < *rate_) {
+            selected_io_thread = io_threads [i];
+            *rate_ = rate;
+        }
+    }
+    return selected_io_thread;
+}
+
+zmq::mutex_t &zmq::ctx_t::get_migration_sync ()
+{
+    return migration_sync;
+}
+
+int zmq::ctx_t::get_io_events () const
+{
+    return io_thread_events;
+}
+
+uint32_t zmq::ctx_t::get_memory_budget () const
+{
+    return memory_budget_kb;
+}
+
+bool zmq::ctx_t::over_memory_budget () const
+{
+    return queued_kb.get () >= memory_budget_kb;
+}
+
+void zmq::ctx_t::charge_memory (uint32_t kbytes_)
+{
+    queued_kb.add (kbytes_);
+}
+
+void zmq::ctx_t::release_memory (uint32_t kbytes_)
+{
+    queued_kb.sub (kbytes_);
+}
+
 zmq::object_t *zmq::ctx_t::get_reaper ()
 {
     return reaper;
 }
 
-void zmq::ctx_t::start_thread (thread_t &thread_, thread_fn *tfn_, void *arg_) const
+void zmq::ctx_t::start_thread (thread_t &thread_, thread_fn *tfn_, void *arg_,
+    const std::set <int> &cpus_) const
 {
+    thread_.setAffinity (cpus_);
     thread_.start(tfn_, arg_);
     thread_.setSchedulingParameters(thread_priority, thread_sched_policy);
 }
 
 void zmq::ctx_t::send_command (uint32_t tid_, const command_t &command_)
 {
+    //  With ZMQ_IO_REBALANCE_IVL set, objects living in I/O threads may be
+    //  migrated to another I/O thread. The mailbox of the thread an object
+    //  has left refuses commands for it, so look up its new thread.
+    if (rebalance_ivl > 0 && tid_ > reaper_tid
+    &&  tid_ <= reaper_tid + io_threads.size ()) {
+        while (!io_threads [tid_ - reaper_tid - 1]->get_mailbox ()->send (
+              command_, tid_))
+            tid_ = command_.destination->get_tid ();
+        return;
+    }
+
     slots [tid_]->send (command_);
 }
 
@@ -429,17 +662,51 @@ zmq::io_thread_t *zmq::ctx_t::choose_io_thread (uint64_t affinity_)
     return selected_io_thread;
 }
 
+void zmq::ctx_t::get_io_threads (uint64_t affinity_,
+    std::vector <zmq::io_thread_t*> &io_threads_)
+{
+    for (io_threads_t::size_type i = 0; i != io_threads.size (); i++)
+        if (!affinity_ || (affinity_ & (uint64_t (1) << i)))
+            io_threads_.push_back (io_threads [i]);
+}
+
+zmq::ctx_t::endpoint_shard_t &zmq::ctx_t::get_shard (const std::string &addr_)
+{
+    //  FNV-1a hash of the address.
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i != addr_.size (); i++) {
+        hash ^= (unsigned char) addr_ [i];
+        hash *= 16777619u;
+    }
+    return endpoint_shards [hash & (inproc_shards - 1)];
+}
+
+void zmq::ctx_t::release_endpoint (endpoint_entry_t *entry_)
+{
+    if (!entry_->refs.sub (1))
+        delete entry_;
+}
+
 int zmq::ctx_t::register_endpoint (const char *addr_,
         const endpoint_t &endpoint_)
 {
-    endpoints_sync.lock ();
+    //  The entry is prepared before locking the shard.
+    const std::string addr (addr_);
+    endpoint_entry_t *entry = new (std::nothrow) endpoint_entry_t;
+    alloc_assert (entry);
+    entry->endpoint = endpoint_;
+    entry->refs.set (1);
 
-    const bool inserted = endpoints.insert (
-        endpoints_t::value_type (std::string (addr_), endpoint_)).second;
+    endpoint_shard_t &shard = get_shard (addr);
+    shard.sync.lock ();
 
-    endpoints_sync.unlock ();
+    const bool inserted = shard.endpoints.insert (
+        endpoints_t::value_type (addr, entry)).second;
+
+    shard.sync.unlock ();
 
     if (!inserted) {
+        delete entry;
         errno = EADDRINUSE;
         return -1;
     }
@@ -449,61 +716,55 @@ int zmq::ctx_t::register_endpoint (const char *addr_,
 int zmq::ctx_t::unregister_endpoint (
         const std::string &addr_, socket_base_t *socket_)
 {
-    endpoints_sync.lock ();
+    endpoint_shard_t &shard = get_shard (addr_);
+    shard.sync.lock ();
 
-    const endpoints_t::iterator it = endpoints.find (addr_);
-    if (it == endpoints.end () || it->second.socket != socket_) {
-        endpoints_sync.unlock ();
+    const endpoints_t::iterator it = shard.endpoints.find (addr_);
+    if (it == shard.endpoints.end ()
+          || it->second->endpoint.socket != socket_) {
+        shard.sync.unlock ();
         errno = ENOENT;
         return -1;
     }
 
     //  Remove endpoint.
-    endpoints.erase (it);
+    endpoint_entry_t *entry = it->second;
+    shard.endpoints.erase (it);
 
-    endpoints_sync.unlock ();
+    shard.sync.unlock ();
 
+    release_endpoint (entry);
     return 0;
 }
 
-void zmq::ctx_t::unregister_endpoints (socket_base_t *socket_)
-{
-    endpoints_sync.lock ();
-
-    endpoints_t::iterator it = endpoints.begin ();
-    while (it != endpoints.end ()) {
-        if (it->second.socket == socket_) {
-            endpoints_t::iterator to_erase = it;
-            ++it;
-            endpoints.erase (to_erase);
-            continue;
-        }
-        ++it;
-    }
-
-    endpoints_sync.unlock ();
-}
-
 zmq::endpoint_t zmq::ctx_t::find_endpoint (const char *addr_)
 {
-     endpoints_sync.lock ();
+     const std::string addr (addr_);
+     endpoint_shard_t &shard = get_shard (addr);
+     shard.sync.lock ();
 
-     endpoints_t::iterator it = endpoints.find (addr_);
-     if (it == endpoints.end ()) {
-         endpoints_sync.unlock ();
+     endpoints_t::iterator it = shard.endpoints.find (addr);
+     if (it == shard.endpoints.end ()) {
+         shard.sync.unlock ();
          errno = ECONNREFUSED;
          endpoint_t empty = {NULL, options_t()};
          return empty;
      }
-     endpoint_t endpoint = it->second;
+     endpoint_entry_t *entry = it->second;
+     entry->refs.add (1);
 
      //  Increment the command sequence number of the peer so that it won't
      //  get deallocated until "bind" command is issued by the caller.
      //  The subsequent 'bind' has to be called with inc_seqnum parameter
      //  set to false, so that the seqnum isn't incremented twice.
-     endpoint.socket->inc_seqnum ();
+     entry->endpoint.socket->inc_seqnum ();
 
-     endpoints_sync.unlock ();
+     shard.sync.unlock ();
+
+     //  The entry doesn't change once registered, and the reference keeps
+     //  it alive even if the endpoint is unregistered meanwhile.
+     const endpoint_t endpoint = entry->endpoint;
+     release_endpoint (entry);
      return endpoint;
 }
 
@@ -513,32 +774,38 @@ void zmq::ctx_t::pend_connection (const std::string &addr_,
     const pending_connection_t pending_connection =
         {endpoint_, pipes_ [0], pipes_ [1]};
 
-    endpoints_sync.lock ();
+    endpoint_shard_t &shard = get_shard (addr_);
+    shard.sync.lock ();
 
-    endpoints_t::iterator it = endpoints.find (addr_);
-    if (it == endpoints.end ()) {
+    endpoints_t::iterator it = shard.endpoints.find (addr_);
+    if (it == shard.endpoints.end ()) {
         // Still no bind.
         endpoint_.socket->inc_seqnum ();
-        pending_connections.insert (pending_connections_t::value_type (addr_, pending_connection));
+        shard.pending_connections.insert (pending_connections_t::value_type (addr_, pending_connection));
     }
     else
         // Bind has happened in the mean time, connect directly
-        connect_inproc_sockets (it->second.socket, it->second.options, pending_connection, connect_side);
+        connect_inproc_sockets (it->second->endpoint.socket,
+            it->second->endpoint.options, pending_connection, connect_side);
 
-    endpoints_sync.unlock ();
+    shard.sync.unlock ();
 }
 
 void zmq::ctx_t::connect_pending (const char *addr_, zmq::socket_base_t *bind_socket_)
 {
-    endpoints_sync.lock ();
+    const std::string addr (addr_);
+    endpoint_shard_t &shard = get_shard (addr);
+    shard.sync.lock ();
 
-    std::pair<pending_connections_t::iterator, pending_connections_t::iterator> pending = pending_connections.equal_range(addr_);
+    std::pair<pending_connections_t::iterator, pending_connections_t::iterator> pending = shard.pending_connections.equal_range(addr);
 
+    const endpoints_t::iterator it = shard.endpoints.find (addr);
+    zmq_assert (it != shard.endpoints.end ());
     for (pending_connections_t::iterator p = pending.first; p != pending.second; ++p)
-        connect_inproc_sockets(bind_socket_, endpoints[addr_].options, p->second, bind_side);
+        connect_inproc_sockets(bind_socket_, it->second->endpoint.options, p->second, bind_side);
 
-    pending_connections.erase(pending.first, pending.second);
-    endpoints_sync.unlock ();
+    shard.pending_connections.erase(pending.first, pending.second);
+    shard.sync.unlock ();
 }
 
 void zmq::ctx_t::connect_inproc_sockets (zmq::socket_base_t *bind_socket_,
@@ -568,6 +835,18 @@ void zmq::ctx_t::connect_inproc_sockets (zmq::socket_base_t *bind_socket_,
 
         pending_connection_.connect_pipe->set_hwms(pending_connection_.endpoint.options.rcvhwm, pending_connection_.endpoint.options.sndhwm);
         pending_connection_.bind_pipe->set_hwms(bind_options.rcvhwm, bind_options.sndhwm);
+
+        //  Byte HWMs set on either end add up.
+        const int64_t connect_snd_bytes =
+            pending_connection_.endpoint.options.sndhwm_bytes +
+            bind_options.rcvhwm_bytes;
+        const int64_t connect_rcv_bytes =
+            pending_connection_.endpoint.options.rcvhwm_bytes +
+            bind_options.sndhwm_bytes;
+        pending_connection_.connect_pipe->set_byte_hwms (connect_rcv_bytes,
+            connect_snd_bytes);
+        pending_connection_.bind_pipe->set_byte_hwms (connect_snd_bytes,
+            connect_rcv_bytes);
     }
     else {
         pending_connection_.connect_pipe->set_hwms(-1, -1);
@@ -620,6 +899,23 @@ int zmq::ctx_t::get_vmci_socket_family ()
 
 #endif
 
+#ifdef HAVE_LIBSODIUM
+
+zmq::curve_tickets_t *zmq::ctx_t::get_curve_tickets ()
+{
+    opt_sync.lock ();
+    if (!curve_tickets) {
+        curve_tickets = new (std::nothrow) curve_tickets_t ();
+        alloc_assert (curve_tickets);
+    }
+    curve_tickets_t *tickets = curve_tickets;
+    opt_sync.unlock ();
+
+    return tickets;
+}
+
+#endif
+
 //  The last used socket ID, or 0 if no socket was used so far. Note that this
 //  is a global variable. Thus, even sockets created in different contexts have
 //  unique IDs.
@@ -31,6 +31,7 @@
 #define __ZMQ_CTX_HPP_INCLUDED__
 
 #include <map>
+#include <set>
 #include <vector>
 #include <string>
 #include <stdarg.h>
@@ -52,6 +53,7 @@ namespace zmq
     class socket_base_t;
     class reaper_t;
     class pipe_t;
+    class curve_tickets_t;
 
     //  Information associated with inproc endpoint. Note that endpoint options
     //  are registered as well so that the peer can access them without a need
@@ -94,12 +96,18 @@ namespace zmq
         int set (int option_, int optval_);
         int get (int option_);
 
+        //  Set and get context properties that aren't integers.
+        int set_ext (int option_, const void *optval_, size_t optvallen_);
+        int get_ext (int option_, void *optval_, size_t *optvallen_);
+
         //  Create and destroy a socket.
         zmq::socket_base_t *create_socket (int type_);
         void destroy_socket (zmq::socket_base_t *socket_);
 
-        //  Start a new thread with proper scheduling parameters.
-        void start_thread (thread_t &thread_, thread_fn *tfn_, void *arg_) const;
+        //  Start a new thread with proper scheduling parameters, on the
+        //  given CPUs or any if cpus_ is empty.
+        void start_thread (thread_t &thread_, thread_fn *tfn_, void *arg_,
+            const std::set <int> &cpus_) const;
 
         //  Send command to the destination thread.
         void send_command (uint32_t tid_, const command_t &command_);
@@ -109,13 +117,37 @@ namespace zmq
         //  Returns NULL if no I/O thread is available.
         zmq::io_thread_t *choose_io_thread (uint64_t affinity_);
 
+        //  Appends all the I/O threads affinity_ makes eligible to
+        //  io_threads_.
+        void get_io_threads (uint64_t affinity_,
+            std::vector <zmq::io_thread_t*> &io_threads_);
+
+        //  Returns the I/O thread other than busy_ whose engines handled
+        //  the fewest events in the last rebalancing interval, storing the
+        //  number of events in rate_. Returns NULL if there's no such thread.
+        zmq::io_thread_t *choose_idle_io_thread (io_thread_t *busy_,
+            uint32_t *rate_);
+
+        //  Serialises the migration of sessions between I/O threads.
+        mutex_t &get_migration_sync ();
+
+        //  Returns the maximum number of events the I/O threads handle in
+        //  one go, see ZMQ_IO_EVENTS.
+        int get_io_events () const;
+
+        //  Accounting of message data queued in pipes against the
+        //  ZMQ_MEMORY_BUDGET, in kilobytes. The budget is 0 if there's none.
+        uint32_t get_memory_budget () const;
+        bool over_memory_budget () const;
+        void charge_memory (uint32_t kbytes_);
+        void release_memory (uint32_t kbytes_);
+
         //  Returns reaper thread object.
         zmq::object_t *get_reaper ();
 
         //  Management of inproc endpoints.
         int register_endpoint (const char *addr_, const endpoint_t &endpoint_);
         int unregister_endpoint (const std::string &addr_, socket_base_t *socket_);
-        void unregister_endpoints (zmq::socket_base_t *socket_);
         endpoint_t find_endpoint (const char *addr_);
         void pend_connection (const std::string &addr_,
                 const endpoint_t &endpoint_, pipe_t **pipes_);
@@ -126,6 +158,12 @@ namespace zmq
         int get_vmci_socket_family ();
 #endif
 
+#ifdef HAVE_LIBSODIUM
+        //  Returns the CURVE session tickets shared by the sockets of the
+        //  context, created on first use.
+        curve_tickets_t *get_curve_tickets ();
+#endif
+
         enum {
             term_tid = 0,
             reaper_tid = 1
@@ -182,16 +220,37 @@ namespace zmq
         //  Mailbox for zmq_term thread.
         mailbox_t term_mailbox;
 
+        //  Registered inproc endpoint. It is shared by the registry and
+        //  the sockets looking it up, so that its options are copied
+        //  without holding the registry's lock.
+        struct endpoint_entry_t
+        {
+            endpoint_t endpoint;
+            atomic_counter_t refs;
+        };
+
+        //  Drops a reference to the entry, deleting it with the last one.
+        static void release_endpoint (endpoint_entry_t *entry_);
+
         //  List of inproc endpoints within this context.
-        typedef std::map <std::string, endpoint_t> endpoints_t;
-        endpoints_t endpoints;
+        typedef std::map <std::string, endpoint_entry_t*> endpoints_t;
 
         // List of inproc connection endpoints pending a bind
         typedef std::multimap <std::string, pending_connection_t> pending_connections_t;
-        pending_connections_t pending_connections;
 
-        //  Synchronisation of access to the list of inproc endpoints.
-        mutex_t endpoints_sync;
+        //  The inproc endpoints and the connections pending on them are
+        //  split in shards by the hash of their address, each with a lock
+        //  of its own.
+        struct endpoint_shard_t
+        {
+            endpoints_t endpoints;
+            pending_connections_t pending_connections;
+            mutex_t sync;
+        };
+        endpoint_shard_t endpoint_shards [inproc_shards];
+
+        //  Returns the shard holding the address.
+        endpoint_shard_t &get_shard (const std::string &addr_);
 
         //  Maximum socket ID.
         static atomic_counter_t max_socket_id;
@@ -212,6 +271,40 @@ namespace zmq
         int thread_priority;
         int thread_sched_policy;
 
+        //  Has this context enabled the message pool?
+        bool msg_pool;
+
+        //  Interval in milliseconds at which I/O threads move busy sessions
+        //  to idle threads. 0 if they don't.
+        int io_rebalance_ivl;
+
+        //  The rebalancing interval the I/O threads were launched with.
+        int rebalance_ivl;
+
+        //  Synchronisation of session migrations.
+        mutex_t migration_sync;
+
+        //  Limit in kilobytes on message data queued in all the pipes of
+        //  the context. 0 if there's no limit.
+        int memory_budget;
+
+        //  The budget the pipes are held to, fixed when the context starts,
+        //  and the amount of it currently in use.
+        uint32_t memory_budget_kb;
+        atomic_counter_t queued_kb;
+
+        //  Maximum number of events an I/O thread handles in one go, and
+        //  the value the I/O threads were launched with.
+        int io_events;
+        int io_thread_events;
+
+        //  ZMQ_IO_THREAD_AFFINITY as set, and the CPUs each I/O thread is
+        //  to run on, from the first I/O thread on. The I/O threads past
+        //  the end and those with no CPUs run on any.
+        std::string io_thread_affinity;
+        typedef std::vector <std::set <int> > cpu_sets_t;
+        cpu_sets_t io_thread_cpus;
+
         //  Synchronisation of access to context options.
         mutex_t opt_sync;
 
@@ -230,6 +323,10 @@ namespace zmq
         int vmci_family;
         mutex_t vmci_sync;
 #endif
+
+#ifdef HAVE_LIBSODIUM
+        curve_tickets_t *curve_tickets;
+#endif
     };
 
 }
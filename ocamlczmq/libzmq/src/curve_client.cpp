@@ -39,16 +39,21 @@
 #include "session_base.hpp"
 #include "err.hpp"
 #include "curve_client.hpp"
+#include "curve_tickets.hpp"
+#include "ctx.hpp"
 #include "wire.hpp"
 
-zmq::curve_client_t::curve_client_t (const options_t &options_) :
+zmq::curve_client_t::curve_client_t (session_base_t *session_,
+                                     const options_t &options_) :
     mechanism_t (options_),
+    session (session_),
     state (send_hello),
     cn_nonce(1),
     cn_peer_nonce(1),
+    resume_tried (false),
+    ticket_received (false),
     sync()
 {
-    int rc;
     memcpy (public_key, options_.curve_public_key, crypto_box_PUBLICKEYBYTES);
     memcpy (secret_key, options_.curve_secret_key, crypto_box_SECRETKEYBYTES);
     memcpy (server_key, options_.curve_server_key, crypto_box_PUBLICKEYBYTES);
@@ -58,13 +63,9 @@ zmq::curve_client_t::curve_client_t (const options_t &options_) :
     unsigned char tmpbytes[4];
     randombytes(tmpbytes, 4);
 #else
-    rc = sodium_init ();
+    int rc = sodium_init ();
     zmq_assert (rc != -1);
 #endif
-
-    //  Generate short-term key pair
-    rc = crypto_box_keypair (cn_public, cn_secret);
-    zmq_assert (rc == 0);
 }
 
 zmq::curve_client_t::~curve_client_t ()
@@ -77,6 +78,18 @@ int zmq::curve_client_t::next_handshake_command (msg_t *msg_)
 
     switch (state) {
         case send_hello:
+            //  Resume the session if we hold a ticket for the server.
+            if (!resume_tried && options.curve_resume > 0) {
+                resume_tried = true;
+                uint8_t id [curve_ticket_id_size];
+                if (session->get_ctx ()->get_curve_tickets ()->take (
+                        public_key, server_key, id, ticket_secret)) {
+                    rc = produce_resume (msg_, id);
+                    if (rc == 0)
+                        state = expect_resumed;
+                    break;
+                }
+            }
             rc = produce_hello (msg_);
             if (rc == 0)
                 state = expect_welcome;
@@ -106,6 +119,14 @@ int zmq::curve_client_t::process_handshake_command (msg_t *msg_)
     if (msg_size >= 6 && !memcmp (msg_data, "\5READY", 6))
         rc = process_ready (msg_data, msg_size);
     else
+    if (msg_size >= 8 && !memcmp (msg_data, "\7RESUMED", 8))
+        rc = process_resumed (msg_data, msg_size);
+    else
+    if (msg_size == 9 && !memcmp (msg_data, "\x08NOTICKET", 9)
+    &&  state == expect_resumed)
+        //  The server can't resume the session; do the full handshake.
+        state = send_hello;
+    else
     if (msg_size >= 6 && !memcmp (msg_data, "\5ERROR", 6))
         rc = process_error (msg_data, msg_size);
     else {
@@ -252,6 +273,101 @@ zmq::mechanism_t::status_t zmq::curve_client_t::status () const
         return mechanism_t::handshaking;
 }
 
+int zmq::curve_client_t::produce_resume (msg_t *msg_, const uint8_t *id_)
+{
+    uint8_t resume_nonce_full [crypto_box_NONCEBYTES];
+    uint8_t resume_plaintext [crypto_box_ZEROBYTES + max_metadata_size];
+    uint8_t resume_box [crypto_box_BOXZEROBYTES + 16 + max_metadata_size];
+
+    //  The key of the RESUME box is derived from the ticket secret and
+    //  our random contribution to the session key.
+    randombytes (resume_nonce, sizeof resume_nonce);
+    uint8_t key_data [32 + 16];
+    memcpy (key_data, ticket_secret, 32);
+    memcpy (key_data + 32, resume_nonce, 16);
+    uint8_t resume_key [crypto_box_BEFORENMBYTES];
+    curve_derive (resume_key, "CurveZMQRESUMEC-", key_data, sizeof key_data);
+
+    //  Create Box [metadata](ticket)
+    memset (resume_plaintext, 0, crypto_box_ZEROBYTES);
+    const size_t mlen = crypto_box_ZEROBYTES
+        + add_metadata (resume_plaintext + crypto_box_ZEROBYTES);
+    zmq_assert (mlen <= sizeof resume_plaintext);
+
+    memcpy (resume_nonce_full, "CurveZMQRESUME--", 16);
+    put_uint64 (resume_nonce_full + 16, cn_nonce);
+
+    int rc = crypto_box_afternm (resume_box, resume_plaintext,
+                                 mlen, resume_nonce_full, resume_key);
+    zmq_assert (rc == 0);
+
+    rc = msg_->init_size (47 + mlen - crypto_box_BOXZEROBYTES);
+    errno_assert (rc == 0);
+
+    uint8_t *resume = static_cast <uint8_t *> (msg_->data ());
+
+    memcpy (resume, "\x06RESUME", 7);
+    //  Ticket id
+    memcpy (resume + 7, id_, 16);
+    //  Client contribution to the session key
+    memcpy (resume + 23, resume_nonce, 16);
+    //  Short nonce, prefixed by "CurveZMQRESUME--"
+    memcpy (resume + 39, resume_nonce_full + 16, 8);
+    //  Box [metadata](ticket)
+    memcpy (resume + 47, resume_box + crypto_box_BOXZEROBYTES,
+            mlen - crypto_box_BOXZEROBYTES);
+
+    cn_nonce++;
+
+    return 0;
+}
+
+int zmq::curve_client_t::process_resumed (
+        const uint8_t *msg_data, size_t msg_size)
+{
+    if (state != expect_resumed
+    ||  msg_size < 48 || msg_size > 32 + 16 + max_metadata_size) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    //  The session key is derived from the ticket secret and the random
+    //  contributions of both sides.
+    uint8_t key_data [32 + 16 + 16];
+    memcpy (key_data, ticket_secret, 32);
+    memcpy (key_data + 32, resume_nonce, 16);
+    memcpy (key_data + 48, msg_data + 8, 16);
+    curve_derive (cn_precom, "CurveZMQRESUMES-", key_data, sizeof key_data);
+
+    const size_t clen = (msg_size - 32) + crypto_box_BOXZEROBYTES;
+
+    uint8_t resumed_nonce [crypto_box_NONCEBYTES];
+    uint8_t resumed_plaintext [crypto_box_ZEROBYTES + max_metadata_size];
+    uint8_t resumed_box [crypto_box_BOXZEROBYTES + 16 + max_metadata_size];
+
+    memset (resumed_box, 0, crypto_box_BOXZEROBYTES);
+    memcpy (resumed_box + crypto_box_BOXZEROBYTES,
+            msg_data + 32, clen - crypto_box_BOXZEROBYTES);
+
+    memcpy (resumed_nonce, "CurveZMQRESUMED-", 16);
+    memcpy (resumed_nonce + 16, msg_data + 24, 8);
+    cn_peer_nonce = get_uint64 (msg_data + 24);
+
+    int rc = crypto_box_open_afternm (resumed_plaintext, resumed_box,
+                                      clen, resumed_nonce, cn_precom);
+    if (rc != 0) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    rc = process_metadata (resumed_plaintext + crypto_box_ZEROBYTES,
+                           clen - crypto_box_ZEROBYTES);
+    if (rc == 0)
+        state = connected;
+
+    return rc;
+}
+
 int zmq::curve_client_t::produce_hello (msg_t *msg_)
 {
     uint8_t hello_nonce [crypto_box_NONCEBYTES];
@@ -262,12 +378,20 @@ int zmq::curve_client_t::produce_hello (msg_t *msg_)
     memcpy (hello_nonce, "CurveZMQHELLO---", 16);
     put_uint64 (hello_nonce + 16, cn_nonce);
 
+    //  Generate short-term key pair
+    int rc = crypto_box_keypair (cn_public, cn_secret);
+    zmq_assert (rc == 0);
+
+    //  Precompute the key of HELLO, used again for WELCOME
+    rc = crypto_box_beforenm (cn_precom, server_key, cn_secret);
+    zmq_assert (rc == 0);
+
     //  Create Box [64 * %x0](C'->S)
     memset (hello_plaintext, 0, sizeof hello_plaintext);
 
-    int rc = crypto_box (hello_box, hello_plaintext,
-                         sizeof hello_plaintext,
-                         hello_nonce, server_key, cn_secret);
+    rc = crypto_box_afternm (hello_box, hello_plaintext,
+                             sizeof hello_plaintext,
+                             hello_nonce, cn_precom);
     zmq_assert (rc == 0);
 
     rc = msg_->init_size (200);
@@ -310,9 +434,9 @@ int zmq::curve_client_t::process_welcome (
     memcpy (welcome_nonce, "WELCOME-", 8);
     memcpy (welcome_nonce + 8, msg_data + 8, 16);
 
-    int rc = crypto_box_open (welcome_plaintext, welcome_box,
-                              sizeof welcome_box,
-                              welcome_nonce, server_key, cn_secret);
+    int rc = crypto_box_open_afternm (welcome_plaintext, welcome_box,
+                                      sizeof welcome_box,
+                                      welcome_nonce, cn_precom);
     if (rc != 0) {
         errno = EPROTO;
         return -1;
@@ -349,10 +473,9 @@ int zmq::curve_client_t::produce_initiate (msg_t *msg_)
                          vouch_nonce, cn_server, secret_key);
     zmq_assert (rc == 0);
 
-    //  Assume here that metadata is limited to 256 bytes
     uint8_t initiate_nonce [crypto_box_NONCEBYTES];
-    uint8_t initiate_plaintext [crypto_box_ZEROBYTES + 128 + 256];
-    uint8_t initiate_box [crypto_box_BOXZEROBYTES + 144 + 256];
+    uint8_t initiate_plaintext [crypto_box_ZEROBYTES + 128 + max_metadata_size];
+    uint8_t initiate_box [crypto_box_BOXZEROBYTES + 144 + max_metadata_size];
 
     //  Create Box [C + vouch + metadata](C'->S')
     memset (initiate_plaintext, 0, crypto_box_ZEROBYTES);
@@ -364,25 +487,15 @@ int zmq::curve_client_t::produce_initiate (msg_t *msg_)
             vouch_box + crypto_box_BOXZEROBYTES, 80);
 
     //  Metadata starts after vouch
-    uint8_t *ptr = initiate_plaintext + crypto_box_ZEROBYTES + 128;
-
-    //  Add socket type property
-    const char *socket_type = socket_type_string (options.type);
-    ptr += add_property (ptr, "Socket-Type", socket_type, strlen (socket_type));
-
-    //  Add identity property
-    if (options.type == ZMQ_REQ
-    ||  options.type == ZMQ_DEALER
-    ||  options.type == ZMQ_ROUTER)
-        ptr += add_property (ptr, "Identity", options.identity, options.identity_size);
-
-    const size_t mlen = ptr - initiate_plaintext;
+    const size_t mlen = crypto_box_ZEROBYTES + 128
+        + add_metadata (initiate_plaintext + crypto_box_ZEROBYTES + 128);
+    zmq_assert (mlen <= sizeof initiate_plaintext);
 
     memcpy (initiate_nonce, "CurveZMQINITIATE", 16);
     put_uint64 (initiate_nonce + 16, cn_nonce);
 
-    rc = crypto_box (initiate_box, initiate_plaintext,
-                     mlen, initiate_nonce, cn_server, cn_secret);
+    rc = crypto_box_afternm (initiate_box, initiate_plaintext,
+                             mlen, initiate_nonce, cn_precom);
     zmq_assert (rc == 0);
 
     rc = msg_->init_size (113 + mlen - crypto_box_BOXZEROBYTES);
@@ -406,7 +519,7 @@ int zmq::curve_client_t::produce_initiate (msg_t *msg_)
 int zmq::curve_client_t::process_ready (
         const uint8_t *msg_data, size_t msg_size)
 {
-    if (msg_size < 30) {
+    if (msg_size < 30 || msg_size > 14 + 16 + max_metadata_size) {
         errno = EPROTO;
         return -1;
     }
@@ -414,8 +527,8 @@ int zmq::curve_client_t::process_ready (
     const size_t clen = (msg_size - 14) + crypto_box_BOXZEROBYTES;
 
     uint8_t ready_nonce [crypto_box_NONCEBYTES];
-    uint8_t ready_plaintext [crypto_box_ZEROBYTES + 256];
-    uint8_t ready_box [crypto_box_BOXZEROBYTES + 16 + 256];
+    uint8_t ready_plaintext [crypto_box_ZEROBYTES + max_metadata_size];
+    uint8_t ready_box [crypto_box_BOXZEROBYTES + 16 + max_metadata_size];
 
     memset (ready_box, 0, crypto_box_BOXZEROBYTES);
     memcpy (ready_box + crypto_box_BOXZEROBYTES,
@@ -433,8 +546,8 @@ int zmq::curve_client_t::process_ready (
         return -1;
     }
 
-    rc = parse_metadata (ready_plaintext + crypto_box_ZEROBYTES,
-                         clen - crypto_box_ZEROBYTES);
+    rc = process_metadata (ready_plaintext + crypto_box_ZEROBYTES,
+                           clen - crypto_box_ZEROBYTES);
     if (rc == 0)
         state = connected;
 
@@ -444,7 +557,8 @@ int zmq::curve_client_t::process_ready (
 int zmq::curve_client_t::process_error (
         const uint8_t *msg_data, size_t msg_size)
 {
-    if (state != expect_welcome && state != expect_ready) {
+    if (state != expect_welcome && state != expect_ready
+    &&  state != expect_resumed) {
         errno = EPROTO;
         return -1;
     }
@@ -461,4 +575,58 @@ int zmq::curve_client_t::process_error (
     return 0;
 }
 
+size_t zmq::curve_client_t::add_metadata (uint8_t *ptr_)
+{
+    uint8_t *ptr = ptr_;
+
+    //  Add socket type property
+    const char *socket_type = socket_type_string (options.type);
+    ptr += add_property (ptr, "Socket-Type", socket_type, strlen (socket_type));
+
+    //  Add priority flag support property
+    if (options.rcvpriority)
+        ptr += add_property (ptr, "Priority-Lanes", "1", 1);
+
+    //  Add compression support property
+    if (options.compress_threshold)
+        ptr += add_property (ptr, "Compression", "LZ", 2);
+
+    //  Add session resumption property
+    if (options.curve_resume > 0)
+        ptr += add_property (ptr, "Resume", "1", 1);
+
+    //  Add identity property
+    if (options.type == ZMQ_REQ
+    ||  options.type == ZMQ_DEALER
+    ||  options.type == ZMQ_ROUTER)
+        ptr += add_property (ptr, "Identity", options.identity, options.identity_size);
+
+    return ptr - ptr_;
+}
+
+int zmq::curve_client_t::process_metadata (const uint8_t *ptr_,
+    size_t length_)
+{
+    ticket_received = false;
+    const int rc = parse_metadata (ptr_, length_);
+    if (rc == 0 && ticket_received) {
+        session->get_ctx ()->get_curve_tickets ()->keep (
+            ticket_id, cn_precom, public_key, server_key,
+            options.curve_resume);
+        zmtp_properties.erase ("Resume-Ticket");
+    }
+    return rc;
+}
+
+int zmq::curve_client_t::property (const std::string &name_,
+    const void *value_, size_t length_)
+{
+    if (name_ == "Resume-Ticket" && length_ == sizeof ticket_id
+    &&  options.curve_resume > 0) {
+        memcpy (ticket_id, value_, sizeof ticket_id);
+        ticket_received = true;
+    }
+    return 0;
+}
+
 #endif
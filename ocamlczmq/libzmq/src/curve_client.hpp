@@ -62,7 +62,7 @@ namespace zmq
     {
     public:
 
-        curve_client_t (const options_t &options_);
+        curve_client_t (session_base_t *session_, const options_t &options_);
         virtual ~curve_client_t ();
 
         // mechanism implementation
@@ -72,10 +72,16 @@ namespace zmq
         virtual int decode (msg_t *msg_);
         virtual status_t status () const;
 
+    protected:
+
+        virtual int property (const std::string &name_,
+            const void *value_, size_t length_);
+
     private:
 
         enum state_t {
             send_hello,
+            expect_resumed,
             expect_welcome,
             send_initiate,
             expect_ready,
@@ -83,6 +89,8 @@ namespace zmq
             connected
         };
 
+        session_base_t * const session;
+
         //  Current FSM state
         state_t state;
 
@@ -114,11 +122,32 @@ namespace zmq
         uint64_t cn_nonce;
         uint64_t cn_peer_nonce;
 
+        //  True once the session was tried to be resumed.
+        bool resume_tried;
+
+        //  Secret of the ticket the session is resumed with and our random
+        //  contribution to the session key.
+        uint8_t ticket_secret [32];
+        uint8_t resume_nonce [16];
+
+        //  Id of the ticket the server sent for the next session, if any.
+        bool ticket_received;
+        uint8_t ticket_id [16];
+
+        int produce_resume (msg_t *msg_, const uint8_t *id_);
+        int process_resumed (const uint8_t *cmd_data, size_t data_size);
         int produce_hello (msg_t *msg_);
         int process_welcome (const uint8_t *cmd_data, size_t data_size);
         int produce_initiate (msg_t *msg_);
         int process_ready (const uint8_t *cmd_data, size_t data_size);
         int process_error (const uint8_t *cmd_data, size_t data_size);
+
+        //  Adds our metadata at ptr_ and returns its size.
+        size_t add_metadata (uint8_t *ptr_);
+
+        //  Parses the metadata of READY or RESUMED and keeps the ticket the
+        //  server sent, if any.
+        int process_metadata (const uint8_t *ptr_, size_t length_);
         mutex_t sync;
     };
 
@@ -39,6 +39,8 @@
 #include "session_base.hpp"
 #include "err.hpp"
 #include "curve_server.hpp"
+#include "curve_tickets.hpp"
+#include "ctx.hpp"
 #include "wire.hpp"
 
 zmq::curve_server_t::curve_server_t (session_base_t *session_,
@@ -50,9 +52,10 @@ zmq::curve_server_t::curve_server_t (session_base_t *session_,
     state (expect_hello),
     cn_nonce (1),
     cn_peer_nonce(1),
+    resumed (false),
+    resume_requested (false),
     sync()
 {
-    int rc;
     //  Fetch our secret key from socket options
     memcpy (secret_key, options_.curve_secret_key, crypto_box_SECRETKEYBYTES);
     scoped_lock_t lock (sync);
@@ -61,13 +64,13 @@ zmq::curve_server_t::curve_server_t (session_base_t *session_,
     unsigned char tmpbytes[4];
     randombytes(tmpbytes, 4);
 #else
-    rc = sodium_init ();
+    int rc = sodium_init ();
     zmq_assert (rc != -1);
 #endif
 
-    //  Generate short-term key pair
-    rc = crypto_box_keypair (cn_public, cn_secret);
-    zmq_assert (rc == 0);
+    if (options.curve_resume > 0)
+        curve_derive (ticket_tag, "CurveZMQSERVER--",
+                      secret_key, crypto_box_SECRETKEYBYTES);
 }
 
 zmq::curve_server_t::~curve_server_t ()
@@ -79,6 +82,11 @@ int zmq::curve_server_t::next_handshake_command (msg_t *msg_)
     int rc = 0;
 
     switch (state) {
+        case send_noticket:
+            rc = produce_noticket (msg_);
+            if (rc == 0)
+                state = expect_hello;
+            break;
         case send_welcome:
             rc = produce_welcome (msg_);
             if (rc == 0)
@@ -108,7 +116,11 @@ int zmq::curve_server_t::process_handshake_command (msg_t *msg_)
 
     switch (state) {
         case expect_hello:
-            rc = process_hello (msg_);
+            if (msg_->size () >= 7
+            &&  !memcmp (msg_->data (), "\x06RESUME", 7))
+                rc = process_resume (msg_);
+            else
+                rc = process_hello (msg_);
             break;
         case expect_initiate:
             rc = process_initiate (msg_);
@@ -277,6 +289,86 @@ zmq::mechanism_t::status_t zmq::curve_server_t::status () const
         return mechanism_t::handshaking;
 }
 
+int zmq::curve_server_t::process_resume (msg_t *msg_)
+{
+    if (msg_->size () < 63
+    ||  msg_->size () > 47 + 16 + max_metadata_size) {
+        //  Temporary support for security debugging
+        puts ("CURVE I: client RESUME is not correct size");
+        errno = EPROTO;
+        return -1;
+    }
+
+    const uint8_t * const resume = static_cast <uint8_t *> (msg_->data ());
+
+    //  Without a valid ticket the client falls back to the full handshake.
+    //  The ticket id is sent in the clear, so it is only used up once the
+    //  box shows the client holds its secret.
+    uint8_t ticket_secret [curve_ticket_secret_size];
+    if (options.curve_resume == 0
+    ||  !session->get_ctx ()->get_curve_tickets ()->find (
+            resume + 7, ticket_tag, ticket_secret, client_key)) {
+        state = send_noticket;
+        return 0;
+    }
+
+    uint8_t key_data [32 + 16 + 16];
+    memcpy (key_data, ticket_secret, 32);
+    memcpy (key_data + 32, resume + 23, 16);
+    uint8_t resume_key [crypto_box_BEFORENMBYTES];
+    curve_derive (resume_key, "CurveZMQRESUMEC-", key_data, 32 + 16);
+
+    const size_t clen = (msg_->size () - 47) + crypto_box_BOXZEROBYTES;
+
+    uint8_t resume_nonce_full [crypto_box_NONCEBYTES];
+    uint8_t resume_plaintext [crypto_box_ZEROBYTES + max_metadata_size];
+    uint8_t resume_box [crypto_box_BOXZEROBYTES + 16 + max_metadata_size];
+
+    //  Open Box [metadata](ticket)
+    memset (resume_box, 0, crypto_box_BOXZEROBYTES);
+    memcpy (resume_box + crypto_box_BOXZEROBYTES,
+            resume + 47, clen - crypto_box_BOXZEROBYTES);
+
+    memcpy (resume_nonce_full, "CurveZMQRESUME--", 16);
+    memcpy (resume_nonce_full + 16, resume + 39, 8);
+
+    int rc = crypto_box_open_afternm (resume_plaintext, resume_box,
+                                      clen, resume_nonce_full, resume_key);
+    if (rc != 0) {
+        //  Temporary support for security debugging
+        puts ("CURVE I: cannot open client RESUME");
+        state = send_noticket;
+        return 0;
+    }
+    if (!session->get_ctx ()->get_curve_tickets ()->redeem (resume + 7)) {
+        state = send_noticket;
+        return 0;
+    }
+    cn_peer_nonce = get_uint64 (resume + 39);
+
+    //  The session key is derived from the ticket secret and the random
+    //  contributions of both sides.
+    randombytes (resume_nonce, sizeof resume_nonce);
+    memcpy (key_data + 48, resume_nonce, 16);
+    curve_derive (cn_precom, "CurveZMQRESUMES-", key_data, sizeof key_data);
+    resumed = true;
+
+    rc = authenticate ();
+    if (rc == -1)
+        return -1;
+
+    return parse_metadata (resume_plaintext + crypto_box_ZEROBYTES,
+                           clen - crypto_box_ZEROBYTES);
+}
+
+int zmq::curve_server_t::produce_noticket (msg_t *msg_) const
+{
+    const int rc = msg_->init_size (9);
+    errno_assert (rc == 0);
+    memcpy (msg_->data (), "\x08NOTICKET", 9);
+    return 0;
+}
+
 int zmq::curve_server_t::process_hello (msg_t *msg_)
 {
     if (msg_->size () != 200) {
@@ -318,10 +410,14 @@ int zmq::curve_server_t::process_hello (msg_t *msg_)
     memset (hello_box, 0, crypto_box_BOXZEROBYTES);
     memcpy (hello_box + crypto_box_BOXZEROBYTES, hello + 120, 80);
 
+    //  Precompute the key of HELLO, used again for WELCOME
+    int rc = crypto_box_beforenm (cn_precom, cn_client, secret_key);
+    zmq_assert (rc == 0);
+
     //  Open Box [64 * %x0](C'->S)
-    int rc = crypto_box_open (hello_plaintext, hello_box,
-                              sizeof hello_box,
-                              hello_nonce, cn_client, secret_key);
+    rc = crypto_box_open_afternm (hello_plaintext, hello_box,
+                                  sizeof hello_box,
+                                  hello_nonce, cn_precom);
     if (rc != 0) {
         //  Temporary support for security debugging
         puts ("CURVE I: cannot open client HELLO -- wrong server key?");
@@ -335,6 +431,10 @@ int zmq::curve_server_t::process_hello (msg_t *msg_)
 
 int zmq::curve_server_t::produce_welcome (msg_t *msg_)
 {
+    //  Generate short-term key pair
+    int rc = crypto_box_keypair (cn_public, cn_secret);
+    zmq_assert (rc == 0);
+
     uint8_t cookie_nonce [crypto_secretbox_NONCEBYTES];
     uint8_t cookie_plaintext [crypto_secretbox_ZEROBYTES + 64];
     uint8_t cookie_ciphertext [crypto_secretbox_BOXZEROBYTES + 80];
@@ -355,7 +455,7 @@ int zmq::curve_server_t::produce_welcome (msg_t *msg_)
     randombytes (cookie_key, crypto_secretbox_KEYBYTES);
 
     //  Encrypt using symmetric cookie key
-    int rc = crypto_secretbox (cookie_ciphertext, cookie_plaintext,
+    rc = crypto_secretbox (cookie_ciphertext, cookie_plaintext,
                                sizeof cookie_plaintext,
                                cookie_nonce, cookie_key);
     zmq_assert (rc == 0);
@@ -377,9 +477,9 @@ int zmq::curve_server_t::produce_welcome (msg_t *msg_)
     memcpy (welcome_plaintext + crypto_box_ZEROBYTES + 48,
             cookie_ciphertext + crypto_secretbox_BOXZEROBYTES, 80);
 
-    rc = crypto_box (welcome_ciphertext, welcome_plaintext,
-                     sizeof welcome_plaintext,
-                     welcome_nonce, cn_client, secret_key);
+    rc = crypto_box_afternm (welcome_ciphertext, welcome_plaintext,
+                             sizeof welcome_plaintext,
+                             welcome_nonce, cn_precom);
     zmq_assert (rc == 0);
 
     rc = msg_->init_size (168);
@@ -395,7 +495,8 @@ int zmq::curve_server_t::produce_welcome (msg_t *msg_)
 
 int zmq::curve_server_t::process_initiate (msg_t *msg_)
 {
-    if (msg_->size () < 257) {
+    if (msg_->size () < 257
+    ||  msg_->size () > 113 + 144 + max_metadata_size) {
         //  Temporary support for security debugging
         puts ("CURVE I: client INITIATE is not correct size");
         errno = EPROTO;
@@ -443,8 +544,8 @@ int zmq::curve_server_t::process_initiate (msg_t *msg_)
     const size_t clen = (msg_->size () - 113) + crypto_box_BOXZEROBYTES;
 
     uint8_t initiate_nonce [crypto_box_NONCEBYTES];
-    uint8_t initiate_plaintext [crypto_box_ZEROBYTES + 128 + 256];
-    uint8_t initiate_box [crypto_box_BOXZEROBYTES + 144 + 256];
+    uint8_t initiate_plaintext [crypto_box_ZEROBYTES + 128 + max_metadata_size];
+    uint8_t initiate_box [crypto_box_BOXZEROBYTES + 144 + max_metadata_size];
 
     //  Open Box [C + vouch + metadata](C'->S')
     memset (initiate_box, 0, crypto_box_BOXZEROBYTES);
@@ -455,8 +556,12 @@ int zmq::curve_server_t::process_initiate (msg_t *msg_)
     memcpy (initiate_nonce + 16, initiate + 105, 8);
     cn_peer_nonce = get_uint64(initiate + 105);
 
-    rc = crypto_box_open (initiate_plaintext, initiate_box,
-                          clen, initiate_nonce, cn_client, cn_secret);
+    //  Precompute connection secret from client key
+    rc = crypto_box_beforenm (cn_precom, cn_client, cn_secret);
+    zmq_assert (rc == 0);
+
+    rc = crypto_box_open_afternm (initiate_plaintext, initiate_box,
+                                  clen, initiate_nonce, cn_precom);
     if (rc != 0) {
         //  Temporary support for security debugging
         puts ("CURVE I: cannot open client INITIATE");
@@ -464,7 +569,7 @@ int zmq::curve_server_t::process_initiate (msg_t *msg_)
         return -1;
     }
 
-    const uint8_t *client_key = initiate_plaintext + crypto_box_ZEROBYTES;
+    memcpy (client_key, initiate_plaintext + crypto_box_ZEROBYTES, 32);
 
     uint8_t vouch_nonce [crypto_box_NONCEBYTES];
     uint8_t vouch_plaintext [crypto_box_ZEROBYTES + 64];
@@ -497,27 +602,9 @@ int zmq::curve_server_t::process_initiate (msg_t *msg_)
         return -1;
     }
 
-    //  Precompute connection secret from client key
-    rc = crypto_box_beforenm (cn_precom, cn_client, cn_secret);
-    zmq_assert (rc == 0);
-
-    //  Use ZAP protocol (RFC 27) to authenticate the user.
-    rc = session->zap_connect ();
-    if (rc == 0) {
-        send_zap_request (client_key);
-        rc = receive_and_process_zap_reply ();
-        if (rc == 0)
-            state = status_code == "200"
-                ? send_ready
-                : send_error;
-        else
-        if (errno == EAGAIN)
-            state = expect_zap_reply;
-        else
-            return -1;
-    }
-    else
-        state = send_ready;
+    rc = authenticate ();
+    if (rc == -1)
+        return -1;
 
     return parse_metadata (initiate_plaintext + crypto_box_ZEROBYTES + 128,
                            clen - crypto_box_ZEROBYTES - 128);
@@ -526,8 +613,8 @@ int zmq::curve_server_t::process_initiate (msg_t *msg_)
 int zmq::curve_server_t::produce_ready (msg_t *msg_)
 {
     uint8_t ready_nonce [crypto_box_NONCEBYTES];
-    uint8_t ready_plaintext [crypto_box_ZEROBYTES + 256];
-    uint8_t ready_box [crypto_box_BOXZEROBYTES + 16 + 256];
+    uint8_t ready_plaintext [crypto_box_ZEROBYTES + max_metadata_size];
+    uint8_t ready_box [crypto_box_BOXZEROBYTES + 16 + max_metadata_size];
 
     //  Create Box [metadata](S'->C')
     memset (ready_plaintext, 0, crypto_box_ZEROBYTES);
@@ -537,31 +624,66 @@ int zmq::curve_server_t::produce_ready (msg_t *msg_)
     const char *socket_type = socket_type_string (options.type);
     ptr += add_property (ptr, "Socket-Type", socket_type, strlen (socket_type));
 
+    //  Add priority flag support property
+    if (options.rcvpriority)
+        ptr += add_property (ptr, "Priority-Lanes", "1", 1);
+
+    //  Add compression support property
+    if (options.compress_threshold)
+        ptr += add_property (ptr, "Compression", "LZ", 2);
+
     //  Add identity property
     if (options.type == ZMQ_REQ
     ||  options.type == ZMQ_DEALER
     ||  options.type == ZMQ_ROUTER)
         ptr += add_property (ptr, "Identity", options.identity, options.identity_size);
 
+    //  Add ticket for resuming the next session
+    uint8_t ticket_id [curve_ticket_id_size];
+    if (resume_requested && options.curve_resume > 0
+    &&  session->get_ctx ()->get_curve_tickets ()->issue (
+            ticket_id, cn_precom, client_key, ticket_tag,
+            options.curve_resume))
+        ptr += add_property (ptr, "Resume-Ticket", ticket_id, sizeof ticket_id);
+
     const size_t mlen = ptr - ready_plaintext;
+    zmq_assert (mlen <= sizeof ready_plaintext);
 
-    memcpy (ready_nonce, "CurveZMQREADY---", 16);
+    if (resumed)
+        memcpy (ready_nonce, "CurveZMQRESUMED-", 16);
+    else
+        memcpy (ready_nonce, "CurveZMQREADY---", 16);
     put_uint64 (ready_nonce + 16, cn_nonce);
 
     int rc = crypto_box_afternm (ready_box, ready_plaintext,
                                  mlen, ready_nonce, cn_precom);
     zmq_assert (rc == 0);
 
-    rc = msg_->init_size (14 + mlen - crypto_box_BOXZEROBYTES);
-    errno_assert (rc == 0);
-
-    uint8_t *ready = static_cast <uint8_t *> (msg_->data ());
+    uint8_t *ready;
+    if (resumed) {
+        rc = msg_->init_size (32 + mlen - crypto_box_BOXZEROBYTES);
+        errno_assert (rc == 0);
+        ready = static_cast <uint8_t *> (msg_->data ());
+
+        memcpy (ready, "\x07RESUMED", 8);
+        //  Server contribution to the session key
+        memcpy (ready + 8, resume_nonce, 16);
+        //  Short nonce, prefixed by "CurveZMQRESUMED-"
+        memcpy (ready + 24, ready_nonce + 16, 8);
+        ready += 32;
+    }
+    else {
+        rc = msg_->init_size (14 + mlen - crypto_box_BOXZEROBYTES);
+        errno_assert (rc == 0);
+        ready = static_cast <uint8_t *> (msg_->data ());
 
-    memcpy (ready, "\x05READY", 6);
-    //  Short nonce, prefixed by "CurveZMQREADY---"
-    memcpy (ready + 6, ready_nonce + 16, 8);
+        memcpy (ready, "\x05READY", 6);
+        //  Short nonce, prefixed by "CurveZMQREADY---"
+        memcpy (ready + 6, ready_nonce + 16, 8);
+        ready += 14;
+    }
     //  Box [metadata](S'->C')
-    memcpy (ready + 14, ready_box + crypto_box_BOXZEROBYTES,
+    memcpy (ready, ready_box + crypto_box_BOXZEROBYTES,
             mlen - crypto_box_BOXZEROBYTES);
 
     cn_nonce++;
@@ -581,6 +703,38 @@ int zmq::curve_server_t::produce_error (msg_t *msg_) const
     return 0;
 }
 
+int zmq::curve_server_t::authenticate ()
+{
+    //  Use ZAP protocol (RFC 27) to authenticate the user.
+    int rc = session->zap_connect ();
+    if (rc == 0) {
+        send_zap_request (client_key);
+        rc = receive_and_process_zap_reply ();
+        if (rc == 0)
+            state = status_code == "200"
+                ? send_ready
+                : send_error;
+        else
+        if (errno == EAGAIN)
+            state = expect_zap_reply;
+        else
+            return -1;
+    }
+    else
+        state = send_ready;
+
+    return 0;
+}
+
+int zmq::curve_server_t::property (const std::string &name_,
+    const void *value_, size_t length_)
+{
+    if (name_ == "Resume" && length_ == 1
+    &&  *static_cast <const char *> (value_) == '1')
+        resume_requested = true;
+    return 0;
+}
+
 void zmq::curve_server_t::send_zap_request (const uint8_t *key)
 {
     int rc;
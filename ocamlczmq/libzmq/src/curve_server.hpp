@@ -76,10 +76,16 @@ namespace zmq
         virtual int zap_msg_available ();
         virtual status_t status () const;
 
+    protected:
+
+        virtual int property (const std::string &name_,
+            const void *value_, size_t length_);
+
     private:
 
         enum state_t {
             expect_hello,
+            send_noticket,
             send_welcome,
             expect_initiate,
             expect_zap_reply,
@@ -114,18 +120,39 @@ namespace zmq
         //  Client's short-term public key (C')
         uint8_t cn_client [crypto_box_PUBLICKEYBYTES];
 
+        //  Client's public key (C)
+        uint8_t client_key [crypto_box_PUBLICKEYBYTES];
+
+        //  True if the session was resumed rather than established by
+        //  a full handshake. READY is then replaced with RESUMED.
+        bool resumed;
+
+        //  Our random contribution to the key of a resumed session.
+        uint8_t resume_nonce [16];
+
+        //  True if the client wants a ticket to resume the next session.
+        bool resume_requested;
+
+        //  Derived from our secret key, identifies the tickets we issued.
+        uint8_t ticket_tag [32];
+
         //  Key used to produce cookie
         uint8_t cookie_key [crypto_secretbox_KEYBYTES];
 
         //  Intermediary buffer used to speed up boxing and unboxing.
         uint8_t cn_precom [crypto_box_BEFORENMBYTES];
 
+        int process_resume (msg_t *msg_);
+        int produce_noticket (msg_t *msg_) const;
         int process_hello (msg_t *msg_);
         int produce_welcome (msg_t *msg_);
         int process_initiate (msg_t *msg_);
         int produce_ready (msg_t *msg_);
         int produce_error (msg_t *msg_) const;
 
+        //  Authenticates the client with ZAP and moves on to READY or ERROR.
+        int authenticate ();
+
         void send_zap_request (const uint8_t *key);
         int receive_and_process_zap_reply ();
         mutex_t sync;
@@ -0,0 +1,187 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "platform.hpp"
+
+#ifdef HAVE_LIBSODIUM
+
+#ifdef ZMQ_HAVE_WINDOWS
+#include "windows.hpp"
+#endif
+
+#ifdef HAVE_TWEETNACL
+#include "tweetnacl_base.h"
+#include "randombytes.h"
+#else
+#include "sodium.h"
+#endif
+
+#include <string.h>
+
+#include "curve_tickets.hpp"
+#include "config.hpp"
+#include "err.hpp"
+
+namespace
+{
+    //  Drops the expired tickets of the store if it's full. Returns false
+    //  if it's still full.
+    template <typename T> bool make_room (T &tickets_, uint64_t now_)
+    {
+        if (tickets_.size () < zmq::curve_tickets_max)
+            return true;
+        typename T::iterator it = tickets_.begin ();
+        while (it != tickets_.end ())
+            if (it->second.expiry <= now_)
+                tickets_.erase (it++);
+            else
+                ++it;
+        return tickets_.size () < zmq::curve_tickets_max;
+    }
+
+    void ticket_secret (uint8_t *secret_, const uint8_t *precom_,
+        const uint8_t *id_)
+    {
+        uint8_t data [32 + zmq::curve_ticket_id_size];
+        memcpy (data, precom_, 32);
+        memcpy (data + 32, id_, zmq::curve_ticket_id_size);
+        zmq::curve_derive (secret_, "CurveZMQTICKET--", data, sizeof data);
+    }
+}
+
+void zmq::curve_derive (uint8_t *key_, const char *label_,
+    const uint8_t *data_, size_t size_)
+{
+    uint8_t input [16 + 128];
+    zmq_assert (size_ <= sizeof input - 16);
+    memcpy (input, label_, 16);
+    memcpy (input + 16, data_, size_);
+
+    uint8_t hash [crypto_hash_BYTES];
+    crypto_hash (hash, input, 16 + size_);
+    memcpy (key_, hash, 32);
+}
+
+zmq::curve_tickets_t::curve_tickets_t ()
+{
+}
+
+zmq::curve_tickets_t::~curve_tickets_t ()
+{
+}
+
+bool zmq::curve_tickets_t::issue (uint8_t *id_, const uint8_t *precom_,
+    const uint8_t *client_key_, const uint8_t *server_tag_, int lifetime_)
+{
+    server_ticket_t ticket;
+    randombytes (id_, curve_ticket_id_size);
+    ticket_secret (ticket.secret, precom_, id_);
+    memcpy (ticket.client_key, client_key_, 32);
+    memcpy (ticket.server_tag, server_tag_, 32);
+
+    scoped_lock_t lock (sync);
+    const uint64_t now = clock.now_ms ();
+    if (!make_room (server_tickets, now))
+        return false;
+    ticket.expiry = now + lifetime_;
+    server_tickets [std::string ((char *) id_, curve_ticket_id_size)] =
+        ticket;
+    return true;
+}
+
+bool zmq::curve_tickets_t::find (const uint8_t *id_,
+    const uint8_t *server_tag_, uint8_t *secret_, uint8_t *client_key_)
+{
+    scoped_lock_t lock (sync);
+    const server_tickets_t::iterator it = server_tickets.find (
+        std::string ((const char *) id_, curve_ticket_id_size));
+    if (it == server_tickets.end ())
+        return false;
+    const server_ticket_t &ticket = it->second;
+
+    if (ticket.expiry <= clock.now_ms ()) {
+        server_tickets.erase (it);
+        return false;
+    }
+    if (memcmp (ticket.server_tag, server_tag_, 32))
+        return false;
+    memcpy (secret_, ticket.secret, curve_ticket_secret_size);
+    memcpy (client_key_, ticket.client_key, 32);
+    return true;
+}
+
+bool zmq::curve_tickets_t::redeem (const uint8_t *id_)
+{
+    scoped_lock_t lock (sync);
+    return server_tickets.erase (
+        std::string ((const char *) id_, curve_ticket_id_size)) == 1;
+}
+
+void zmq::curve_tickets_t::keep (const uint8_t *id_, const uint8_t *precom_,
+    const uint8_t *client_key_, const uint8_t *server_key_, int lifetime_)
+{
+    client_ticket_t ticket;
+    memcpy (ticket.id, id_, curve_ticket_id_size);
+    ticket_secret (ticket.secret, precom_, id_);
+
+    std::string key ((const char *) client_key_, 32);
+    key.append ((const char *) server_key_, 32);
+
+    scoped_lock_t lock (sync);
+    const uint64_t now = clock.now_ms ();
+    if (!make_room (client_tickets, now))
+        return;
+    ticket.expiry = now + lifetime_;
+    client_tickets.insert (client_tickets_t::value_type (key, ticket));
+}
+
+bool zmq::curve_tickets_t::take (const uint8_t *client_key_,
+    const uint8_t *server_key_, uint8_t *id_, uint8_t *secret_)
+{
+    std::string key ((const char *) client_key_, 32);
+    key.append ((const char *) server_key_, 32);
+
+    scoped_lock_t lock (sync);
+    const uint64_t now = clock.now_ms ();
+    std::pair <client_tickets_t::iterator, client_tickets_t::iterator> range =
+        client_tickets.equal_range (key);
+    while (range.first != range.second) {
+        const client_ticket_t ticket = range.first->second;
+        client_tickets.erase (range.first++);
+        if (ticket.expiry > now) {
+            memcpy (id_, ticket.id, curve_ticket_id_size);
+            memcpy (secret_, ticket.secret, curve_ticket_secret_size);
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
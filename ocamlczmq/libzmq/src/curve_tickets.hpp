@@ -0,0 +1,135 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_CURVE_TICKETS_HPP_INCLUDED__
+#define __ZMQ_CURVE_TICKETS_HPP_INCLUDED__
+
+#include <stddef.h>
+#include <map>
+#include <string>
+
+#include "stdint.hpp"
+#include "clock.hpp"
+#include "mutex.hpp"
+
+namespace zmq
+{
+
+    //  Tickets CURVE sessions are resumed with (ZMQ_CURVE_RESUME). After a
+    //  full handshake the server hands the client the id of a ticket whose
+    //  secret both derive from the session key. On reconnect the client
+    //  proves it holds the secret instead of running the public key
+    //  handshake again.
+
+    enum {
+        curve_ticket_id_size = 16,
+        curve_ticket_secret_size = 32
+    };
+
+    //  Derives a 32-byte key from the 16-byte label_ and data_.
+    void curve_derive (uint8_t *key_, const char *label_,
+        const uint8_t *data_, size_t size_);
+
+    //  The tickets of a context, shared by its sockets. Tickets are
+    //  single-use. All methods are thread safe.
+
+    class curve_tickets_t
+    {
+    public:
+
+        curve_tickets_t ();
+        ~curve_tickets_t ();
+
+        //  Issues a ticket for the session with session key precom_ whose
+        //  client has public key client_key_. server_tag_ is derived from
+        //  the secret key of the server so that only the same server
+        //  redeems the ticket. Stores the id in id_ and returns false if
+        //  there's no room.
+        bool issue (uint8_t *id_, const uint8_t *precom_,
+            const uint8_t *client_key_, const uint8_t *server_tag_,
+            int lifetime_);
+
+        //  Looks up the ticket id_ issued by server_tag_, leaving it in
+        //  place. Returns false if there is no such ticket or it expired,
+        //  else stores its secret and the client's public key.
+        bool find (const uint8_t *id_, const uint8_t *server_tag_,
+            uint8_t *secret_, uint8_t *client_key_);
+
+        //  Removes the ticket id_ once the client proved it holds the
+        //  secret. Returns false if another session redeemed it first.
+        bool redeem (const uint8_t *id_);
+
+        //  Keeps the ticket id_ received in the session with session key
+        //  precom_ between client_key_ and server_key_.
+        void keep (const uint8_t *id_, const uint8_t *precom_,
+            const uint8_t *client_key_, const uint8_t *server_key_,
+            int lifetime_);
+
+        //  Removes a ticket for a session between client_key_ and
+        //  server_key_. Returns false if there's none, else stores its id
+        //  and secret.
+        bool take (const uint8_t *client_key_, const uint8_t *server_key_,
+            uint8_t *id_, uint8_t *secret_);
+
+    private:
+
+        struct server_ticket_t
+        {
+            uint8_t secret [curve_ticket_secret_size];
+            uint8_t client_key [32];
+            uint8_t server_tag [32];
+            uint64_t expiry;
+        };
+
+        struct client_ticket_t
+        {
+            uint8_t id [curve_ticket_id_size];
+            uint8_t secret [curve_ticket_secret_size];
+            uint64_t expiry;
+        };
+
+        //  Tickets issued, by id, and tickets received, by the client and
+        //  server public keys.
+        typedef std::map <std::string, server_ticket_t> server_tickets_t;
+        server_tickets_t server_tickets;
+        typedef std::multimap <std::string, client_ticket_t>
+            client_tickets_t;
+        client_tickets_t client_tickets;
+
+        clock_t clock;
+        mutex_t sync;
+
+        curve_tickets_t (const curve_tickets_t&);
+        const curve_tickets_t &operator = (const curve_tickets_t&);
+    };
+
+}
+
+#endif
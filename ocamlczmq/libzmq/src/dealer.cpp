@@ -62,6 +62,7 @@ void zmq::dealer_t::xattach_pipe (pipe_t *pipe_, bool subscribe_to_all_)
         errno_assert (rc == 0);
     }
 
+    fq.set_priority (options.rcvpriority);
     fq.attach (pipe_);
     lb.attach (pipe_);
 }
@@ -108,6 +109,11 @@ bool zmq::dealer_t::xhas_out ()
     return lb.has_out ();
 }
 
+uint64_t zmq::dealer_t::xdrops ()
+{
+    return lb.get_drops ();
+}
+
 zmq::blob_t zmq::dealer_t::get_credential () const
 {
     return fq.get_credential ();
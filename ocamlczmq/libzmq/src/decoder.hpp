@@ -156,6 +156,11 @@ namespace zmq
             allocator->resize (new_size);
         }
 
+        virtual void set_batch_size (std::size_t size_)
+        {
+            allocator->set_max_size (size_);
+        }
+
     protected:
 
         //  Prototype of state machine action. Action should return false if
@@ -32,13 +32,22 @@
 #include <cmath>
 
 #include "msg.hpp"
+#include "msg_pool.hpp"
+
+// Number of messages a buffer of size_ bytes can hold at most.
+static std::size_t max_counters (std::size_t size_)
+{
+    return static_cast <size_t> (std::ceil (static_cast <double> (size_) / static_cast <double> (zmq::msg_t::max_vsm_size)));
+}
 
 zmq::shared_message_memory_allocator::shared_message_memory_allocator (std::size_t bufsize_) :
     buf(NULL),
     bufsize(0),
     max_size(bufsize_),
     msg_refcnt(NULL),
-    maxCounters (static_cast <size_t> (std::ceil (static_cast <double> (max_size) / static_cast <double> (msg_t::max_vsm_size))))
+    maxCounters (max_counters (max_size)),
+    capacity(0),
+    fixedCounters(false)
 {
 }
 
@@ -47,7 +56,9 @@ zmq::shared_message_memory_allocator::shared_message_memory_allocator (std::size
     bufsize(0),
     max_size(bufsize_),
     msg_refcnt(NULL),
-    maxCounters(maxMessages)
+    maxCounters(maxMessages),
+    capacity(0),
+    fixedCounters(true)
 {
 }
 
@@ -72,15 +83,23 @@ unsigned char* zmq::shared_message_memory_allocator::allocate ()
         }
     }
 
-    // if buf != NULL it is not used by any message so we can re-use it for the next run
+    // if buf != NULL it is not used by any message so we can re-use it for the next run,
+    // unless the buffer size has changed since it was allocated
+    if (buf && capacity != max_size) {
+        msg_pool_t::deallocate (buf);
+        release ();
+    }
+
     if (!buf) {
         // allocate memory for reference counters together with reception buffer
         std::size_t const allocationsize =
               max_size + sizeof (zmq::atomic_counter_t) +
               maxCounters * sizeof (zmq::atomic_counter_t);
 
-        buf = static_cast <unsigned char *> (std::malloc (allocationsize));
+        buf = static_cast <unsigned char *>
+            (msg_pool_t::allocate (allocationsize));
         alloc_assert (buf);
+        capacity = max_size;
 
         new (buf) atomic_counter_t (1);
     } else {
@@ -98,7 +117,7 @@ void zmq::shared_message_memory_allocator::deallocate ()
 {
     zmq::atomic_counter_t* c = reinterpret_cast<zmq::atomic_counter_t* >(buf);
     if (buf && !c->sub(1)) {
-        std::free(buf);
+        msg_pool_t::deallocate(buf);
     }
     release();
 }
@@ -126,12 +145,19 @@ void zmq::shared_message_memory_allocator::call_dec_ref(void*, void* hint)
 
     if (!c->sub (1)) {
         c->~atomic_counter_t ();
-        std::free (buf);
+        msg_pool_t::deallocate (buf);
         buf = NULL;
     }
 }
 
 
+void zmq::shared_message_memory_allocator::set_max_size (std::size_t max_size_)
+{
+    max_size = max_size_;
+    if (!fixedCounters)
+        maxCounters = max_counters (max_size);
+}
+
 std::size_t zmq::shared_message_memory_allocator::size () const
 {
     return bufsize;
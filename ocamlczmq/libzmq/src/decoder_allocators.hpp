@@ -44,6 +44,8 @@ namespace zmq
     public:
         explicit c_single_allocator (std::size_t bufsize_) :
                 bufsize(bufsize_),
+                max_size(bufsize_),
+                capacity(bufsize_),
                 buf(static_cast <unsigned char*> (std::malloc (bufsize)))
         {
             alloc_assert (buf);
@@ -56,6 +58,15 @@ namespace zmq
 
         unsigned char* allocate ()
         {
+            //  The previous batch has been decoded completely, so the buffer
+            //  can be replaced if the batch size changed meanwhile.
+            if (capacity != max_size) {
+                std::free (buf);
+                buf = static_cast <unsigned char*> (std::malloc (max_size));
+                alloc_assert (buf);
+                capacity = max_size;
+            }
+            bufsize = capacity;
             return buf;
         }
 
@@ -72,8 +83,16 @@ namespace zmq
         {
             bufsize = new_size;
         }
+
+        //  Sets the size of the buffers allocated from now on.
+        void set_max_size (std::size_t max_size_)
+        {
+            max_size = max_size_;
+        }
     private:
         std::size_t bufsize;
+        std::size_t max_size;
+        std::size_t capacity;
         unsigned char* buf;
 
         c_single_allocator (c_single_allocator const&);
@@ -132,6 +151,10 @@ namespace zmq
             bufsize = new_size;
         }
 
+        // Set the size of the buffers allocated from now on. The current
+        // buffer keeps its size.
+        void set_max_size (std::size_t max_size_);
+
         zmq::atomic_counter_t* provide_refcnt ()
         {
             return msg_refcnt;
@@ -148,6 +171,11 @@ namespace zmq
         std::size_t max_size;
         zmq::atomic_counter_t* msg_refcnt;
         std::size_t maxCounters;
+
+        // Size of the current buffer, and whether the number of messages
+        // was given rather than derived from the buffer size.
+        std::size_t capacity;
+        bool fixedCounters;
     };
 }
 
@@ -39,6 +39,7 @@
 #include <unistd.h>
 #include <limits.h>
 #include <algorithm>
+#include <vector>
 
 #include "devpoll.hpp"
 #include "err.hpp"
@@ -136,7 +137,7 @@ void zmq::devpoll_t::reset_pollout (handle_t handle_)
 
 void zmq::devpoll_t::start ()
 {
-    ctx.start_thread (worker, worker_routine, this);
+    ctx.start_thread (worker, worker_routine, this, affinity);
 }
 
 void zmq::devpoll_t::stop ()
@@ -151,9 +152,10 @@ int zmq::devpoll_t::max_fds ()
 
 void zmq::devpoll_t::loop ()
 {
+    std::vector <struct pollfd> ev_buf (ctx.get_io_events ());
+
     while (!stopping) {
 
-        struct pollfd ev_buf [max_io_events];
         struct dvpoll poll_req;
 
         for (pending_list_t::size_type i = 0; i < pending_list.size (); i ++)
@@ -167,9 +169,9 @@ void zmq::devpoll_t::loop ()
         //  On Solaris, we can retrieve no more then (OPEN_MAX - 1) events.
         poll_req.dp_fds = &ev_buf [0];
 #if defined ZMQ_HAVE_SOLARIS
-        poll_req.dp_nfds = std::min ((int) max_io_events, OPEN_MAX - 1);
+        poll_req.dp_nfds = std::min ((int) ev_buf.size (), OPEN_MAX - 1);
 #else
-        poll_req.dp_nfds = max_io_events;
+        poll_req.dp_nfds = (int) ev_buf.size ();
 #endif
         poll_req.dp_timeout = timeout ? timeout : -1;
         int n = ioctl (devpoll_fd, DP_POLL, &poll_req);
@@ -33,17 +33,33 @@
 #include "msg.hpp"
 #include "likely.hpp"
 
+#include <algorithm>
+
 zmq::dist_t::dist_t () :
     matching (0),
     active (0),
     eligible (0),
-    more (false)
+    passive_matching (0),
+    drops (0),
+    more (false),
+    conflate_topics (false)
 {
 }
 
 zmq::dist_t::~dist_t ()
 {
     zmq_assert (pipes.empty ());
+
+    //  The socket may be closed in the middle of a multi-part message.
+    for (parts_t::iterator it = parts.begin (); it != parts.end (); ++it) {
+        int rc = it->close ();
+        errno_assert (rc == 0);
+    }
+}
+
+void zmq::dist_t::set_conflate_topics (bool conflate_)
+{
+    conflate_topics = conflate_;
 }
 
 void zmq::dist_t::attach (pipe_t *pipe_)
@@ -70,9 +86,15 @@ void zmq::dist_t::match (pipe_t *pipe_)
     if (pipes.index (pipe_) < matching)
         return;
 
-    //  If the pipe isn't eligible, ignore it.
-    if (pipes.index (pipe_) >= eligible)
+    //  If the pipe isn't eligible, the message is going to be dropped
+    //  for it. Remember that, counting each pipe only once.
+    if (pipes.index (pipe_) >= eligible) {
+        if (pipes.index (pipe_) >= eligible + passive_matching) {
+            pipes.swap (pipes.index (pipe_), eligible + passive_matching);
+            passive_matching++;
+        }
         return;
+    }
 
     //  Mark the pipe as matching.
     pipes.swap (pipes.index (pipe_), matching);
@@ -93,11 +115,15 @@ void zmq::dist_t::reverse_match ()
     for (pipes_t::size_type i = prev_matching; i < eligible; ++i) {
         pipes.swap(i, matching++);
     }
+
+    //  Only the number of passive matching pipes is used from now on.
+    passive_matching = pipes.size () - eligible - passive_matching;
 }
 
 void zmq::dist_t::unmatch ()
 {
     matching = 0;
+    passive_matching = 0;
 }
 
 void zmq::dist_t::pipe_terminated (pipe_t *pipe_)
@@ -116,12 +142,46 @@ void zmq::dist_t::pipe_terminated (pipe_t *pipe_)
         pipes.swap (pipes.index (pipe_), eligible - 1);
         eligible--;
     }
+    else
+    if (pipes.index (pipe_) < eligible + passive_matching) {
+        pipes.swap (pipes.index (pipe_), eligible + passive_matching - 1);
+        passive_matching--;
+    }
 
     pipes.erase (pipe_);
+
+    //  Drop the messages held for the pipe.
+    conflated_t::iterator it = conflated.find (pipe_);
+    if (it != conflated.end ()) {
+        for (topics_t::iterator topic_it = it->second.begin ();
+              topic_it != it->second.end (); ++topic_it)
+            for (parts_t::iterator part_it = topic_it->second.begin ();
+                  part_it != topic_it->second.end (); ++part_it) {
+                int rc = part_it->close ();
+                errno_assert (rc == 0);
+            }
+        conflated.erase (it);
+    }
+    deferred.erase (std::remove (deferred.begin (), deferred.end (), pipe_),
+        deferred.end ());
 }
 
 void zmq::dist_t::activated (pipe_t *pipe_)
 {
+    if (conflate_topics) {
+        //  The message being sent may yet have to be conflated for the
+        //  pipe; activate it once the message is complete.
+        if (more) {
+            deferred.push_back (pipe_);
+            return;
+        }
+
+        //  The pipe stays inactive until it has caught up with all the
+        //  topics, so that no newer message overtakes them.
+        if (!flush_conflated (pipe_))
+            return;
+    }
+
     //  Move the pipe from passive to eligible state.
     pipes.swap (pipes.index (pipe_), eligible);
     eligible++;
@@ -137,6 +197,7 @@ void zmq::dist_t::activated (pipe_t *pipe_)
 int zmq::dist_t::send_to_all (msg_t *msg_)
 {
     matching = active;
+    passive_matching = pipes.size () - eligible;
     return send_to_matching (msg_);
 }
 
@@ -145,6 +206,21 @@ int zmq::dist_t::send_to_matching (msg_t *msg_)
     //  Is this end of a multipart message?
     bool msg_more = msg_->flags () & msg_t::more ? true : false;
 
+    //  With conflated topics, keep a copy of the message for the matching
+    //  pipes that cannot take it rather than dropping it for them.
+    if (conflate_topics) {
+        if (!more)
+            topic.assign ((unsigned char *) msg_->data (), msg_->size ());
+        msg_t copy;
+        int rc = copy.init ();
+        errno_assert (rc == 0);
+        rc = copy.copy (*msg_);
+        errno_assert (rc == 0);
+        parts.push_back (copy);
+    }
+    else
+        drops += passive_matching;
+
     //  Push the message to matching pipes.
     distribute (msg_);
 
@@ -154,9 +230,85 @@ int zmq::dist_t::send_to_matching (msg_t *msg_)
 
     more = msg_more;
 
+    if (conflate_topics && !more) {
+        conflate ();
+
+        //  Now activate the pipes that were activated in the meantime.
+        std::vector <pipe_t *> pending;
+        pending.swap (deferred);
+        for (std::vector <pipe_t *>::iterator it = pending.begin ();
+              it != pending.end (); ++it)
+            activated (*it);
+    }
+
     return 0;
 }
 
+void zmq::dist_t::conflate ()
+{
+    for (pipes_t::size_type i = eligible; i < eligible + passive_matching;
+          ++i) {
+        parts_t &latest = conflated [pipes [i]][topic];
+
+        //  The message replaces the previous one of the same topic.
+        drops += latest.size ();
+        for (parts_t::iterator it = latest.begin (); it != latest.end (); ++it) {
+            int rc = it->close ();
+            errno_assert (rc == 0);
+        }
+        latest.resize (parts.size ());
+        for (parts_t::size_type j = 0; j != parts.size (); ++j) {
+            int rc = latest [j].init ();
+            errno_assert (rc == 0);
+            rc = latest [j].copy (parts [j]);
+            errno_assert (rc == 0);
+        }
+    }
+
+    for (parts_t::iterator it = parts.begin (); it != parts.end (); ++it) {
+        int rc = it->close ();
+        errno_assert (rc == 0);
+    }
+    parts.clear ();
+}
+
+bool zmq::dist_t::flush_conflated (pipe_t *pipe_)
+{
+    conflated_t::iterator it = conflated.find (pipe_);
+    if (it == conflated.end ())
+        return true;
+
+    topics_t &topics = it->second;
+    while (!topics.empty ()) {
+        parts_t &latest = topics.begin ()->second;
+
+        //  Write copies, so that the message is kept whole if the pipe
+        //  fills up in the middle of it.
+        for (parts_t::size_type i = 0; i != latest.size (); ++i) {
+            msg_t copy;
+            int rc = copy.init ();
+            errno_assert (rc == 0);
+            rc = copy.copy (latest [i]);
+            errno_assert (rc == 0);
+            if (!pipe_->write (&copy)) {
+                rc = copy.close ();
+                errno_assert (rc == 0);
+                pipe_->rollback ();
+                return false;
+            }
+        }
+        pipe_->flush ();
+        for (parts_t::iterator part_it = latest.begin ();
+              part_it != latest.end (); ++part_it) {
+            int rc = part_it->close ();
+            errno_assert (rc == 0);
+        }
+        topics.erase (topics.begin ());
+    }
+    conflated.erase (it);
+    return true;
+}
+
 void zmq::dist_t::distribute (msg_t *msg_)
 {
     //  If there are no matching pipes available, simply drop the message.
@@ -213,6 +365,13 @@ bool zmq::dist_t::write (pipe_t *pipe_, msg_t *msg_)
         active--;
         pipes.swap (active, eligible - 1);
         eligible--;
+
+        //  With conflated topics, a pipe that fails to take the first part
+        //  gets the message with the rest of the passive matching pipes.
+        if (conflate_topics && !more)
+            passive_matching++;
+        else
+            drops++;
         return false;
     }
     if (!(msg_->flags () & msg_t::more))
@@ -229,4 +388,7 @@ bool zmq::dist_t::check_hwm ()
     return true;
 }
 
-
+uint64_t zmq::dist_t::get_drops () const
+{
+    return drops;
+}
@@ -30,10 +30,14 @@
 #ifndef __ZMQ_DIST_HPP_INCLUDED__
 #define __ZMQ_DIST_HPP_INCLUDED__
 
+#include <map>
 #include <vector>
 
 #include "array.hpp"
+#include "blob.hpp"
+#include "msg.hpp"
 #include "pipe.hpp"
+#include "stdint.hpp"
 
 namespace zmq
 {
@@ -80,6 +84,15 @@ namespace zmq
         // check HWM of all pipes matching
         bool check_hwm ();
 
+        //  Returns the number of message parts not delivered to a pipe
+        //  because the pipe had reached its high water mark.
+        uint64_t get_drops () const;
+
+        //  If enabled, pipes at their high water mark are not dropped
+        //  messages, but get the latest message of each topic once they
+        //  can take messages again. The topic is the first message part.
+        void set_conflate_topics (bool conflate_);
+
     private:
 
         //  Write the message to the pipe. Make the pipe inactive if writing
@@ -89,6 +102,14 @@ namespace zmq
         //  Put the message to all active pipes.
         void distribute (zmq::msg_t *msg_);
 
+        //  Stores the message just sent as the latest one of its topic
+        //  for all the matching pipes that could not take it.
+        void conflate ();
+
+        //  Writes the latest messages of the topics held for the pipe to
+        //  it. Returns false if the pipe filled up before all were written.
+        bool flush_conflated (zmq::pipe_t *pipe_);
+
         //  List of outbound pipes.
         typedef array_t <zmq::pipe_t, 2> pipes_t;
         pipes_t pipes;
@@ -108,9 +129,37 @@ namespace zmq
         //  with initial parts missing.
         pipes_t::size_type eligible;
 
+        //  Number of pipes that match the current message but are not
+        //  eligible. They are located right after the eligible pipes.
+        pipes_t::size_type passive_matching;
+
+        //  Number of message parts dropped because of the high water mark.
+        uint64_t drops;
+
         //  True if last we are in the middle of a multipart message.
         bool more;
 
+        //  True if topics are conflated for the pipes at their high water
+        //  mark rather than messages being dropped.
+        bool conflate_topics;
+
+        //  Topic and copies of the parts of the message being sent, kept
+        //  for the pipes that cannot take it, if topics are conflated.
+        typedef std::vector <msg_t> parts_t;
+        blob_t topic;
+        parts_t parts;
+
+        //  Latest message of each topic held for the pipes that were at
+        //  their high water mark when it was sent.
+        typedef std::map <blob_t, parts_t> topics_t;
+        typedef std::map <pipe_t *, topics_t> conflated_t;
+        conflated_t conflated;
+
+        //  Pipes activated in the middle of a multi-part message. They are
+        //  activated once the message is complete, after it has been
+        //  conflated for them.
+        std::vector <pipe_t *> deferred;
+
         dist_t (const dist_t&);
         const dist_t &operator = (const dist_t&);
     };
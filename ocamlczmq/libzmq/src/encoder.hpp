@@ -76,6 +76,15 @@ namespace zmq
         //  points to NULL) decoder object will provide buffer of its own.
         inline size_t encode (unsigned char **data_, size_t size_)
         {
+            return encode_gather (data_, size_, 0, NULL, NULL);
+        }
+
+        inline size_t encode_gather (unsigned char **data_, size_t size_,
+            size_t min_body_, unsigned char **body_, size_t *body_size_)
+        {
+            if (body_size_)
+                *body_size_ = 0;
+
             unsigned char *buffer = !*data_ ? buf : *data_;
             size_t buffersize = !*data_ ? bufsize : size_;
 
@@ -100,6 +109,17 @@ namespace zmq
                     (static_cast <T*> (this)->*next) ();
                 }
 
+                //  Hand a large message body over to the caller instead of
+                //  copying it. Only the last step of a message, which the
+                //  new_msg_flag marks, is the body.
+                if (body_ && new_msg_flag && to_write >= min_body_) {
+                    *body_ = write_pos;
+                    *body_size_ = to_write;
+                    write_pos = NULL;
+                    to_write = 0;
+                    break;
+                }
+
                 //  If there are no data in the buffer yet and we are able to
                 //  fill whole buffer in a single go, let's use zero-copy.
                 //  There's no disadvantage to it as we cannot stuck multiple
@@ -137,6 +157,16 @@ namespace zmq
             (static_cast <T*> (this)->*next) ();
         }
 
+        void set_batch_size (size_t size_)
+        {
+            if (size_ == bufsize)
+                return;
+            free (buf);
+            bufsize = size_;
+            buf = (unsigned char*) malloc (bufsize);
+            alloc_assert (buf);
+        }
+
     protected:
 
         //  Prototype of state machine action.
@@ -131,7 +131,7 @@ void zmq::epoll_t::reset_pollout (handle_t handle_)
 
 void zmq::epoll_t::start ()
 {
-    ctx.start_thread (worker, worker_routine, this);
+    ctx.start_thread (worker, worker_routine, this, affinity);
 }
 
 void zmq::epoll_t::stop ()
@@ -146,7 +146,7 @@ int zmq::epoll_t::max_fds ()
 
 void zmq::epoll_t::loop ()
 {
-    epoll_event ev_buf [max_io_events];
+    std::vector <epoll_event> ev_buf (ctx.get_io_events ());
 
     while (!stopping) {
 
@@ -154,7 +154,7 @@ void zmq::epoll_t::loop ()
         int timeout = (int) execute_timers ();
 
         //  Wait for events.
-        int n = epoll_wait (epoll_fd, &ev_buf [0], max_io_events,
+        int n = epoll_wait (epoll_fd, &ev_buf [0], (int) ev_buf.size (),
             timeout ? timeout : -1);
         if (n == -1) {
             errno_assert (errno == EINTR);
@@ -36,6 +36,7 @@ zmq::fq_t::fq_t () :
     active (0),
     last_in (NULL),
     current (0),
+    priority (false),
     more (false)
 {
 }
@@ -79,6 +80,11 @@ void zmq::fq_t::activated (pipe_t *pipe_)
     active++;
 }
 
+void zmq::fq_t::set_priority (bool priority_)
+{
+    priority = priority_;
+}
+
 int zmq::fq_t::recv (msg_t *msg_)
 {
     return recvpipe (msg_, NULL);
@@ -90,6 +96,16 @@ int zmq::fq_t::recvpipe (msg_t *msg_, pipe_t **pipe_)
     int rc = msg_->close ();
     errno_assert (rc == 0);
 
+    //  Between messages, a pipe with a priority message waiting takes
+    //  the turn. The round-robin continues after it.
+    if (priority && !more) {
+        for (pipes_t::size_type i = 0; i != active; i++)
+            if (pipes [i]->check_priority ()) {
+                current = i;
+                break;
+            }
+    }
+
     //  Round-robin over the pipes to get the next message.
     while (active > 0) {
 
@@ -51,6 +51,11 @@ namespace zmq
 
         void attach (pipe_t *pipe_);
         void activated (pipe_t *pipe_);
+
+        //  If true, a pipe whose next message is a priority message is
+        //  read from ahead of its turn. Looking for such pipes costs a
+        //  check of every active pipe per message.
+        void set_priority (bool priority_);
         void pipe_terminated (pipe_t *pipe_);
 
         int recv (msg_t *msg_);
@@ -76,6 +81,9 @@ namespace zmq
         //  Index of the next bound pipe to read a message from.
         pipes_t::size_type current;
 
+        //  If true, priority messages are looked for across all the pipes.
+        bool priority;
+
         //  If true, part of a multipart message was already received, but
         //  there are following parts still waiting in the current pipe.
         bool more;
@@ -47,6 +47,11 @@ namespace zmq
         virtual void get_buffer (unsigned char **data_, size_t *size_) = 0;
 
         virtual void resize_buffer(size_t) = 0;
+
+        //  Sets the size of the buffers returned by get_buffer from the
+        //  next batch on.
+        virtual void set_batch_size (size_t size_) = 0;
+
         //  Decodes data pointed to by data_.
         //  When a message is decoded, 1 is returned.
         //  When the decoder needs more data, 0 is returned.
@@ -50,9 +50,22 @@ namespace zmq
         //  Function returns 0 when a new message is required.
         virtual size_t encode (unsigned char **data_, size_t size) = 0;
 
+        //  Same as encode, except that a message body of at least min_body_
+        //  bytes is not copied to the buffer. Encoding stops in front of it
+        //  and the body is returned in body_ and body_size_ instead, to be
+        //  sent right after the returned data. The body stays valid until
+        //  the encoder is called again. If there's no such body, body_size_
+        //  is set to 0.
+        virtual size_t encode_gather (unsigned char **data_, size_t size_,
+            size_t min_body_, unsigned char **body_, size_t *body_size_) = 0;
+
         //  Load a new message into encoder.
         virtual void load_msg (msg_t *msg_) = 0;
 
+        //  Resizes the encoder's own buffer. Must not be called while
+        //  data returned from it are yet to be written.
+        virtual void set_batch_size (size_t size_) = 0;
+
     };
 
 }
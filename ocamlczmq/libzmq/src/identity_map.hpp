@@ -0,0 +1,221 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ZMQ_IDENTITY_MAP_HPP_INCLUDED__
+#define __ZMQ_IDENTITY_MAP_HPP_INCLUDED__
+
+#include <vector>
+#include <stddef.h>
+#include <string.h>
+
+#include "blob.hpp"
+#include "stdint.hpp"
+
+namespace zmq
+{
+
+    //  Hash table mapping peer identities to values, used for routing
+    //  outbound messages. It uses open addressing with linear probing in
+    //  a power-of-two sized array of slots. Each slot keeps the hash of
+    //  its identity, so probing compares identity bytes only when the
+    //  hashes match and growing the table never hashes the keys again.
+    //  Removal shifts the following entries back rather than leaving
+    //  tombstones, so lookups stay short under heavy reconnect churn.
+
+    template <typename T> class identity_map_t
+    {
+    public:
+
+        inline identity_map_t () :
+            count (0)
+        {
+        }
+
+        //  FNV-1a hash of an identity.
+        static inline uint32_t hash (const unsigned char *data_, size_t size_)
+        {
+            uint32_t h = 2166136261u;
+            for (size_t i = 0; i != size_; i++) {
+                h ^= data_ [i];
+                h *= 16777619u;
+            }
+            return h;
+        }
+
+        inline bool empty () const
+        {
+            return count == 0;
+        }
+
+        inline size_t size () const
+        {
+            return count;
+        }
+
+        //  Returns the value stored for the identity, NULL if there's none.
+        inline T *find (const unsigned char *data_, size_t size_)
+        {
+            const size_t index = lookup (data_, size_, hash (data_, size_));
+            return index == npos ? NULL : &slots [index].value;
+        }
+
+        inline T *find (const blob_t &identity_)
+        {
+            return find (identity_.data (), identity_.size ());
+        }
+
+        //  Adds the identity to the table. Returns false if it is
+        //  already there.
+        bool insert (const blob_t &identity_, const T &value_)
+        {
+            const uint32_t h = hash (identity_.data (), identity_.size ());
+            if (lookup (identity_.data (), identity_.size (), h) != npos)
+                return false;
+
+            //  Keep the load factor under 3/4.
+            if ((count + 1) * 4 > slots.size () * 3)
+                grow ();
+
+            const size_t mask = slots.size () - 1;
+            size_t index = h & mask;
+            while (slots [index].used)
+                index = (index + 1) & mask;
+            slot_t &slot = slots [index];
+            slot.identity = identity_;
+            slot.value = value_;
+            slot.hash = h;
+            slot.used = true;
+            count++;
+            return true;
+        }
+
+        //  Removes the identity from the table. Returns false if it
+        //  was not there.
+        bool erase (const blob_t &identity_)
+        {
+            size_t index = lookup (identity_.data (), identity_.size (),
+                hash (identity_.data (), identity_.size ()));
+            if (index == npos)
+                return false;
+
+            //  Move back every following entry in the probe run that
+            //  would not be reachable from its home slot any more.
+            const size_t mask = slots.size () - 1;
+            size_t next = index;
+            while (true) {
+                next = (next + 1) & mask;
+                if (!slots [next].used)
+                    break;
+                const size_t home = slots [next].hash & mask;
+                const bool in_place = index <= next ?
+                    index < home && home <= next :
+                    index < home || home <= next;
+                if (in_place)
+                    continue;
+                slots [index].identity.swap (slots [next].identity);
+                slots [index].value = slots [next].value;
+                slots [index].hash = slots [next].hash;
+                index = next;
+            }
+            slots [index].identity.clear ();
+            slots [index].value = T ();
+            slots [index].used = false;
+            count--;
+            return true;
+        }
+
+    private:
+
+        struct slot_t
+        {
+            inline slot_t () :
+                value (),
+                hash (0),
+                used (false)
+            {
+            }
+
+            blob_t identity;
+            T value;
+            uint32_t hash;
+            bool used;
+        };
+
+        static const size_t npos = (size_t) -1;
+
+        //  The table never gets smaller than this many slots.
+        enum {min_slots = 16};
+
+        size_t lookup (const unsigned char *data_, size_t size_,
+            uint32_t hash_) const
+        {
+            if (slots.empty ())
+                return npos;
+            const size_t mask = slots.size () - 1;
+            for (size_t index = hash_ & mask; slots [index].used;
+                  index = (index + 1) & mask) {
+                const slot_t &slot = slots [index];
+                if (slot.hash == hash_ && slot.identity.size () == size_ &&
+                      memcmp (slot.identity.data (), data_, size_) == 0)
+                    return index;
+            }
+            return npos;
+        }
+
+        void grow ()
+        {
+            std::vector <slot_t> old;
+            old.swap (slots);
+            slots.resize (old.empty () ? (size_t) min_slots : old.size () * 2);
+            const size_t mask = slots.size () - 1;
+            for (size_t i = 0; i != old.size (); i++) {
+                if (!old [i].used)
+                    continue;
+                size_t index = old [i].hash & mask;
+                while (slots [index].used)
+                    index = (index + 1) & mask;
+                slots [index].identity.swap (old [i].identity);
+                slots [index].value = old [i].value;
+                slots [index].hash = old [i].hash;
+                slots [index].used = true;
+            }
+        }
+
+        std::vector <slot_t> slots;
+
+        //  Number of identities in the table.
+        size_t count;
+
+        identity_map_t (const identity_map_t&);
+        const identity_map_t &operator = (const identity_map_t&);
+    };
+
+}
+
+#endif
@@ -34,12 +34,20 @@
 #include "platform.hpp"
 #include "err.hpp"
 #include "ctx.hpp"
-
-zmq::io_thread_t::io_thread_t (ctx_t *ctx_, uint32_t tid_) :
-    object_t (ctx_, tid_)
+#include "config.hpp"
+#include "session_base.hpp"
+#include "stream_engine.hpp"
+#include "zap_client.hpp"
+
+zmq::io_thread_t::io_thread_t (ctx_t *ctx_, uint32_t tid_,
+      int rebalance_ivl_, const std::set <int> &cpus_) :
+    object_t (ctx_, tid_),
+    rebalance_ivl (rebalance_ivl_),
+    zap_client (NULL)
 {
     poller = new (std::nothrow) poller_t (*ctx_);
     alloc_assert (poller);
+    poller->set_affinity (cpus_);
 
     mailbox_handle = poller->add_fd (mailbox.get_fd (), this);
     poller->set_pollin (mailbox_handle);
@@ -47,11 +55,26 @@ zmq::io_thread_t::io_thread_t (ctx_t *ctx_, uint32_t tid_) :
 
 zmq::io_thread_t::~io_thread_t ()
 {
+    //  Deleting the poller waits for the thread to exit, which it does
+    //  once the ZAP client closed its pipe.
     LIBZMQ_DELETE(poller);
+    LIBZMQ_DELETE(zap_client);
+}
+
+zmq::zap_client_t *zmq::io_thread_t::get_zap_client ()
+{
+    if (!zap_client) {
+        zap_client = new (std::nothrow) zap_client_t (this);
+        alloc_assert (zap_client);
+    }
+    return zap_client;
 }
 
 void zmq::io_thread_t::start ()
 {
+    if (rebalance_ivl > 0)
+        poller->add_timer (rebalance_ivl, this, rebalance_timer_id);
+
     //  Start the underlying I/O thread.
     poller->start ();
 }
@@ -94,10 +117,12 @@ void zmq::io_thread_t::out_event ()
     zmq_assert (false);
 }
 
-void zmq::io_thread_t::timer_event (int)
+void zmq::io_thread_t::timer_event (int id_)
 {
-    //  No timers here. This function is never called.
-    zmq_assert (false);
+    //  The only timer is the rebalancing one.
+    zmq_assert (id_ == rebalance_timer_id);
+    rebalance ();
+    poller->add_timer (rebalance_ivl, this, rebalance_timer_id);
 }
 
 zmq::poller_t *zmq::io_thread_t::get_poller ()
@@ -107,7 +132,116 @@ zmq::poller_t *zmq::io_thread_t::get_poller ()
 }
 
 void zmq::io_thread_t::process_stop ()
+{
+    //  The pipe to the ZAP handler must be closed while the thread still
+    //  processes commands. Stop once it's gone.
+    if (zap_client && zap_client->terminate ())
+        return;
+    stop_polling ();
+}
+
+void zmq::io_thread_t::zap_client_terminated ()
+{
+    stop_polling ();
+}
+
+void zmq::io_thread_t::stop_polling ()
 {
     poller->rm_fd (mailbox_handle);
     poller->stop ();
 }
+
+void zmq::io_thread_t::process_migrate (session_base_t *session_,
+    stream_engine_t *engine_)
+{
+    session_->migrate_in (this);
+    engine_->migrate_in (this);
+}
+
+void zmq::io_thread_t::add_engine (stream_engine_t *engine_)
+{
+    if (rebalance_ivl > 0) {
+        engine_load_t load = {engine_->get_events (), 0};
+        engines.insert (engines_t::value_type (engine_, load));
+    }
+}
+
+void zmq::io_thread_t::rm_engine (stream_engine_t *engine_)
+{
+    if (rebalance_ivl > 0)
+        engines.erase (engine_);
+}
+
+uint32_t zmq::io_thread_t::get_rate ()
+{
+    return rate.get ();
+}
+
+void zmq::io_thread_t::rebalance ()
+{
+    //  Process the pending commands first. The session can't be moved
+    //  unless the mailbox is empty, see below.
+    in_event ();
+
+    //  Measure how busy the engines were during the last interval.
+    uint64_t total = 0;
+    for (engines_t::iterator it = engines.begin (); it != engines.end ();
+          ++it) {
+        const uint64_t events = it->first->get_events ();
+        const uint64_t delta = events - it->second.events;
+        it->second.events = events;
+        it->second.rate = delta > 0xffffffff ? 0xffffffff : (uint32_t) delta;
+        total += it->second.rate;
+    }
+    const uint32_t busy_rate = total > 0xffffffff ? 0xffffffff :
+        (uint32_t) total;
+    rate.set (busy_rate);
+
+    uint32_t idle_rate = 0;
+    io_thread_t *idle = get_ctx ()->choose_idle_io_thread (this, &idle_rate);
+    if (!idle || busy_rate / 2 <= idle_rate ||
+          (uint64_t) (busy_rate - idle_rate) * 1000 <
+          (uint64_t) rebalance_min_rate * rebalance_ivl)
+        return;
+
+    //  Moving an engine that handles more than half of the difference
+    //  would just make the other thread the busier one, so pick the
+    //  busiest engine below that.
+    const uint32_t max_rate = (busy_rate - idle_rate) / 2;
+    const uint64_t idle_mask = uint64_t (1) << (idle->get_tid () -
+        ctx_t::reaper_tid - 1);
+    stream_engine_t *engine = NULL;
+    uint32_t engine_rate = 0;
+    for (engines_t::iterator it = engines.begin (); it != engines.end ();
+          ++it) {
+        if (it->second.rate <= engine_rate || it->second.rate > max_rate)
+            continue;
+        const uint64_t affinity = it->first->get_affinity ();
+        if (affinity && !(affinity & idle_mask))
+            continue;
+        if (!it->first->migratable () ||
+              !it->first->get_session ()->migratable ())
+            continue;
+        engine = it->first;
+        engine_rate = it->second.rate;
+    }
+    if (!engine)
+        return;
+
+    //  Commands for the session and its pipe go to the new thread as soon
+    //  as their thread ID is changed. Before that, the session must be
+    //  handed over to the new thread, and there must be no commands for
+    //  them left here. Locking the mailbox, which is only possible if
+    //  it's empty, makes senders wait until the IDs are changed.
+    mutex_t &migration_sync = get_ctx ()->get_migration_sync ();
+    migration_sync.lock ();
+    if (mailbox.lock_if_empty ()) {
+        session_base_t *session = engine->get_session ();
+        engine->migrate_out ();
+        session->migrate_out (idle, engine);
+        mailbox.unlock ();
+        rate.set (busy_rate - engine_rate);
+        idle->rate.add (engine_rate);
+    }
+    migration_sync.unlock ();
+}
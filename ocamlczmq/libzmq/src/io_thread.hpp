@@ -31,17 +31,23 @@
 #define __ZMQ_IO_THREAD_HPP_INCLUDED__
 
 #include <vector>
+#include <map>
+#include <set>
 
 #include "stdint.hpp"
 #include "object.hpp"
 #include "poller.hpp"
 #include "i_poll_events.hpp"
 #include "mailbox.hpp"
+#include "atomic_counter.hpp"
 
 namespace zmq
 {
 
     class ctx_t;
+    class session_base_t;
+    class stream_engine_t;
+    class zap_client_t;
 
     //  Generic part of the I/O thread. Polling-mechanism-specific features
     //  are implemented in separate "polling objects".
@@ -50,7 +56,12 @@ namespace zmq
     {
     public:
 
-        io_thread_t (zmq::ctx_t *ctx_, uint32_t tid_);
+        //  If rebalance_ivl_ is not 0, the I/O thread checks every that many
+        //  milliseconds whether it is busier than the other I/O threads and
+        //  if so, moves one of its engines to the least busy one. The thread
+        //  runs on the CPUs in cpus_, or on any if it is empty.
+        io_thread_t (zmq::ctx_t *ctx_, uint32_t tid_, int rebalance_ivl_ = 0,
+            const std::set <int> &cpus_ = std::set <int> ());
 
         //  Clean-up. If the thread was started, it's necessary to call 'stop'
         //  before invoking destructor. Otherwise the destructor would hang up.
@@ -75,12 +86,61 @@ namespace zmq
 
         //  Command handlers.
         void process_stop ();
+        void process_migrate (zmq::session_base_t *session_,
+            zmq::stream_engine_t *engine_);
 
         //  Returns load experienced by the I/O thread.
         int get_load ();
 
+        //  Stream engines living in the I/O thread register with it so that
+        //  they can be moved to another I/O thread.
+        void add_engine (zmq::stream_engine_t *engine_);
+        void rm_engine (zmq::stream_engine_t *engine_);
+
+        //  Returns the number of I/O events the engines of the thread
+        //  handled in the last rebalancing interval.
+        uint32_t get_rate ();
+
+        //  Returns the connection to the ZAP handler shared by the sessions
+        //  living in the I/O thread.
+        zmq::zap_client_t *get_zap_client ();
+
+        //  Called by the ZAP client once the pipe it was closing on stop
+        //  is gone.
+        void zap_client_terminated ();
+
     private:
 
+        //  Stops polling, which ends the thread.
+        void stop_polling ();
+
+        //  Moves an engine, with its session, to the least busy I/O thread
+        //  if that makes the load of the two threads more even.
+        void rebalance ();
+
+        //  Rebalancing interval in milliseconds, 0 if disabled.
+        const int rebalance_ivl;
+
+        enum {rebalance_timer_id = 0x40};
+
+        //  Engines living in the I/O thread. For each engine, the number of
+        //  I/O events it handled until the last rebalancing and during the
+        //  last rebalancing interval is kept.
+        struct engine_load_t
+        {
+            uint64_t events;
+            uint32_t rate;
+        };
+        typedef std::map <stream_engine_t *, engine_load_t> engines_t;
+        engines_t engines;
+
+        //  Number of I/O events handled during the last rebalancing
+        //  interval. Read by other I/O threads.
+        atomic_counter_t rate;
+
+        //  Created on first use.
+        zap_client_t *zap_client;
+
         //  I/O thread accesses incoming commands via this mailbox.
         mailbox_t mailbox;
 
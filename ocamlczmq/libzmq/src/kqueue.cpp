@@ -37,6 +37,7 @@
 #include <unistd.h>
 #include <algorithm>
 #include <new>
+#include <vector>
 
 #include "macros.hpp"
 #include "kqueue.hpp"
@@ -156,7 +157,7 @@ void zmq::kqueue_t::reset_pollout (handle_t handle_)
 
 void zmq::kqueue_t::start ()
 {
-    ctx.start_thread (worker, worker_routine, this);
+    ctx.start_thread (worker, worker_routine, this, affinity);
 }
 
 void zmq::kqueue_t::stop ()
@@ -171,15 +172,16 @@ int zmq::kqueue_t::max_fds ()
 
 void zmq::kqueue_t::loop ()
 {
+    std::vector <struct kevent> ev_buf (ctx.get_io_events ());
+
     while (!stopping) {
 
         //  Execute any due timers.
         int timeout = (int) execute_timers ();
 
         //  Wait for events.
-        struct kevent ev_buf [max_io_events];
         timespec ts = {timeout / 1000, (timeout % 1000) * 1000000};
-        int n = kevent (kqueue_fd, NULL, 0, &ev_buf [0], max_io_events,
+        int n = kevent (kqueue_fd, NULL, 0, &ev_buf [0], (int) ev_buf.size (),
             timeout ? &ts: NULL);
 #ifdef HAVE_FORK
         if (unlikely(pid != getpid())) {
@@ -36,7 +36,8 @@ zmq::lb_t::lb_t () :
     active (0),
     current (0),
     more (false),
-    dropping (false)
+    dropping (false),
+    drops (0)
 {
 }
 
@@ -91,6 +92,7 @@ int zmq::lb_t::sendpipe (msg_t *msg_, pipe_t **pipe_)
 
         more = msg_->flags () & msg_t::more ? true : false;
         dropping = more;
+        drops++;
 
         int rc = msg_->close ();
         errno_assert (rc == 0);
@@ -168,3 +170,8 @@ bool zmq::lb_t::has_out ()
 
     return false;
 }
+
+uint64_t zmq::lb_t::get_drops () const
+{
+    return drops;
+}
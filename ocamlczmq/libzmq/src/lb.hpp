@@ -60,6 +60,10 @@ namespace zmq
 
         bool has_out ();
 
+        //  Returns the number of message parts dropped because their pipe
+        //  went away in the middle of a multipart message.
+        uint64_t get_drops () const;
+
     private:
 
         //  List of outbound pipes.
@@ -79,6 +83,9 @@ namespace zmq
         //  True if we are dropping current message.
         bool dropping;
 
+        //  Number of message parts dropped so far.
+        uint64_t drops;
+
         lb_t (const lb_t&);
         const lb_t &operator = (const lb_t&);
     };
@@ -0,0 +1,235 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "lz_codec.hpp"
+
+#include <string.h>
+
+//  Shortest match worth encoding, and the number of bytes at the end of a
+//  block that are always left as literals so that reading 4-byte
+//  sequences never runs past the input.
+static const size_t min_match = 4;
+static const size_t tail_literals = 8;
+static const size_t max_offset = 65535;
+
+static inline uint32_t read32 (const unsigned char *p_)
+{
+    uint32_t value;
+    memcpy (&value, p_, sizeof value);
+    return value;
+}
+
+static inline uint32_t hash32 (uint32_t value_, int log_)
+{
+    return (value_ * 2654435761U) >> (32 - log_);
+}
+
+//  Writes the extension bytes of a length that didn't fit in its nibble.
+static inline unsigned char *put_length (unsigned char *op_, size_t length_)
+{
+    while (length_ >= 255) {
+        *op_++ = 255;
+        length_ -= 255;
+    }
+    *op_++ = (unsigned char) length_;
+    return op_;
+}
+
+//  Reads the extension bytes of a length. Returns false if the block ends
+//  first.
+static inline bool get_length (const unsigned char *&ip_,
+    const unsigned char *iend_, size_t &length_)
+{
+    unsigned char byte;
+    do {
+        if (ip_ == iend_)
+            return false;
+        byte = *ip_++;
+        length_ += byte;
+    } while (byte == 255);
+    return true;
+}
+
+//  Appends a sequence of literals_ bytes at literal_ and, unless
+//  match_length_ is 0, a match offset_ bytes back. Returns NULL if it
+//  would go past oend_.
+static unsigned char *put_sequence (unsigned char *op_, unsigned char *oend_,
+    const unsigned char *literal_, size_t literals_, size_t offset_,
+    size_t match_length_)
+{
+    //  Token, literal length and match length bytes, offset and literals.
+    const size_t worst = 1 + (literals_ / 255 + 1) + (match_length_ / 255 + 1)
+        + 2 + literals_;
+    if ((size_t) (oend_ - op_) < worst)
+        return NULL;
+
+    unsigned char *token = op_++;
+    *token = 0;
+    if (literals_ >= 15) {
+        *token = 15 << 4;
+        op_ = put_length (op_, literals_ - 15);
+    }
+    else
+        *token = (unsigned char) (literals_ << 4);
+    memcpy (op_, literal_, literals_);
+    op_ += literals_;
+
+    if (match_length_) {
+        *op_++ = (unsigned char) (offset_ & 0xff);
+        *op_++ = (unsigned char) (offset_ >> 8);
+        const size_t length = match_length_ - min_match;
+        if (length >= 15) {
+            *token |= 15;
+            op_ = put_length (op_, length - 15);
+        }
+        else
+            *token |= (unsigned char) length;
+    }
+    return op_;
+}
+
+zmq::lz_compressor_t::lz_compressor_t ()
+{
+    memset (table, 0, sizeof table);
+}
+
+size_t zmq::lz_compressor_t::compress (const unsigned char *src_,
+    size_t size_, unsigned char *dst_, size_t capacity_)
+{
+    const unsigned char *ip = src_;
+    const unsigned char *anchor = src_;
+    const unsigned char *const iend = src_ + size_;
+    unsigned char *op = dst_;
+    unsigned char *const oend = dst_ + capacity_;
+
+    if (size_ > tail_literals + min_match) {
+        const unsigned char *const limit = iend - tail_literals;
+        while (ip < limit) {
+            const uint32_t sequence = read32 (ip);
+            uint32_t &entry = table [hash32 (sequence, hash_log)];
+            const size_t pos = ip - src_;
+            const size_t candidate = entry;
+            entry = (uint32_t) pos;
+
+            //  The further the last match, the faster incompressible data
+            //  is skipped.
+            if (candidate >= pos || pos - candidate > max_offset
+                  || read32 (src_ + candidate) != sequence) {
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            const unsigned char *ref = src_ + candidate;
+            const unsigned char *end = ip + min_match;
+            const unsigned char *rend = ref + min_match;
+            while (end < limit && *end == *rend) {
+                end++;
+                rend++;
+            }
+            while (ip > anchor && ref > src_ && ip [-1] == ref [-1]) {
+                ip--;
+                ref--;
+            }
+
+            op = put_sequence (op, oend, anchor, ip - anchor, ip - ref,
+                end - ip);
+            if (!op)
+                return 0;
+
+            //  Remember a position inside the match as well, as repeated
+            //  text tends to continue the same way.
+            if (end - 2 > src_ && end < limit)
+                table [hash32 (read32 (end - 2), hash_log)] =
+                    (uint32_t) (end - 2 - src_);
+            ip = end;
+            anchor = ip;
+        }
+    }
+
+    op = put_sequence (op, oend, anchor, iend - anchor, 0, 0);
+    if (!op)
+        return 0;
+    return op - dst_;
+}
+
+int zmq::lz_decompress (const unsigned char *src_, size_t size_,
+    unsigned char *dst_, size_t dst_size_)
+{
+    const unsigned char *ip = src_;
+    const unsigned char *const iend = src_ + size_;
+    unsigned char *op = dst_;
+    unsigned char *const oend = dst_ + dst_size_;
+
+    while (true) {
+        if (ip == iend)
+            return -1;
+        const unsigned char token = *ip++;
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !get_length (ip, iend, literals))
+            return -1;
+        if ((size_t) (iend - ip) < literals
+              || (size_t) (oend - op) < literals)
+            return -1;
+        memcpy (op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        //  The last sequence ends the block.
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+        const size_t offset = ip [0] | (ip [1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - dst_))
+            return -1;
+
+        size_t length = token & 15;
+        if (length == 15 && !get_length (ip, iend, length))
+            return -1;
+        length += min_match;
+        if ((size_t) (oend - op) < length)
+            return -1;
+
+        //  Matches may overlap the bytes they produce.
+        const unsigned char *ref = op - offset;
+        if (offset >= length) {
+            memcpy (op, ref, length);
+            op += length;
+        }
+        else
+            while (length--)
+                *op++ = *ref++;
+    }
+
+    return op == oend ? 0 : -1;
+}
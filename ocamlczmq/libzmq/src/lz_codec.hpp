@@ -0,0 +1,84 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_LZ_CODEC_HPP_INCLUDED__
+#define __ZMQ_LZ_CODEC_HPP_INCLUDED__
+
+#include <stddef.h>
+
+#include "stdint.hpp"
+
+namespace zmq
+{
+
+    //  Byte-oriented LZ77 codec used to compress message frames. A block
+    //  is a series of sequences, each made of a token byte, literal bytes
+    //  copied as they are and a match copied from earlier output. The
+    //  high nibble of the token is the number of literals and the low
+    //  nibble the match length minus 4; a nibble of 15 is followed by
+    //  bytes adding up to 255 each to it, a byte below 255 ending the
+    //  length. The match offset, 1 to 65535 bytes back, is two bytes in
+    //  little-endian order. The last sequence has literals only.
+
+    class lz_compressor_t
+    {
+    public:
+
+        lz_compressor_t ();
+
+        //  Compresses size_ bytes at src_ to dst_. Returns the size of the
+        //  block, or 0 if it would not fit in capacity_ bytes.
+        size_t compress (const unsigned char *src_, size_t size_,
+            unsigned char *dst_, size_t capacity_);
+
+    private:
+
+        //  Positions of recently seen 4-byte sequences by their hash.
+        //  Entries left over from earlier blocks are harmless, as every
+        //  candidate match is checked.
+        enum {hash_log = 14};
+        uint32_t table [1 << hash_log];
+
+        lz_compressor_t (const lz_compressor_t&);
+        const lz_compressor_t &operator = (const lz_compressor_t&);
+    };
+
+    //  A block never decompresses to more than this many times its size.
+    enum {lz_max_ratio = 256};
+
+    //  Decompresses the block of size_ bytes at src_ to exactly dst_size_
+    //  bytes at dst_. Returns -1 if the block is malformed or doesn't
+    //  decompress to dst_size_ bytes.
+    int lz_decompress (const unsigned char *src_, size_t size_,
+        unsigned char *dst_, size_t dst_size_);
+
+}
+
+#endif
@@ -28,8 +28,26 @@
 */
 
 #include "mailbox.hpp"
+#include "object.hpp"
+#include "clock.hpp"
+#include "likely.hpp"
 #include "err.hpp"
 
+#if defined ZMQ_HAVE_WINDOWS
+#include "windows.hpp"
+#endif
+
+//  Hint the CPU that we are in a spin-wait loop.
+static inline void spin_pause ()
+{
+#if (defined __GNUC__ || defined __clang__) && \
+    (defined __i386__ || defined __x86_64__)
+    __asm__ __volatile__ ("pause");
+#elif defined ZMQ_HAVE_WINDOWS
+    YieldProcessor ();
+#endif
+}
+
 zmq::mailbox_t::mailbox_t ()
 {
     //  Get the pipe into passive state. That way, if the users starts by
@@ -65,6 +83,36 @@ void zmq::mailbox_t::send (const command_t &cmd_)
         signaler.send ();
 }
 
+bool zmq::mailbox_t::send (const command_t &cmd_, uint32_t tid_)
+{
+    sync.lock ();
+    if (unlikely (cmd_.destination->get_tid () != tid_)) {
+        sync.unlock ();
+        return false;
+    }
+    cpipe.write (cmd_, false);
+    const bool ok = cpipe.flush ();
+    sync.unlock ();
+    if (!ok)
+        signaler.send ();
+    return true;
+}
+
+bool zmq::mailbox_t::lock_if_empty ()
+{
+    sync.lock ();
+    if (cpipe.check_read ()) {
+        sync.unlock ();
+        return false;
+    }
+    return true;
+}
+
+void zmq::mailbox_t::unlock ()
+{
+    sync.unlock ();
+}
+
 int zmq::mailbox_t::recv (command_t *cmd_, int timeout_)
 {
     //  Try to get the command straight away.
@@ -98,3 +146,25 @@ int zmq::mailbox_t::recv (command_t *cmd_, int timeout_)
     zmq_assert (ok);
     return 0;
 }
+
+bool zmq::mailbox_t::spin (int max_us_)
+{
+    //  There may be commands to read straight away.
+    if (active)
+        return true;
+
+    //  While the pipe is passive, check_read only succeeds once the writer
+    //  has flushed a command. The writer still signals, so the subsequent
+    //  recv finds the signal without having to sleep. The clock is read
+    //  every few iterations only as it's more expensive than the check.
+    const uint64_t end = clock_t::now_us () + max_us_;
+    while (true) {
+        for (int i = 0; i != 16; i++) {
+            if (cpipe.check_read ())
+                return true;
+            spin_pause ();
+        }
+        if (clock_t::now_us () >= end)
+            return false;
+    }
+}
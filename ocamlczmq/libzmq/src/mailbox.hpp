@@ -33,6 +33,7 @@
 #include <stddef.h>
 
 #include "platform.hpp"
+#include "stdint.hpp"
 #include "signaler.hpp"
 #include "fd.hpp"
 #include "config.hpp"
@@ -55,6 +56,23 @@ namespace zmq
         void send (const command_t &cmd_);
         int recv (command_t *cmd_, int timeout_);
 
+        //  Same as send, except that the command is refused, returning
+        //  false, if the destination object no longer lives in the thread
+        //  with ID tid_ because it has been migrated to another thread.
+        bool send (const command_t &cmd_, uint32_t tid_);
+
+        //  Locks the mailbox if no command is waiting in it, so that no
+        //  command can be posted until unlock is called. Returns false,
+        //  leaving the mailbox unlocked, if there are commands waiting.
+        //  Only to be called from the thread receiving from the mailbox.
+        bool lock_if_empty ();
+        void unlock ();
+
+        //  Busy-poll for up to max_us_ microseconds until a command is
+        //  posted. Returns true if there is a command to receive. The
+        //  command itself is left for recv to pick up.
+        bool spin (int max_us_);
+
 #ifdef HAVE_FORK
         // close the file descriptors in the signaller. This is used in a forked
         // child process to close the file descriptors so that they do not interfere
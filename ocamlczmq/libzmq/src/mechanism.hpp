@@ -91,6 +91,18 @@ namespace zmq
 
     protected:
 
+        //  Most metadata bytes a mechanism sends: the socket type, the
+        //  identity at its 255-byte maximum and every optional property.
+        enum {
+            max_metadata_size =
+                22          //  Socket-Type, with a six-letter type
+              + 20          //  Priority-Lanes
+              + 18          //  Compression
+              + 12          //  Resume
+              + 268         //  Identity
+              + 34          //  Resume-Ticket
+        };
+
         //  Only used to identify the socket for the Socket-Type
         //  property in the wire protocol.
         const char *socket_type_string (int socket_type) const;
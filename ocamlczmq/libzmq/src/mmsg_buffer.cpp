@@ -0,0 +1,133 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <new>
+
+#include "mmsg_buffer.hpp"
+#include "config.hpp"
+#include "err.hpp"
+
+namespace
+{
+    //  States of a slot in use, depending on whether the buffer is still
+    //  owned. Only the addresses matter.
+    char in_use_marker;
+    char orphaned_marker;
+
+    void *const in_use = &in_use_marker;
+    void *const orphaned = &orphaned_marker;
+
+    enum { cache_line_size = 64 };
+}
+
+zmq::mmsg_buffer_t::mmsg_buffer_t (size_t capacity_, int hwm_) :
+    msgs (0),
+    misses (0),
+    slot_capacity (capacity_),
+    next (0)
+{
+    const size_t header_size = (sizeof (slot_t) + 15) & ~(size_t) 15;
+    slot_size = (header_size + slot_capacity + cache_line_size - 1)
+        & ~(size_t) (cache_line_size - 1);
+    slot_count = mmsg_buffer_size / slot_size;
+    if (hwm_ > 0 && (size_t) hwm_ < slot_count)
+        slot_count = hwm_;
+    if (slot_count < 16)
+        slot_count = 16;
+
+    block = (unsigned char *) malloc (
+        slot_count * slot_size + cache_line_size - 1);
+    alloc_assert (block);
+    slots = (unsigned char *) (((uintptr_t) block + cache_line_size - 1)
+        & ~(uintptr_t) (cache_line_size - 1));
+
+    for (size_t i = 0; i != slot_count; i++) {
+        slot_t *s = new (slots + i * slot_size) slot_t ();
+        s->buffer = this;
+        s->data = (unsigned char *) s + header_size;
+    }
+}
+
+zmq::mmsg_buffer_t::~mmsg_buffer_t ()
+{
+    for (size_t i = 0; i != slot_count; i++)
+        slot (i)->~slot_t ();
+    free (block);
+}
+
+zmq::mmsg_buffer_t::slot_t *zmq::mmsg_buffer_t::allocate ()
+{
+    slot_t *s = slot (next);
+    if (++next == slot_count)
+        next = 0;
+
+    if (s->state.cas (NULL, in_use) != NULL) {
+        misses++;
+        return NULL;
+    }
+    msgs++;
+    return s;
+}
+
+void zmq::mmsg_buffer_t::release (slot_t *slot_)
+{
+    //  The slot may be handed out again as soon as it is marked free, so
+    //  nothing in it is touched afterwards unless the buffer is orphaned.
+    mmsg_buffer_t *buffer = slot_->buffer;
+    if (slot_->state.xchg (NULL) == orphaned)
+        if (!buffer->orphan_refs.sub (1))
+            delete buffer;
+}
+
+void zmq::mmsg_buffer_t::orphan ()
+{
+    //  Count the references up front so that slots released meanwhile
+    //  can't bring the count to zero before we are done.
+    orphan_refs.set ((atomic_counter_t::integer_t) slot_count + 1);
+    size_t used = 0;
+    for (size_t i = 0; i != slot_count; i++)
+        if (slot (i)->state.cas (in_use, orphaned) == in_use)
+            used++;
+
+    if (!orphan_refs.sub (
+          (atomic_counter_t::integer_t) (slot_count + 1 - used)))
+        delete this;
+}
+
+size_t zmq::mmsg_buffer_t::capacity () const
+{
+    return slot_capacity;
+}
+
+zmq::mmsg_buffer_t::slot_t *zmq::mmsg_buffer_t::slot (size_t index_)
+{
+    return (slot_t *) (slots + index_ * slot_size);
+}
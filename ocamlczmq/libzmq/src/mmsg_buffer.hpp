@@ -0,0 +1,124 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_MMSG_BUFFER_HPP_INCLUDED__
+#define __ZMQ_MMSG_BUFFER_HPP_INCLUDED__
+
+#include <stddef.h>
+
+#include "stdint.hpp"
+#include "atomic_ptr.hpp"
+#include "atomic_counter.hpp"
+
+namespace zmq
+{
+
+    //  Preallocated buffer of fixed-capacity slots that medium messages
+    //  (ZMQ_MEDIUM_MSG_SIZE) are carved from. A buffer has a single owner,
+    //  the one producer of the messages, which hands slots out in ring
+    //  order. The consumer, on whatever thread, gives a slot back with a
+    //  single atomic exchange; no reference is counted unless the message
+    //  gets copied.
+    //
+    //  As messages are mostly consumed in the order they were produced, the
+    //  owner only looks at the next slot of the ring. If it is still in use
+    //  the allocation fails and the caller falls back to the heap.
+    //
+    //  The owner drops the buffer with orphan. It is deallocated once its
+    //  last slot is released.
+
+    class mmsg_buffer_t
+    {
+    public:
+
+        struct slot_t
+        {
+            //  NULL if the slot is free, else a marker saying whether the
+            //  buffer is still owned.
+            atomic_ptr_t <void> state;
+
+            //  Number of references once the message is shared.
+            atomic_counter_t refcnt;
+
+            mmsg_buffer_t *buffer;
+            unsigned char *data;
+        };
+
+        //  Creates a buffer of slots of capacity_ bytes, one for each of
+        //  the hwm_ messages the pipes it feeds may hold. 0 stands for no
+        //  limit. The buffer is kept within mmsg_buffer_size.
+        mmsg_buffer_t (size_t capacity_, int hwm_);
+
+        //  Returns a slot or NULL if the next slot is still in use. Owner
+        //  only.
+        slot_t *allocate ();
+
+        //  Gives the slot back. May be called from any thread.
+        static void release (slot_t *slot_);
+
+        //  Called by the owner instead of deleting the buffer.
+        void orphan ();
+
+        size_t capacity () const;
+
+        //  Number of slots handed out, and of allocations that failed as the
+        //  next slot was in use. Owner only.
+        uint64_t msgs;
+        uint64_t misses;
+
+    private:
+
+        ~mmsg_buffer_t ();
+
+        slot_t *slot (size_t index_);
+
+        //  Each slot is a header followed by its data, starting on a cache
+        //  line of its own so that the producer and the consumer working on
+        //  neighbouring slots don't contend.
+        const size_t slot_capacity;
+        size_t slot_size;
+        size_t slot_count;
+        unsigned char *block;
+        unsigned char *slots;
+
+        //  Index of the slot to hand out next.
+        size_t next;
+
+        //  References held by the owner and by the slots in use at the
+        //  time the buffer was orphaned.
+        atomic_counter_t orphan_refs;
+
+        mmsg_buffer_t (const mmsg_buffer_t&);
+        const mmsg_buffer_t &operator = (const mmsg_buffer_t&);
+    };
+
+}
+
+#endif
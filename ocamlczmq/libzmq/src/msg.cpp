@@ -38,6 +38,7 @@
 #include "stdint.hpp"
 #include "likely.hpp"
 #include "metadata.hpp"
+#include "msg_pool.hpp"
 #include "err.hpp"
 
 //  Check whether the sizes of public representation of the message (zmq_msg_t)
@@ -106,7 +107,8 @@ int zmq::msg_t::init_size (size_t size_)
         u.lmsg.routing_id = 0;
         u.lmsg.content = NULL;
         if (sizeof (content_t) + size_ > size_)
-            u.lmsg.content = (content_t*) malloc (sizeof (content_t) + size_);
+            u.lmsg.content = (content_t*)
+                msg_pool_t::allocate (sizeof (content_t) + size_);
         if (unlikely (!u.lmsg.content)) {
             errno = ENOMEM;
             return -1;
@@ -167,7 +169,8 @@ int zmq::msg_t::init_data (void *data_, size_t size_,
         u.lmsg.type = type_lmsg;
         u.lmsg.flags = 0;
         u.lmsg.routing_id = 0;
-        u.lmsg.content = (content_t*) malloc (sizeof (content_t));
+        u.lmsg.content = (content_t*)
+            msg_pool_t::allocate (sizeof (content_t));
         if (!u.lmsg.content) {
             errno = ENOMEM;
             return -1;
@@ -192,6 +195,26 @@ int zmq::msg_t::init_delimiter ()
     return 0;
 }
 
+int zmq::msg_t::init_medium (size_t size_, mmsg_buffer_t *buffer_)
+{
+    zmq_assert (size_ > max_vsm_size && size_ <= buffer_->capacity ());
+
+    mmsg_buffer_t::slot_t *slot = buffer_->allocate ();
+    if (unlikely (!slot)) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    file_desc = -1;
+    u.mmsg.metadata = NULL;
+    u.mmsg.type = type_mmsg;
+    u.mmsg.flags = 0;
+    u.mmsg.routing_id = 0;
+    u.mmsg.slot = slot;
+    u.mmsg.size = size_;
+    return 0;
+}
+
 int zmq::msg_t::close ()
 {
     //  Check the validity of the message.
@@ -214,10 +237,18 @@ int zmq::msg_t::close ()
             if (u.lmsg.content->ffn)
                 u.lmsg.content->ffn (u.lmsg.content->data,
                     u.lmsg.content->hint);
-            free (u.lmsg.content);
+            msg_pool_t::deallocate (u.lmsg.content);
         }
     }
 
+    if (u.base.type == type_mmsg) {
+
+        //  The slot is given back when the last reference is dropped.
+        if (!(u.mmsg.flags & msg_t::shared) ||
+              !u.mmsg.slot->refcnt.sub (1))
+            mmsg_buffer_t::release (u.mmsg.slot);
+    }
+
     if (is_zcmsg())
     {
         zmq_assert( u.zclmsg.ffn );
@@ -294,6 +325,17 @@ int zmq::msg_t::copy (msg_t &src_)
         }
     }
 
+    if (src_.u.base.type == type_mmsg) {
+
+        //  Medium messages are reference-counted only once shared.
+        if (src_.u.mmsg.flags & msg_t::shared)
+            src_.u.mmsg.slot->refcnt.add (1);
+        else {
+            src_.u.mmsg.flags |= msg_t::shared;
+            src_.u.mmsg.slot->refcnt.set (2);
+        }
+    }
+
     if (src_.is_zcmsg()) {
 
         //  One reference is added to shared messages. Non-shared messages
@@ -328,6 +370,8 @@ void *zmq::msg_t::data ()
         return u.cmsg.data;
     case type_zclmsg:
         return u.zclmsg.data;
+    case type_mmsg:
+        return u.mmsg.slot->data;
     default:
         zmq_assert (false);
         return NULL;
@@ -348,6 +392,8 @@ size_t zmq::msg_t::size ()
         return u.zclmsg.size;
     case type_cmsg:
         return u.cmsg.size;
+    case type_mmsg:
+        return u.mmsg.size;
     default:
         zmq_assert (false);
         return 0;
@@ -432,6 +478,11 @@ bool zmq::msg_t::is_zcmsg() const
     return u.base.type == type_zclmsg;
 }
 
+bool zmq::msg_t::is_mmsg () const
+{
+    return u.base.type == type_mmsg;
+}
+
 void zmq::msg_t::add_refs (int refs_)
 {
     zmq_assert (refs_ >= 0);
@@ -444,8 +495,8 @@ void zmq::msg_t::add_refs (int refs_)
         return;
 
     //  VSMs, CMSGS and delimiters can be copied straight away. The only
-    //  message type that needs special care are long messages.
-    if (u.base.type == type_lmsg || is_zcmsg() ) {
+    //  message types that need special care are long and medium messages.
+    if (u.base.type == type_lmsg || is_zcmsg() || is_mmsg ()) {
         if (u.base.flags & msg_t::shared)
             refcnt()->add (refs_);
         else {
@@ -467,7 +518,8 @@ bool zmq::msg_t::rm_refs (int refs_)
         return true;
 
     //  If there's only one reference close the message.
-    if ( (u.base.type != type_zclmsg && u.base.type != type_lmsg) || !(u.base.flags & msg_t::shared)) {
+    if ( (u.base.type != type_zclmsg && u.base.type != type_lmsg
+          && u.base.type != type_mmsg) || !(u.base.flags & msg_t::shared)) {
         close ();
         return false;
     }
@@ -480,8 +532,13 @@ bool zmq::msg_t::rm_refs (int refs_)
 
         if (u.lmsg.content->ffn)
             u.lmsg.content->ffn (u.lmsg.content->data, u.lmsg.content->hint);
-        free (u.lmsg.content);
+        msg_pool_t::deallocate (u.lmsg.content);
+
+        return false;
+    }
 
+    if (is_mmsg () && !u.mmsg.slot->refcnt.sub (refs_)) {
+        mmsg_buffer_t::release (u.mmsg.slot);
         return false;
     }
 
@@ -520,6 +577,8 @@ zmq::atomic_counter_t *zmq::msg_t::refcnt()
             return &u.lmsg.content->refcnt;
         case type_zclmsg:
             return u.zclmsg.refcnt;
+        case type_mmsg:
+            return &u.mmsg.slot->refcnt;
         default:
             zmq_assert(false);
             return NULL;
@@ -36,6 +36,7 @@
 #include "config.hpp"
 #include "atomic_counter.hpp"
 #include "metadata.hpp"
+#include "mmsg_buffer.hpp"
 
 //  Signature for free function to deallocate the message content.
 //  Note that it has to be declared as "C" so that it is the same as
@@ -60,6 +61,8 @@ namespace zmq
         {
             more = 1,           //  Followed by more parts
             command = 2,        //  Command frame (see ZMTP spec)
+            priority = 4,       //  Overtakes queued ordinary messages
+            compressed = 8,     //  Body compressed on the wire
             credential = 32,
             identity = 64,
             shared = 128
@@ -78,6 +81,13 @@ namespace zmq
         int init_external_storage(void *data_, size_t size_, zmq::atomic_counter_t* ctr,
                                   msg_free_fn *ffn_, void *hint_);
         int init_delimiter ();
+
+        //  Initialises a message of size_ bytes whose content lives in a
+        //  slot of buffer_, avoiding the heap. Returns -1 with errno set to
+        //  EAGAIN if the buffer has no free slot at hand; the caller then
+        //  falls back to init_size. size_ must be larger than max_vsm_size
+        //  and must fit the slots of the buffer.
+        int init_medium (size_t size_, mmsg_buffer_t *buffer_);
         int close ();
         int move (msg_t &src_);
         int copy (msg_t &src_);
@@ -97,6 +107,7 @@ namespace zmq
         bool is_vsm () const;
         bool is_cmsg () const;
         bool is_zcmsg() const;
+        bool is_mmsg () const;
         uint32_t get_routing_id ();
         int set_routing_id (uint32_t routing_id_);
 
@@ -148,7 +159,11 @@ namespace zmq
             // zero-copy LMSG message for v2_decoder
             type_zclmsg = 105,
 
-            type_max = 105
+            //  MMSG messages store the content in a slot of a medium
+            //  message buffer
+            type_mmsg = 106,
+
+            type_max = 106
         };
 
         // the file descriptor where this message originated, needs to be 64bit due to alignment
@@ -214,6 +229,19 @@ namespace zmq
                 unsigned char flags;
                 uint32_t routing_id;
             } cmsg;
+            struct {
+                metadata_t *metadata;
+                mmsg_buffer_t::slot_t *slot;
+                size_t size;
+                unsigned char unused [msg_t_size - (8 + sizeof (metadata_t *)
+                                                      + sizeof (mmsg_buffer_t::slot_t *)
+                                                      + sizeof (size_t)
+                                                      + 2
+                                                      + sizeof(uint32_t))];
+                unsigned char type;
+                unsigned char flags;
+                uint32_t routing_id;
+            } mmsg;
             struct {
                 metadata_t *metadata;
                 unsigned char unused [msg_t_size - (8 + sizeof (metadata_t *) + 2 + sizeof(uint32_t))];
@@ -0,0 +1,324 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include "platform.hpp"
+#include "msg_pool.hpp"
+#include "atomic_counter.hpp"
+#include "mutex.hpp"
+#include "stdint.hpp"
+#include "likely.hpp"
+#include "err.hpp"
+
+#if !defined ZMQ_HAVE_WINDOWS
+#include <pthread.h>
+#endif
+
+namespace zmq
+{
+
+    struct msg_pool_cache_t;
+
+    //  Header preceding every block handed out by the pool. The union keeps
+    //  the payload aligned for any type the caller may store there.
+    union msg_pool_block_t
+    {
+        struct {
+            //  The thread cache the block belongs to, NULL if the block
+            //  was allocated by plain malloc.
+            msg_pool_cache_t *cache;
+            uint32_t size_class;
+        } h;
+        double align_double;
+        int64_t align_int;
+    };
+
+    //  Blocks of 64B up to 64kB (header included) are pooled.
+    enum {
+        min_block_shift = 6,
+        size_class_count = 11,
+        max_block_size = 1 << (min_block_shift + size_class_count - 1)
+    };
+
+    //  Upper bound on the memory kept in the free lists of each thread,
+    //  all size classes together.
+    enum { max_cached_bytes = 4 * 1024 * 1024 };
+
+    struct msg_pool_cache_t
+    {
+        msg_pool_cache_t () :
+            cached_bytes (0),
+            returned (NULL),
+            orphaned (false),
+            refs (1)
+        {
+            memset (free_list, 0, sizeof (free_list));
+        }
+
+        //  Blocks ready for reuse, touched by the owning thread only.
+        msg_pool_block_t *free_list [size_class_count];
+        size_t cached_bytes;
+
+        //  Blocks freed by other threads, waiting to be collected by the
+        //  owning thread. Once the owning thread has exited the cache is
+        //  orphaned and blocks are freed directly instead.
+        mutex_t sync;
+        msg_pool_block_t *returned;
+        bool orphaned;
+
+        //  One reference for the owning thread plus one per block that is
+        //  currently allocated. The last one to drop it deletes the cache.
+        atomic_counter_t refs;
+    };
+
+}
+
+static zmq::atomic_counter_t enable_count;
+
+//  The free blocks are chained through their first payload word.
+static inline zmq::msg_pool_block_t *&next_block (zmq::msg_pool_block_t *block_)
+{
+    return *(zmq::msg_pool_block_t**) (block_ + 1);
+}
+
+static inline size_t block_size (uint32_t size_class_)
+{
+    return (size_t) 1 << (zmq::min_block_shift + size_class_);
+}
+
+static inline uint32_t size_class (size_t size_)
+{
+    uint32_t size_class = 0;
+    while (block_size (size_class) < size_)
+        size_class++;
+    return size_class;
+}
+
+//  Put the block to the free list or, if the thread's cache is full, back
+//  to the system.
+static void cache_block (zmq::msg_pool_cache_t *cache_,
+    zmq::msg_pool_block_t *block_)
+{
+    uint32_t size_class = block_->h.size_class;
+    size_t size = block_size (size_class);
+    if (cache_->cached_bytes + size > (size_t) zmq::max_cached_bytes) {
+        free (block_);
+        return;
+    }
+    next_block (block_) = cache_->free_list [size_class];
+    cache_->free_list [size_class] = block_;
+    cache_->cached_bytes += size;
+}
+
+//  Move the blocks returned by other threads to the free lists.
+static void collect_returned (zmq::msg_pool_cache_t *cache_)
+{
+    cache_->sync.lock ();
+    zmq::msg_pool_block_t *block = cache_->returned;
+    cache_->returned = NULL;
+    cache_->sync.unlock ();
+
+    while (block) {
+        zmq::msg_pool_block_t *next = next_block (block);
+        cache_block (cache_, block);
+        block = next;
+    }
+}
+
+static void release_cache (zmq::msg_pool_cache_t *cache_)
+{
+    if (!cache_->refs.sub (1))
+        delete cache_;
+}
+
+#if !defined ZMQ_HAVE_WINDOWS
+
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+extern "C"
+{
+    //  Invoked when a thread that used the pool exits. The free blocks go
+    //  back to the system; the cache itself lives on until the blocks still
+    //  in use elsewhere are freed.
+    static void orphan_cache (void *arg_)
+    {
+        zmq::msg_pool_cache_t *cache = (zmq::msg_pool_cache_t*) arg_;
+
+        cache->sync.lock ();
+        cache->orphaned = true;
+        zmq::msg_pool_block_t *block = cache->returned;
+        cache->returned = NULL;
+        cache->sync.unlock ();
+
+        while (block) {
+            zmq::msg_pool_block_t *next = next_block (block);
+            free (block);
+            block = next;
+        }
+        for (int i = 0; i != zmq::size_class_count; i++) {
+            block = cache->free_list [i];
+            while (block) {
+                zmq::msg_pool_block_t *next = next_block (block);
+                free (block);
+                block = next;
+            }
+        }
+
+        release_cache (cache);
+    }
+
+    static void create_cache_key ()
+    {
+        int rc = pthread_key_create (&cache_key, orphan_cache);
+        posix_assert (rc);
+    }
+}
+
+static zmq::msg_pool_cache_t *get_cache (bool create_)
+{
+    int rc = pthread_once (&cache_key_once, create_cache_key);
+    posix_assert (rc);
+
+    zmq::msg_pool_cache_t *cache =
+        (zmq::msg_pool_cache_t*) pthread_getspecific (cache_key);
+    if (!cache && create_) {
+        cache = new (std::nothrow) zmq::msg_pool_cache_t;
+        if (!cache)
+            return NULL;
+        rc = pthread_setspecific (cache_key, cache);
+        posix_assert (rc);
+    }
+    return cache;
+}
+
+#else
+
+//  Thread exit notifications are not available, so the pool is disabled
+//  and every block is malloc'ed.
+static zmq::msg_pool_cache_t *get_cache (bool)
+{
+    return NULL;
+}
+
+#endif
+
+void zmq::msg_pool_t::enable ()
+{
+    enable_count.add (1);
+}
+
+void zmq::msg_pool_t::disable ()
+{
+    enable_count.sub (1);
+}
+
+bool zmq::msg_pool_t::enabled ()
+{
+    return enable_count.get () != 0;
+}
+
+void *zmq::msg_pool_t::allocate (size_t size_)
+{
+    size_t total = sizeof (msg_pool_block_t) + size_;
+    if (unlikely (total < size_))
+        return NULL;
+
+    msg_pool_cache_t *cache = NULL;
+    if (enabled () && total <= (size_t) max_block_size)
+        cache = get_cache (true);
+
+    msg_pool_block_t *block;
+    if (!cache) {
+        block = (msg_pool_block_t*) malloc (total);
+        if (unlikely (!block))
+            return NULL;
+        block->h.cache = NULL;
+        block->h.size_class = 0;
+        return block + 1;
+    }
+
+    uint32_t cls = size_class (total);
+    if (!cache->free_list [cls])
+        collect_returned (cache);
+
+    block = cache->free_list [cls];
+    if (block) {
+        cache->free_list [cls] = next_block (block);
+        cache->cached_bytes -= block_size (cls);
+    }
+    else {
+        block = (msg_pool_block_t*) malloc (block_size (cls));
+        if (unlikely (!block))
+            return NULL;
+        block->h.cache = cache;
+        block->h.size_class = cls;
+    }
+
+    cache->refs.add (1);
+    return block + 1;
+}
+
+void zmq::msg_pool_t::deallocate (void *ptr_)
+{
+    if (!ptr_)
+        return;
+
+    msg_pool_block_t *block = (msg_pool_block_t*) ptr_ - 1;
+    msg_pool_cache_t *cache = block->h.cache;
+    if (!cache) {
+        free (block);
+        return;
+    }
+
+    //  Freed by the owning thread. The owner's own reference keeps the
+    //  count above zero.
+    if (cache == get_cache (false)) {
+        cache_block (cache, block);
+        cache->refs.sub (1);
+        return;
+    }
+
+    //  Hand the block back to the owning thread, unless it's gone.
+    cache->sync.lock ();
+    bool orphaned = cache->orphaned;
+    if (!orphaned) {
+        next_block (block) = cache->returned;
+        cache->returned = block;
+    }
+    cache->sync.unlock ();
+
+    if (orphaned)
+        free (block);
+    release_cache (cache);
+}
@@ -0,0 +1,71 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_MSG_POOL_HPP_INCLUDED__
+#define __ZMQ_MSG_POOL_HPP_INCLUDED__
+
+#include <stddef.h>
+
+namespace zmq
+{
+
+    //  Size-classed allocator for message content blocks. Each thread keeps
+    //  its own free lists, so allocating and freeing on the same thread
+    //  never touches a lock. A block freed by another thread is handed back
+    //  to the owning thread through a per-thread return queue, which the
+    //  owner drains when its free list runs dry.
+    //
+    //  Every block carries a small header saying where it came from, so
+    //  deallocate works on any block returned by allocate, whether it was
+    //  pooled or not. While no context has enabled the pool (ZMQ_MSG_POOL)
+    //  or when the request is too large for any size class, allocate falls
+    //  back to plain malloc.
+
+    class msg_pool_t
+    {
+    public:
+
+        //  The pool is active while at least one context enabled it.
+        static void enable ();
+        static void disable ();
+        static bool enabled ();
+
+        //  Allocate a block of at least size_ bytes. Returns NULL if out
+        //  of memory.
+        static void *allocate (size_t size_);
+
+        //  Release a block obtained from allocate. May be called from any
+        //  thread.
+        static void deallocate (void *ptr_);
+    };
+
+}
+
+#endif
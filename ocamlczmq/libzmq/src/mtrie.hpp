@@ -34,6 +34,7 @@
 #include <set>
 
 #include "stdint.hpp"
+#include "radix_tree.hpp"
 
 namespace zmq
 {
@@ -41,6 +42,7 @@ namespace zmq
     class pipe_t;
 
     //  Multi-trie. Each node in the trie is a set of pointers to pipes.
+    //  The nodes are stored in a path-compressed radix tree.
 
     class mtrie_t
     {
@@ -71,26 +73,33 @@ namespace zmq
 
     private:
 
-        bool add_helper (unsigned char *prefix_, size_t size_,
-            zmq::pipe_t *pipe_);
-        void rm_helper (zmq::pipe_t *pipe_, unsigned char **buff_,
-            size_t buffsize_, size_t maxbuffsize_,
-            void (*func_) (unsigned char *data_, size_t size_, void *arg_),
-            void *arg_, bool call_on_uniq_);
-        bool rm_helper (unsigned char *prefix_, size_t size_,
-            zmq::pipe_t *pipe_);
-        bool is_redundant () const;
-
         typedef std::set <zmq::pipe_t*> pipes_t;
-        pipes_t *pipes;
-
-        unsigned char min;
-        unsigned short count;
-        unsigned short live_nodes;
-        union {
-            class mtrie_t *node;
-            class mtrie_t **table;
-        } next;
+
+        //  Carries the callback and its arguments through radix_tree_t's
+        //  match and apply.
+        struct match_ctx_t
+        {
+            void (*func) (zmq::pipe_t *pipe_, void *arg_);
+            void *arg;
+        };
+
+        struct rm_ctx_t
+        {
+            zmq::pipe_t *pipe;
+            void (*func) (unsigned char *data_, size_t size_, void *arg_);
+            void *arg;
+            bool call_on_uniq;
+        };
+
+        static void match_helper (pipes_t *&pipes_, void *arg_);
+        static void rm_helper (unsigned char *data_, size_t size_,
+            pipes_t *&pipes_, void *arg_);
+        static void free_helper (unsigned char *data_, size_t size_,
+            pipes_t *&pipes_, void *arg_);
+
+        //  Each node holds the set of pipes subscribed to the prefix ending
+        //  there, or NULL if there are none.
+        radix_tree_t <pipes_t*> tree;
 
         mtrie_t (const mtrie_t&);
         const mtrie_t &operator = (const mtrie_t&);
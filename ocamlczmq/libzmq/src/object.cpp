@@ -46,7 +46,7 @@ zmq::object_t::object_t (ctx_t *ctx_, uint32_t tid_) :
 
 zmq::object_t::object_t (object_t *parent_) :
     ctx (parent_->ctx),
-    tid (parent_->tid)
+    tid (parent_->tid.get ())
 {
 }
 
@@ -56,12 +56,12 @@ zmq::object_t::~object_t ()
 
 uint32_t zmq::object_t::get_tid ()
 {
-    return tid;
+    return tid.get ();
 }
 
 void zmq::object_t::set_tid(uint32_t id)
 {
-    tid = id;
+    tid.set (id);
 }
 
 zmq::ctx_t *zmq::object_t::get_ctx ()
@@ -78,7 +78,8 @@ void zmq::object_t::process_command (command_t &cmd_)
         break;
 
     case command_t::activate_write:
-        process_activate_write (cmd_.args.activate_write.msgs_read);
+        process_activate_write (cmd_.args.activate_write.msgs_read,
+            cmd_.args.activate_write.bytes_read);
         break;
 
     case command_t::stop:
@@ -106,7 +107,7 @@ void zmq::object_t::process_command (command_t &cmd_)
         break;
 
     case command_t::hiccup:
-        process_hiccup (cmd_.args.hiccup.pipe);
+        process_hiccup (cmd_.args.hiccup.pipe, cmd_.args.hiccup.prio);
         break;
 
     case command_t::pipe_term:
@@ -141,6 +142,10 @@ void zmq::object_t::process_command (command_t &cmd_)
         process_seqnum ();
         break;
 
+    case command_t::migrate:
+        process_migrate (cmd_.args.migrate.session, cmd_.args.migrate.engine);
+        break;
+
     case command_t::done:
     default:
         zmq_assert (false);
@@ -159,11 +164,6 @@ int zmq::object_t::unregister_endpoint (
     return ctx->unregister_endpoint (addr_, socket_);
 }
 
-void zmq::object_t::unregister_endpoints (socket_base_t *socket_)
-{
-    return ctx->unregister_endpoints (socket_);
-}
-
 zmq::endpoint_t zmq::object_t::find_endpoint (const char *addr_)
 {
     return ctx->find_endpoint (addr_);
@@ -197,7 +197,7 @@ void zmq::object_t::send_stop ()
     command_t cmd;
     cmd.destination = this;
     cmd.type = command_t::stop;
-    ctx->send_command (tid, cmd);
+    ctx->send_command (tid.get (), cmd);
 }
 
 void zmq::object_t::send_plug (own_t *destination_, bool inc_seqnum_)
@@ -256,21 +256,24 @@ void zmq::object_t::send_activate_read (pipe_t *destination_)
 }
 
 void zmq::object_t::send_activate_write (pipe_t *destination_,
-    uint64_t msgs_read_)
+    uint64_t msgs_read_, uint64_t bytes_read_)
 {
     command_t cmd;
     cmd.destination = destination_;
     cmd.type = command_t::activate_write;
     cmd.args.activate_write.msgs_read = msgs_read_;
+    cmd.args.activate_write.bytes_read = bytes_read_;
     send_command (cmd);
 }
 
-void zmq::object_t::send_hiccup (pipe_t *destination_, void *pipe_)
+void zmq::object_t::send_hiccup (pipe_t *destination_, void *pipe_,
+    void *prio_)
 {
     command_t cmd;
     cmd.destination = destination_;
     cmd.type = command_t::hiccup;
     cmd.args.hiccup.pipe = pipe_;
+    cmd.args.hiccup.prio = prio_;
     send_command (cmd);
 }
 
@@ -342,6 +345,17 @@ void zmq::object_t::send_inproc_connected (zmq::socket_base_t *socket_)
     send_command (cmd);
 }
 
+void zmq::object_t::send_migrate (io_thread_t *destination_,
+    session_base_t *session_, stream_engine_t *engine_)
+{
+    command_t cmd;
+    cmd.destination = destination_;
+    cmd.type = command_t::migrate;
+    cmd.args.migrate.session = session_;
+    cmd.args.migrate.engine = engine_;
+    send_command (cmd);
+}
+
 void zmq::object_t::send_done ()
 {
     command_t cmd;
@@ -380,12 +394,12 @@ void zmq::object_t::process_activate_read ()
     zmq_assert (false);
 }
 
-void zmq::object_t::process_activate_write (uint64_t)
+void zmq::object_t::process_activate_write (uint64_t, uint64_t)
 {
     zmq_assert (false);
 }
 
-void zmq::object_t::process_hiccup (void *)
+void zmq::object_t::process_hiccup (void *, void *)
 {
     zmq_assert (false);
 }
@@ -425,6 +439,11 @@ void zmq::object_t::process_reaped ()
     zmq_assert (false);
 }
 
+void zmq::object_t::process_migrate (session_base_t *, stream_engine_t *)
+{
+    zmq_assert (false);
+}
+
 void zmq::object_t::process_seqnum ()
 {
     zmq_assert (false);
@@ -32,6 +32,7 @@
 
 #include <string>
 #include "stdint.hpp"
+#include "atomic_counter.hpp"
 
 namespace zmq
 {
@@ -46,6 +47,7 @@ namespace zmq
     class session_base_t;
     class io_thread_t;
     class own_t;
+    class stream_engine_t;
 
     //  Base class for all objects that participate in inter-thread
     //  communication.
@@ -73,7 +75,6 @@ namespace zmq
                 const zmq::endpoint_t &endpoint_);
         int unregister_endpoint (
                 const std::string &addr_, socket_base_t *socket_);
-        void unregister_endpoints (zmq::socket_base_t *socket_);
         zmq::endpoint_t find_endpoint (const char *addr_);
         void pend_connection (const std::string &addr_,
                 const endpoint_t &endpoint, pipe_t **pipes_);
@@ -98,8 +99,9 @@ namespace zmq
              zmq::i_engine *engine_, bool inc_seqnum_ = true);
         void send_activate_read (zmq::pipe_t *destination_);
         void send_activate_write (zmq::pipe_t *destination_,
-             uint64_t msgs_read_);
-        void send_hiccup (zmq::pipe_t *destination_, void *pipe_);
+             uint64_t msgs_read_, uint64_t bytes_read_);
+        void send_hiccup (zmq::pipe_t *destination_, void *pipe_,
+            void *prio_);
         void send_pipe_term (zmq::pipe_t *destination_);
         void send_pipe_term_ack (zmq::pipe_t *destination_);
         void send_term_req (zmq::own_t *destination_,
@@ -108,6 +110,8 @@ namespace zmq
         void send_term_ack (zmq::own_t *destination_);
         void send_reap (zmq::socket_base_t *socket_);
         void send_reaped ();
+        void send_migrate (zmq::io_thread_t *destination_,
+            zmq::session_base_t *session_, zmq::stream_engine_t *engine_);
         void send_done ();
 
         //  These handlers can be overridden by the derived objects. They are
@@ -118,8 +122,9 @@ namespace zmq
         virtual void process_attach (zmq::i_engine *engine_);
         virtual void process_bind (zmq::pipe_t *pipe_);
         virtual void process_activate_read ();
-        virtual void process_activate_write (uint64_t msgs_read_);
-        virtual void process_hiccup (void *pipe_);
+        virtual void process_activate_write (uint64_t msgs_read_,
+            uint64_t bytes_read_);
+        virtual void process_hiccup (void *pipe_, void *prio_);
         virtual void process_pipe_term ();
         virtual void process_pipe_term_ack ();
         virtual void process_term_req (zmq::own_t *object_);
@@ -127,6 +132,8 @@ namespace zmq
         virtual void process_term_ack ();
         virtual void process_reap (zmq::socket_base_t *socket_);
         virtual void process_reaped ();
+        virtual void process_migrate (zmq::session_base_t *session_,
+            zmq::stream_engine_t *engine_);
 
         //  Special handler called after a command that requires a seqnum
         //  was processed. The implementation should catch up with its counter
@@ -138,8 +145,10 @@ namespace zmq
         //  Context provides access to the global state.
         zmq::ctx_t *ctx;
 
-        //  Thread ID of the thread the object belongs to.
-        uint32_t tid;
+        //  Thread ID of the thread the object belongs to. Engine migration
+        //  rewrites it on an I/O thread while other threads read it to
+        //  route commands, hence the atomic.
+        atomic_counter_t tid;
 
         void send_command (command_t &cmd_);
 
@@ -31,6 +31,7 @@
 
 #include "options.hpp"
 #include "err.hpp"
+#include "config.hpp"
 #include "../include/zmq_utils.h"
 
 zmq::options_t::options_t () :
@@ -77,7 +78,22 @@ zmq::options_t::options_t () :
     connected (false),
     heartbeat_ttl (0),
     heartbeat_interval (0),
-    heartbeat_timeout (-1)
+    heartbeat_timeout (-1),
+    busy_poll (0),
+    gather_threshold (0),
+    zerocopy_threshold (0),
+    sndhwm_bytes (0),
+    rcvhwm_bytes (0),
+    tcp_sharded_accept (false),
+    rcvpriority (false),
+    inbound_poll_rate (zmq::inbound_poll_rate),
+    max_command_delay (zmq::max_command_delay),
+    adaptive_batch (false),
+    coalesce_ivl (0),
+    coalesce_bytes (0),
+    compress_threshold (0),
+    curve_resume (0),
+    medium_msg_size (0)
 {
 #if defined ZMQ_HAVE_VMCI
     vmci_buffer_size = 0;
@@ -591,6 +607,111 @@ int zmq::options_t::setsockopt (int option_, const void *optval_,
             }
             break;
 
+        case ZMQ_BUSY_POLL:
+            if (is_int && value >= 0) {
+                busy_poll = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_GATHER_THRESHOLD:
+            if (is_int && value >= 0) {
+                gather_threshold = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_ZEROCOPY_THRESHOLD:
+            if (is_int && value >= 0) {
+                zerocopy_threshold = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_SNDHWM_BYTES:
+            if (optvallen_ == sizeof (int64_t) && *((int64_t *) optval_) >= 0) {
+                sndhwm_bytes = *((int64_t *) optval_);
+                return 0;
+            }
+            break;
+
+        case ZMQ_RCVHWM_BYTES:
+            if (optvallen_ == sizeof (int64_t) && *((int64_t *) optval_) >= 0) {
+                rcvhwm_bytes = *((int64_t *) optval_);
+                return 0;
+            }
+            break;
+
+        case ZMQ_TCP_SHARDED_ACCEPT:
+            if (is_int && (value == 0 || value == 1)) {
+                tcp_sharded_accept = (value != 0);
+                return 0;
+            }
+            break;
+
+        case ZMQ_RCVPRIORITY:
+            if (is_int && (value == 0 || value == 1)) {
+                rcvpriority = (value != 0);
+                return 0;
+            }
+            break;
+
+        case ZMQ_INBOUND_POLL_RATE:
+            if (is_int && value > 0) {
+                inbound_poll_rate = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_MAX_COMMAND_DELAY:
+            if (is_int && value >= 0) {
+                max_command_delay = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_ADAPTIVE_BATCH:
+            if (is_int && (value == 0 || value == 1)) {
+                adaptive_batch = (value != 0);
+                return 0;
+            }
+            break;
+
+        case ZMQ_COALESCE_IVL:
+            if (is_int && value >= 0) {
+                coalesce_ivl = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_COALESCE_BYTES:
+            if (is_int && value >= 0) {
+                coalesce_bytes = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_COMPRESS_THRESHOLD:
+            if (is_int && value >= 0) {
+                compress_threshold = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_CURVE_RESUME:
+            if (is_int && value >= 0) {
+                curve_resume = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_MEDIUM_MSG_SIZE:
+            if (is_int && value >= 0 && value <= mmsg_max_size) {
+                medium_msg_size = value;
+                return 0;
+            }
+            break;
+
 #       ifdef ZMQ_HAVE_VMCI
         case ZMQ_VMCI_BUFFER_SIZE:
             if (optvallen_ == sizeof (uint64_t)) {
@@ -1031,6 +1152,111 @@ int zmq::options_t::getsockopt (int option_, void *optval_, size_t *optvallen_)
             }
             break;
 
+        case ZMQ_BUSY_POLL:
+            if (is_int) {
+                *value = busy_poll;
+                return 0;
+            }
+            break;
+
+        case ZMQ_GATHER_THRESHOLD:
+            if (is_int) {
+                *value = gather_threshold;
+                return 0;
+            }
+            break;
+
+        case ZMQ_ZEROCOPY_THRESHOLD:
+            if (is_int) {
+                *value = zerocopy_threshold;
+                return 0;
+            }
+            break;
+
+        case ZMQ_SNDHWM_BYTES:
+            if (*optvallen_ == sizeof (int64_t)) {
+                *((int64_t *) optval_) = sndhwm_bytes;
+                return 0;
+            }
+            break;
+
+        case ZMQ_RCVHWM_BYTES:
+            if (*optvallen_ == sizeof (int64_t)) {
+                *((int64_t *) optval_) = rcvhwm_bytes;
+                return 0;
+            }
+            break;
+
+        case ZMQ_TCP_SHARDED_ACCEPT:
+            if (is_int) {
+                *value = tcp_sharded_accept;
+                return 0;
+            }
+            break;
+
+        case ZMQ_RCVPRIORITY:
+            if (is_int) {
+                *value = rcvpriority;
+                return 0;
+            }
+            break;
+
+        case ZMQ_INBOUND_POLL_RATE:
+            if (is_int) {
+                *value = inbound_poll_rate;
+                return 0;
+            }
+            break;
+
+        case ZMQ_MAX_COMMAND_DELAY:
+            if (is_int) {
+                *value = max_command_delay;
+                return 0;
+            }
+            break;
+
+        case ZMQ_ADAPTIVE_BATCH:
+            if (is_int) {
+                *value = adaptive_batch;
+                return 0;
+            }
+            break;
+
+        case ZMQ_COALESCE_IVL:
+            if (is_int) {
+                *value = coalesce_ivl;
+                return 0;
+            }
+            break;
+
+        case ZMQ_COALESCE_BYTES:
+            if (is_int) {
+                *value = coalesce_bytes;
+                return 0;
+            }
+            break;
+
+        case ZMQ_COMPRESS_THRESHOLD:
+            if (is_int) {
+                *value = compress_threshold;
+                return 0;
+            }
+            break;
+
+        case ZMQ_CURVE_RESUME:
+            if (is_int) {
+                *value = curve_resume;
+                return 0;
+            }
+            break;
+
+        case ZMQ_MEDIUM_MSG_SIZE:
+            if (is_int) {
+                *value = medium_msg_size;
+                return 0;
+            }
+            break;
+
         default:
 #if defined (ZMQ_ACT_MILITANT)
             malformed = false;
@@ -225,6 +225,62 @@ namespace zmq
         //  Time in milliseconds to wait for a PING response before disconnecting
         int heartbeat_timeout;
 
+        //  Upper bound in microseconds on busy-polling for the peer before
+        //  a blocking send or recv goes to sleep. 0 disables busy-polling.
+        int busy_poll;
+
+        //  Message bodies of at least this many bytes are written to stream
+        //  transports straight from the message buffer with vectored I/O
+        //  rather than being copied into the output batch. 0 disables it.
+        int gather_threshold;
+
+        //  Message bodies of at least this many bytes are sent over TCP
+        //  with MSG_ZEROCOPY where the system supports it. 0 disables it.
+        int zerocopy_threshold;
+
+        //  High-water marks for message pipes counted in bytes of message
+        //  data. 0 means no limit.
+        int64_t sndhwm_bytes;
+        int64_t rcvhwm_bytes;
+
+        //  If true, a TCP bind opens one SO_REUSEPORT listener per I/O
+        //  thread, each accepting connections into its own thread.
+        bool tcp_sharded_accept;
+
+        //  If true, fair-queuing sockets receive priority messages waiting
+        //  on any of their pipes before other messages.
+        bool rcvpriority;
+
+        //  Number of messages received in a row before checking for
+        //  commands, and the CPU ticks allowed to pass between checks for
+        //  commands when sending. See inbound_poll_rate and
+        //  max_command_delay in config.hpp.
+        int inbound_poll_rate;
+        int max_command_delay;
+
+        //  If true, stream engines grow their batches under sustained
+        //  traffic and shrink them again when it becomes sparse, and the
+        //  socket checks for commands less often while none arrive.
+        bool adaptive_batch;
+
+        //  Milliseconds a stream engine may hold back a batch smaller than
+        //  coalesce_bytes waiting for more messages, 0 to write at once.
+        //  A coalesce_bytes of 0 stands for the whole batch.
+        int coalesce_ivl;
+        int coalesce_bytes;
+
+        //  Frames of at least this many bytes are sent compressed to peers
+        //  that set it too, 0 never compressing them.
+        int compress_threshold;
+
+        //  Lifetime in milliseconds of the tickets CURVE sessions are
+        //  resumed with, 0 if sessions are not resumed.
+        int curve_resume;
+
+        //  Largest message carved from a medium message buffer rather than
+        //  allocated on the heap, 0 if there are no such buffers.
+        int medium_msg_size;
+
 #       if defined ZMQ_HAVE_VMCI
         uint64_t vmci_buffer_size;
         uint64_t vmci_buffer_min_size;
@@ -32,7 +32,9 @@
 
 #include "macros.hpp"
 #include "pipe.hpp"
+#include "ctx.hpp"
 #include "err.hpp"
+#include "trace.hpp"
 
 #include "ypipe.hpp"
 #include "ypipe_conflate.hpp"
@@ -60,11 +62,25 @@ int zmq::pipepair (class object_t *parents_ [2], class pipe_t* pipes_ [2],
         upipe2 = new (std::nothrow) upipe_normal_t ();
     alloc_assert (upipe2);
 
+    //  Conflating pipes keep only the last message, so there is nothing
+    //  for a priority message to overtake.
+    pipe_t::prio_lane_t *prio1 = NULL;
+    if (!conflate_ [0]) {
+        prio1 = new (std::nothrow) pipe_t::prio_lane_t ();
+        alloc_assert (prio1);
+    }
+
+    pipe_t::prio_lane_t *prio2 = NULL;
+    if (!conflate_ [1]) {
+        prio2 = new (std::nothrow) pipe_t::prio_lane_t ();
+        alloc_assert (prio2);
+    }
+
     pipes_ [0] = new (std::nothrow) pipe_t (parents_ [0], upipe1, upipe2,
-        hwms_ [1], hwms_ [0], conflate_ [0]);
+        prio1, prio2, hwms_ [1], hwms_ [0], conflate_ [0]);
     alloc_assert (pipes_ [0]);
     pipes_ [1] = new (std::nothrow) pipe_t (parents_ [1], upipe2, upipe1,
-        hwms_ [0], hwms_ [1], conflate_ [1]);
+        prio2, prio1, hwms_ [0], hwms_ [1], conflate_ [1]);
     alloc_assert (pipes_ [1]);
 
     pipes_ [0]->set_peer (pipes_ [1]);
@@ -74,10 +90,17 @@ int zmq::pipepair (class object_t *parents_ [2], class pipe_t* pipes_ [2],
 }
 
 zmq::pipe_t::pipe_t (object_t *parent_, upipe_t *inpipe_, upipe_t *outpipe_,
+      prio_lane_t *inprio_, prio_lane_t *outprio_,
       int inhwm_, int outhwm_, bool conflate_) :
     object_t (parent_),
     inpipe (inpipe_),
     outpipe (outpipe_),
+    inprio (inprio_),
+    outprio (outprio_),
+    in_more (false),
+    in_prio (false),
+    out_more (false),
+    out_prio (false),
     in_active (true),
     out_active (true),
     hwm (outhwm_),
@@ -87,12 +110,21 @@ zmq::pipe_t::pipe_t (object_t *parent_, upipe_t *inpipe_, upipe_t *outpipe_,
     msgs_read (0),
     msgs_written (0),
     peers_msgs_read (0),
+    byte_hwm (0),
+    byte_lwm (0),
+    bytes_read (0),
+    bytes_written (0),
+    peers_bytes_read (0),
+    bytes_acked (0),
+    budget (NULL),
     peer (NULL),
     sink (NULL),
     state (active),
     delay (true),
     conflate (conflate_)
 {
+    if (!conflate && get_ctx ()->get_memory_budget ())
+        budget = get_ctx ();
 }
 
 zmq::pipe_t::~pipe_t ()
@@ -145,9 +177,23 @@ bool zmq::pipe_t::check_read ()
     if (unlikely (state != active && state != waiting_for_delimiter))
         return false;
 
-    //  Check if there's an item in the pipe.
+    //  A priority message is read first.
+    if (prio_ready ())
+        return true;
+
+    //  Check if there's an item in the pipe. If there's none, the priority
+    //  lane is checked the same way, so that the writer wakes us up
+    //  whichever of the two it writes to next.
     if (!inpipe->check_read ()) {
+        if (inprio && !in_more && inprio->pipe.check_read ())
+            return true;
+
         in_active = false;
+
+        //  A writer held back by the memory budget waits for the pipe
+        //  to be drained.
+        if (budget && bytes_read != bytes_acked)
+            send_ack ();
         return false;
     }
 
@@ -172,11 +218,19 @@ bool zmq::pipe_t::read (msg_t *msg_)
         return false;
 
 read_message:
-    if (!inpipe->read (msg_)) {
+    if (!read_item (msg_)) {
         in_active = false;
+
+        //  A writer held back by the memory budget waits for the pipe
+        //  to be drained.
+        if (budget && bytes_read != bytes_acked)
+            send_ack ();
         return false;
     }
 
+    if (!msg_->is_delimiter ())
+        message_read (msg_);
+
     //  If this is a credential, save a copy and receive next message.
     if (unlikely (msg_->is_credential ())) {
         const unsigned char *data = static_cast <const unsigned char *> (msg_->data ());
@@ -195,12 +249,72 @@ read_message:
     if (!(msg_->flags () & msg_t::more) && !msg_->is_identity ())
         msgs_read++;
 
-    if (lwm > 0 && msgs_read % lwm == 0)
-        send_activate_write (peer, msgs_read);
+    if ((lwm > 0 && msgs_read % lwm == 0) ||
+          (byte_lwm > 0 && bytes_read - bytes_acked >= (uint64_t) byte_lwm))
+        send_ack ();
 
     return true;
 }
 
+bool zmq::pipe_t::check_priority ()
+{
+    if (unlikely (!in_active))
+        return false;
+    if (unlikely (state != active && state != waiting_for_delimiter))
+        return false;
+
+    return !in_more && prio_ready ();
+}
+
+bool zmq::pipe_t::prio_ready ()
+{
+    if (!inprio)
+        return false;
+
+    //  A message is read whole from the lane it started in.
+    if (in_more)
+        return in_prio;
+
+    //  The count read can run ahead of the count published, when the
+    //  lane was read after the main pipe ran dry.
+    return (int32_t) (inprio->flushed.get () - inprio->read) > 0;
+}
+
+bool zmq::pipe_t::read_item (msg_t *msg_)
+{
+    bool prio;
+    if (prio_ready () && inprio->pipe.read (msg_))
+        prio = true;
+    else
+    if (inpipe->read (msg_))
+        prio = false;
+    else
+    if (inprio && !in_more && inprio->pipe.read (msg_))
+        prio = true;
+    else
+        return false;
+
+    in_more = msg_->flags () & msg_t::more ? true : false;
+    in_prio = prio;
+    if (prio && !in_more)
+        inprio->read++;
+    return true;
+}
+
+void zmq::pipe_t::message_read (msg_t *msg_)
+{
+    const size_t size = msg_->size ();
+    bytes_read += size;
+    if (budget)
+        budget->release_memory ((uint32_t) (size >> 10));
+}
+
+void zmq::pipe_t::send_ack ()
+{
+    send_activate_write (peer, msgs_read, bytes_read);
+    bytes_acked = bytes_read;
+}
+
 bool zmq::pipe_t::check_write ()
 {
     if (unlikely (!out_active || state != active))
@@ -223,10 +337,32 @@ bool zmq::pipe_t::write (msg_t *msg_)
 
     bool more = msg_->flags () & msg_t::more ? true : false;
     const bool is_identity = msg_->is_identity ();
-    outpipe->write (*msg_, more);
+    const size_t size = msg_->size ();
+
+    //  The first part of a message decides the lane for all of it.
+    if (!out_more)
+        out_prio = outprio && (msg_->flags () & msg_t::priority);
+    out_more = more;
+
+    if (out_prio) {
+        outprio->pipe.write (*msg_, more);
+        if (!more)
+            outprio->written++;
+    }
+    else
+        outpipe->write (*msg_, more);
     if (!more && !is_identity)
         msgs_written++;
 
+    //  The memory budget is charged in whole kilobytes. Messages under
+    //  a kilobyte are left to the message-count HWMs.
+    bytes_written += size;
+    if (budget)
+        budget->charge_memory ((uint32_t) (size >> 10));
+
+    if (unlikely (trace_enabled) && !is_identity)
+        trace_record (ZMQ_TRACE_PIPE_WRITE, this, size);
+
     return true;
 }
 
@@ -235,12 +371,18 @@ void zmq::pipe_t::rollback ()
     //  Remove incomplete message from the outbound pipe.
     msg_t msg;
     if (outpipe) {
-        while (outpipe->unwrite (&msg)) {
+        upipe_t *lane = out_prio ? &outprio->pipe : outpipe;
+        while (lane->unwrite (&msg)) {
             zmq_assert (msg.flags () & msg_t::more);
+            const size_t size = msg.size ();
+            bytes_written -= size;
+            if (budget)
+                budget->release_memory ((uint32_t) (size >> 10));
             int rc = msg.close ();
             errno_assert (rc == 0);
         }
     }
+    out_more = false;
 }
 
 void zmq::pipe_t::flush ()
@@ -249,7 +391,22 @@ void zmq::pipe_t::flush ()
     if (state == term_ack_sent)
         return;
 
-    if (outpipe && !outpipe->flush ())
+    if (!outpipe)
+        return;
+
+    //  The priority lane is flushed first, so that the reader doesn't see
+    //  the delimiter before the priority messages written ahead of it.
+    bool asleep = false;
+    if (outprio) {
+        if (!outprio->pipe.flush ())
+            asleep = true;
+        if (outprio->flushed.get () != outprio->written)
+            outprio->flushed.set (outprio->written);
+    }
+    if (!outpipe->flush ())
+        asleep = true;
+
+    if (asleep)
         send_activate_read (peer);
 }
 
@@ -261,10 +418,12 @@ void zmq::pipe_t::process_activate_read ()
     }
 }
 
-void zmq::pipe_t::process_activate_write (uint64_t msgs_read_)
+void zmq::pipe_t::process_activate_write (uint64_t msgs_read_,
+    uint64_t bytes_read_)
 {
     //  Remember the peer's message sequence number.
     peers_msgs_read = msgs_read_;
+    peers_bytes_read = bytes_read_;
 
     if (!out_active && state == active) {
         out_active = true;
@@ -272,7 +431,7 @@ void zmq::pipe_t::process_activate_write (uint64_t msgs_read_)
     }
 }
 
-void zmq::pipe_t::process_hiccup (void *pipe_)
+void zmq::pipe_t::process_hiccup (void *pipe_, void *prio_)
 {
     //  Destroy old outpipe. Note that the read end of the pipe was already
     //  migrated to this thread.
@@ -282,14 +441,37 @@ void zmq::pipe_t::process_hiccup (void *pipe_)
     while (outpipe->read (&msg)) {
        if (!(msg.flags () & msg_t::more))
             msgs_written--;
+       const size_t size = msg.size ();
+       bytes_written -= size;
+       if (budget)
+           budget->release_memory ((uint32_t) (size >> 10));
        int rc = msg.close ();
        errno_assert (rc == 0);
     }
     LIBZMQ_DELETE(outpipe);
 
+    //  The same for the priority lane.
+    if (outprio) {
+        outprio->pipe.flush ();
+        while (outprio->pipe.read (&msg)) {
+           if (!(msg.flags () & msg_t::more))
+                msgs_written--;
+           const size_t size = msg.size ();
+           bytes_written -= size;
+           if (budget)
+               budget->release_memory ((uint32_t) (size >> 10));
+           int rc = msg.close ();
+           errno_assert (rc == 0);
+        }
+        LIBZMQ_DELETE(outprio);
+    }
+
     //  Plug in the new outpipe.
     zmq_assert (pipe_);
     outpipe = (upipe_t*) pipe_;
+    outprio = (prio_lane_t*) prio_;
+    out_more = false;
+    out_prio = false;
     out_active = true;
 
     //  If appropriate, notify the user about the hiccup.
@@ -314,6 +496,7 @@ void zmq::pipe_t::process_pipe_term ()
         else {
             state = term_ack_sent;
             outpipe = NULL;
+            outprio = NULL;
             send_pipe_term_ack (peer);
         }
     }
@@ -324,6 +507,7 @@ void zmq::pipe_t::process_pipe_term ()
     if (state == delimiter_received) {
         state = term_ack_sent;
         outpipe = NULL;
+        outprio = NULL;
         send_pipe_term_ack (peer);
     }
 
@@ -334,6 +518,7 @@ void zmq::pipe_t::process_pipe_term ()
     if (state == term_req_sent1) {
         state = term_req_sent2;
         outpipe = NULL;
+        outprio = NULL;
         send_pipe_term_ack (peer);
     }
 }
@@ -350,6 +535,7 @@ void zmq::pipe_t::process_pipe_term_ack ()
     //  All the other states are invalid.
     if (state == term_req_sent1) {
         outpipe = NULL;
+        outprio = NULL;
         send_pipe_term_ack (peer);
     }
     else
@@ -364,9 +550,17 @@ void zmq::pipe_t::process_pipe_term_ack ()
     if (!conflate) {
         msg_t msg;
         while (inpipe->read (&msg)) {
+            if (!msg.is_delimiter ())
+                message_read (&msg);
+            int rc = msg.close ();
+            errno_assert (rc == 0);
+        }
+        while (inprio->pipe.read (&msg)) {
+            message_read (&msg);
             int rc = msg.close ();
             errno_assert (rc == 0);
         }
+        LIBZMQ_DELETE(inprio);
     }
 
     LIBZMQ_DELETE(inpipe);
@@ -404,6 +598,7 @@ void zmq::pipe_t::terminate (bool delay_)
     //  'terminate'. We can act as if all the pending messages were read.
     else if (state == waiting_for_delimiter && !delay) {
         outpipe = NULL;
+        outprio = NULL;
         send_pipe_term_ack (peer);
         state = term_ack_sent;
     }
@@ -476,6 +671,7 @@ void zmq::pipe_t::process_delimiter ()
         state = delimiter_received;
     else {
         outpipe = NULL;
+        outprio = NULL;
         send_pipe_term_ack (peer);
         state = term_ack_sent;
     }
@@ -487,21 +683,27 @@ void zmq::pipe_t::hiccup ()
     if (state != active)
         return;
 
-    //  We'll drop the pointer to the inpipe. From now on, the peer is
-    //  responsible for deallocating it.
+    //  We'll drop the pointers to the inpipe and the priority lane. From
+    //  now on, the peer is responsible for deallocating them.
     inpipe = NULL;
+    inprio = NULL;
 
     //  Create new inpipe.
     if (conflate)
         inpipe = new (std::nothrow)ypipe_conflate_t <msg_t>();
-    else
+    else {
         inpipe = new (std::nothrow)ypipe_t <msg_t, message_pipe_granularity>();
+        inprio = new (std::nothrow) prio_lane_t ();
+        alloc_assert (inprio);
+    }
 
     alloc_assert (inpipe);
     in_active = true;
+    in_more = false;
+    in_prio = false;
 
     //  Notify the peer about the hiccup.
-    send_hiccup (peer, (void*) inpipe);
+    send_hiccup (peer, (void*) inpipe, (void*) inprio);
 }
 
 void zmq::pipe_t::set_hwms (int inhwm_, int outhwm_)
@@ -526,8 +728,43 @@ void zmq::pipe_t::set_hwms_boost(int inhwmboost_, int outhwmboost_)
     outhwmboost = outhwmboost_;
 }
 
+void zmq::pipe_t::set_byte_hwms (int64_t inhwm_, int64_t outhwm_)
+{
+    byte_lwm = (inhwm_ + 1) / 2;
+    byte_hwm = outhwm_;
+}
+
 bool zmq::pipe_t::check_hwm () const
 {
     bool full = hwm > 0 && msgs_written - peers_msgs_read >= uint64_t (hwm);
+
+    //  A message is accepted as long as the bytes queued are under the
+    //  limit, so the limit is exceeded by at most one message.
+    if (byte_hwm > 0 &&
+          bytes_written - peers_bytes_read >= uint64_t (byte_hwm))
+        full = true;
+
+    //  Over the context's memory budget, pipes that have data in flight
+    //  stop accepting more. A pipe's reader acknowledges the data once it
+    //  has drained the pipe, so each pipe can always move at least one
+    //  message.
+    if (budget && bytes_written != peers_bytes_read &&
+          budget->over_memory_budget ())
+        full = true;
+
     return( !full );
 }
+
+uint64_t zmq::pipe_t::get_queued_in () const
+{
+    //  Once termination has started the peer may go away any time.
+    if (state != active || !peer)
+        return 0;
+    const uint64_t written = peer->msgs_written;
+    return written > msgs_read ? written - msgs_read : 0;
+}
+
+uint64_t zmq::pipe_t::get_queued_out () const
+{
+    return msgs_written - peers_msgs_read;
+}
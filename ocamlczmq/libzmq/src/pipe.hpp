@@ -32,6 +32,8 @@
 
 #include "msg.hpp"
 #include "ypipe_base.hpp"
+#include "ypipe.hpp"
+#include "atomic_counter.hpp"
 #include "config.hpp"
 #include "object.hpp"
 #include "stdint.hpp"
@@ -42,6 +44,7 @@ namespace zmq
 {
 
     class object_t;
+    class ctx_t;
     class pipe_t;
 
     //  Create a pipepair for bi-directional transfer of messages.
@@ -97,6 +100,10 @@ namespace zmq
         //  Returns true if there is at least one message to read in the pipe.
         bool check_read ();
 
+        //  Returns true if the next message to read is a priority message.
+        //  It is cheap enough to be asked of every pipe of a socket.
+        bool check_priority ();
+
         //  Reads a message to the underlying pipe.
         bool read (msg_t *msg_);
 
@@ -136,17 +143,50 @@ namespace zmq
         //  Set the boost to high water marks, used by inproc sockets so total hwm are sum of connect and bind sockets watermarks
         void set_hwms_boost(int inhwmboost_, int outhwmboost_);
 
+        //  Set the high water marks counted in bytes. 0 means no limit.
+        void set_byte_hwms (int64_t inhwm_, int64_t outhwm_);
+
         //  Returns true if HWM is not reached
         bool check_hwm () const;
+
+        //  Returns the number of messages written by the peer but not read
+        //  yet. The peer's counter is read without synchronisation, so the
+        //  result is approximate.
+        uint64_t get_queued_in () const;
+
+        //  Returns the number of messages written but not yet known to be
+        //  read by the peer.
+        uint64_t get_queued_out () const;
     private:
 
         //  Type of the underlying lock-free pipe.
         typedef ypipe_base_t <msg_t> upipe_t;
 
+        //  Messages flagged as priority travel in a lane of their own next
+        //  to the main pipe, so that they overtake the messages queued
+        //  there. The writer publishes the number of messages it has
+        //  flushed to the lane; comparing it with the number read tells
+        //  the reader whether to look at the lane without touching the
+        //  lane's shared pointer. The counts are of whole messages.
+        struct prio_lane_t
+        {
+            inline prio_lane_t () :
+                written (0),
+                read (0)
+            {
+            }
+
+            ypipe_t <msg_t, priority_pipe_granularity> pipe;
+            uint32_t written;
+            atomic_counter_t flushed;
+            uint32_t read;
+        };
+
         //  Command handlers.
         void process_activate_read ();
-        void process_activate_write (uint64_t msgs_read_);
-        void process_hiccup (void *pipe_);
+        void process_activate_write (uint64_t msgs_read_,
+            uint64_t bytes_read_);
+        void process_hiccup (void *pipe_, void *prio_);
         void process_pipe_term ();
         void process_pipe_term_ack ();
 
@@ -156,6 +196,7 @@ namespace zmq
         //  Constructor is private. Pipe can only be created using
         //  pipepair function.
         pipe_t (object_t *parent_, upipe_t *inpipe_, upipe_t *outpipe_,
+            prio_lane_t *inprio_, prio_lane_t *outprio_,
             int inhwm_, int outhwm_, bool conflate_);
 
         //  Pipepair uses this function to let us know about
@@ -169,6 +210,26 @@ namespace zmq
         upipe_t *inpipe;
         upipe_t *outpipe;
 
+        //  Priority lanes for both directions. NULL if the pipe conflates.
+        prio_lane_t *inprio;
+        prio_lane_t *outprio;
+
+        //  Whether a message is partly read, and whether the message
+        //  being read comes from the priority lane.
+        bool in_more;
+        bool in_prio;
+
+        //  The same for the message being written.
+        bool out_more;
+        bool out_prio;
+
+        //  Returns true if the next item is to be read from the priority
+        //  lane.
+        bool prio_ready ();
+
+        //  Reads the next item from whichever lane it is due from.
+        bool read_item (msg_t *msg_);
+
         //  Can the pipe be read from / written to?
         bool in_active;
         bool out_active;
@@ -191,6 +252,28 @@ namespace zmq
         //  can be higher at the moment.
         uint64_t peers_msgs_read;
 
+        //  High watermark for the outbound pipe and low watermark for the
+        //  inbound pipe in bytes of message data, 0 if there's none.
+        int64_t byte_hwm;
+        int64_t byte_lwm;
+
+        //  Bytes of message data read and written so far, the peer's
+        //  bytes_read as last received and our own as last sent to it.
+        uint64_t bytes_read;
+        uint64_t bytes_written;
+        uint64_t peers_bytes_read;
+        uint64_t bytes_acked;
+
+        //  Context whose ZMQ_MEMORY_BUDGET the pipe is charged to. NULL
+        //  if the context has no budget or if the pipe conflates.
+        ctx_t *budget;
+
+        //  Accounts for a message taken off the inbound pipe.
+        void message_read (msg_t *msg_);
+
+        //  Tells the writer how far we have read.
+        void send_ack ();
+
         //  The pipe object on the other side of the pipepair.
         pipe_t *peer;
 
@@ -252,6 +252,14 @@ int zmq::plain_server_t::produce_ready (msg_t *msg_) const
     const char *socket_type = socket_type_string (options.type);
     ptr += add_property (ptr, "Socket-Type", socket_type, strlen (socket_type));
 
+    //  Add priority flag support property
+    if (options.rcvpriority)
+        ptr += add_property (ptr, "Priority-Lanes", "1", 1);
+
+    //  Add compression support property
+    if (options.compress_threshold)
+        ptr += add_property (ptr, "Compression", "LZ", 2);
+
     //  Add identity property
     if (options.type == ZMQ_REQ
     ||  options.type == ZMQ_DEALER
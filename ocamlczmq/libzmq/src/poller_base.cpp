@@ -46,6 +46,11 @@ int zmq::poller_base_t::get_load ()
     return load.get ();
 }
 
+void zmq::poller_base_t::set_affinity (const std::set <int> &cpus_)
+{
+    affinity = cpus_;
+}
+
 void zmq::poller_base_t::adjust_load (int amount_)
 {
     if (amount_ > 0)
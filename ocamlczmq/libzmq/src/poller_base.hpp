@@ -31,6 +31,7 @@
 #define __ZMQ_POLLER_BASE_HPP_INCLUDED__
 
 #include <map>
+#include <set>
 
 #include "clock.hpp"
 #include "atomic_counter.hpp"
@@ -59,8 +60,16 @@ namespace zmq
         //  Cancel the timer created by sink_ object with ID equal to id_.
         void cancel_timer (zmq::i_poll_events *sink_, int id_);
 
+        //  Sets the CPUs the poller's thread is to run on, see
+        //  ZMQ_IO_THREAD_AFFINITY. Must be called before the poller is
+        //  started.
+        void set_affinity (const std::set <int> &cpus_);
+
     protected:
 
+        //  CPUs the poller's thread runs on. Empty if any.
+        std::set <int> affinity;
+
         //  Called by individual poller implementations to manage the load.
         void adjust_load (int amount_);
 
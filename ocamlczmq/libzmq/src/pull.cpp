@@ -48,6 +48,7 @@ void zmq::pull_t::xattach_pipe (pipe_t *pipe_, bool subscribe_to_all_)
     LIBZMQ_UNUSED (subscribe_to_all_);
 
     zmq_assert (pipe_);
+    fq.set_priority (options.rcvpriority);
     fq.attach (pipe_);
 }
 
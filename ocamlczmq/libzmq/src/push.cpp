@@ -74,3 +74,8 @@ bool zmq::push_t::xhas_out ()
 {
     return lb.has_out ();
 }
+
+uint64_t zmq::push_t::xdrops ()
+{
+    return lb.get_drops ();
+}
@@ -0,0 +1,394 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_RADIX_TREE_HPP_INCLUDED__
+#define __ZMQ_RADIX_TREE_HPP_INCLUDED__
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "err.hpp"
+#include "stdint.hpp"
+
+namespace zmq
+{
+
+    //  Path-compressed radix tree keyed by byte strings. It is the storage
+    //  behind trie_t and mtrie_t. A chain of single-child nodes collapses
+    //  into a single edge, so matching a message against the subscriptions
+    //  costs one memchr over the child index plus one memcmp per edge rather
+    //  than one table lookup per byte of the topic.
+    //
+    //  T is the value held by each node. It must be a plain type whose
+    //  value-initialised form (0 or NULL) means "no subscription here".
+    //  Nodes holding such a value are dropped or merged with their only
+    //  child by prune and compact. The tree never destroys the values, the
+    //  owner must release them (e.g. using apply) before the tree goes away.
+
+    template <typename T> class radix_tree_t
+    {
+    public:
+
+        inline radix_tree_t ()
+        {
+            root = make_node (NULL, 0);
+        }
+
+        inline ~radix_tree_t ()
+        {
+            destroy (root);
+        }
+
+        //  Return the value slot for the key, creating the path if needed.
+        T *insert (const unsigned char *key_, size_t size_)
+        {
+            node_t *node = root;
+            while (true) {
+                if (!size_)
+                    return &node->value;
+
+                int idx = edge_index (node, *key_);
+                if (idx < 0) {
+                    node_t *leaf = make_node (key_, size_);
+                    add_edge (node, leaf);
+                    return &leaf->value;
+                }
+
+                //  Find the length of the common prefix. The first byte is
+                //  known to match.
+                node_t *child = node->children [idx];
+                size_t limit = child->key_size < size_ ?
+                    child->key_size : size_;
+                size_t common = 1;
+                while (common < limit && child->key () [common] ==
+                      key_ [common])
+                    common++;
+
+                //  The key diverges in the middle of the edge. Split it.
+                if (common < child->key_size) {
+                    node_t *mid = make_node (key_, common);
+                    child->key_size -= (uint32_t) common;
+                    memmove (child->key (), child->key () + common,
+                        child->key_size);
+                    add_edge (mid, child);
+                    node->children [idx] = mid;
+                    child = mid;
+                }
+
+                node = child;
+                key_ += common;
+                size_ -= common;
+            }
+        }
+
+        //  Return the value slot for the key, or NULL if the key is not
+        //  a node in the tree.
+        T *find (const unsigned char *key_, size_t size_)
+        {
+            node_t *node = root;
+            while (size_) {
+                node_t *child = next (node, key_, size_);
+                if (!child)
+                    return NULL;
+                key_ += child->key_size;
+                size_ -= child->key_size;
+                node = child;
+            }
+            return &node->value;
+        }
+
+        //  Invoke the function for each non-empty value whose key is
+        //  a prefix of the data supplied.
+        void match (const unsigned char *data_, size_t size_,
+            void (*func_) (T &value_, void *arg_), void *arg_)
+        {
+            //  This function is on critical path. It deliberately doesn't
+            //  use recursion to get a bit better performance.
+            node_t *node = root;
+            while (true) {
+                if (!is_empty (node->value))
+                    func_ (node->value, arg_);
+                node_t *child = next (node, data_, size_);
+                if (!child)
+                    break;
+                data_ += child->key_size;
+                size_ -= child->key_size;
+                node = child;
+            }
+        }
+
+        //  Check whether any key with a non-empty value is a prefix
+        //  of the data supplied.
+        bool check (const unsigned char *data_, size_t size_)
+        {
+            node_t *node = root;
+            while (true) {
+                if (!is_empty (node->value))
+                    return true;
+                node_t *child = next (node, data_, size_);
+                if (!child)
+                    return false;
+                data_ += child->key_size;
+                size_ -= child->key_size;
+                node = child;
+            }
+        }
+
+        //  Invoke the function for each non-empty value along with its
+        //  key. The function may clear the value; call compact afterwards
+        //  to drop the nodes that became redundant.
+        void apply (void (*func_) (unsigned char *data_, size_t size_,
+            T &value_, void *arg_), void *arg_)
+        {
+            unsigned char *buff = NULL;
+            size_t maxbuffsize = 0;
+            apply_helper (root, &buff, 0, &maxbuffsize, func_, arg_);
+            free (buff);
+        }
+
+        //  Drop the nodes on the path of the key that no longer hold
+        //  a value. Call after clearing the value of the key.
+        void prune (const unsigned char *key_, size_t size_)
+        {
+            prune_helper (root, key_, size_);
+        }
+
+        //  Drop all the nodes in the tree that no longer hold a value.
+        void compact ()
+        {
+            compact_helper (root);
+        }
+
+    private:
+
+        struct node_t
+        {
+            T value;
+            uint32_t key_size;
+            uint32_t edge_count;
+
+            //  First byte of each child's key, kept sorted. It is scanned
+            //  with memchr to pick the edge to follow.
+            unsigned char *first_bytes;
+            node_t **children;
+
+            //  The key of the edge leading to the node is stored right
+            //  after the node in the same allocation.
+            inline unsigned char *key ()
+            {
+                return (unsigned char*) (this + 1);
+            }
+        };
+
+        static inline bool is_empty (const T &value_)
+        {
+            return value_ == T ();
+        }
+
+        //  Allocate a node with room for a key of size_ bytes. The key is
+        //  copied in if supplied.
+        static node_t *make_node (const unsigned char *key_, size_t size_)
+        {
+            node_t *node = (node_t*) malloc (sizeof (node_t) + size_);
+            alloc_assert (node);
+            node->value = T ();
+            node->key_size = (uint32_t) size_;
+            node->edge_count = 0;
+            node->first_bytes = NULL;
+            node->children = NULL;
+            if (key_ && size_)
+                memcpy (node->key (), key_, size_);
+            return node;
+        }
+
+        static void free_node (node_t *node_)
+        {
+            free (node_->first_bytes);
+            free (node_->children);
+            free (node_);
+        }
+
+        static void destroy (node_t *node_)
+        {
+            for (uint32_t i = 0; i != node_->edge_count; i++)
+                destroy (node_->children [i]);
+            free_node (node_);
+        }
+
+        static inline int edge_index (node_t *node_, unsigned char c_)
+        {
+            if (!node_->edge_count)
+                return -1;
+            const unsigned char *pos = (const unsigned char*)
+                memchr (node_->first_bytes, c_, node_->edge_count);
+            return pos ? (int) (pos - node_->first_bytes) : -1;
+        }
+
+        //  Return the child of the node whose key is a prefix of the data,
+        //  or NULL if there's no such child.
+        static inline node_t *next (node_t *node_, const unsigned char *data_,
+            size_t size_)
+        {
+            if (!size_)
+                return NULL;
+            int idx = edge_index (node_, *data_);
+            if (idx < 0)
+                return NULL;
+            node_t *child = node_->children [idx];
+            if (child->key_size > size_ ||
+                  memcmp (child->key (), data_, child->key_size) != 0)
+                return NULL;
+            return child;
+        }
+
+        static void add_edge (node_t *node_, node_t *child_)
+        {
+            unsigned char c = child_->key () [0];
+            uint32_t pos = 0;
+            while (pos != node_->edge_count && node_->first_bytes [pos] < c)
+                pos++;
+
+            node_->first_bytes = (unsigned char*) realloc (node_->first_bytes,
+                node_->edge_count + 1);
+            alloc_assert (node_->first_bytes);
+            node_->children = (node_t**) realloc (node_->children,
+                sizeof (node_t*) * (node_->edge_count + 1));
+            alloc_assert (node_->children);
+
+            memmove (node_->first_bytes + pos + 1, node_->first_bytes + pos,
+                node_->edge_count - pos);
+            memmove (node_->children + pos + 1, node_->children + pos,
+                sizeof (node_t*) * (node_->edge_count - pos));
+            node_->first_bytes [pos] = c;
+            node_->children [pos] = child_;
+            node_->edge_count++;
+        }
+
+        static void remove_edge (node_t *node_, uint32_t idx_)
+        {
+            zmq_assert (idx_ < node_->edge_count);
+            node_->edge_count--;
+            if (!node_->edge_count) {
+                free (node_->first_bytes);
+                free (node_->children);
+                node_->first_bytes = NULL;
+                node_->children = NULL;
+                return;
+            }
+            memmove (node_->first_bytes + idx_, node_->first_bytes + idx_ + 1,
+                node_->edge_count - idx_);
+            memmove (node_->children + idx_, node_->children + idx_ + 1,
+                sizeof (node_t*) * (node_->edge_count - idx_));
+        }
+
+        //  If the idx_-th child of the node holds no value, either remove
+        //  it (if it's a leaf) or merge it with its only child.
+        static void tidy (node_t *node_, uint32_t idx_)
+        {
+            node_t *child = node_->children [idx_];
+            if (!is_empty (child->value))
+                return;
+
+            if (child->edge_count == 0) {
+                remove_edge (node_, idx_);
+                free_node (child);
+            }
+            else
+            if (child->edge_count == 1) {
+                node_t *grandchild = child->children [0];
+                node_t *merged = make_node (NULL,
+                    child->key_size + grandchild->key_size);
+                memcpy (merged->key (), child->key (), child->key_size);
+                memcpy (merged->key () + child->key_size, grandchild->key (),
+                    grandchild->key_size);
+                merged->value = grandchild->value;
+                merged->edge_count = grandchild->edge_count;
+                merged->first_bytes = grandchild->first_bytes;
+                merged->children = grandchild->children;
+                free_node (child);
+                free (grandchild);
+                node_->children [idx_] = merged;
+            }
+        }
+
+        static void prune_helper (node_t *node_, const unsigned char *key_,
+            size_t size_)
+        {
+            node_t *child = next (node_, key_, size_);
+            if (!child)
+                return;
+            prune_helper (child, key_ + child->key_size,
+                size_ - child->key_size);
+            tidy (node_, (uint32_t) edge_index (node_, *key_));
+        }
+
+        static void compact_helper (node_t *node_)
+        {
+            //  Walk backwards so that removing an edge doesn't shift
+            //  the edges still to be visited.
+            for (uint32_t i = node_->edge_count; i != 0; i--) {
+                compact_helper (node_->children [i - 1]);
+                tidy (node_, i - 1);
+            }
+        }
+
+        static void apply_helper (node_t *node_, unsigned char **buff_,
+            size_t buffsize_, size_t *maxbuffsize_,
+            void (*func_) (unsigned char *data_, size_t size_, T &value_,
+            void *arg_), void *arg_)
+        {
+            if (node_->key_size) {
+                if (buffsize_ + node_->key_size > *maxbuffsize_) {
+                    *maxbuffsize_ = buffsize_ + node_->key_size + 256;
+                    *buff_ = (unsigned char*) realloc (*buff_, *maxbuffsize_);
+                    alloc_assert (*buff_);
+                }
+                memcpy (*buff_ + buffsize_, node_->key (), node_->key_size);
+                buffsize_ += node_->key_size;
+            }
+
+            if (!is_empty (node_->value))
+                func_ (*buff_, buffsize_, node_->value, arg_);
+
+            for (uint32_t i = 0; i != node_->edge_count; i++)
+                apply_helper (node_->children [i], buff_, buffsize_,
+                    maxbuffsize_, func_, arg_);
+        }
+
+        node_t *root;
+
+        radix_tree_t (const radix_tree_t&);
+        const radix_tree_t &operator = (const radix_tree_t&);
+    };
+
+}
+
+#endif
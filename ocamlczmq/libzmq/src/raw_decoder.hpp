@@ -59,6 +59,11 @@ namespace zmq
 
         virtual void resize_buffer(size_t) {}
 
+        virtual void set_batch_size (size_t size_)
+        {
+            allocator.set_max_size (size_);
+        }
+
     private:
         msg_t in_progress;
 
@@ -262,17 +262,20 @@ zmq::req_session_t::~req_session_t ()
 
 int zmq::req_session_t::push_msg (msg_t *msg_)
 {
+    //  Replies may be sent as priority messages.
+    const unsigned char flags = msg_->flags () & ~msg_t::priority;
+
     switch (state) {
     case bottom:
-        if (msg_->flags () == msg_t::more && msg_->size () == 0) {
+        if (flags == msg_t::more && msg_->size () == 0) {
             state = body;
             return session_base_t::push_msg (msg_);
         }
         break;
     case body:
-        if (msg_->flags () == msg_t::more)
+        if (flags == msg_t::more)
             return session_base_t::push_msg (msg_);
-        if (msg_->flags () == 0) {
+        if (flags == 0) {
             state = bottom;
             return session_base_t::push_msg (msg_);
         }
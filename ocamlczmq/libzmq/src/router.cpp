@@ -86,6 +86,8 @@ void zmq::router_t::xattach_pipe (pipe_t *pipe_, bool subscribe_to_all_)
         errno_assert (rc == 0);
     }
 
+    fq.set_priority (options.rcvpriority);
+
     bool identity_ok = identify_peer (pipe_);
     if (identity_ok)
         fq.attach (pipe_);
@@ -153,9 +155,8 @@ void zmq::router_t::xpipe_terminated (pipe_t *pipe_)
     if (it != anonymous_pipes.end ())
         anonymous_pipes.erase (it);
     else {
-        outpipes_t::iterator it = outpipes.find (pipe_->get_identity ());
-        zmq_assert (it != outpipes.end ());
-        outpipes.erase (it);
+        const bool ok = outpipes.erase (pipe_->get_identity ());
+        zmq_assert (ok);
         fq.pipe_terminated (pipe_);
         if (pipe_ == current_out)
             current_out = NULL;
@@ -178,14 +179,10 @@ void zmq::router_t::xread_activated (pipe_t *pipe_)
 
 void zmq::router_t::xwrite_activated (pipe_t *pipe_)
 {
-    outpipes_t::iterator it;
-    for (it = outpipes.begin (); it != outpipes.end (); ++it)
-        if (it->second.pipe == pipe_)
-            break;
-
-    zmq_assert (it != outpipes.end ());
-    zmq_assert (!it->second.active);
-    it->second.active = true;
+    outpipe_t *outpipe = outpipes.find (pipe_->get_identity ());
+    zmq_assert (outpipe && outpipe->pipe == pipe_);
+    zmq_assert (!outpipe->active);
+    outpipe->active = true;
 }
 
 int zmq::router_t::xsend (msg_t *msg_)
@@ -205,13 +202,13 @@ int zmq::router_t::xsend (msg_t *msg_)
             //  Find the pipe associated with the identity stored in the prefix.
             //  If there's no such pipe just silently ignore the message, unless
             //  router_mandatory is set.
-            blob_t identity ((unsigned char*) msg_->data (), msg_->size ());
-            outpipes_t::iterator it = outpipes.find (identity);
+            outpipe_t *outpipe = outpipes.find (
+                (unsigned char*) msg_->data (), msg_->size ());
 
-            if (it != outpipes.end ()) {
-                current_out = it->second.pipe;
+            if (outpipe) {
+                current_out = outpipe->pipe;
                 if (!current_out->check_write ()) {
-                    it->second.active = false;
+                    outpipe->active = false;
                     current_out = NULL;
                     if (mandatory) {
                         more_out = false;
@@ -430,8 +427,7 @@ bool zmq::router_t::identify_peer (pipe_t *pipe_)
         identity = blob_t ((unsigned char*) connect_rid.c_str (),
             connect_rid.length());
         connect_rid.clear ();
-        outpipes_t::iterator it = outpipes.find (identity);
-        if (it != outpipes.end ())
+        if (outpipes.find (identity))
             zmq_assert(false); //  Not allowed to duplicate an existing rid
     }
     else
@@ -459,10 +455,10 @@ bool zmq::router_t::identify_peer (pipe_t *pipe_)
         }
         else {
             identity = blob_t ((unsigned char*) msg.data (), msg.size ());
-            outpipes_t::iterator it = outpipes.find (identity);
+            outpipe_t *existing = outpipes.find (identity);
             msg.close ();
 
-            if (it != outpipes.end ()) {
+            if (existing) {
                 if (!handover)
                     //  Ignore peers with duplicate ID
                     return false;
@@ -475,17 +471,16 @@ bool zmq::router_t::identify_peer (pipe_t *pipe_)
                     put_uint32 (buf + 1, next_rid++);
                     blob_t new_identity = blob_t (buf, sizeof buf);
 
-                    it->second.pipe->set_identity (new_identity);
-                    outpipe_t existing_outpipe =
-                        {it->second.pipe, it->second.active};
-
-                    ok = outpipes.insert (outpipes_t::value_type (
-                        new_identity, existing_outpipe)).second;
-                    zmq_assert (ok);
+                    existing->pipe->set_identity (new_identity);
+                    outpipe_t existing_outpipe = *existing;
 
                     //  Remove the existing identity entry to allow the new
                     //  connection to take the identity.
-                    outpipes.erase (it);
+                    ok = outpipes.erase (identity);
+                    zmq_assert (ok);
+
+                    ok = outpipes.insert (new_identity, existing_outpipe);
+                    zmq_assert (ok);
 
                     if (existing_outpipe.pipe == current_in)
                         terminate_current_in = true;
@@ -499,7 +494,7 @@ bool zmq::router_t::identify_peer (pipe_t *pipe_)
     pipe_->set_identity (identity);
     //  Add the record into output pipes lookup table
     outpipe_t outpipe = {pipe_, true};
-    ok = outpipes.insert (outpipes_t::value_type (identity, outpipe)).second;
+    ok = outpipes.insert (identity, outpipe);
     zmq_assert (ok);
 
     return true;
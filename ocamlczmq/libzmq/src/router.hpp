@@ -30,12 +30,13 @@
 #ifndef __ZMQ_ROUTER_HPP_INCLUDED__
 #define __ZMQ_ROUTER_HPP_INCLUDED__
 
-#include <map>
+#include <set>
 
 #include "socket_base.hpp"
 #include "session_base.hpp"
 #include "stdint.hpp"
 #include "blob.hpp"
+#include "identity_map.hpp"
 #include "msg.hpp"
 #include "fq.hpp"
 
@@ -111,7 +112,7 @@ namespace zmq
         std::set <pipe_t*> anonymous_pipes;
 
         //  Outbound pipes indexed by the peer IDs.
-        typedef std::map <blob_t, outpipe_t> outpipes_t;
+        typedef identity_map_t <outpipe_t> outpipes_t;
         outpipes_t outpipes;
 
         //  The pipe we are currently writing to.
@@ -63,6 +63,7 @@ void zmq::server_t::xattach_pipe (pipe_t *pipe_, bool subscribe_to_all_)
     bool ok = outpipes.insert (outpipes_t::value_type (routing_id, outpipe)).second;
     zmq_assert (ok);
 
+    fq.set_priority (options.rcvpriority);
     fq.attach (pipe_);
 }
 
@@ -45,6 +45,8 @@
 
 #include "ctx.hpp"
 #include "req.hpp"
+#include "io_thread.hpp"
+#include "zap_client.hpp"
 
 zmq::session_base_t *zmq::session_base_t::create (class io_thread_t *io_thread_,
     bool active_, class socket_base_t *socket_, const options_t &options_,
@@ -87,7 +89,7 @@ zmq::session_base_t::session_base_t (class io_thread_t *io_thread_,
     io_object_t (io_thread_),
     active (active_),
     pipe (NULL),
-    zap_pipe (NULL),
+    zap_frames_sent (0),
     incomplete_in (false),
     pending (false),
     engine (NULL),
@@ -101,7 +103,7 @@ zmq::session_base_t::session_base_t (class io_thread_t *io_thread_,
 zmq::session_base_t::~session_base_t ()
 {
     zmq_assert (!pipe);
-    zmq_assert (!zap_pipe);
+    cancel_zap_request ();
 
     //  If there's still a pending linger timer, remove it.
     if (has_linger_timer) {
@@ -153,37 +155,96 @@ int zmq::session_base_t::push_msg (msg_t *msg_)
 
 int zmq::session_base_t::read_zap_msg (msg_t *msg_)
 {
-    if (zap_pipe == NULL) {
-        errno = ENOTCONN;
-        return -1;
-    }
-
-    if (!zap_pipe->read (msg_)) {
-        errno = EAGAIN;
+    if (zap_reply.empty ()) {
+        errno = zap_request.empty ()? ENOTCONN: EAGAIN;
         return -1;
     }
 
+    const int rc = msg_->move (zap_reply.front ());
+    errno_assert (rc == 0);
+    zap_reply.pop_front ();
     return 0;
 }
 
 int zmq::session_base_t::write_zap_msg (msg_t *msg_)
 {
-    if (zap_pipe == NULL) {
-        errno = ENOTCONN;
-        return -1;
+    zap_client_t *zap_client = io_thread->get_zap_client ();
+    const int frame = zap_frames_sent;
+    zap_frames_sent = msg_->flags () & msg_t::more? frame + 1: 0;
+
+    if (frame == 0) {
+        zmq_assert (zap_request.empty () && zap_reply.empty ());
+        zap_request = zap_client->open (this);
     }
 
-    const bool ok = zap_pipe->write (msg_);
-    zmq_assert (ok);
+    //  The rest of a request that failed is dropped.
+    if (zap_request.empty ()) {
+        const int rc = msg_->close ();
+        errno_assert (rc == 0);
+        return msg_->init ();
+    }
 
-    if ((msg_->flags () & msg_t::more) == 0)
-        zap_pipe->flush ();
+    //  Request id frame.
+    if (frame == 2) {
+        zap_request_id.assign (static_cast <char *> (msg_->data ()),
+            msg_->size ());
+        const int flags = msg_->flags ();
+        int rc = msg_->close ();
+        errno_assert (rc == 0);
+        rc = msg_->init_size (zap_request.size ());
+        errno_assert (rc == 0);
+        memcpy (msg_->data (), zap_request.data (), zap_request.size ());
+        msg_->set_flags (flags);
+    }
 
-    const int rc = msg_->init ();
-    errno_assert (rc == 0);
+    //  The connection is being closed. The request fails, which the
+    //  mechanism learns when it reads the reply.
+    if (zap_client->write (msg_) == -1) {
+        cancel_zap_request ();
+        const int rc = msg_->close ();
+        errno_assert (rc == 0);
+        return msg_->init ();
+    }
     return 0;
 }
 
+void zmq::session_base_t::zap_reply_arrived (std::vector <msg_t> &reply_)
+{
+    zmq_assert (!zap_request.empty () && zap_reply.empty ());
+    zap_request.clear ();
+    zap_reply.assign (reply_.begin (), reply_.end ());
+    reply_.clear ();
+
+    //  Give the mechanism back the request id it chose.
+    if (zap_reply.size () > 2) {
+        msg_t &id = zap_reply [2];
+        const int flags = id.flags ();
+        int rc = id.close ();
+        errno_assert (rc == 0);
+        rc = id.init_size (zap_request_id.size ());
+        errno_assert (rc == 0);
+        memcpy (id.data (), zap_request_id.data (), zap_request_id.size ());
+        id.set_flags (flags);
+    }
+
+    if (engine)
+        engine->zap_msg_available ();
+}
+
+void zmq::session_base_t::cancel_zap_request ()
+{
+    if (!zap_request.empty ()) {
+        io_thread->get_zap_client ()->cancel (zap_request);
+        zap_request.clear ();
+    }
+    zap_frames_sent = 0;
+    while (!zap_reply.empty ()) {
+        const int rc = zap_reply.front ().close ();
+        errno_assert (rc == 0);
+        zap_reply.pop_front ();
+    }
+}
+
 void zmq::session_base_t::reset ()
 {
 }
@@ -219,7 +280,6 @@ void zmq::session_base_t::pipe_terminated (pipe_t *pipe_)
 {
     // Drop the reference to the deallocated pipe if required.
     zmq_assert (pipe_ == pipe
-             || pipe_ == zap_pipe
              || terminating_pipes.count (pipe_) == 1);
 
     if (pipe_ == pipe) {
@@ -230,9 +290,6 @@ void zmq::session_base_t::pipe_terminated (pipe_t *pipe_)
             has_linger_timer = false;
         }
     }
-    else
-    if (pipe_ == zap_pipe)
-        zap_pipe = NULL;
     else
         // Remove the pipe from the detached pipes set
         terminating_pipes.erase (pipe_);
@@ -248,7 +305,7 @@ void zmq::session_base_t::pipe_terminated (pipe_t *pipe_)
     //  If we are waiting for pending messages to be sent, at this point
     //  we are sure that there will be no more messages and we can proceed
     //  with termination safely.
-    if (pending && !pipe && !zap_pipe && terminating_pipes.empty ()) {
+    if (pending && !pipe && terminating_pipes.empty ()) {
         pending = false;
         own_t::process_term (0);
     }
@@ -257,7 +314,7 @@ void zmq::session_base_t::pipe_terminated (pipe_t *pipe_)
 void zmq::session_base_t::read_activated (pipe_t *pipe_)
 {
     // Skip activating if we're detaching this pipe
-    if (unlikely (pipe_ != pipe && pipe_ != zap_pipe)) {
+    if (unlikely (pipe_ != pipe)) {
         zmq_assert (terminating_pipes.count (pipe_) == 1);
         return;
     }
@@ -267,10 +324,7 @@ void zmq::session_base_t::read_activated (pipe_t *pipe_)
         return;
     }
 
-    if (likely (pipe_ == pipe))
-        engine->restart_output ();
-    else
-        engine->zap_msg_available ();
+    engine->restart_output ();
 }
 
 void zmq::session_base_t::write_activated (pipe_t *pipe_)
@@ -297,6 +351,34 @@ zmq::socket_base_t *zmq::session_base_t::get_socket ()
     return socket;
 }
 
+bool zmq::session_base_t::migratable ()
+{
+    //  Only a fully established session is moved. Its only pipe is the one
+    //  to the socket, it has no timers running and awaits no ZAP reply.
+    return engine && pipe && zap_request.empty () && zap_reply.empty ()
+        && terminating_pipes.empty ()
+        && !pending && !has_linger_timer && !is_terminating ();
+}
+
+void zmq::session_base_t::migrate_out (io_thread_t *io_thread_,
+    stream_engine_t *engine_)
+{
+    zmq_assert (engine == engine_);
+    io_object_t::unplug ();
+
+    //  The new thread gets the session before any command sent to it
+    //  once the thread IDs are changed.
+    send_migrate (io_thread_, this, engine_);
+    set_tid (io_thread_->get_tid ());
+    pipe->set_tid (io_thread_->get_tid ());
+}
+
+void zmq::session_base_t::migrate_in (io_thread_t *io_thread_)
+{
+    io_object_t::plug (io_thread_);
+    io_thread = io_thread_;
+}
+
 void zmq::session_base_t::process_plug ()
 {
     if (active)
@@ -305,48 +387,7 @@ void zmq::session_base_t::process_plug ()
 
 int zmq::session_base_t::zap_connect ()
 {
-    zmq_assert (zap_pipe == NULL);
-
-    endpoint_t peer = find_endpoint ("inproc://zeromq.zap.01");
-    if (peer.socket == NULL) {
-        errno = ECONNREFUSED;
-        return -1;
-    }
-    if (peer.options.type != ZMQ_REP
-    &&  peer.options.type != ZMQ_ROUTER
-    &&  peer.options.type != ZMQ_SERVER) {
-        errno = ECONNREFUSED;
-        return -1;
-    }
-
-    //  Create a bi-directional pipe that will connect
-    //  session with zap socket.
-    object_t *parents [2] = {this, peer.socket};
-    pipe_t *new_pipes [2] = {NULL, NULL};
-    int hwms [2] = {0, 0};
-    bool conflates [2] = {false, false};
-    int rc = pipepair (parents, new_pipes, hwms, conflates);
-    errno_assert (rc == 0);
-
-    //  Attach local end of the pipe to this socket object.
-    zap_pipe = new_pipes [0];
-    zap_pipe->set_nodelay ();
-    zap_pipe->set_event_sink (this);
-
-    send_bind (peer.socket, new_pipes [1], false);
-
-    //  Send empty identity if required by the peer.
-    if (peer.options.recv_identity) {
-        msg_t id;
-        rc = id.init ();
-        errno_assert (rc == 0);
-        id.set_flags (msg_t::identity);
-        bool ok = zap_pipe->write (&id);
-        zmq_assert (ok);
-        zap_pipe->flush ();
-    }
-
-    return 0;
+    return io_thread->get_zap_client ()->connect ();
 }
 
 bool zmq::session_base_t::zap_enabled ()
@@ -378,6 +419,12 @@ void zmq::session_base_t::process_attach (i_engine *engine_)
         bool conflates [2] = {conflate, conflate};
         int rc = pipepair (parents, pipes, hwms, conflates);
         errno_assert (rc == 0);
+        if (!conflate) {
+            pipes [0]->set_byte_hwms (options.sndhwm_bytes,
+                options.rcvhwm_bytes);
+            pipes [1]->set_byte_hwms (options.rcvhwm_bytes,
+                options.sndhwm_bytes);
+        }
 
         //  Plug the local end of the pipe.
         pipes [0]->set_event_sink (this);
@@ -401,6 +448,7 @@ void zmq::session_base_t::engine_error (
 {
     //  Engine is dead. Let's forget about it.
     engine = NULL;
+    cancel_zap_request ();
 
     //  Remove any half-done messages from the pipes.
     if (pipe)
@@ -427,9 +475,6 @@ void zmq::session_base_t::engine_error (
     if (pipe)
         pipe->check_read ();
 
-    if (zap_pipe)
-        zap_pipe->check_read ();
-
     zmq_assert(socket);
     socket->flush_commands();
 }
@@ -441,7 +486,9 @@ void zmq::session_base_t::process_term (int linger_)
     //  If the termination of the pipe happens before the term command is
     //  delivered there's nothing much to do. We can proceed with the
     //  standard termination immediately.
-    if (!pipe && !zap_pipe && terminating_pipes.empty ()) {
+    cancel_zap_request ();
+
+    if (!pipe && terminating_pipes.empty ()) {
         own_t::process_term (0);
         return;
     }
@@ -468,9 +515,6 @@ void zmq::session_base_t::process_term (int linger_)
         if (!engine)
             pipe->check_read ();
     }
-
-    if (zap_pipe != NULL)
-        zap_pipe->terminate (false);
 }
 
 void zmq::session_base_t::timer_event (int id_)
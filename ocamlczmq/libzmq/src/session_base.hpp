@@ -31,6 +31,8 @@
 #define __ZMQ_SESSION_BASE_HPP_INCLUDED__
 
 #include <string>
+#include <deque>
+#include <vector>
 #include <stdarg.h>
 
 #include "own.hpp"
@@ -96,8 +98,23 @@ namespace zmq
         //  The function takes ownership of the message.
         int write_zap_msg (msg_t *msg_);
 
+        //  Called by the I/O thread's ZAP client with the frames of the
+        //  reply to the outstanding ZAP request, or none if the request
+        //  failed. The session takes over the frames.
+        void zap_reply_arrived (std::vector <msg_t> &reply_);
+
         socket_base_t *get_socket ();
 
+        //  Moving the session, with its engine, to another I/O thread.
+        //  migrate_out is called in the current I/O thread, after the
+        //  engine was detached from it. It hands the session over to
+        //  io_thread_, where migrate_in is called. The caller ensures no
+        //  commands can be posted to the session and its pipe meanwhile.
+        bool migratable ();
+        void migrate_out (zmq::io_thread_t *io_thread_,
+            zmq::stream_engine_t *engine_);
+        void migrate_in (zmq::io_thread_t *io_thread_);
+
     protected:
 
         session_base_t (zmq::io_thread_t *io_thread_, bool active_,
@@ -123,6 +140,9 @@ namespace zmq
         //  Call this function when engine disconnect to get rid of leftovers.
         void clean_pipes ();
 
+        //  Drops the outstanding ZAP request and the unread reply, if any.
+        void cancel_zap_request ();
+
         //  If true, this session (re)connects to the peer. Otherwise, it's
         //  a transient session created by the listener.
         const bool active;
@@ -130,8 +150,17 @@ namespace zmq
         //  Pipe connecting the session to its socket.
         zmq::pipe_t *pipe;
 
-        //  Pipe used to exchange messages with ZAP socket.
-        zmq::pipe_t *zap_pipe;
+        //  The ZAP request of the handshake in progress goes through the
+        //  connection the I/O thread shares among its sessions. The request
+        //  id the mechanism chose is swapped for one unique on the shared
+        //  connection and restored in the reply. zap_request is empty
+        //  unless a request is outstanding.
+        std::string zap_request;
+        std::string zap_request_id;
+        int zap_frames_sent;
+
+        //  Reply frames not yet read by the mechanism.
+        std::deque <msg_t> zap_reply;
 
         //  This set is added to with pipes we are disconnecting, but haven't yet completed
         std::set <pipe_t *> terminating_pipes;
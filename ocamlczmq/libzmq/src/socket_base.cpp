@@ -67,6 +67,8 @@
 #include "tipc_address.hpp"
 #include "mailbox.hpp"
 #include "mailbox_safe.hpp"
+#include "socket_poller.hpp"
+#include "trace.hpp"
 
 #if defined ZMQ_HAVE_VMCI
 #include "vmci_address.hpp"
@@ -91,6 +93,7 @@
 #include "stream.hpp"
 #include "server.hpp"
 #include "client.hpp"
+#include "mmsg_buffer.hpp"
 
 #define ENTER_MUTEX() \
     if (thread_safe) \
@@ -170,6 +173,21 @@ zmq::socket_base_t *zmq::socket_base_t::create (int type_, class ctx_t *parent_,
     return s;
 }
 
+//  Number of CPUs available to the process, or 0 if unknown.
+static int cpu_count ()
+{
+#if defined ZMQ_HAVE_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo (&info);
+    return (int) info.dwNumberOfProcessors;
+#elif defined _SC_NPROCESSORS_ONLN
+    long count = sysconf (_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int) count : 0;
+#else
+    return 0;
+#endif
+}
+
 zmq::socket_base_t::socket_base_t (ctx_t *parent_, uint32_t tid_, int sid_, bool thread_safe_) :
     own_t (parent_, tid_),
     tag (0xbaddecaf),
@@ -177,10 +195,17 @@ zmq::socket_base_t::socket_base_t (ctx_t *parent_, uint32_t tid_, int sid_, bool
     destroyed (false),
     last_tsc (0),
     ticks (0),
+    poll_rate (inbound_poll_rate),
+    commands_processed (0),
+    busy_poll_budget (-1),
     rcvmore (false),
     file_desc(-1),
+    medium_buffer (NULL),
     monitor_socket (NULL),
     monitor_events (0),
+    capture (NULL),
+    capture_flags (0),
+    capture_dropping (false),
     thread_safe (thread_safe_),
     reaper_signaler (NULL)
 {
@@ -188,6 +213,9 @@ zmq::socket_base_t::socket_base_t (ctx_t *parent_, uint32_t tid_, int sid_, bool
     options.ipv6 = (parent_->get (ZMQ_IPV6) != 0);
     options.linger = parent_->get (ZMQ_BLOCKY)? -1: 0;
 
+    stats = new (std::nothrow) socket_stats_t ();
+    alloc_assert (stats);
+
     if (thread_safe)
         mailbox = new mailbox_safe_t(&sync);
     else
@@ -203,6 +231,9 @@ zmq::socket_base_t::~socket_base_t ()
     }
     
     stop_monitor ();
+    stats->release ();
+    if (medium_buffer)
+        medium_buffer->orphan ();
     zmq_assert (destroyed);
 }
 
@@ -488,6 +519,23 @@ int zmq::socket_base_t::remove_signaler(signaler_t *s_)
     return 0;
 }
 
+void zmq::socket_base_t::add_poller (socket_poller_t *poller_, void *item_)
+{
+    zmq_assert (!thread_safe);
+    poller_ref_t ref = {poller_, item_};
+    socket_pollers.push_back (ref);
+}
+
+void zmq::socket_base_t::remove_poller (socket_poller_t *poller_)
+{
+    for (poller_refs_t::iterator it = socket_pollers.begin ();
+          it != socket_pollers.end (); ++it)
+        if (it->poller == poller_) {
+            socket_pollers.erase (it);
+            return;
+        }
+}
+
 int zmq::socket_base_t::bind (const char *addr_)
 {
     ENTER_MUTEX();
@@ -517,6 +565,7 @@ int zmq::socket_base_t::bind (const char *addr_)
         const endpoint_t endpoint = { this, options };
         const int rc = register_endpoint (addr_, endpoint);
         if (rc == 0) {
+            inproc_binds.push_back (std::string (addr_));
             connect_pending (addr_, this);
             last_endpoint.assign (addr_);
             options.connected = true;
@@ -560,6 +609,31 @@ int zmq::socket_base_t::bind (const char *addr_)
         listener->get_address (last_endpoint);
 
         add_endpoint (last_endpoint.c_str (), (own_t *) listener, NULL);
+
+        //  Open a listener on the same address in each of the other
+        //  I/O threads. The address is the resolved one, so that they
+        //  all share the port a wildcard bind has picked. Where
+        //  SO_REUSEPORT isn't supported the extra binds fail and the
+        //  first listener accepts all the connections.
+        if (options.tcp_sharded_accept) {
+            std::vector <io_thread_t*> io_threads;
+            get_ctx ()->get_io_threads (options.affinity, io_threads);
+            const std::string resolved =
+                last_endpoint.substr (strlen ("tcp://"));
+            for (size_t i = 0; i != io_threads.size (); i++) {
+                if (io_threads [i] == io_thread)
+                    continue;
+                tcp_listener_t *shard = new (std::nothrow) tcp_listener_t (
+                    io_threads [i], this, options);
+                alloc_assert (shard);
+                if (shard->set_address (resolved.c_str ()) != 0) {
+                    LIBZMQ_DELETE(shard);
+                    continue;
+                }
+                add_endpoint (last_endpoint.c_str (), (own_t *) shard, NULL);
+            }
+        }
+
         options.connected = true;
         EXIT_MUTEX();
         return 0;
@@ -701,6 +775,15 @@ int zmq::socket_base_t::connect (const char *addr_)
         if (!conflate) {
             new_pipes[0]->set_hwms_boost(peer.options.sndhwm, peer.options.rcvhwm);
             new_pipes[1]->set_hwms_boost(options.sndhwm, options.rcvhwm);
+
+            //  Byte HWMs set on either end add up. If the peer isn't
+            //  bound yet, they are combined once it is.
+            const int64_t snd_bytes = options.sndhwm_bytes +
+                (peer.socket ? peer.options.rcvhwm_bytes : 0);
+            const int64_t rcv_bytes = options.rcvhwm_bytes +
+                (peer.socket ? peer.options.sndhwm_bytes : 0);
+            new_pipes [0]->set_byte_hwms (rcv_bytes, snd_bytes);
+            new_pipes [1]->set_byte_hwms (snd_bytes, rcv_bytes);
         }
 
         errno_assert (rc == 0);
@@ -916,6 +999,12 @@ int zmq::socket_base_t::connect (const char *addr_)
         bool conflates [2] = {conflate, conflate};
         rc = pipepair (parents, new_pipes, hwms, conflates);
         errno_assert (rc == 0);
+        if (!conflate) {
+            new_pipes [0]->set_byte_hwms (options.rcvhwm_bytes,
+                options.sndhwm_bytes);
+            new_pipes [1]->set_byte_hwms (options.sndhwm_bytes,
+                options.rcvhwm_bytes);
+        }
 
         //  Attach local end of the pipe to the socket object.
         attach_pipe (new_pipes [0], subscribe_to_all);
@@ -977,6 +1066,8 @@ int zmq::socket_base_t::term_endpoint (const char *addr_)
     // Disconnect an inproc socket
     if (protocol == "inproc") {
         if (unregister_endpoint (std::string(addr_), this) == 0) {
+            inproc_binds.erase (std::find (inproc_binds.begin (),
+                inproc_binds.end (), std::string (addr_)));
             EXIT_MUTEX();
             return 0;
         }
@@ -1047,23 +1138,58 @@ int zmq::socket_base_t::send (msg_t *msg_, int flags_)
 
     msg_->reset_metadata ();
 
-    //  Try to send the message.
-    rc = xsend (msg_);
+    //  Remember the size, the message is moved out by a successful send.
+    const size_t size = msg_->size ();
+
+    //  The trace event is stamped with the time the message was handed
+    //  over but recorded only once it has been sent.
+    const uint64_t trace_time = unlikely (trace_enabled) ? trace_clock () : 0;
+
+    //  The capture socket gets a copy of the message, for the same reason.
+    msg_t captured;
+    const bool capturing = capture && (capture_flags & ZMQ_CAPTURE_SEND);
+    if (unlikely (capturing)) {
+        rc = captured.init ();
+        errno_assert (rc == 0);
+        rc = captured.copy (*msg_);
+        errno_assert (rc == 0);
+    }
+
+    rc = send_blocking (msg_, flags_);
     if (rc == 0) {
-        EXIT_MUTEX();
-        return 0;
+        stats->msgs_out++;
+        stats->bytes_out += size;
+        if (unlikely (trace_time))
+            trace_record_at (trace_time, ZMQ_TRACE_SEND, this, size);
     }
-    if (unlikely (errno != EAGAIN)) {
-        EXIT_MUTEX();
-        return -1;
+    if (unlikely (capturing)) {
+        if (rc == 0)
+            capture_msg (&captured);
+        else {
+            int err = errno;
+            int rc2 = captured.close ();
+            errno_assert (rc2 == 0);
+            errno = err;
+        }
     }
+    EXIT_MUTEX();
+    return rc;
+}
+
+int zmq::socket_base_t::send_blocking (msg_t *msg_, int flags_)
+{
+    //  Try to send the message.
+    int rc = xsend (msg_);
+    if (rc == 0)
+        return 0;
+    if (unlikely (errno != EAGAIN))
+        return -1;
+    stats->hwm_stalls++;
 
     //  In case of non-blocking send we'll simply propagate
     //  the error - including EAGAIN - up the stack.
-    if (flags_ & ZMQ_DONTWAIT || options.sndtimeo == 0) {
-        EXIT_MUTEX();
+    if (flags_ & ZMQ_DONTWAIT || options.sndtimeo == 0)
         return -1;
-    }
 
     //  Compute the time when the timeout should occur.
     //  If the timeout is infinite, don't care.
@@ -1074,29 +1200,52 @@ int zmq::socket_base_t::send (msg_t *msg_, int flags_)
     //  command, process it and try to send the message again.
     //  If timeout is reached in the meantime, return EAGAIN.
     while (true) {
-        if (unlikely (process_commands (timeout, false) != 0)) {
-            EXIT_MUTEX();
+        if (unlikely (process_commands (timeout, false) != 0))
             return -1;
-        }
         rc = xsend (msg_);
         if (rc == 0)
-            break;
-        if (unlikely (errno != EAGAIN)) {
-            EXIT_MUTEX();
+            return 0;
+        if (unlikely (errno != EAGAIN))
             return -1;
-        }
         if (timeout > 0) {
             timeout = (int) (end - clock.now_ms ());
             if (timeout <= 0) {
                 errno = EAGAIN;
-                EXIT_MUTEX();
                 return -1;
             }
         }
     }
+}
 
-    EXIT_MUTEX();
-    return 0;
+int zmq::socket_base_t::init_msg (msg_t *msg_, size_t size_)
+{
+    //  A thread-safe socket may be used by several threads at a time while
+    //  the buffer has a single owner, so it doesn't get one.
+    if (options.medium_msg_size > 0 && !thread_safe
+    &&  size_ > msg_t::max_vsm_size
+    &&  size_ <= (size_t) options.medium_msg_size) {
+
+        //  The option may have changed since the buffer was created.
+        if (medium_buffer
+        &&  medium_buffer->capacity () != (size_t) options.medium_msg_size) {
+            medium_buffer->orphan ();
+            medium_buffer = NULL;
+        }
+        //  Messages queue up to our HWM and, over inproc, the peer's.
+        if (!medium_buffer) {
+            medium_buffer = new (std::nothrow) mmsg_buffer_t (
+                options.medium_msg_size, 2 * options.sndhwm);
+            alloc_assert (medium_buffer);
+        }
+
+        if (msg_->init_medium (size_, medium_buffer) == 0) {
+            stats->medium_msgs++;
+            return 0;
+        }
+        stats->medium_misses++;
+    }
+
+    return msg_->init_size (size_);
 }
 
 int zmq::socket_base_t::recv (msg_t *msg_, int flags_)
@@ -1125,12 +1274,22 @@ int zmq::socket_base_t::recv (msg_t *msg_, int flags_)
     //  Note that 'recv' uses different command throttling algorithm (the one
     //  described above) from the one used by 'send'. This is because counting
     //  ticks is more efficient than doing RDTSC all the time.
-    if (++ticks == inbound_poll_rate) {
+    if (++ticks >= poll_rate) {
+        const uint64_t processed = commands_processed;
         if (unlikely (process_commands (0, false) != 0)) {
             EXIT_MUTEX();
             return -1;
         }
         ticks = 0;
+
+        //  With ZMQ_ADAPTIVE_BATCH, poll less and less often while the
+        //  polls find no commands, and at the configured rate again as soon
+        //  as one does.
+        if (options.adaptive_batch && commands_processed == processed)
+            poll_rate = std::min (poll_rate * 2,
+                options.inbound_poll_rate * adaptive_poll_factor);
+        else
+            poll_rate = options.inbound_poll_rate;
     }
 
     //  Get the message.
@@ -1145,6 +1304,7 @@ int zmq::socket_base_t::recv (msg_t *msg_, int flags_)
         if (file_desc != retired_fd)
             msg_->set_fd(file_desc);
         extract_flags (msg_);
+        capture_received (msg_);
         EXIT_MUTEX();
         return 0;
     }
@@ -1168,6 +1328,7 @@ int zmq::socket_base_t::recv (msg_t *msg_, int flags_)
         if (file_desc != retired_fd)
             msg_->set_fd(file_desc);
         extract_flags (msg_);
+        capture_received (msg_);
 
         EXIT_MUTEX();
         return 0;
@@ -1209,6 +1370,7 @@ int zmq::socket_base_t::recv (msg_t *msg_, int flags_)
     if (file_desc != retired_fd)
         msg_->set_fd(file_desc);
     extract_flags (msg_);
+    capture_received (msg_);
     EXIT_MUTEX();
     return 0;
 }
@@ -1218,6 +1380,10 @@ int zmq::socket_base_t::close ()
     //  Mark the socket as dead
     tag = 0xdeadbeef;
 
+    //  From now on the commands are processed in the reaper thread,
+    //  which must not touch the application's pollers.
+    socket_pollers.clear ();
+
     //  Transfer the ownership of the socket from this application thread
     //  to the reaper thread which will take care of the rest of shutdown
     //  process.
@@ -1271,11 +1437,20 @@ void zmq::socket_base_t::start_reaping (poller_t *poller_)
 
 int zmq::socket_base_t::process_commands (int timeout_, bool throttle_)
 {
+    //  Every call from the application passes through here, and any of
+    //  them may change what the socket is ready for. Let the persistent
+    //  pollers re-check the socket at their next wait.
+    for (poller_refs_t::iterator it = socket_pollers.begin ();
+          it != socket_pollers.end (); ++it)
+        it->poller->touch (it->item);
+
     int rc;
     command_t cmd;
     if (timeout_ != 0) {
 
         //  If we are asked to wait, simply ask mailbox to wait.
+        if (options.busy_poll > 0 && !thread_safe)
+            busy_poll ();
         rc = mailbox->recv (&cmd, timeout_);
     }
     else {
@@ -1297,7 +1472,8 @@ int zmq::socket_base_t::process_commands (int timeout_, bool throttle_)
             //  Check whether TSC haven't jumped backwards (in case of migration
             //  between CPU cores) and whether certain time have elapsed since
             //  last command processing. If it didn't do nothing.
-            if (tsc >= last_tsc && tsc - last_tsc <= max_command_delay)
+            if (tsc >= last_tsc &&
+                  tsc - last_tsc <= (uint64_t) options.max_command_delay)
                 return 0;
             last_tsc = tsc;
         }
@@ -1309,6 +1485,7 @@ int zmq::socket_base_t::process_commands (int timeout_, bool throttle_)
     //  Process all available commands.
     while (rc == 0) {
         cmd.destination->process_command (cmd);
+        commands_processed++;
         rc = mailbox->recv (&cmd, 0);
     }
 
@@ -1325,6 +1502,26 @@ int zmq::socket_base_t::process_commands (int timeout_, bool throttle_)
     return 0;
 }
 
+void zmq::socket_base_t::busy_poll ()
+{
+    //  Spinning only pays off if the peer can run meanwhile.
+    if (busy_poll_budget < 0)
+        busy_poll_budget = cpu_count () > 1 ? options.busy_poll : 0;
+    if (busy_poll_budget == 0)
+        return;
+
+    //  Tune the spin to how quickly the peer actually answers. Double it
+    //  after a spin that caught the command, halve it after one that
+    //  ended up blocking anyway.
+    const int limit = options.busy_poll;
+    const int floor = limit / 16 > 0 ? limit / 16 : 1;
+    busy_poll_budget = std::min (std::max (busy_poll_budget, floor), limit);
+    if (((mailbox_t*) mailbox)->spin (busy_poll_budget))
+        busy_poll_budget = std::min (busy_poll_budget * 2, limit);
+    else
+        busy_poll_budget = std::max (busy_poll_budget / 2, floor);
+}
+
 void zmq::socket_base_t::process_stop ()
 {
     //  Here, someone have called zmq_term while the socket was still alive.
@@ -1345,7 +1542,9 @@ void zmq::socket_base_t::process_term (int linger_)
     //  Unregister all inproc endpoints associated with this socket.
     //  Doing this we make sure that no new pipes from other sockets (inproc)
     //  will be initiated.
-    unregister_endpoints (this);
+    for (size_t i = 0; i != inproc_binds.size (); i++)
+        unregister_endpoint (inproc_binds [i], this);
+    inproc_binds.clear ();
 
     //  Ask all attached pipes to terminate.
     for (pipes_t::size_type i = 0; i != pipes.size (); ++i)
@@ -1366,6 +1565,14 @@ void zmq::socket_base_t::update_pipe_options(int option_)
         }
     }
 
+    if (option_ == ZMQ_SNDHWM_BYTES || option_ == ZMQ_RCVHWM_BYTES)
+    {
+        for (pipes_t::size_type i = 0; i != pipes.size(); ++i)
+        {
+            pipes[i]->set_byte_hwms(options.rcvhwm_bytes, options.sndhwm_bytes);
+        }
+    }
+
 }
 
 void zmq::socket_base_t::process_destroy ()
@@ -1406,6 +1613,11 @@ zmq::blob_t zmq::socket_base_t::get_credential () const
     return blob_t ();
 }
 
+uint64_t zmq::socket_base_t::xdrops ()
+{
+    return 0;
+}
+
 void zmq::socket_base_t::xread_activated (pipe_t *)
 {
     zmq_assert (false);
@@ -1469,6 +1681,12 @@ void zmq::socket_base_t::check_destroy ()
 
 void zmq::socket_base_t::flush_commands ()
 {
+    //  Only a thread-safe socket's mailbox may be drained from a thread
+    //  other than the application's. Any other socket picks the commands
+    //  up on its next call.
+    if (!thread_safe)
+        return;
+
     ENTER_MUTEX();
     process_commands (0, false);
     EXIT_MUTEX();
@@ -1520,6 +1738,106 @@ void zmq::socket_base_t::extract_flags (msg_t *msg_)
 
     //  Remove MORE flag.
     rcvmore = msg_->flags () & msg_t::more ? true : false;
+
+    stats->msgs_in++;
+    stats->bytes_in += msg_->size ();
+    if (unlikely (trace_enabled))
+        trace_record (ZMQ_TRACE_RECV, this, msg_->size ());
+}
+
+int zmq::socket_base_t::set_capture (socket_base_t *capture_, int flags_)
+{
+    if (unlikely (ctx_terminated)) {
+        errno = ETERM;
+        return -1;
+    }
+
+    //  Capturing a socket into itself would recurse on every send.
+    if (capture_ == this ||
+          (capture_ && (flags_ == 0 ||
+          (flags_ & ~(ZMQ_CAPTURE_SEND | ZMQ_CAPTURE_RECV))))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ENTER_MUTEX();
+    capture = capture_;
+    capture_flags = capture_ ? flags_ : 0;
+    capture_dropping = false;
+    EXIT_MUTEX();
+    return 0;
+}
+
+void zmq::socket_base_t::capture_msg (msg_t *msg_)
+{
+    const bool more = msg_->flags () & msg_t::more ? true : false;
+
+    //  The capture socket must never stall the captured one, so the copy
+    //  is dropped if the capture socket is at its high-water mark. Once a
+    //  part is dropped, the rest of the message goes with it.
+    int rc = -1;
+    if (!capture_dropping) {
+        const int flags = (more ? ZMQ_SNDMORE : 0) | ZMQ_DONTWAIT;
+        rc = capture->send (msg_, flags);
+
+        //  Non-blocking sends process the commands from the capture socket's
+        //  peers only once in a while. Catch up with them before giving up,
+        //  in case the reader has made room in the meantime.
+        if (rc != 0 && errno == EAGAIN) {
+            int events;
+            size_t events_size = sizeof (events);
+            if (capture->getsockopt (ZMQ_EVENTS, &events, &events_size) == 0
+                  && (events & ZMQ_POLLOUT))
+                rc = capture->send (msg_, flags);
+        }
+    }
+    if (unlikely (rc != 0)) {
+        rc = msg_->close ();
+        errno_assert (rc == 0);
+        capture_dropping = more;
+    }
+}
+
+void zmq::socket_base_t::capture_received (msg_t *msg_)
+{
+    if (likely (!capture || !(capture_flags & ZMQ_CAPTURE_RECV)))
+        return;
+
+    msg_t captured;
+    int rc = captured.init ();
+    errno_assert (rc == 0);
+    rc = captured.copy (*msg_);
+    errno_assert (rc == 0);
+    capture_msg (&captured);
+}
+
+int zmq::socket_base_t::statistics (zmq_socket_stats_t *stats_)
+{
+    ENTER_MUTEX();
+
+    if (unlikely (!stats_)) {
+        errno = EFAULT;
+        EXIT_MUTEX();
+        return -1;
+    }
+
+    stats->get (stats_);
+    stats_->drops = xdrops ();
+    stats_->pipes = pipes.size ();
+    stats_->queued_in = 0;
+    stats_->queued_out = 0;
+    for (pipes_t::size_type i = 0; i != pipes.size (); i++) {
+        stats_->queued_in += pipes [i]->get_queued_in ();
+        stats_->queued_out += pipes [i]->get_queued_out ();
+    }
+
+    EXIT_MUTEX();
+    return 0;
+}
+
+zmq::socket_stats_t *zmq::socket_base_t::get_stats ()
+{
+    return stats;
 }
 
 int zmq::socket_base_t::monitor (const char *addr_, int events_)
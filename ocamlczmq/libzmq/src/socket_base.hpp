@@ -32,6 +32,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <stdarg.h>
 
 #include "own.hpp"
@@ -45,6 +46,7 @@
 #include "stdint.hpp"
 #include "clock.hpp"
 #include "pipe.hpp"
+#include "socket_stats.hpp"
 
 extern "C"
 {
@@ -56,7 +58,9 @@ namespace zmq
 
     class ctx_t;
     class msg_t;
+    class mmsg_buffer_t;
     class pipe_t;
+    class socket_poller_t;
 
     class socket_base_t :
         public own_t,
@@ -90,10 +94,22 @@ namespace zmq
         int term_endpoint (const char *addr_);
         int send (zmq::msg_t *msg_, int flags_);
         int recv (zmq::msg_t *msg_, int flags_);
+
+        //  Initialises a message of size_ bytes to be sent through the
+        //  socket, carving it from the socket's medium message buffer if
+        //  ZMQ_MEDIUM_MSG_SIZE allows.
+        int init_msg (zmq::msg_t *msg_, size_t size_);
+
         int add_signaler (signaler_t *s);
         int remove_signaler (signaler_t *s);
         int close ();
 
+        //  Registers a persistent poller to be touched, with the item
+        //  passed in, whenever the socket's readiness may have changed.
+        //  Only used for sockets that are not thread safe.
+        void add_poller (socket_poller_t *poller_, void *item_);
+        void remove_poller (socket_poller_t *poller_);
+
         //  These functions are used by the polling mechanism to determine
         //  which events are to be reported from this socket.
         bool has_in ();
@@ -121,6 +137,17 @@ namespace zmq
 
         int monitor (const char *endpoint_, int events_);
 
+        //  Copies messages sent and/or received on this socket, as selected
+        //  by ZMQ_CAPTURE_SEND and ZMQ_CAPTURE_RECV, to the capture socket.
+        //  NULL capture socket stops capturing.
+        int set_capture (socket_base_t *capture_, int flags_);
+
+        //  Collects the runtime statistics of the socket.
+        int statistics (zmq_socket_stats_t *stats_);
+
+        //  Returns the statistics object engines report their counters to.
+        socket_stats_t *get_stats ();
+
         void set_fd(fd_t fd_);
         fd_t fd();
 
@@ -164,6 +191,11 @@ namespace zmq
         //  the function returns empty credential.
         virtual blob_t get_credential () const;
 
+        //  Returns the number of message parts dropped by the socket's
+        //  distribution algorithm. The default implementation assumes
+        //  that the socket never drops messages.
+        virtual uint64_t xdrops ();
+
         //  i_pipe_events will be forwarded to these functions.
         virtual void xread_activated (pipe_t *pipe_);
         virtual void xwrite_activated (pipe_t *pipe_);
@@ -195,14 +227,30 @@ namespace zmq
         typedef std::multimap <std::string, pipe_t *> inprocs_t;
         inprocs_t inprocs;
 
+        //  Addresses of the inproc endpoints the socket is bound to, to be
+        //  unregistered when it terminates.
+        std::vector <std::string> inproc_binds;
+
         //  To be called after processing commands or invoking any command
         //  handlers explicitly. If required, it will deallocate the socket.
         void check_destroy ();
 
         //  Moves the flags from the message to local variables,
-        //  to be later retrieved by getsockopt.
+        //  to be later retrieved by getsockopt, and accounts for the
+        //  received message in the statistics.
         void extract_flags (msg_t *msg_);
 
+        //  Sends the message, waiting for it to be accepted by the pipes
+        //  unless ZMQ_DONTWAIT is set or the send timeout expires.
+        int send_blocking (msg_t *msg_, int flags_);
+
+        //  Passes the copy of a message on to the capture socket, closing
+        //  it if it cannot be sent without blocking.
+        void capture_msg (msg_t *msg_);
+
+        //  Captures a copy of the received message, if requested.
+        void capture_received (msg_t *msg_);
+
         //  Used to check whether the object is a socket.
         uint32_t tag;
 
@@ -231,6 +279,10 @@ namespace zmq
         //  in a predefined time period.
         int process_commands (int timeout_, bool throttle_);
 
+        //  Spins waiting for a command before process_commands blocks,
+        //  if ZMQ_BUSY_POLL is set.
+        void busy_poll ();
+
         //  Handlers for incoming commands.
         void process_stop ();
         void process_bind (zmq::pipe_t *pipe_);
@@ -255,6 +307,18 @@ namespace zmq
         //  Number of messages received since last command processing.
         int ticks;
 
+        //  Number of messages to receive before processing commands, see
+        //  ZMQ_INBOUND_POLL_RATE and ZMQ_ADAPTIVE_BATCH.
+        int poll_rate;
+
+        //  Number of commands processed so far.
+        uint64_t commands_processed;
+
+        //  Current busy-poll duration in microseconds, adapted between
+        //  1/16 of ZMQ_BUSY_POLL and ZMQ_BUSY_POLL. 0 if busy-polling
+        //  is pointless on this machine, -1 until first used.
+        int busy_poll_budget;
+
         //  True if the last message received had MORE flag set.
         bool rcvmore;
 
@@ -264,12 +328,28 @@ namespace zmq
         //  Improves efficiency of time measurement.
         clock_t clock;
 
+        //  Runtime statistics, shared with the engines.
+        socket_stats_t *stats;
+
+        //  Buffer init_msg carves medium messages from, created on first
+        //  use. Messages sent through the socket end up in its outbound
+        //  pipes, so the pipes share it.
+        mmsg_buffer_t *medium_buffer;
+
         // Monitor socket;
         void *monitor_socket;
 
         // Bitmask of events being monitored
         int monitor_events;
 
+        //  Socket the sent and/or received messages are copied to, if any.
+        socket_base_t *capture;
+        int capture_flags;
+
+        //  True while dropping the rest of a message whose copy could not
+        //  be passed on to the capture socket.
+        bool capture_dropping;
+
         // Last socket endpoint resolved URI
         std::string last_endpoint;
 
@@ -279,6 +359,15 @@ namespace zmq
         // Signaler to be used in the reaping stage
         signaler_t* reaper_signaler;
 
+        //  Persistent pollers the socket is registered with.
+        struct poller_ref_t
+        {
+            socket_poller_t *poller;
+            void *item;
+        };
+        typedef std::vector <poller_ref_t> poller_refs_t;
+        poller_refs_t socket_pollers;
+
         // Mutex for synchronize access to the socket in thread safe mode
         mutex_t sync;
 
@@ -27,18 +27,36 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+
 #include "socket_poller.hpp"
+#include "config.hpp"
 #include "err.hpp"
 
 zmq::socket_poller_t::socket_poller_t () :
     tag (0xCAFEBABE),
     need_rebuild (true),
     use_signaler (false)
-#if defined ZMQ_POLL_BASED_ON_POLL  
+#if defined ZMQ_USE_EPOLL
+    ,
+    checking (NULL)
+#elif defined ZMQ_POLL_BASED_ON_POLL
     ,
     pollfds (NULL)
 #endif
 {    
+#if defined ZMQ_USE_EPOLL
+    epoll_fd = epoll_create (1);
+    errno_assert (epoll_fd != -1);
+
+    //  The signaler is told apart from the items by its NULL pointer.
+    epoll_event ev;
+    memset (&ev, 0, sizeof (ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    int rc = epoll_ctl (epoll_fd, EPOLL_CTL_ADD, signaler.get_fd (), &ev);
+    errno_assert (rc != -1);
+#endif
 }
 
 zmq::socket_poller_t::~socket_poller_t ()
@@ -47,16 +65,32 @@ zmq::socket_poller_t::~socket_poller_t ()
     tag = 0xdeadbeef;    
 
     for (items_t::iterator it = items.begin(); it != items.end(); ++it) {
-        if (it->socket) {
+        if ((*it)->socket) {
             int thread_safe;
             size_t thread_safe_size = sizeof(int);
 
-            if (it->socket->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == 0 && thread_safe)
-                it->socket->remove_signaler (&signaler);                              			   		
+            if ((*it)->socket->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == 0) {
+                if (thread_safe)
+                    (*it)->socket->remove_signaler (&signaler);
+#if defined ZMQ_USE_EPOLL
+                else
+                    (*it)->socket->remove_poller (this);
+#endif
+            }
+#if defined ZMQ_USE_EPOLL
+            if (!(*it)->thread_safe) {
+                int rc = close ((*it)->fd);
+                errno_assert (rc == 0);
+            }
+#endif
         }
+        delete *it;
     }
 
-#if defined ZMQ_POLL_BASED_ON_POLL
+#if defined ZMQ_USE_EPOLL
+    int rc = close (epoll_fd);
+    errno_assert (rc == 0);
+#elif defined ZMQ_POLL_BASED_ON_POLL
     if (pollfds) {
         free (pollfds);
         pollfds = NULL;
@@ -69,13 +103,31 @@ bool zmq::socket_poller_t::check_tag ()
     return tag == 0xCAFEBABE;
 }
 
+zmq::socket_poller_t::items_t::iterator zmq::socket_poller_t::find (
+    socket_base_t *socket_)
+{
+    items_t::iterator it;
+    for (it = items.begin (); it != items.end (); ++it)
+        if ((*it)->socket == socket_)
+            break;
+    return it;
+}
+
+zmq::socket_poller_t::items_t::iterator zmq::socket_poller_t::find_fd (
+    fd_t fd_)
+{
+    items_t::iterator it;
+    for (it = items.begin (); it != items.end (); ++it)
+        if (!(*it)->socket && (*it)->fd == fd_)
+            break;
+    return it;
+}
+
 int zmq::socket_poller_t::add (socket_base_t *socket_, void* user_data_, short events_) 
 {
-    for (items_t::iterator it = items.begin (); it != items.end (); ++it) {
-        if (it->socket == socket_) {
-            errno = EINVAL;
-            return -1;
-        }            
+    if (find (socket_) != items.end ()) {
+        errno = EINVAL;
+        return -1;
     }
 
     int thread_safe;
@@ -84,28 +136,78 @@ int zmq::socket_poller_t::add (socket_base_t *socket_, void* user_data_, short e
     if (socket_->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == -1)
         return -1;
 
+    item_t *item = new (std::nothrow) item_t ();
+    alloc_assert (item);
+    item->socket = socket_;
+    item->user_data = user_data_;
+    item->events = events_;
+
+#if defined ZMQ_USE_EPOLL
+    item->thread_safe = thread_safe != 0;
+    if (!thread_safe) {
+        //  The socket's file descriptor is registered through a duplicate,
+        //  as epoll takes each descriptor only once and the application
+        //  may add the socket's own one with add_fd as well.
+        fd_t fd;
+        size_t fd_size = sizeof (zmq::fd_t);
+        if (socket_->getsockopt (ZMQ_FD, &fd, &fd_size) == -1) {
+            delete item;
+            return -1;
+        }
+        item->fd = dup (fd);
+        if (item->fd == retired_fd || ctl (EPOLL_CTL_ADD, item) == -1) {
+            if (item->fd != retired_fd)
+                close (item->fd);
+            delete item;
+            return -1;
+        }
+    }
+#endif
+
     if (thread_safe) {
-        if (socket_->add_signaler (&signaler) == -1)
-           return -1;
+        if (socket_->add_signaler (&signaler) == -1) {
+            delete item;
+            return -1;
+        }
     }
     
-    item_t item = {socket_, 0, user_data_, events_};
     items.push_back (item);
     need_rebuild = true;
 
+#if defined ZMQ_USE_EPOLL
+    if (thread_safe)
+        safe_items.push_back (item);
+    else
+        socket_->add_poller (this, item);
+
+    //  The socket may be ready already.
+    make_pending (item);
+#endif
+
     return 0;
 }
 
 int zmq::socket_poller_t::add_fd (fd_t fd_, void *user_data_, short events_)
 {
-   for (items_t::iterator it = items.begin (); it != items.end (); ++it) {
-        if (!it->socket && it->fd == fd_) {
-            errno = EINVAL;
-            return -1;
-        }            
+    if (find_fd (fd_) != items.end ()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    item_t *item = new (std::nothrow) item_t ();
+    alloc_assert (item);
+    item->socket = NULL;
+    item->fd = fd_;
+    item->user_data = user_data_;
+    item->events = events_;
+
+#if defined ZMQ_USE_EPOLL
+    if (ctl (EPOLL_CTL_ADD, item) == -1) {
+        delete item;
+        return -1;
     }
+#endif
 
-    item_t item = {NULL, fd_, user_data_, events_};
     items.push_back (item);
     need_rebuild = true;
 
@@ -114,54 +216,50 @@ int zmq::socket_poller_t::add_fd (fd_t fd_, void *user_data_, short events_)
 
 int zmq::socket_poller_t::modify (socket_base_t  *socket_, short events_)
 {
-    items_t::iterator it;
-
-    for (it = items.begin (); it != items.end (); ++it) {
-        if (it->socket == socket_)
-            break;
-    }
+    items_t::iterator it = find (socket_);
 
     if (it == items.end()) {
         errno = EINVAL;
         return -1;
     }
 
-    it->events = events_;
+    (*it)->events = events_;
     need_rebuild = true;
 
+#if defined ZMQ_USE_EPOLL
+    if (!(*it)->thread_safe && ctl (EPOLL_CTL_MOD, *it) == -1)
+        return -1;
+    make_pending (*it);
+#endif
+
     return 0;
 }
 
 
 int zmq::socket_poller_t::modify_fd (fd_t fd_, short events_)
 {
-    items_t::iterator it;
-
-    for (it = items.begin (); it != items.end (); ++it) {
-        if (!it->socket && it->fd == fd_)
-            break;
-    }
+    items_t::iterator it = find_fd (fd_);
 
     if (it == items.end()) {
         errno = EINVAL;
         return -1;
     }
  
-    it->events = events_;
+    (*it)->events = events_;
     need_rebuild = true;
 
+#if defined ZMQ_USE_EPOLL
+    if (ctl (EPOLL_CTL_MOD, *it) == -1)
+        return -1;
+#endif
+
     return 0;
 } 
 
 
 int zmq::socket_poller_t::remove (socket_base_t *socket_)
 {
-    items_t::iterator it;
-
-    for (it = items.begin (); it != items.end (); ++it) {
-        if (it->socket == socket_)
-            break;
-    }
+    items_t::iterator it = find (socket_);
 
     if (it == items.end()) {
         errno = EINVAL;
@@ -178,36 +276,168 @@ int zmq::socket_poller_t::remove (socket_base_t *socket_)
         if (socket_->remove_signaler (&signaler) == -1)
             return -1;
     }
-    
+
+    item_t *item = *it;
     items.erase (it);
     need_rebuild = true;    
-    
+
+#if defined ZMQ_USE_EPOLL
+    if (thread_safe)
+        safe_items.erase (std::find (safe_items.begin (), safe_items.end (),
+            item));
+    else {
+        socket_->remove_poller (this);
+        int rc = ctl (EPOLL_CTL_DEL, item);
+        errno_assert (rc == 0);
+        rc = close (item->fd);
+        errno_assert (rc == 0);
+    }
+    if (item->pending)
+        pending.erase (std::find (pending.begin (), pending.end (), item));
+#endif
+
+    delete item;
     return 0;
 }
 
 int zmq::socket_poller_t::remove_fd (fd_t fd_)
 {
-    items_t::iterator it;
-
-    for (it = items.begin (); it != items.end (); ++it) {
-        if (!it->socket && it->fd == fd_)
-            break;
-    }
+    items_t::iterator it = find_fd (fd_);
 
     if (it == items.end()) {
         errno = EINVAL;
         return -1;
     }
  
+    item_t *item = *it;
     items.erase (it);
     need_rebuild = true;
 
+#if defined ZMQ_USE_EPOLL
+    //  The file descriptor may have been closed already, which removes
+    //  it from the epoll set.
+    int rc = ctl (EPOLL_CTL_DEL, item);
+    errno_assert (rc == 0 || errno == EBADF || errno == ENOENT);
+    if (item->pending)
+        pending.erase (std::find (pending.begin (), pending.end (), item));
+#endif
+
+    delete item;
     return 0;
 }
 
+void zmq::socket_poller_t::touch (void *item_)
+{
+#if defined ZMQ_USE_EPOLL
+    item_t *item = (item_t*) item_;
+    if (item != checking)
+        make_pending (item);
+#else
+    LIBZMQ_UNUSED (item_);
+#endif
+}
+
+#if defined ZMQ_USE_EPOLL
+
+int zmq::socket_poller_t::ctl (int op_, item_t *item_)
+{
+    //  Sockets are watched for commands arriving on their mailbox,
+    //  whatever the events asked for. A socket that asks for no events
+    //  is not watched at all, as it would wake the poller up for nothing.
+    epoll_event ev;
+    memset (&ev, 0, sizeof (ev));
+    if (item_->socket) {
+        if (item_->events)
+            ev.events = EPOLLIN;
+    }
+    else {
+        if (item_->events & ZMQ_POLLIN)
+            ev.events |= EPOLLIN;
+        if (item_->events & ZMQ_POLLOUT)
+            ev.events |= EPOLLOUT;
+        if (item_->events & ZMQ_POLLPRI)
+            ev.events |= EPOLLPRI;
+    }
+    ev.data.ptr = item_;
+    return epoll_ctl (epoll_fd, op_, item_->fd, &ev);
+}
+
+void zmq::socket_poller_t::make_pending (item_t *item_)
+{
+    if (!item_->pending) {
+        item_->pending = true;
+        pending.push_back (item_);
+    }
+}
+
+bool zmq::socket_poller_t::check_pending (event_t *event_)
+{
+    //  Each pending item is checked at most once per call. A socket found
+    //  ready goes to the back of the queue, so that one busy socket does
+    //  not starve the others, and is checked again at the next wait.
+    for (size_t n = pending.size (); n; n--) {
+        item_t *item = pending.front ();
+        pending.pop_front ();
+        item->pending = false;
+
+        if (!item->events) {
+            item->revents = 0;
+            continue;
+        }
+
+        if (item->socket) {
+            checking = item;
+            size_t events_size = sizeof (uint32_t);
+            uint32_t events;
+            const int rc = item->socket->getsockopt (ZMQ_EVENTS, &events,
+                &events_size);
+            checking = NULL;
+            if (rc == -1)
+                continue;
+
+            if (item->events & events) {
+                make_pending (item);
+                event_->socket = item->socket;
+                event_->user_data = item->user_data;
+                event_->events = item->events & events;
+                return true;
+            }
+        }
+        else {
+            //  The raw file descriptor is reported again by the level
+            //  triggered epoll set for as long as it stays ready.
+            short events = 0;
+            if (item->revents & EPOLLIN)
+                events |= ZMQ_POLLIN;
+            if (item->revents & EPOLLOUT)
+                events |= ZMQ_POLLOUT;
+            if (item->revents & EPOLLPRI)
+                events |= ZMQ_POLLPRI;
+            if (item->revents & ~(EPOLLIN | EPOLLOUT | EPOLLPRI))
+                events |= ZMQ_POLLERR;
+            item->revents = 0;
+
+            if (events) {
+                event_->socket = NULL;
+                event_->user_data = item->user_data;
+                event_->fd = item->fd;
+                event_->events = events;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+#endif
+
 int zmq::socket_poller_t::rebuild () 
 {
-#if defined ZMQ_POLL_BASED_ON_POLL
+#if defined ZMQ_USE_EPOLL
+
+    //  The epoll set is kept up to date by add, modify and remove.
+
+#elif defined ZMQ_POLL_BASED_ON_POLL
 
     if (pollfds) {
         free (pollfds);
@@ -219,12 +449,12 @@ int zmq::socket_poller_t::rebuild ()
     poll_size = 0;
 
     for (items_t::iterator it = items.begin (); it != items.end (); ++it) {
-        if (it->events) {
-            if (it->socket) {
+        if ((*it)->events) {
+            if ((*it)->socket) {
                 int thread_safe;
                 size_t thread_safe_size = sizeof(int);
 
-                if (it->socket->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == -1)
+                if ((*it)->socket->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == -1)
                     return -1;
 
                 if (thread_safe) {
@@ -256,17 +486,17 @@ int zmq::socket_poller_t::rebuild ()
     }
 
     for (items_t::iterator it = items.begin (); it != items.end (); ++it) {        
-        if (it->events) {
-            if (it->socket) {
+        if ((*it)->events) {
+            if ((*it)->socket) {
                 int thread_safe;
                 size_t thread_safe_size = sizeof(int);
 
-                if (it->socket->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == -1)
+                if ((*it)->socket->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == -1)
                     return -1;
 
                 if (!thread_safe) {                
                     size_t fd_size = sizeof (zmq::fd_t);
-                    if (it->socket->getsockopt (ZMQ_FD, &pollfds [item_nbr].fd, &fd_size) == -1) {
+                    if ((*it)->socket->getsockopt (ZMQ_FD, &pollfds [item_nbr].fd, &fd_size) == -1) {
                         return -1;
                     }
                             
@@ -275,12 +505,12 @@ int zmq::socket_poller_t::rebuild ()
                 }
             }
             else {
-                pollfds [item_nbr].fd = it->fd;
+                pollfds [item_nbr].fd = (*it)->fd;
                 pollfds [item_nbr].events =
-                    (it->events & ZMQ_POLLIN ? POLLIN : 0) |
-                    (it->events & ZMQ_POLLOUT ? POLLOUT : 0) |
-                    (it->events & ZMQ_POLLPRI ? POLLPRI : 0);
-                it->pollfd_index = item_nbr;
+                    ((*it)->events & ZMQ_POLLIN ? POLLIN : 0) |
+                    ((*it)->events & ZMQ_POLLOUT ? POLLOUT : 0) |
+                    ((*it)->events & ZMQ_POLLPRI ? POLLPRI : 0);
+                (*it)->pollfd_index = item_nbr;
                 item_nbr++;                
             }
         }
@@ -301,14 +531,14 @@ int zmq::socket_poller_t::rebuild ()
     use_signaler = false;
 
     for (items_t::iterator it = items.begin (); it != items.end (); ++it) {
-        if (it->socket) {
+        if ((*it)->socket) {
             int thread_safe;
             size_t thread_safe_size = sizeof(int);
 
-            if (it->socket->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == -1)
+            if ((*it)->socket->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == -1)
                 return -1;
 
-            if (thread_safe && it->events) {
+            if (thread_safe && (*it)->events) {
                 use_signaler = true;
                 FD_SET (signaler.get_fd (), &pollset_in);
                 poll_size = 1;
@@ -321,20 +551,20 @@ int zmq::socket_poller_t::rebuild ()
 
     //  Build the fd_sets for passing to select ().
     for (items_t::iterator it = items.begin (); it != items.end (); ++it) {
-        if (it->events) {
+        if ((*it)->events) {
             //  If the poll item is a 0MQ socket we are interested in input on the
             //  notification file descriptor retrieved by the ZMQ_FD socket option.
-            if (it->socket) {
+            if ((*it)->socket) {
                 int thread_safe;
                 size_t thread_safe_size = sizeof(int);
 
-                if (it->socket->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == -1)
+                if ((*it)->socket->getsockopt (ZMQ_THREAD_SAFE, &thread_safe, &thread_safe_size) == -1)
                     return -1;
 
                 if (!thread_safe) {
                     zmq::fd_t notify_fd;
                     size_t fd_size = sizeof (zmq::fd_t);
-                    if (it->socket->getsockopt (ZMQ_FD, &notify_fd, &fd_size) == -1)
+                    if ((*it)->socket->getsockopt (ZMQ_FD, &notify_fd, &fd_size) == -1)
                         return -1;
 
                     FD_SET (notify_fd, &pollset_in);
@@ -347,14 +577,14 @@ int zmq::socket_poller_t::rebuild ()
             //  Else, the poll item is a raw file descriptor. Convert the poll item
             //  events to the appropriate fd_sets.
             else {
-                if (it->events & ZMQ_POLLIN)
-                    FD_SET (it->fd, &pollset_in);
-                if (it->events & ZMQ_POLLOUT)
-                    FD_SET (it->fd, &pollset_out);
-                if (it->events & ZMQ_POLLERR)
-                    FD_SET (it->fd, &pollset_err);
-                if (maxfd < it->fd)
-                    maxfd = it->fd;
+                if ((*it)->events & ZMQ_POLLIN)
+                    FD_SET ((*it)->fd, &pollset_in);
+                if ((*it)->events & ZMQ_POLLOUT)
+                    FD_SET ((*it)->fd, &pollset_out);
+                if ((*it)->events & ZMQ_POLLERR)
+                    FD_SET ((*it)->fd, &pollset_err);
+                if (maxfd < (*it)->fd)
+                    maxfd = (*it)->fd;
 
                 poll_size++;
             }
@@ -373,7 +603,95 @@ int zmq::socket_poller_t::wait (zmq::socket_poller_t::event_t *event_, long time
         if (rebuild () == -1)
             return -1;
 
-#if defined ZMQ_POLL_BASED_ON_POLL
+#if defined ZMQ_USE_EPOLL
+    if (unlikely (items.empty ())) {
+        if (timeout_ == 0)
+            return 0;
+        return usleep (timeout_ * 1000);
+    }
+
+    zmq::clock_t clock;
+    uint64_t now = 0;
+    uint64_t end = 0;
+
+    bool first_pass = true;
+    epoll_event ev_buf [max_io_events];
+
+    while (true) {
+        //  Compute the timeout for the subsequent poll.
+        int timeout;
+        if (first_pass)
+            timeout = 0;
+        else
+        if (timeout_ < 0)
+            timeout = -1;
+        else
+            timeout = end - now;
+
+        //  Wait for events.
+        const int n = epoll_wait (epoll_fd, &ev_buf [0], max_io_events,
+            timeout);
+        if (n == -1) {
+            errno_assert (errno == EINTR);
+            return -1;
+        }
+
+        for (int i = 0; i != n; i++) {
+            item_t *item = (item_t*) ev_buf [i].data.ptr;
+
+            //  The signaler does not tell which thread-safe socket got
+            //  a command, so check all of them.
+            if (!item) {
+                signaler.recv ();
+                for (items_t::iterator it = safe_items.begin ();
+                      it != safe_items.end (); ++it)
+                    make_pending (*it);
+                continue;
+            }
+            if (!item->socket)
+                item->revents = ev_buf [i].events;
+            make_pending (item);
+        }
+
+        //  Check for the events.
+        if (check_pending (event_))
+            return 0;
+
+        //  If timeout is zero, exit immediately whether there are events or not.
+        if (timeout_ == 0)
+            break;
+
+        //  At this point we are meant to wait for events but there are none.
+        //  If timeout is infinite we can just loop until we get some events.
+        if (timeout_ < 0) {
+            if (first_pass)
+                first_pass = false;
+            continue;
+        }
+
+        //  The timeout is finite and there are no events. In the first pass
+        //  we get a timestamp of when the polling have begun. (We assume that
+        //  first pass have taken negligible time). We also compute the time
+        //  when the polling should time out.
+        if (first_pass) {
+            now = clock.now_ms ();
+            end = now + timeout_;
+            if (now == end)
+                break;
+            first_pass = false;
+            continue;
+        }
+
+        //  Find out whether timeout have expired.
+        now = clock.now_ms ();
+        if (now >= end)
+            break;
+    }
+
+    errno = ETIMEDOUT;
+    return -1;
+
+#elif defined ZMQ_POLL_BASED_ON_POLL
     if (unlikely (poll_size == 0)) {
         if (timeout_ == 0)
             return 0;
@@ -424,17 +742,17 @@ int zmq::socket_poller_t::wait (zmq::socket_poller_t::event_t *event_, long time
 
             //  The poll item is a 0MQ socket. Retrieve pending events
             //  using the ZMQ_EVENTS socket option.
-            if (it->socket) {
+            if ((*it)->socket) {
                 size_t events_size = sizeof (uint32_t);
                 uint32_t events;
-                if (it->socket->getsockopt (ZMQ_EVENTS, &events, &events_size) == -1) {
+                if ((*it)->socket->getsockopt (ZMQ_EVENTS, &events, &events_size) == -1) {
                     return -1;
                 }
 
-                if (it->events & events) {
-                    event_->socket = it->socket;
-                    event_->user_data = it->user_data;
-                    event_->events = it->events & events;
+                if ((*it)->events & events) {
+                    event_->socket = (*it)->socket;
+                    event_->user_data = (*it)->user_data;
+                    event_->events = (*it)->events & events;
 
                     //  If there is event to return, we can exit immediately.
                     return 0;
@@ -443,7 +761,7 @@ int zmq::socket_poller_t::wait (zmq::socket_poller_t::event_t *event_, long time
             //  Else, the poll item is a raw file descriptor, simply convert
             //  the events to zmq_pollitem_t-style format.
             else {
-                short revents = pollfds [it->pollfd_index].revents;
+                short revents = pollfds [(*it)->pollfd_index].revents;
                 short events = 0;           
                 
                 if (revents & POLLIN)
@@ -457,8 +775,8 @@ int zmq::socket_poller_t::wait (zmq::socket_poller_t::event_t *event_, long time
 
                 if (events) {
                     event_->socket = NULL;
-                    event_->user_data = it->user_data;
-                    event_->fd = it->fd;
+                    event_->user_data = (*it)->user_data;
+                    event_->fd = (*it)->fd;
                     event_->events = events;
 
                     //  If there is event to return, we can exit immediately.
@@ -569,16 +887,16 @@ int zmq::socket_poller_t::wait (zmq::socket_poller_t::event_t *event_, long time
 
             //  The poll item is a 0MQ socket. Retrieve pending events
             //  using the ZMQ_EVENTS socket option.
-            if (it->socket) {
+            if ((*it)->socket) {
                 size_t events_size = sizeof (uint32_t);
                 uint32_t events;
-                if (it->socket->getsockopt (ZMQ_EVENTS, &events, &events_size) == -1)
+                if ((*it)->socket->getsockopt (ZMQ_EVENTS, &events, &events_size) == -1)
                     return -1;
 
-                if (it->events & events) {
-                    event_->socket = it->socket;
-                    event_->user_data = it->user_data;
-                    event_->events = it->events & events;
+                if ((*it)->events & events) {
+                    event_->socket = (*it)->socket;
+                    event_->user_data = (*it)->user_data;
+                    event_->events = (*it)->events & events;
 
                     //  If there is event to return, we can exit immediately.
                     return 0;
@@ -589,17 +907,17 @@ int zmq::socket_poller_t::wait (zmq::socket_poller_t::event_t *event_, long time
             else {
                 short events = 0;
 
-                if (FD_ISSET (it->fd, &inset))
+                if (FD_ISSET ((*it)->fd, &inset))
                     events |= ZMQ_POLLIN;
-                if (FD_ISSET (it->fd, &outset))
+                if (FD_ISSET ((*it)->fd, &outset))
                     events |= ZMQ_POLLOUT;
-                if (FD_ISSET (it->fd, &errset))
+                if (FD_ISSET ((*it)->fd, &errset))
                     events |= ZMQ_POLLERR;
     
                 if (events) {
                     event_->socket = NULL;
-                    event_->user_data = it->user_data;
-                    event_->fd = it->fd;
+                    event_->user_data = (*it)->user_data;
+                    event_->fd = (*it)->fd;
                     event_->events = events;
 
                     //  If there is event to return, we can exit immediately.
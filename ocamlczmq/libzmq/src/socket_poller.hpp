@@ -32,7 +32,10 @@
 
 #include "poller.hpp"
 
-#if defined ZMQ_POLL_BASED_ON_POLL
+#if defined ZMQ_USE_EPOLL
+#include <sys/epoll.h>
+#include <unistd.h>
+#elif defined ZMQ_POLL_BASED_ON_POLL
 #include <poll.h>
 #endif
 
@@ -43,6 +46,7 @@
 #endif
 
 #include <vector>
+#include <deque>
 #include <algorithm>
 
 #include "socket_base.hpp"
@@ -75,6 +79,9 @@ namespace zmq
 
         int wait (event_t *event, long timeout);
 
+        //  Called by a registered socket whose readiness may have changed.
+        void touch (void *item_);
+
         //  Return false if object is not a socket.
         bool check_tag ();
 
@@ -92,15 +99,24 @@ namespace zmq
             fd_t fd;
             void *user_data; 
             short events;
-#if defined ZMQ_POLL_BASED_ON_POLL
+#if defined ZMQ_USE_EPOLL
+            bool thread_safe;
+            //  True iff the item is in the pending queue.
+            bool pending;
+            //  Events last reported by epoll for a raw file descriptor.
+            uint32_t revents;
+#elif defined ZMQ_POLL_BASED_ON_POLL
             int  pollfd_index;
 #endif
         } item_t;
 
         //  List of sockets
-        typedef std::vector <item_t> items_t;
+        typedef std::vector <item_t*> items_t;
         items_t items;
 
+        items_t::iterator find (socket_base_t *socket_);
+        items_t::iterator find_fd (fd_t fd_);
+
         //  Does the pollset needs rebuilding?
         bool need_rebuild;
 
@@ -110,7 +126,30 @@ namespace zmq
         //  Size of the pollset
         int poll_size;
    
-#if defined ZMQ_POLL_BASED_ON_POLL
+#if defined ZMQ_USE_EPOLL
+        //  The items are registered with the epoll set for as long as
+        //  they are in the poller, so a wait does not depend on how many
+        //  there are. The epoll set reports sockets that have received
+        //  commands and file descriptors that are ready. Sockets may
+        //  also become ready through calls made by the application, and
+        //  then touch the poller. Either way the item lands in the
+        //  pending queue, and only the pending items are checked.
+        fd_t epoll_fd;
+
+        int ctl (int op_, item_t *item_);
+        void make_pending (item_t *item_);
+        bool check_pending (event_t *event_);
+
+        typedef std::deque <item_t*> pending_t;
+        pending_t pending;
+
+        //  Thread-safe sockets, all of which are checked whenever the
+        //  signaler fires.
+        items_t safe_items;
+
+        //  Item being checked; its touches are ignored.
+        item_t *checking;
+#elif defined ZMQ_POLL_BASED_ON_POLL
         pollfd *pollfds;
 #elif defined ZMQ_POLL_BASED_ON_SELECT
         fd_set pollset_in;
@@ -0,0 +1,117 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <algorithm>
+
+#include "socket_stats.hpp"
+#include "err.hpp"
+
+zmq::socket_stats_t::socket_stats_t () :
+    msgs_in (0),
+    msgs_out (0),
+    bytes_in (0),
+    bytes_out (0),
+    hwm_stalls (0),
+    medium_msgs (0),
+    medium_misses (0),
+    refs (1)
+{
+    memset (&retired, 0, sizeof retired);
+}
+
+zmq::socket_stats_t::~socket_stats_t ()
+{
+    zmq_assert (engines.empty ());
+}
+
+void zmq::socket_stats_t::add_ref ()
+{
+    refs.add (1);
+}
+
+void zmq::socket_stats_t::release ()
+{
+    if (!refs.sub (1))
+        delete this;
+}
+
+void zmq::socket_stats_t::attach (engine_stats_t *engine_)
+{
+    scoped_lock_t lock (sync);
+    engines.push_back (engine_);
+}
+
+void zmq::socket_stats_t::detach (engine_stats_t *engine_)
+{
+    scoped_lock_t lock (sync);
+    engines_t::iterator it =
+        std::find (engines.begin (), engines.end (), engine_);
+    zmq_assert (it != engines.end ());
+    engines.erase (it);
+
+    retired.bytes_in += engine_->bytes_in;
+    retired.bytes_out += engine_->bytes_out;
+    retired.read_calls += engine_->read_calls;
+    retired.write_calls += engine_->write_calls;
+    retired.medium_msgs += engine_->medium_msgs;
+    retired.medium_misses += engine_->medium_misses;
+}
+
+void zmq::socket_stats_t::get (zmq_socket_stats_t *stats_)
+{
+    stats_->msgs_in = msgs_in;
+    stats_->msgs_out = msgs_out;
+    stats_->bytes_in = bytes_in;
+    stats_->bytes_out = bytes_out;
+    stats_->hwm_stalls = hwm_stalls;
+    stats_->medium_msgs = medium_msgs;
+    stats_->medium_misses = medium_misses;
+
+    scoped_lock_t lock (sync);
+    stats_->wire_bytes_in = retired.bytes_in;
+    stats_->wire_bytes_out = retired.bytes_out;
+    stats_->read_calls = retired.read_calls;
+    stats_->write_calls = retired.write_calls;
+    stats_->medium_msgs += retired.medium_msgs;
+    stats_->medium_misses += retired.medium_misses;
+    stats_->decoder_bytes = 0;
+    stats_->encoder_bytes = 0;
+    for (engines_t::size_type i = 0; i != engines.size (); i++) {
+        const engine_stats_t *engine = engines [i];
+        stats_->wire_bytes_in += engine->bytes_in;
+        stats_->wire_bytes_out += engine->bytes_out;
+        stats_->read_calls += engine->read_calls;
+        stats_->write_calls += engine->write_calls;
+        stats_->decoder_bytes += engine->decoder_bytes;
+        stats_->encoder_bytes += engine->encoder_bytes;
+        stats_->medium_msgs += engine->medium_msgs;
+        stats_->medium_misses += engine->medium_misses;
+    }
+}
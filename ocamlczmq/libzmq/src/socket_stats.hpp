@@ -0,0 +1,122 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ZMQ_SOCKET_STATS_HPP_INCLUDED__
+#define __ZMQ_SOCKET_STATS_HPP_INCLUDED__
+
+#include <vector>
+
+#include "../include/zmq.h"
+#include "stdint.hpp"
+#include "mutex.hpp"
+#include "atomic_counter.hpp"
+
+namespace zmq
+{
+
+    //  Counters of a single stream engine. They are written only from the
+    //  engine's I/O thread and read without locking when the statistics
+    //  are collected, so the reader may see slightly stale values.
+    struct engine_stats_t
+    {
+        uint64_t bytes_in;
+        uint64_t bytes_out;
+        uint64_t read_calls;
+        uint64_t write_calls;
+
+        //  Bytes read but not decoded yet and bytes encoded but not
+        //  written yet, respectively.
+        uint64_t decoder_bytes;
+        uint64_t encoder_bytes;
+
+        //  Copied from the counters of the decoder's medium message buffer.
+        uint64_t medium_msgs;
+        uint64_t medium_misses;
+    };
+
+    //  Runtime statistics of a socket. Counters owned by the socket's
+    //  thread are plain members. Engines running in I/O threads register
+    //  their own counter blocks which are summed up on read, so neither
+    //  side pays for atomic operations on the data path.
+    //
+    //  The object is reference counted because engines are destroyed
+    //  asynchronously and may outlive the socket by a little.
+
+    class socket_stats_t
+    {
+    public:
+
+        socket_stats_t ();
+
+        void add_ref ();
+
+        //  Drops a reference and deallocates the object if it was the
+        //  last one.
+        void release ();
+
+        //  Registers or unregisters an engine's counters. Unregistering
+        //  keeps the cumulative counters of the engine.
+        void attach (engine_stats_t *engine_);
+        void detach (engine_stats_t *engine_);
+
+        //  Fills in the socket counters and the sum of engine counters.
+        void get (zmq_socket_stats_t *stats_);
+
+        //  Counters maintained by the socket's thread.
+        uint64_t msgs_in;
+        uint64_t msgs_out;
+        uint64_t bytes_in;
+        uint64_t bytes_out;
+        uint64_t hwm_stalls;
+        uint64_t medium_msgs;
+        uint64_t medium_misses;
+
+    private:
+
+        ~socket_stats_t ();
+
+        atomic_counter_t refs;
+
+        //  Synchronises registration of engines. Engine counters
+        //  themselves are read without locking.
+        mutex_t sync;
+
+        typedef std::vector <engine_stats_t *> engines_t;
+        engines_t engines;
+
+        //  Cumulative counters of engines that have already been detached.
+        engine_stats_t retired;
+
+        socket_stats_t (const socket_stats_t&);
+        const socket_stats_t &operator = (const socket_stats_t&);
+    };
+
+}
+
+#endif
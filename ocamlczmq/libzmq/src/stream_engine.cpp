@@ -47,6 +47,7 @@
 #include <string.h>
 #include <new>
 #include <sstream>
+#include <algorithm>
 
 #include "stream_engine.hpp"
 #include "io_thread.hpp"
@@ -55,6 +56,7 @@
 #include "v1_decoder.hpp"
 #include "v2_encoder.hpp"
 #include "v2_decoder.hpp"
+#include "mmsg_buffer.hpp"
 #include "null_mechanism.hpp"
 #include "plain_client.hpp"
 #include "plain_server.hpp"
@@ -64,12 +66,40 @@
 #include "curve_server.hpp"
 #include "raw_decoder.hpp"
 #include "raw_encoder.hpp"
+#include "lz_codec.hpp"
 #include "config.hpp"
+#include "clock.hpp"
 #include "err.hpp"
 #include "ip.hpp"
 #include "tcp.hpp"
 #include "likely.hpp"
 #include "wire.hpp"
+#include "trace.hpp"
+
+//  Doubles the batch size if filled_ bytes used the batch up, or halves it
+//  once adaptive_batch_shrink batches in a row used less than a quarter of
+//  it, keeping it between min_ and adaptive_batch_factor times min_.
+//  Returns true if the size changed.
+static bool adapt_batch (size_t &batch_, int &short_batches_, size_t filled_,
+    size_t min_)
+{
+    if (filled_ == batch_) {
+        short_batches_ = 0;
+        if (batch_ >= min_ * zmq::adaptive_batch_factor)
+            return false;
+        batch_ = std::min (batch_ * 2, min_ * zmq::adaptive_batch_factor);
+        return true;
+    }
+    if (filled_ >= batch_ / 4 || batch_ <= min_) {
+        short_batches_ = 0;
+        return false;
+    }
+    if (++short_batches_ < zmq::adaptive_batch_shrink)
+        return false;
+    short_batches_ = 0;
+    batch_ = std::max (batch_ / 2, min_);
+    return true;
+}
 
 zmq::stream_engine_t::stream_engine_t (fd_t fd_, const options_t &options_,
                                        const std::string &endpoint_) :
@@ -80,11 +110,21 @@ zmq::stream_engine_t::stream_engine_t (fd_t fd_, const options_t &options_,
     outpos (NULL),
     outsize (0),
     encoder (NULL),
+    in_batch (options_.tcp_recv_buffer_size),
+    out_batch (options_.tcp_send_buffer_size),
+    in_short_batches (0),
+    out_short_batches (0),
+    bodypos (NULL),
+    bodysize (0),
+    zerocopy (false),
+    body_zerocopy (false),
+    zerocopy_first (0),
     metadata (NULL),
     handshaking (true),
     greeting_size (v2_greeting_size),
     greeting_bytes_read (0),
     session (NULL),
+    io_thread (NULL),
     options (options_),
     endpoint (endpoint_),
     plugged (false),
@@ -92,7 +132,10 @@ zmq::stream_engine_t::stream_engine_t (fd_t fd_, const options_t &options_,
     process_msg (&stream_engine_t::process_identity_msg),
     io_error (false),
     subscription_required (false),
+    peer_priority (false),
     mechanism (NULL),
+    compressor (NULL),
+    medium_buffer (NULL),
     input_stopped (false),
     output_stopped (false),
     has_handshake_timer (false),
@@ -100,11 +143,16 @@ zmq::stream_engine_t::stream_engine_t (fd_t fd_, const options_t &options_,
     has_timeout_timer (false),
     has_heartbeat_timer (false),
     heartbeat_timeout (0),
-    socket (NULL)
+    has_coalesce_timer (false),
+    coalesce_due (false),
+    socket (NULL),
+    socket_stats (NULL)
 {
     int rc = tx_msg.init ();
     errno_assert (rc == 0);
 
+    memset (&stats, 0, sizeof stats);
+
     //  Put the socket into non-blocking mode.
     unblock_socket (s);
 
@@ -157,6 +205,22 @@ zmq::stream_engine_t::~stream_engine_t ()
 {
     zmq_assert (!plugged);
 
+    //  The kernel may still be sending from messages sent with
+    //  MSG_ZEROCOPY. Unless the connection has failed, give it some time
+    //  to finish before the messages are released.
+    if (!zerocopy_sends.empty () && !io_error) {
+        clock_t clock;
+        const uint64_t end = clock.now_ms () + zerocopy_linger;
+        for (uint64_t now = clock.now_ms ();
+              !zerocopy_sends.empty () && now < end; now = clock.now_ms ())
+            reap_zerocopy ((int) (end - now));
+    }
+    while (!zerocopy_sends.empty ()) {
+        int rc = zerocopy_sends.front ().msg.close ();
+        errno_assert (rc == 0);
+        zerocopy_sends.pop_front ();
+    }
+
     if (s != retired_fd) {
 #ifdef ZMQ_HAVE_WINDOWS
         int rc = closesocket (s);
@@ -181,7 +245,15 @@ zmq::stream_engine_t::~stream_engine_t ()
 
     LIBZMQ_DELETE(encoder);
     LIBZMQ_DELETE(decoder);
+    if (medium_buffer)
+        medium_buffer->orphan ();
     LIBZMQ_DELETE(mechanism);
+    LIBZMQ_DELETE(compressor);
+
+    if (socket_stats) {
+        socket_stats->detach (&stats);
+        socket_stats->release ();
+    }
 }
 
 void zmq::stream_engine_t::plug (io_thread_t *io_thread_,
@@ -196,11 +268,22 @@ void zmq::stream_engine_t::plug (io_thread_t *io_thread_,
     session = session_;
     socket = session-> get_socket ();
 
+    //  Report our counters to the socket. The statistics object is kept
+    //  alive until we are done with it.
+    socket_stats = socket->get_stats ();
+    socket_stats->add_ref ();
+    socket_stats->attach (&stats);
+
     //  Connect to I/O threads poller object.
     io_object_t::plug (io_thread_);
+    io_thread = io_thread_;
+    io_thread->add_engine (this);
     handle = add_fd (s);
     io_error = false;
 
+    if (options.zerocopy_threshold > 0)
+        zerocopy = tcp_enable_zerocopy (s);
+
     if (options.raw_socket) {
         // no handshaking for raw sock, instantiate raw encoder and decoders
         encoder = new (std::nothrow) raw_encoder_t (options.tcp_send_buffer_size);
@@ -276,16 +359,75 @@ void zmq::stream_engine_t::unplug ()
         cancel_timer (heartbeat_ivl_timer_id);
         has_heartbeat_timer = false;
     }
+
+    if (has_coalesce_timer) {
+        cancel_timer (coalesce_timer_id);
+        has_coalesce_timer = false;
+    }
     //  Cancel all fd subscriptions.
     if (!io_error)
         rm_fd (handle);
 
     //  Disconnect from I/O threads poller object.
+    io_thread->rm_engine (this);
+    io_thread = NULL;
     io_object_t::unplug ();
 
     session = NULL;
 }
 
+bool zmq::stream_engine_t::migratable () const
+{
+    return plugged && !handshaking && !io_error && !has_handshake_timer
+        && !has_ttl_timer && !has_timeout_timer && !has_coalesce_timer;
+}
+
+void zmq::stream_engine_t::migrate_out ()
+{
+    zmq_assert (migratable ());
+
+    if (has_heartbeat_timer)
+        cancel_timer (heartbeat_ivl_timer_id);
+    rm_fd (handle);
+
+    io_thread->rm_engine (this);
+    io_thread = NULL;
+    io_object_t::unplug ();
+}
+
+void zmq::stream_engine_t::migrate_in (io_thread_t *io_thread_)
+{
+    io_object_t::plug (io_thread_);
+    io_thread = io_thread_;
+    io_thread->add_engine (this);
+
+    //  Restore the polling state. The poller is level-triggered, so any
+    //  data that arrived meanwhile is picked up straight away.
+    handle = add_fd (s);
+    if (!input_stopped)
+        set_pollin (handle);
+    if (!output_stopped)
+        set_pollout (handle);
+
+    if (has_heartbeat_timer)
+        add_timer (options.heartbeat_interval, heartbeat_ivl_timer_id);
+}
+
+uint64_t zmq::stream_engine_t::get_events () const
+{
+    return stats.read_calls + stats.write_calls;
+}
+
+zmq::session_base_t *zmq::stream_engine_t::get_session ()
+{
+    return session;
+}
+
+uint64_t zmq::stream_engine_t::get_affinity () const
+{
+    return options.affinity;
+}
+
 void zmq::stream_engine_t::terminate ()
 {
     unplug ();
@@ -296,6 +438,12 @@ void zmq::stream_engine_t::in_event ()
 {
     zmq_assert (!io_error);
 
+    //  Completed MSG_ZEROCOPY sends are reported as a socket error. If
+    //  that's what the event was about, there's nothing more to do.
+    if (!zerocopy_sends.empty ())
+        if (reap_zerocopy (0) && input_stopped)
+            return;
+
     //  If still handshaking, receive and process the greeting message.
     if (unlikely (handshaking))
         if (!handshake ())
@@ -321,6 +469,7 @@ void zmq::stream_engine_t::in_event ()
         decoder->get_buffer (&inpos, &bufsize);
 
         const int rc = tcp_read (s, inpos, bufsize);
+        stats.read_calls++;
 
         if (rc == 0) {
             error (connection_error);
@@ -334,8 +483,18 @@ void zmq::stream_engine_t::in_event ()
 
         //  Adjust input size
         insize = static_cast <size_t> (rc);
+        stats.bytes_in += insize;
+        if (unlikely (trace_enabled))
+            trace_record (ZMQ_TRACE_READ, this, stats.bytes_in);
         // Adjust buffer size to received bytes
         decoder->resize_buffer(insize);
+
+        //  Size the next batch to the traffic. Reads straight into a large
+        //  message don't count.
+        if (options.adaptive_batch && bufsize == in_batch
+        &&  adapt_batch (in_batch, in_short_batches, insize,
+              options.tcp_recv_buffer_size))
+            decoder->set_batch_size (in_batch);
     }
 
     int rc = 0;
@@ -348,11 +507,21 @@ void zmq::stream_engine_t::in_event ()
         insize -= processed;
         if (rc == 0 || rc == -1)
             break;
+        //  The frame ends where the unprocessed input starts.
+        if (unlikely (trace_enabled)
+              && !(decoder->msg ()->flags () & msg_t::command))
+            trace_record (ZMQ_TRACE_DECODE, this, stats.bytes_in - insize);
         rc = (this->*process_msg) (decoder->msg ());
         if (rc == -1)
             break;
     }
 
+    stats.decoder_bytes = insize;
+    if (medium_buffer) {
+        stats.medium_msgs = medium_buffer->msgs;
+        stats.medium_misses = medium_buffer->misses;
+    }
+
     //  Tear down the connection if we have failed to decode input data
     //  or the session has rejected the message.
     if (rc == -1) {
@@ -372,7 +541,9 @@ void zmq::stream_engine_t::out_event ()
     zmq_assert (!io_error);
 
     //  If write buffer is empty, try to read new data from the encoder.
-    if (!outsize) {
+    //  A batch held back by ZMQ_COALESCE_IVL is topped up instead.
+    const bool held = has_coalesce_timer || coalesce_due;
+    if (held || (!outsize && !bodysize)) {
 
         //  Even when we stop polling as soon as there is no
         //  data to send, the poller may invoke out_event one
@@ -382,23 +553,70 @@ void zmq::stream_engine_t::out_event ()
             return;
         }
 
-        outpos = NULL;
-        outsize = encoder->encode (&outpos, 0);
+        if (!held) {
+            //  The encoder's buffer is free to be resized until the batch
+            //  is encoded into it.
+            if (options.adaptive_batch)
+                encoder->set_batch_size (out_batch);
 
-        while (outsize < options.tcp_send_buffer_size) {
+            outpos = NULL;
+            outsize = encode (&outpos, 0);
+        }
+
+        while (outsize < out_batch && !bodysize) {
             if ((this->*next_msg) (&tx_msg) == -1)
                 break;
+            //  Everything before the batch has been written, so the frame
+            //  starts this far into the stream.
+            if (unlikely (trace_enabled)
+                  && !(tx_msg.flags () & msg_t::command))
+                trace_record (ZMQ_TRACE_ENCODE, this,
+                    stats.bytes_out + outsize);
             encoder->load_msg (&tx_msg);
             unsigned char *bufptr = outpos + outsize;
-            size_t n = encoder->encode (&bufptr, options.tcp_send_buffer_size - outsize);
-            zmq_assert (n > 0);
+            size_t n = encode (&bufptr, out_batch - outsize);
+            zmq_assert (n > 0 || bodysize > 0);
             if (outpos == NULL)
                 outpos = bufptr;
             outsize += n;
         }
 
+        //  Hold a small batch back until it grows to ZMQ_COALESCE_BYTES or
+        //  ZMQ_COALESCE_IVL runs out, so that a trickle of small messages
+        //  takes one write rather than one each. Handshake commands are
+        //  never held.
+        if (options.coalesce_ivl && !coalesce_due && outsize && !bodysize
+              && outsize < coalesce_limit ()
+              && next_msg != &stream_engine_t::next_handshake_command) {
+            if (!has_coalesce_timer) {
+                add_timer (options.coalesce_ivl, coalesce_timer_id);
+                has_coalesce_timer = true;
+            }
+            if (!output_stopped) {
+                output_stopped = true;
+                reset_pollout (handle);
+            }
+            stats.encoder_bytes = outsize;
+            return;
+        }
+        if (held) {
+            if (has_coalesce_timer) {
+                cancel_timer (coalesce_timer_id);
+                has_coalesce_timer = false;
+            }
+            coalesce_due = false;
+            if (output_stopped) {
+                set_pollout (handle);
+                output_stopped = false;
+            }
+        }
+
+        if (options.adaptive_batch)
+            adapt_batch (out_batch, out_short_batches, outsize,
+                options.tcp_send_buffer_size);
+
         //  If there is no data to send, stop polling for output.
-        if (outsize == 0) {
+        if (outsize == 0 && bodysize == 0) {
             output_stopped = true;
             reset_pollout (handle);
             return;
@@ -410,7 +628,17 @@ void zmq::stream_engine_t::out_event ()
     //  arbitrarily large. However, we assume that underlying TCP layer has
     //  limited transmission buffer and thus the actual number of bytes
     //  written should be reasonably modest.
-    const int nbytes = tcp_write (s, outpos, outsize);
+    //  A body sent with MSG_ZEROCOPY is sent on its own, as the batch
+    //  buffer is reused straight away.
+    int nbytes;
+    if (body_zerocopy && !outsize)
+        nbytes = write_zerocopy ();
+    else
+    if (bodysize && !body_zerocopy)
+        nbytes = tcp_write_gather (s, outpos, outsize, bodypos, bodysize);
+    else
+        nbytes = tcp_write (s, outpos, outsize);
+    stats.write_calls++;
 
     //  IO error has occurred. We stop waiting for output events.
     //  The engine is not terminated until we detect input error;
@@ -420,22 +648,108 @@ void zmq::stream_engine_t::out_event ()
         return;
     }
 
-    outpos += nbytes;
-    outsize -= nbytes;
+    stats.bytes_out += nbytes;
+    if (unlikely (trace_enabled))
+        trace_record (ZMQ_TRACE_WRITE, this, stats.bytes_out);
+    if ((size_t) nbytes <= outsize) {
+        outpos += nbytes;
+        outsize -= nbytes;
+    }
+    else {
+        bodypos += nbytes - outsize;
+        bodysize -= nbytes - outsize;
+        outpos += outsize;
+        outsize = 0;
+    }
+    stats.encoder_bytes = outsize + bodysize;
 
     //  If we are still handshaking and there are no data
     //  to send, stop polling for output.
     if (unlikely (handshaking))
-        if (outsize == 0)
+        if (outsize == 0 && bodysize == 0)
             reset_pollout (handle);
 }
 
+size_t zmq::stream_engine_t::coalesce_limit () const
+{
+    if (options.coalesce_bytes && (size_t) options.coalesce_bytes < out_batch)
+        return (size_t) options.coalesce_bytes;
+    return out_batch;
+}
+
+size_t zmq::stream_engine_t::encode (unsigned char **data_, size_t size_)
+{
+    size_t threshold = (size_t) options.gather_threshold;
+    if (zerocopy && (!threshold ||
+          (size_t) options.zerocopy_threshold < threshold))
+        threshold = (size_t) options.zerocopy_threshold;
+    if (!threshold)
+        return encoder->encode (data_, size_);
+
+    //  Large message bodies are not copied to the batch. The batch is
+    //  complete once one is encountered and the body is written right
+    //  after it. As message buffers are shared between pipes, a message
+    //  published to many peers is then never copied per peer.
+    const size_t n = encoder->encode_gather (data_, size_, threshold,
+        &bodypos, &bodysize);
+    body_zerocopy =
+        zerocopy && bodysize >= (size_t) options.zerocopy_threshold;
+    return n;
+}
+
+int zmq::stream_engine_t::write_zerocopy ()
+{
+    bool copied;
+    const int nbytes = tcp_write_zerocopy (s, bodypos, bodysize, &copied);
+
+    //  The body belongs to the message being encoded, tx_msg. Keep a
+    //  reference to it until the kernel reports the send completed.
+    if (nbytes > 0 && !copied) {
+        zerocopy_send_t send;
+        int rc = send.msg.init ();
+        errno_assert (rc == 0);
+        rc = send.msg.copy (tx_msg);
+        errno_assert (rc == 0);
+        send.done = false;
+        zerocopy_sends.push_back (send);
+    }
+    return nbytes;
+}
+
+bool zmq::stream_engine_t::reap_zerocopy (int timeout_)
+{
+    bool reaped = false;
+    uint32_t first;
+    uint32_t last;
+    while (tcp_zerocopy_completion (s, &first, &last, timeout_)) {
+        reaped = true;
+        timeout_ = 0;
+
+        //  Sends may complete out of order, in ranges.
+        for (uint32_t send = first; ; send++) {
+            const uint32_t index = send - zerocopy_first;
+            if (index < zerocopy_sends.size ())
+                zerocopy_sends [index].done = true;
+            if (send == last)
+                break;
+        }
+        while (!zerocopy_sends.empty () && zerocopy_sends.front ().done) {
+            int rc = zerocopy_sends.front ().msg.close ();
+            errno_assert (rc == 0);
+            zerocopy_sends.pop_front ();
+            zerocopy_first++;
+        }
+    }
+    return reaped;
+}
+
 void zmq::stream_engine_t::restart_output ()
 {
     if (unlikely (io_error))
         return;
 
-    if (likely (output_stopped)) {
+    //  A batch being held back is topped up without polling for output.
+    if (likely (output_stopped) && !has_coalesce_timer) {
         set_pollout (handle);
         output_stopped = false;
     }
@@ -470,10 +784,18 @@ void zmq::stream_engine_t::restart_input ()
         insize -= processed;
         if (rc == 0 || rc == -1)
             break;
+        if (unlikely (trace_enabled)
+              && !(decoder->msg ()->flags () & msg_t::command))
+            trace_record (ZMQ_TRACE_DECODE, this, stats.bytes_in - insize);
         rc = (this->*process_msg) (decoder->msg ());
         if (rc == -1)
             break;
     }
+    stats.decoder_bytes = insize;
+    if (medium_buffer) {
+        stats.medium_msgs = medium_buffer->msgs;
+        stats.medium_misses = medium_buffer->misses;
+    }
 
     if (rc == -1 && errno == EAGAIN)
         session->flush ();
@@ -501,6 +823,7 @@ bool zmq::stream_engine_t::handshake ()
     while (greeting_bytes_read < greeting_size) {
         const int n = tcp_read (s, greeting_recv + greeting_bytes_read,
                                 greeting_size - greeting_bytes_read);
+        stats.read_calls++;
         if (n == 0) {
             error (connection_error);
             return false;
@@ -512,6 +835,7 @@ bool zmq::stream_engine_t::handshake ()
         }
 
         greeting_bytes_read += n;
+        stats.bytes_in += n;
 
         //  We have received at least one byte from the peer.
         //  If the first byte is not 0xff, we know that the
@@ -653,16 +977,28 @@ bool zmq::stream_engine_t::handshake ()
         encoder = new (std::nothrow) v2_encoder_t (options.tcp_send_buffer_size);
         alloc_assert (encoder);
 
+        if (options.medium_msg_size > 0) {
+            medium_buffer = new (std::nothrow) mmsg_buffer_t (
+                options.medium_msg_size, options.rcvhwm);
+            alloc_assert (medium_buffer);
+        }
+
         decoder = new (std::nothrow) v2_decoder_t (
-            options.tcp_recv_buffer_size, options.maxmsgsize);
+            options.tcp_recv_buffer_size, options.maxmsgsize, medium_buffer);
         alloc_assert (decoder);
     }
     else {
         encoder = new (std::nothrow) v2_encoder_t (options.tcp_send_buffer_size);
         alloc_assert (encoder);
 
+        if (options.medium_msg_size > 0) {
+            medium_buffer = new (std::nothrow) mmsg_buffer_t (
+                options.medium_msg_size, options.rcvhwm);
+            alloc_assert (medium_buffer);
+        }
+
         decoder = new (std::nothrow) v2_decoder_t (
-                options.tcp_recv_buffer_size, options.maxmsgsize);
+            options.tcp_recv_buffer_size, options.maxmsgsize, medium_buffer);
         alloc_assert (decoder);
 
         if (options.mechanism == ZMQ_NULL
@@ -690,7 +1026,7 @@ bool zmq::stream_engine_t::handshake ()
                 mechanism = new (std::nothrow)
                     curve_server_t (session, peer_address, options);
             else
-                mechanism = new (std::nothrow) curve_client_t (options);
+                mechanism = new (std::nothrow) curve_client_t (session, options);
             alloc_assert (mechanism);
         }
 #endif
@@ -853,6 +1189,18 @@ void zmq::stream_engine_t::mechanism_ready ()
     const properties_t& zmtp_properties = mechanism->get_zmtp_properties ();
     properties.insert(zmtp_properties.begin (), zmtp_properties.end ());
 
+    const properties_t::const_iterator it =
+        zmtp_properties.find ("Priority-Lanes");
+    peer_priority = it != zmtp_properties.end () && it->second == "1";
+
+    const properties_t::const_iterator compression =
+        zmtp_properties.find ("Compression");
+    if (options.compress_threshold && compression != zmtp_properties.end ()
+          && compression->second == "LZ") {
+        compressor = new (std::nothrow) lz_compressor_t ();
+        alloc_assert (compressor);
+    }
+
     zmq_assert (metadata == NULL);
     if (!properties.empty ())
         metadata = new (std::nothrow) metadata_t (properties);
@@ -860,7 +1208,12 @@ void zmq::stream_engine_t::mechanism_ready ()
 
 int zmq::stream_engine_t::pull_msg_from_session (msg_t *msg_)
 {
-    return session->pull_msg (msg_);
+    if (session->pull_msg (msg_) == -1)
+        return -1;
+
+    //  Peers older than ZMTP/3.0 can't be told about priority.
+    msg_->reset_flags (msg_t::priority);
+    return 0;
 }
 
 int zmq::stream_engine_t::push_msg_to_session (msg_t *msg_)
@@ -903,8 +1256,90 @@ int zmq::stream_engine_t::pull_and_encode (msg_t *msg_)
 
     if (session->pull_msg (msg_) == -1)
         return -1;
+
+    //  Compression comes before encryption, whose output doesn't compress.
+    const bool compressed = compressor
+        && msg_->size () >= (size_t) options.compress_threshold
+        && !(msg_->flags () & msg_t::command) && compress_msg (msg_);
+
+    //  The mechanism may replace the message, so the flags are put back on
+    //  whatever goes on the wire, if the peer understands them.
+    const bool priority = peer_priority &&
+        (msg_->flags () & msg_t::priority);
     if (mechanism->encode (msg_) == -1)
         return -1;
+    if (priority)
+        msg_->set_flags (msg_t::priority);
+    else
+        msg_->reset_flags (msg_t::priority);
+    if (compressed)
+        msg_->set_flags (msg_t::compressed);
+    else
+        msg_->reset_flags (msg_t::compressed);
+    return 0;
+}
+
+bool zmq::stream_engine_t::compress_msg (msg_t *msg_)
+{
+    //  The block has to save more than the size it is prefixed with.
+    const size_t size = msg_->size ();
+    const size_t saving = size / 32 + 4;
+    if (size <= saving || (uint64_t) size > 0xffffffffULL)
+        return false;
+
+    if (compress_buf.size () < size)
+        compress_buf.resize (size);
+    const size_t n = compressor->compress (
+        (const unsigned char *) msg_->data (), size, &compress_buf [0],
+        size - saving);
+    if (n == 0)
+        return false;
+
+    msg_t msg;
+    int rc = msg.init_size (n + 4);
+    errno_assert (rc == 0);
+    unsigned char *data = (unsigned char *) msg.data ();
+    put_uint32 (data, (uint32_t) size);
+    memcpy (data + 4, &compress_buf [0], n);
+    msg.set_flags (msg_->flags () & (msg_t::more | msg_t::priority));
+    rc = msg_->move (msg);
+    errno_assert (rc == 0);
+    return true;
+}
+
+int zmq::stream_engine_t::decompress_msg (msg_t *msg_)
+{
+    const size_t size = msg_->size ();
+    const unsigned char *data = (const unsigned char *) msg_->data ();
+    if (size < 4) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    //  The original size is checked before allocating anything, against
+    //  ZMQ_MAXMSGSIZE and against what the block can expand to.
+    const size_t original = get_uint32 (data);
+    if (original > (size - 4) * lz_max_ratio
+          || (options.maxmsgsize >= 0
+              && (int64_t) original > options.maxmsgsize)) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    msg_t msg;
+    int rc = msg.init_size (original);
+    if (rc == -1)
+        return -1;
+    if (lz_decompress (data + 4, size - 4, (unsigned char *) msg.data (),
+          original) == -1) {
+        rc = msg.close ();
+        errno_assert (rc == 0);
+        errno = EPROTO;
+        return -1;
+    }
+    msg.set_flags (msg_->flags () & (msg_t::more | msg_t::priority));
+    rc = msg_->move (msg);
+    errno_assert (rc == 0);
     return 0;
 }
 
@@ -912,8 +1347,14 @@ int zmq::stream_engine_t::decode_and_push (msg_t *msg_)
 {
     zmq_assert (mechanism != NULL);
 
+    const bool priority = (msg_->flags () & msg_t::priority) != 0;
+    const bool compressed = (msg_->flags () & msg_t::compressed) != 0;
     if (mechanism->decode (msg_) == -1)
         return -1;
+    if (priority)
+        msg_->set_flags (msg_t::priority);
+    if (compressed && decompress_msg (msg_) == -1)
+        return -1;
 
     if(has_timeout_timer) {
         has_timeout_timer = false;
@@ -1020,6 +1461,12 @@ void zmq::stream_engine_t::timer_event (int id_)
         has_timeout_timer = false;
         error(timeout_error);
     }
+    else if (id_ == coalesce_timer_id) {
+        has_coalesce_timer = false;
+        coalesce_due = true;
+        if (!io_error)
+            out_event ();
+    }
     else
         // There are no other valid timer ids!
         assert(false);
@@ -31,6 +31,8 @@
 #define __ZMQ_STREAM_ENGINE_HPP_INCLUDED__
 
 #include <stddef.h>
+#include <deque>
+#include <vector>
 
 #include "fd.hpp"
 #include "i_engine.hpp"
@@ -55,6 +57,8 @@ namespace zmq
     class msg_t;
     class session_base_t;
     class mechanism_t;
+    class lz_compressor_t;
+    class mmsg_buffer_t;
 
     //  This engine handles any socket with SOCK_STREAM semantics,
     //  e.g. TCP socket or an UNIX domain socket.
@@ -86,6 +90,20 @@ namespace zmq
         void out_event ();
         void timer_event (int id_);
 
+        //  Moving the engine to another I/O thread, see io_thread_t.
+        //  Only an engine done with the handshake that has no timeouts
+        //  pending is moved. migrate_out detaches the engine from the
+        //  current I/O thread and migrate_in attaches it to the new one.
+        bool migratable () const;
+        void migrate_out ();
+        void migrate_in (zmq::io_thread_t *io_thread_);
+
+        //  Returns the number of I/O events the engine has handled.
+        uint64_t get_events () const;
+
+        zmq::session_base_t *get_session ();
+        uint64_t get_affinity () const;
+
     private:
         //  Unplug the engine from the session.
         void unplug ();
@@ -93,6 +111,24 @@ namespace zmq
         //  Function to handle network disconnections.
         void error (error_reason_t reason);
 
+        //  Fills the output batch from the encoder, setting the body to
+        //  write after the batch if ZMQ_GATHER_THRESHOLD or
+        //  ZMQ_ZEROCOPY_THRESHOLD applies.
+        size_t encode (unsigned char **data_, size_t size_);
+
+        //  Size below which output batches are held back when
+        //  ZMQ_COALESCE_IVL is set.
+        size_t coalesce_limit () const;
+
+        //  Writes the body with MSG_ZEROCOPY, holding on to the message
+        //  until the kernel is done with it.
+        int write_zerocopy ();
+
+        //  Releases the messages of completed MSG_ZEROCOPY sends, waiting
+        //  up to timeout_ milliseconds for a completion. Returns false if
+        //  there was none.
+        bool reap_zerocopy (int timeout_);
+
         //  Receives the greeting message from the peer.
         int receive_greeting ();
 
@@ -113,6 +149,13 @@ namespace zmq
         int write_credential (msg_t *msg_);
         int pull_and_encode (msg_t *msg_);
         int decode_and_push (msg_t *msg_);
+
+        //  Replaces the message with its compressed form, the original size
+        //  followed by an LZ block, and returns true if that is smaller.
+        bool compress_msg (msg_t *msg_);
+
+        //  Replaces a compressed message with its original content.
+        int decompress_msg (msg_t *msg_);
         int push_one_then_decode_and_push (msg_t *msg_);
 
         void mechanism_ready ();
@@ -149,6 +192,37 @@ namespace zmq
         size_t outsize;
         i_encoder *encoder;
 
+        //  Current input and output batch sizes, and the number of batches
+        //  in a row that were mostly empty. The sizes only change from
+        //  ZMQ_TCP_RECV_BUFFER and ZMQ_TCP_SEND_BUFFER with
+        //  ZMQ_ADAPTIVE_BATCH.
+        size_t in_batch;
+        size_t out_batch;
+        int in_short_batches;
+        int out_short_batches;
+
+        //  Message body to be written right after the output batch,
+        //  without being copied into it.
+        unsigned char *bodypos;
+        size_t bodysize;
+
+        //  True iff message bodies are sent with MSG_ZEROCOPY, and iff the
+        //  current body is.
+        bool zerocopy;
+        bool body_zerocopy;
+
+        //  Messages the kernel may still be sending from, one for each
+        //  MSG_ZEROCOPY send in the order of the sends, and the number of
+        //  the first of these sends.
+        struct zerocopy_send_t
+        {
+            msg_t msg;
+            bool done;
+        };
+        typedef std::deque <zerocopy_send_t> zerocopy_sends_t;
+        zerocopy_sends_t zerocopy_sends;
+        uint32_t zerocopy_first;
+
         //  Metadata to be attached to received messages. May be NULL.
         metadata_t *metadata;
 
@@ -178,6 +252,9 @@ namespace zmq
         //  The session this engine is attached to.
         zmq::session_base_t *session;
 
+        //  The I/O thread the engine lives in.
+        zmq::io_thread_t *io_thread;
+
         options_t options;
 
         // String representation of endpoint
@@ -196,8 +273,22 @@ namespace zmq
         //  Needed to support old peers.
         bool subscription_required;
 
+        //  True iff the peer announced in the handshake that it
+        //  understands the priority flag.
+        bool peer_priority;
+
         mechanism_t *mechanism;
 
+        //  Compresses frames of at least ZMQ_COMPRESS_THRESHOLD bytes if
+        //  the peer announced that it can decompress them, NULL otherwise.
+        lz_compressor_t *compressor;
+        std::vector<unsigned char> compress_buf;
+
+        //  Buffer the decoder carves medium messages from, if
+        //  ZMQ_MEDIUM_MSG_SIZE is set. Only the session's pipe carries
+        //  them, so the buffer is effectively the pipe's.
+        mmsg_buffer_t *medium_buffer;
+
         //  True iff the engine couldn't consume the last decoded message.
         bool input_stopped;
 
@@ -221,9 +312,19 @@ namespace zmq
         bool has_heartbeat_timer;
         int heartbeat_timeout;
 
+        //  The output batch is held back while the coalesce timer is
+        //  running, and written as soon as it is due.
+        enum {coalesce_timer_id = 0x90};
+        bool has_coalesce_timer;
+        bool coalesce_due;
+
         // Socket
         zmq::socket_base_t *socket;
 
+        //  Counters reported to the socket's statistics.
+        engine_stats_t stats;
+        socket_stats_t *socket_stats;
+
         std::string peer_address;
 
         stream_engine_t (const stream_engine_t&);
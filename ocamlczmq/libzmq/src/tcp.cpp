@@ -41,12 +41,23 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/uio.h>
+#include <string.h>
 #endif
 
 #if defined ZMQ_HAVE_OPENVMS
 #include <ioctl.h>
 #endif
 
+#if defined ZMQ_HAVE_LINUX
+#include <linux/errqueue.h>
+#if defined MSG_ZEROCOPY && defined SO_ZEROCOPY \
+    && defined SO_EE_ORIGIN_ZEROCOPY
+#define ZMQ_HAVE_TCP_ZEROCOPY
+#include <poll.h>
+#endif
+#endif
+
 void zmq::tune_tcp_socket (fd_t s_)
 {
     //  Disable Nagle's algorithm. We are doing data batching on 0MQ level,
@@ -171,20 +182,19 @@ void zmq::tune_tcp_retransmit_timeout (fd_t sockfd_, int timeout_)
 #endif
 }
 
- int zmq::tcp_write (fd_t s_, const void *data_, size_t size_)
+//  Turns the result of a send call into the tcp_write return value.
+static int write_result (int nbytes_)
 {
 #ifdef ZMQ_HAVE_WINDOWS
 
-    int nbytes = send (s_, (char*) data_, (int) size_, 0);
-
     //  If not a single byte can be written to the socket in non-blocking mode
     //  we'll get an error (this may happen during the speculative write).
 	const int last_error = WSAGetLastError();
-    if (nbytes == SOCKET_ERROR && last_error == WSAEWOULDBLOCK)
+    if (nbytes_ == SOCKET_ERROR && last_error == WSAEWOULDBLOCK)
         return 0;
 
     //  Signalise peer failure.
-    if (nbytes == SOCKET_ERROR && (
+    if (nbytes_ == SOCKET_ERROR && (
           last_error == WSAENETDOWN     ||
           last_error == WSAENETRESET    ||
           last_error == WSAEHOSTUNREACH ||
@@ -196,24 +206,23 @@ void zmq::tune_tcp_retransmit_timeout (fd_t sockfd_, int timeout_)
 
     //  Circumvent a Windows bug; see https://support.microsoft.com/en-us/kb/201213
     //  and https://zeromq.jira.com/browse/LIBZMQ-195
-    if (nbytes == SOCKET_ERROR && last_error == WSAENOBUFS)
+    if (nbytes_ == SOCKET_ERROR && last_error == WSAENOBUFS)
         return 0;
 
-    wsa_assert (nbytes != SOCKET_ERROR);
-    return nbytes;
+    wsa_assert (nbytes_ != SOCKET_ERROR);
+    return nbytes_;
 
 #else
-    ssize_t nbytes = send (s_, data_, size_, 0);
 
     //  Several errors are OK. When speculative write is being done we may not
     //  be able to write a single byte from the socket. Also, SIGSTOP issued
     //  by a debugging tool can result in EINTR error.
-    if (nbytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+    if (nbytes_ == -1 && (errno == EAGAIN || errno == EWOULDBLOCK ||
           errno == EINTR))
         return 0;
 
     //  Signalise peer failure.
-    if (nbytes == -1) {
+    if (nbytes_ == -1) {
         errno_assert (errno != EACCES
                    && errno != EBADF
                    && errno != EDESTADDRREQ
@@ -226,8 +235,121 @@ void zmq::tune_tcp_retransmit_timeout (fd_t sockfd_, int timeout_)
         return -1;
     }
 
-    return static_cast <int> (nbytes);
+    return nbytes_;
+
+#endif
+}
+
+int zmq::tcp_write (fd_t s_, const void *data_, size_t size_)
+{
+#ifdef ZMQ_HAVE_WINDOWS
+    int nbytes = send (s_, (char*) data_, (int) size_, 0);
+#else
+    int nbytes = static_cast <int> (send (s_, data_, size_, 0));
+#endif
+    return write_result (nbytes);
+}
 
+int zmq::tcp_write_gather (fd_t s_, const void *data_, size_t size_,
+    const void *data2_, size_t size2_)
+{
+#ifdef ZMQ_HAVE_WINDOWS
+    WSABUF buffers [2];
+    buffers [0].buf = (char*) data_;
+    buffers [0].len = (ULONG) size_;
+    buffers [1].buf = (char*) data2_;
+    buffers [1].len = (ULONG) size2_;
+    DWORD sent = 0;
+    int rc = WSASend (s_, buffers, 2, &sent, 0, NULL, NULL);
+    return write_result (rc == SOCKET_ERROR ? SOCKET_ERROR : (int) sent);
+#else
+    struct iovec iov [2];
+    iov [0].iov_base = (void*) data_;
+    iov [0].iov_len = size_;
+    iov [1].iov_base = (void*) data2_;
+    iov [1].iov_len = size2_;
+    struct msghdr hdr;
+    memset (&hdr, 0, sizeof hdr);
+    hdr.msg_iov = iov;
+    hdr.msg_iovlen = 2;
+    return write_result (static_cast <int> (sendmsg (s_, &hdr, 0)));
+#endif
+}
+
+bool zmq::tcp_enable_zerocopy (fd_t s_)
+{
+#if defined ZMQ_HAVE_TCP_ZEROCOPY
+    int flag = 1;
+    return setsockopt (s_, SOL_SOCKET, SO_ZEROCOPY, &flag,
+        sizeof (int)) == 0;
+#else
+    LIBZMQ_UNUSED (s_);
+    return false;
+#endif
+}
+
+int zmq::tcp_write_zerocopy (fd_t s_, const void *data_, size_t size_,
+    bool *copied_)
+{
+#if defined ZMQ_HAVE_TCP_ZEROCOPY
+    int nbytes = static_cast <int> (send (s_, data_, size_, MSG_ZEROCOPY));
+
+    //  Pinning the pages fails if the socket's option memory is used up
+    //  by the sends not completed yet. The data is copied then.
+    if (nbytes == -1 && errno == ENOBUFS) {
+        *copied_ = true;
+        return tcp_write (s_, data_, size_);
+    }
+    *copied_ = false;
+    return write_result (nbytes);
+#else
+    *copied_ = true;
+    return tcp_write (s_, data_, size_);
+#endif
+}
+
+bool zmq::tcp_zerocopy_completion (fd_t s_, uint32_t *first_,
+    uint32_t *last_, int timeout_)
+{
+#if defined ZMQ_HAVE_TCP_ZEROCOPY
+    char control [CMSG_SPACE (sizeof (struct sock_extended_err) +
+        sizeof (struct sockaddr_storage))];
+    struct msghdr hdr;
+    memset (&hdr, 0, sizeof hdr);
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof control;
+
+    while (true) {
+        if (recvmsg (s_, &hdr, MSG_ERRQUEUE) == -1) {
+            if (errno != EAGAIN || timeout_ <= 0)
+                return false;
+
+            //  Whatever is put on the error queue is reported as POLLERR.
+            struct pollfd pfd = {s_, 0, 0};
+            if (poll (&pfd, 1, timeout_) <= 0)
+                return false;
+            timeout_ = 0;
+            continue;
+        }
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (&hdr); cmsg;
+              cmsg = CMSG_NXTHDR (&hdr, cmsg)) {
+            const struct sock_extended_err *err =
+                (const struct sock_extended_err *) CMSG_DATA (cmsg);
+            if (err->ee_errno == 0
+                  && err->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+                *first_ = err->ee_info;
+                *last_ = err->ee_data;
+                return true;
+            }
+        }
+        hdr.msg_controllen = sizeof control;
+    }
+#else
+    LIBZMQ_UNUSED (s_);
+    LIBZMQ_UNUSED (first_);
+    LIBZMQ_UNUSED (last_);
+    LIBZMQ_UNUSED (timeout_);
+    return false;
 #endif
 }
 
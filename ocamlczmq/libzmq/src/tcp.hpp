@@ -31,6 +31,7 @@
 #define __ZMQ_TCP_HPP_INCLUDED__
 
 #include "fd.hpp"
+#include "stdint.hpp"
 
 namespace zmq
 {
@@ -55,6 +56,30 @@ namespace zmq
     //  of error or orderly shutdown by the other peer -1 is returned.
     int tcp_write (fd_t s_, const void *data_, size_t size_);
 
+    //  Same as tcp_write, but writes two buffers, one after the other,
+    //  in a single system call.
+    int tcp_write_gather (fd_t s_, const void *data_, size_t size_,
+        const void *data2_, size_t size2_);
+
+    //  Enables sending with MSG_ZEROCOPY on the socket. Returns false if
+    //  the system doesn't support it.
+    bool tcp_enable_zerocopy (fd_t s_);
+
+    //  Same as tcp_write, but the kernel sends the data straight from the
+    //  buffer, which must then stay unchanged until the send is reported
+    //  by tcp_zerocopy_completion. The sends are numbered from 0 on, each
+    //  call that writes something counting as one, except if the kernel
+    //  has copied the data anyway, which is reported in copied_.
+    int tcp_write_zerocopy (fd_t s_, const void *data_, size_t size_,
+        bool *copied_);
+
+    //  Takes the next report of completed MSG_ZEROCOPY sends off the
+    //  socket's error queue, storing the numbers of the first and the last
+    //  of them in first_ and last_. Waits up to timeout_ milliseconds for
+    //  one to arrive. Returns false if there's none.
+    bool tcp_zerocopy_completion (fd_t s_, uint32_t *first_,
+        uint32_t *last_, int timeout_);
+
     //  Reads data from the socket (up to 'size' bytes).
     //  Returns the number of bytes actually read or -1 on error.
     //  Zero indicates the peer has closed the connection.
@@ -64,7 +64,8 @@ zmq::tcp_listener_t::tcp_listener_t (io_thread_t *io_thread_,
     own_t (io_thread_, options_),
     io_object_t (io_thread_),
     s (retired_fd),
-    socket (socket_)
+    socket (socket_),
+    io_thread (io_thread_)
 {
 }
 
@@ -112,12 +113,15 @@ void zmq::tcp_listener_t::in_event ()
 
     //  Choose I/O thread to run connecter in. Given that we are already
     //  running in an I/O thread, there must be at least one available.
-    io_thread_t *io_thread = choose_io_thread (options.affinity);
-    zmq_assert (io_thread);
+    //  With ZMQ_TCP_SHARDED_ACCEPT the kernel has already spread the
+    //  connections over the listeners, so the connection stays here.
+    io_thread_t *session_thread = options.tcp_sharded_accept ?
+        io_thread : choose_io_thread (options.affinity);
+    zmq_assert (session_thread);
 
     //  Create and launch a session object.
-    session_base_t *session = session_base_t::create (io_thread, false, socket,
-        options, NULL);
+    session_base_t *session = session_base_t::create (session_thread, false,
+        socket, options, NULL);
     errno_assert (session);
     session->inc_seqnum ();
     launch_child (session);
@@ -226,6 +230,16 @@ int zmq::tcp_listener_t::set_address (const char *addr_)
 
     address.to_string (endpoint);
 
+    //  Sharded listeners all bind to the same address, the kernel
+    //  balancing incoming connections between them.
+#ifdef SO_REUSEPORT
+    if (options.tcp_sharded_accept) {
+        rc = setsockopt (s, SOL_SOCKET, SO_REUSEPORT, &flag, sizeof (int));
+        if (rc != 0)
+            goto error;
+    }
+#endif
+
     //  Bind the socket to the network interface and port.
     rc = bind (s, address.addr (), address.addrlen ());
 #ifdef ZMQ_HAVE_WINDOWS
@@ -87,6 +87,9 @@ namespace zmq
         //  Socket the listener belongs to.
         zmq::socket_base_t *socket;
 
+        //  The I/O thread the listener lives in.
+        zmq::io_thread_t *io_thread;
+
        // String representation of endpoint to bind to
         std::string endpoint;
 
@@ -31,6 +31,11 @@
 #include "err.hpp"
 #include "platform.hpp"
 
+void zmq::thread_t::setAffinity (const std::set <int> &cpus_)
+{
+    affinity = cpus_;
+}
+
 #ifdef ZMQ_HAVE_WINDOWS
 
 extern "C"
@@ -77,11 +82,29 @@ void zmq::thread_t::setSchedulingParameters(int priority_, int schedulingPolicy_
 #else
 
 #include <signal.h>
+#if defined ZMQ_HAVE_LINUX && !defined ZMQ_HAVE_ANDROID
+#include <sched.h>
+#endif
 
 extern "C"
 {
     static void *thread_routine (void *arg_)
     {
+        zmq::thread_t *self = (zmq::thread_t*) arg_;
+
+#if defined ZMQ_HAVE_LINUX && !defined ZMQ_HAVE_ANDROID
+        if (!self->affinity.empty ()) {
+            cpu_set_t cpus;
+            CPU_ZERO (&cpus);
+            for (std::set <int>::const_iterator it = self->affinity.begin ();
+                  it != self->affinity.end (); ++it)
+                CPU_SET (*it, &cpus);
+            int rc = pthread_setaffinity_np (pthread_self (), sizeof (cpus),
+                &cpus);
+            posix_assert (rc);
+        }
+#endif
+
 #if !defined ZMQ_HAVE_OPENVMS && !defined ZMQ_HAVE_ANDROID
         //  Following code will guarantee more predictable latencies as it'll
         //  disallow any signal handling in the I/O thread.
@@ -92,7 +115,6 @@ extern "C"
         posix_assert (rc);
 #endif
 
-        zmq::thread_t *self = (zmq::thread_t*) arg_;
         self->tfn (self->arg);
         return NULL;
     }
@@ -32,6 +32,8 @@
 
 #include "platform.hpp"
 
+#include <set>
+
 #ifdef ZMQ_HAVE_WINDOWS
 #include "windows.hpp"
 #else
@@ -69,10 +71,18 @@ namespace zmq
         // pthread. Has no effect on other platforms.
         void setSchedulingParameters(int priority_, int schedulingPolicy_);
 
+        //  Sets the CPUs the thread is to run on, any if empty. Must be
+        //  called before the thread is started, as the thread applies it
+        //  before running 'tfn', so that the memory it allocates and
+        //  touches first is local to the CPUs. Only implemented for Linux.
+        //  Has no effect on other platforms.
+        void setAffinity (const std::set <int> &cpus_);
+
         //  These are internal members. They should be private, however then
         //  they would not be accessible from the main C routine of the thread.
         thread_fn *tfn;
         void *arg;
+        std::set <int> affinity;
         
     private:
 
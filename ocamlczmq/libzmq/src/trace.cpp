@@ -0,0 +1,254 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "trace.hpp"
+#include "clock.hpp"
+#include "likely.hpp"
+#include "err.hpp"
+
+#if defined ZMQ_HAVE_TRACE
+
+#include <new>
+#include <time.h>
+#include <pthread.h>
+#include <vector>
+#include <algorithm>
+
+#include "mutex.hpp"
+
+volatile bool zmq::trace_enabled = false;
+
+namespace
+{
+    //  Events recorded by one thread. Only the owning thread writes to the
+    //  ring, the oldest events being overwritten once it is full. A ring
+    //  recorded under an earlier zmq_trace_start is reset by its owner the
+    //  next time it records.
+    struct trace_ring_t
+    {
+        zmq_trace_event_t *events;
+        size_t capacity;
+        uint64_t head;
+        uint64_t generation;
+        uint32_t thread;
+        bool alive;
+    };
+
+    //  Guards the list of rings and the settings below. Recording threads
+    //  take it only when they set up or reset their ring.
+    zmq::mutex_t sync;
+
+    typedef std::vector <trace_ring_t *> rings_t;
+    rings_t rings;
+
+    //  Rings of exited threads are kept for zmq_trace_dump, as I/O threads
+    //  are gone by the time their context is terminated, and released by
+    //  the next zmq_trace_start.
+    pthread_key_t ring_key;
+    bool ring_key_created = false;
+
+    size_t ring_capacity = 0;
+    volatile uint64_t generation = 0;
+    uint32_t thread_count = 0;
+
+    bool event_earlier (const zmq_trace_event_t &a_,
+        const zmq_trace_event_t &b_)
+    {
+        return a_.time < b_.time;
+    }
+}
+
+static void retire_ring (void *ring_)
+{
+    zmq::scoped_lock_t lock (sync);
+    ((trace_ring_t *) ring_)->alive = false;
+}
+
+//  Sets up the calling thread's ring, or resets it for a new trace.
+static trace_ring_t *attach_ring (trace_ring_t *ring_)
+{
+    zmq::scoped_lock_t lock (sync);
+
+    if (!ring_) {
+        ring_ = new (std::nothrow) trace_ring_t ();
+        alloc_assert (ring_);
+        ring_->events = NULL;
+        ring_->capacity = 0;
+        ring_->thread = thread_count++;
+        ring_->alive = true;
+        rings.push_back (ring_);
+        const int rc = pthread_setspecific (ring_key, ring_);
+        posix_assert (rc);
+    }
+    if (ring_->capacity != ring_capacity) {
+        free (ring_->events);
+        ring_->events = (zmq_trace_event_t *)
+            malloc (ring_capacity * sizeof (zmq_trace_event_t));
+        alloc_assert (ring_->events);
+        ring_->capacity = ring_capacity;
+    }
+    ring_->head = 0;
+    ring_->generation = generation;
+    return ring_;
+}
+
+void zmq::trace_record_at (uint64_t time_, int point_, const void *object_,
+    uint64_t value_)
+{
+    trace_ring_t *ring = (trace_ring_t *) pthread_getspecific (ring_key);
+    if (unlikely (!ring || ring->generation != generation))
+        ring = attach_ring (ring);
+
+    //  The capacity is a power of two.
+    zmq_trace_event_t &event =
+        ring->events [ring->head & (ring->capacity - 1)];
+    event.time = time_;
+    event.object = (uint64_t) (uintptr_t) object_;
+    event.value = value_;
+    event.thread = ring->thread;
+    event.point = (uint32_t) point_;
+    ring->head++;
+}
+
+int zmq::trace_start (size_t events_per_thread_)
+{
+    if (events_per_thread_ == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t capacity = 1;
+    while (capacity < events_per_thread_)
+        capacity <<= 1;
+
+    scoped_lock_t lock (sync);
+
+    if (!ring_key_created) {
+        const int rc = pthread_key_create (&ring_key, retire_ring);
+        posix_assert (rc);
+        ring_key_created = true;
+    }
+
+    //  Release the rings of exited threads. Live threads reset their own
+    //  ring when they next record.
+    for (rings_t::size_type i = 0; i != rings.size ();)
+        if (!rings [i]->alive) {
+            free (rings [i]->events);
+            delete rings [i];
+            rings [i] = rings.back ();
+            rings.pop_back ();
+        }
+        else
+            i++;
+
+    ring_capacity = capacity;
+    generation++;
+    trace_enabled = true;
+    return 0;
+}
+
+int zmq::trace_stop ()
+{
+    trace_enabled = false;
+    return 0;
+}
+
+int zmq::trace_dump (zmq_trace_event_t *events_, size_t *count_)
+{
+    if (!count_) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    std::vector <zmq_trace_event_t> events;
+    {
+        scoped_lock_t lock (sync);
+        for (rings_t::iterator it = rings.begin (); it != rings.end (); ++it) {
+            const trace_ring_t *ring = *it;
+            if (ring->generation != generation)
+                continue;
+            const uint64_t first = ring->head > ring->capacity ?
+                ring->head - ring->capacity : 0;
+            for (uint64_t i = first; i != ring->head; i++)
+                events.push_back (ring->events [i & (ring->capacity - 1)]);
+        }
+    }
+
+    if (!events_) {
+        *count_ = events.size ();
+        return 0;
+    }
+    std::stable_sort (events.begin (), events.end (), event_earlier);
+    if (*count_ > events.size ())
+        *count_ = events.size ();
+    std::copy (events.begin (), events.begin () + *count_, events_);
+    return 0;
+}
+
+#else
+
+void zmq::trace_record_at (uint64_t, int, const void *, uint64_t)
+{
+}
+
+int zmq::trace_start (size_t)
+{
+    errno = ENOTSUP;
+    return -1;
+}
+
+int zmq::trace_stop ()
+{
+    errno = ENOTSUP;
+    return -1;
+}
+
+int zmq::trace_dump (zmq_trace_event_t *, size_t *)
+{
+    errno = ENOTSUP;
+    return -1;
+}
+
+#endif
+
+uint64_t zmq::trace_clock ()
+{
+#if defined ZMQ_HAVE_TRACE && defined HAVE_CLOCK_GETTIME \
+ && defined CLOCK_MONOTONIC
+    struct timespec ts;
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+        return ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+#endif
+    return clock_t::now_us () * 1000;
+}
+
+void zmq::trace_record (int point_, const void *object_, uint64_t value_)
+{
+    trace_record_at (trace_clock (), point_, object_, value_);
+}
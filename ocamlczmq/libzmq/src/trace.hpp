@@ -0,0 +1,68 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_TRACE_HPP_INCLUDED__
+#define __ZMQ_TRACE_HPP_INCLUDED__
+
+#include "../include/zmq.h"
+#include "platform.hpp"
+#include "stdint.hpp"
+
+namespace zmq
+{
+
+    //  Message tracing. Each thread records ZMQ_TRACE_* events into a ring
+    //  buffer of its own, so recording takes no locks. Call sites test
+    //  trace_enabled first; when tracing is compiled out it is a constant
+    //  and the call sites disappear altogether.
+
+#if defined ZMQ_HAVE_TRACE
+    extern volatile bool trace_enabled;
+#else
+    const bool trace_enabled = false;
+#endif
+
+    //  Monotonic time in nanoseconds.
+    uint64_t trace_clock ();
+
+    //  Records an event of the calling thread, stamped now or at the time
+    //  given.
+    void trace_record (int point_, const void *object_, uint64_t value_);
+    void trace_record_at (uint64_t time_, int point_, const void *object_,
+        uint64_t value_);
+
+    //  Implementation of zmq_trace_start, zmq_trace_stop and zmq_trace_dump.
+    int trace_start (size_t events_per_thread_);
+    int trace_stop ();
+    int trace_dump (zmq_trace_event_t *events_, size_t *count_);
+
+}
+
+#endif
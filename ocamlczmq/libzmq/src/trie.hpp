@@ -33,6 +33,7 @@
 #include <stddef.h>
 
 #include "stdint.hpp"
+#include "radix_tree.hpp"
 
 namespace zmq
 {
@@ -61,20 +62,19 @@ namespace zmq
 
     private:
 
-        void apply_helper (
-            unsigned char **buff_, size_t buffsize_, size_t maxbuffsize_,
-            void (*func_) (unsigned char *data_, size_t size_, void *arg_),
-            void *arg_);
-        bool is_redundant () const;
-
-        uint32_t refcnt;
-        unsigned char min;
-        unsigned short count;
-        unsigned short live_nodes;
-        union {
-            class trie_t *node;
-            class trie_t **table;
-        } next;
+        //  Carries the user's callback through radix_tree_t::apply.
+        struct apply_ctx_t
+        {
+            void (*func) (unsigned char *data_, size_t size_, void *arg_);
+            void *arg;
+        };
+
+        static void apply_helper (unsigned char *data_, size_t size_,
+            uint32_t &refcnt_, void *arg_);
+
+        //  Each node holds the reference count of the subscription
+        //  ending there.
+        radix_tree_t <uint32_t> tree;
 
         trie_t (const trie_t&);
         const trie_t &operator = (const trie_t&);
@@ -44,11 +44,13 @@
 
 
 
-zmq::v2_decoder_t::v2_decoder_t (size_t bufsize_, int64_t maxmsgsize_) :
+zmq::v2_decoder_t::v2_decoder_t (size_t bufsize_, int64_t maxmsgsize_,
+      mmsg_buffer_t *medium_buffer_) :
     shared_message_memory_allocator( bufsize_),
     decoder_base_t <v2_decoder_t, shared_message_memory_allocator> (this),
     msg_flags (0),
-    maxmsgsize (maxmsgsize_)
+    maxmsgsize (maxmsgsize_),
+    medium_buffer (medium_buffer_)
 {
     int rc = in_progress.init ();
     errno_assert (rc == 0);
@@ -70,6 +72,10 @@ int zmq::v2_decoder_t::flags_ready (unsigned char const*)
         msg_flags |= msg_t::more;
     if (tmpbuf [0] & v2_protocol_t::command_flag)
         msg_flags |= msg_t::command;
+    if (tmpbuf [0] & v2_protocol_t::priority_flag)
+        msg_flags |= msg_t::priority;
+    if (tmpbuf [0] & v2_protocol_t::compressed_flag)
+        msg_flags |= msg_t::compressed;
 
     //  The payload length is either one or eight bytes,
     //  depending on whether the 'large' bit is set.
@@ -118,7 +124,15 @@ int zmq::v2_decoder_t::size_ready(uint64_t msg_size, unsigned char const* read_p
     {
         // a new message has started, but the size would exceed the pre-allocated arena
         // this happens every time when a message does not fit completely into the buffer
-        rc = in_progress.init_size (static_cast <size_t> (msg_size));
+        // medium messages are copied into a slot of the connection's buffer
+        // rather than a block allocated on the heap
+        rc = -1;
+        if (medium_buffer && msg_size > msg_t::max_vsm_size
+        &&  msg_size <= medium_buffer->capacity ())
+            rc = in_progress.init_medium (static_cast <size_t> (msg_size),
+                medium_buffer);
+        if (rc != 0)
+            rc = in_progress.init_size (static_cast <size_t> (msg_size));
     }
     else
     {
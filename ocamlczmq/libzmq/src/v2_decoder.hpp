@@ -32,6 +32,7 @@
 
 #include "decoder.hpp"
 #include "decoder_allocators.hpp"
+#include "mmsg_buffer.hpp"
 
 namespace zmq
 {
@@ -44,7 +45,11 @@ namespace zmq
             public decoder_base_t <v2_decoder_t, shared_message_memory_allocator>
     {
     public:
-        v2_decoder_t (size_t bufsize_, int64_t maxmsgsize_);
+        //  Bodies of up to the capacity of medium_buffer_, if not NULL, that
+        //  don't fit in the read buffer are carved from it rather than
+        //  allocated. The buffer remains owned by the caller.
+        v2_decoder_t (size_t bufsize_, int64_t maxmsgsize_,
+            mmsg_buffer_t *medium_buffer_ = NULL);
         virtual ~v2_decoder_t ();
 
         //  i_decoder interface.
@@ -65,6 +70,8 @@ namespace zmq
 
         const int64_t maxmsgsize;
 
+        mmsg_buffer_t *const medium_buffer;
+
         v2_decoder_t (const v2_decoder_t&);
         void operator = (const v2_decoder_t&);
     };
@@ -54,6 +54,10 @@ void zmq::v2_encoder_t::message_ready ()
         protocol_flags |= v2_protocol_t::large_flag;
     if (in_progress->flags () & msg_t::command)
         protocol_flags |= v2_protocol_t::command_flag;
+    if (in_progress->flags () & msg_t::priority)
+        protocol_flags |= v2_protocol_t::priority_flag;
+    if (in_progress->flags () & msg_t::compressed)
+        protocol_flags |= v2_protocol_t::compressed_flag;
 
     //  Encode the message length. For messages less then 256 bytes,
     //  the length is encoded as 8-bit unsigned integer. For larger
@@ -41,7 +41,14 @@ namespace zmq
         {
             more_flag = 1,
             large_flag = 2,
-            command_flag = 4
+            command_flag = 4,
+
+            //  Only sent to peers announcing the Priority-Lanes property
+            //  in the ZMTP/3.0 handshake.
+            priority_flag = 8,
+
+            //  Only sent to peers announcing the Compression property.
+            compressed_flag = 16
         };
     };
 }
@@ -134,7 +134,8 @@ int zmq::xpub_t::xsetsockopt (int option_, const void *optval_,
     size_t optvallen_)
 {
     if (option_ == ZMQ_XPUB_VERBOSE || option_ == ZMQ_XPUB_VERBOSE_UNSUBSCRIBE ||
-        option_ == ZMQ_XPUB_NODROP || option_ == ZMQ_XPUB_MANUAL)
+        option_ == ZMQ_XPUB_NODROP || option_ == ZMQ_XPUB_MANUAL ||
+        option_ == ZMQ_XPUB_CONFLATE_TOPICS)
     {
         if (optvallen_ != sizeof(int) || *static_cast <const int*> (optval_) < 0) {
             errno = EINVAL;
@@ -152,6 +153,9 @@ int zmq::xpub_t::xsetsockopt (int option_, const void *optval_,
         else
         if (option_ == ZMQ_XPUB_MANUAL)
             manual = (*static_cast <const int*> (optval_) != 0);
+        else
+        if (option_ == ZMQ_XPUB_CONFLATE_TOPICS)
+            dist.set_conflate_topics (*static_cast <const int*> (optval_) != 0);
     }
     else
     if (option_ == ZMQ_SUBSCRIBE && manual) {
@@ -236,6 +240,11 @@ bool zmq::xpub_t::xhas_out ()
     return dist.has_out ();
 }
 
+uint64_t zmq::xpub_t::xdrops ()
+{
+    return dist.get_drops ();
+}
+
 int zmq::xpub_t::xrecv (msg_t *msg_)
 {
     //  If there is at least one
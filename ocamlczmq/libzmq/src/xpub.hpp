@@ -59,6 +59,7 @@ namespace zmq
         void xattach_pipe (zmq::pipe_t *pipe_, bool subscribe_to_all_ = false);
         int xsend (zmq::msg_t *msg_);
         bool xhas_out ();
+        uint64_t xdrops ();
         int xrecv (zmq::msg_t *msg_);
         bool xhas_in ();
         void xread_activated (zmq::pipe_t *pipe_);
@@ -59,6 +59,7 @@ void zmq::xsub_t::xattach_pipe (pipe_t *pipe_, bool subscribe_to_all_)
     LIBZMQ_UNUSED (subscribe_to_all_);
 
     zmq_assert (pipe_);
+    fq.set_priority (options.rcvpriority);
     fq.attach (pipe_);
     dist.attach (pipe_);
 
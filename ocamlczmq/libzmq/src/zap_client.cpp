@@ -0,0 +1,224 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <sstream>
+
+#include "zap_client.hpp"
+#include "io_thread.hpp"
+#include "session_base.hpp"
+#include "err.hpp"
+
+zmq::zap_client_t::zap_client_t (io_thread_t *io_thread_) :
+    object_t (io_thread_),
+    io_thread (io_thread_),
+    pipe (NULL),
+    terminating (false),
+    sequence (0)
+{
+}
+
+zmq::zap_client_t::~zap_client_t ()
+{
+    zmq_assert (!pipe);
+    zmq_assert (requests.empty ());
+    for (size_t i = 0; i != reply.size (); i++)
+        reply [i].close ();
+}
+
+int zmq::zap_client_t::connect ()
+{
+    if (pipe)
+        return 0;
+    if (terminating) {
+        errno = ECONNREFUSED;
+        return -1;
+    }
+
+    endpoint_t peer = find_endpoint ("inproc://zeromq.zap.01");
+    if (peer.socket == NULL) {
+        errno = ECONNREFUSED;
+        return -1;
+    }
+    if (peer.options.type != ZMQ_REP
+    &&  peer.options.type != ZMQ_ROUTER
+    &&  peer.options.type != ZMQ_SERVER) {
+        errno = ECONNREFUSED;
+        return -1;
+    }
+
+    //  Create a bi-directional pipe that will connect
+    //  the I/O thread with zap socket.
+    object_t *parents [2] = {this, peer.socket};
+    pipe_t *new_pipes [2] = {NULL, NULL};
+    int hwms [2] = {0, 0};
+    bool conflates [2] = {false, false};
+    int rc = pipepair (parents, new_pipes, hwms, conflates);
+    errno_assert (rc == 0);
+
+    //  Attach local end of the pipe to this object.
+    pipe = new_pipes [0];
+    pipe->set_nodelay ();
+    pipe->set_event_sink (this);
+
+    //  Nothing was read yet; have the pipe signal the first reply.
+    pipe->check_read ();
+
+    send_bind (peer.socket, new_pipes [1], false);
+
+    //  Send empty identity if required by the peer.
+    if (peer.options.recv_identity) {
+        msg_t id;
+        rc = id.init ();
+        errno_assert (rc == 0);
+        id.set_flags (msg_t::identity);
+        bool ok = pipe->write (&id);
+        zmq_assert (ok);
+        pipe->flush ();
+    }
+
+    return 0;
+}
+
+std::string zmq::zap_client_t::open (session_base_t *session_)
+{
+    std::ostringstream id;
+    id << ++sequence;
+    requests [id.str ()] = session_;
+    return id.str ();
+}
+
+void zmq::zap_client_t::cancel (const std::string &id_)
+{
+    requests.erase (id_);
+}
+
+int zmq::zap_client_t::write (msg_t *msg_)
+{
+    if (!pipe || !pipe->write (msg_))
+        return -1;
+    if ((msg_->flags () & msg_t::more) == 0)
+        pipe->flush ();
+
+    const int rc = msg_->init ();
+    errno_assert (rc == 0);
+    return 0;
+}
+
+bool zmq::zap_client_t::terminate ()
+{
+    terminating = true;
+    fail_requests ();
+    if (!pipe)
+        return false;
+    pipe->terminate (false);
+    return true;
+}
+
+void zmq::zap_client_t::read_activated (pipe_t *pipe_)
+{
+    zmq_assert (pipe_ == pipe);
+
+    msg_t msg;
+    int rc = msg.init ();
+    errno_assert (rc == 0);
+    while (pipe && pipe->read (&msg)) {
+        //  The vector takes over the message.
+        reply.push_back (msg);
+        rc = msg.init ();
+        errno_assert (rc == 0);
+        if ((reply.back ().flags () & msg_t::more) == 0)
+            dispatch ();
+    }
+}
+
+void zmq::zap_client_t::dispatch ()
+{
+    //  The request id is the third frame of the reply.
+    requests_t::iterator it = requests.end ();
+    if (reply.size () > 2)
+        it = requests.find (std::string (
+            static_cast <char *> (reply [2].data ()), reply [2].size ()));
+
+    if (it == requests.end ()) {
+        //  Reply to a cancelled request or garbage.
+        for (size_t i = 0; i != reply.size (); i++) {
+            const int rc = reply [i].close ();
+            errno_assert (rc == 0);
+        }
+        reply.clear ();
+        return;
+    }
+
+    session_base_t *session = it->second;
+    requests.erase (it);
+    session->zap_reply_arrived (reply);
+    zmq_assert (reply.empty ());
+}
+
+void zmq::zap_client_t::write_activated (pipe_t *)
+{
+    //  The pipe has no limit.
+    zmq_assert (false);
+}
+
+void zmq::zap_client_t::hiccuped (pipe_t *)
+{
+    //  Hiccups are always sent from session to socket, not the other
+    //  way round.
+    zmq_assert (false);
+}
+
+void zmq::zap_client_t::pipe_terminated (pipe_t *pipe_)
+{
+    zmq_assert (pipe_ == pipe);
+    pipe = NULL;
+
+    //  The handler went away; the outstanding requests fail.
+    fail_requests ();
+
+    if (terminating)
+        io_thread->zap_client_terminated ();
+}
+
+void zmq::zap_client_t::fail_requests ()
+{
+    for (size_t i = 0; i != reply.size (); i++) {
+        const int rc = reply [i].close ();
+        errno_assert (rc == 0);
+    }
+    reply.clear ();
+
+    //  The map is set aside first as the sessions may start new requests
+    //  meanwhile.
+    requests_t failed;
+    failed.swap (requests);
+    for (requests_t::iterator it = failed.begin (); it != failed.end (); ++it)
+        it->second->zap_reply_arrived (reply);
+}
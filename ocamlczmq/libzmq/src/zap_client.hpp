@@ -0,0 +1,124 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_ZAP_CLIENT_HPP_INCLUDED__
+#define __ZMQ_ZAP_CLIENT_HPP_INCLUDED__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "stdint.hpp"
+#include "object.hpp"
+#include "pipe.hpp"
+#include "msg.hpp"
+
+namespace zmq
+{
+
+    class io_thread_t;
+    class session_base_t;
+
+    //  Connection of an I/O thread to the ZAP handler, shared by the
+    //  handshakes of all the sessions living in the thread. Requests are
+    //  pipelined: each one is given a request id unique on the connection
+    //  and the replies are matched to the requests by it, in any order.
+
+    class zap_client_t :
+        public object_t,
+        public i_pipe_events
+    {
+    public:
+
+        zap_client_t (zmq::io_thread_t *io_thread_);
+        ~zap_client_t ();
+
+        //  Connects to the ZAP handler unless connected already. Returns 0
+        //  if successful; -1 with errno set to ECONNREFUSED if there's no
+        //  handler.
+        int connect ();
+
+        //  Starts a request on behalf of session_ and returns its id. The
+        //  reply is delivered to the session once all its frames arrive.
+        std::string open (zmq::session_base_t *session_);
+
+        //  Forgets the request; its reply, if any, is dropped.
+        void cancel (const std::string &id_);
+
+        //  Sends a frame of a request. Returns 0 if successful; -1 if the
+        //  connection is being closed. Takes ownership of the message if
+        //  successful.
+        int write (msg_t *msg_);
+
+        //  Fails the outstanding requests and closes the connection, as the
+        //  I/O thread stops. Returns true if the pipe is still closing, in
+        //  which case the I/O thread is told once it's gone.
+        bool terminate ();
+
+        //  i_pipe_events interface implementation.
+        void read_activated (zmq::pipe_t *pipe_);
+        void write_activated (zmq::pipe_t *pipe_);
+        void hiccuped (zmq::pipe_t *pipe_);
+        void pipe_terminated (zmq::pipe_t *pipe_);
+
+    private:
+
+        //  Hands the reply collected so far over to its session.
+        void dispatch ();
+
+        //  Fails the outstanding requests, dropping the partial reply.
+        void fail_requests ();
+
+        //  The I/O thread the connection belongs to.
+        zmq::io_thread_t *io_thread;
+
+        //  Pipe to the ZAP handler, NULL if not connected.
+        zmq::pipe_t *pipe;
+
+        //  True once the I/O thread asked to close the pipe.
+        bool terminating;
+
+        //  Outstanding requests, by request id.
+        typedef std::map <std::string, session_base_t *> requests_t;
+        requests_t requests;
+
+        //  Sequence number of the last request.
+        uint64_t sequence;
+
+        //  Frames of the reply being read.
+        std::vector <msg_t> reply;
+
+        zap_client_t (const zap_client_t&);
+        const zap_client_t &operator = (const zap_client_t&);
+    };
+
+}
+
+#endif
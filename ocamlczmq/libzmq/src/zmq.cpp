@@ -77,6 +77,7 @@ struct iovec {
 #include "metadata.hpp"
 #include "signaler.hpp"
 #include "socket_poller.hpp"
+#include "trace.hpp"
 
 #if !defined ZMQ_HAVE_WINDOWS
 #include <unistd.h>
@@ -217,6 +218,26 @@ int zmq_ctx_get (void *ctx_, int option_)
     return ((zmq::ctx_t*) ctx_)->get (option_);
 }
 
+int zmq_ctx_set_ext (void *ctx_, int option_, const void *optval_,
+    size_t optvallen_)
+{
+    if (!ctx_ || !((zmq::ctx_t*) ctx_)->check_tag ()) {
+        errno = EFAULT;
+        return -1;
+    }
+    return ((zmq::ctx_t*) ctx_)->set_ext (option_, optval_, optvallen_);
+}
+
+int zmq_ctx_get_ext (void *ctx_, int option_, void *optval_,
+    size_t *optvallen_)
+{
+    if (!ctx_ || !((zmq::ctx_t*) ctx_)->check_tag ()) {
+        errno = EFAULT;
+        return -1;
+    }
+    return ((zmq::ctx_t*) ctx_)->get_ext (option_, optval_, optvallen_);
+}
+
 //  Stable/legacy context API
 
 void *zmq_init (int io_threads_)
@@ -298,6 +319,47 @@ int zmq_socket_monitor (void *s_, const char *addr_, int events_)
     return result;
 }
 
+int zmq_socket_capture (void *s_, void *capture_, int flags_)
+{
+    if (!s_ || !((zmq::socket_base_t*) s_)->check_tag ()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    if (capture_ && !((zmq::socket_base_t*) capture_)->check_tag ()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    zmq::socket_base_t *s = (zmq::socket_base_t *) s_;
+    int result = s->set_capture ((zmq::socket_base_t *) capture_, flags_);
+    return result;
+}
+
+int zmq_socket_stats (void *s_, zmq_socket_stats_t *stats_)
+{
+    if (!s_ || !((zmq::socket_base_t*) s_)->check_tag ()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    zmq::socket_base_t *s = (zmq::socket_base_t *) s_;
+    int result = s->statistics (stats_);
+    return result;
+}
+
+int zmq_trace_start (size_t events_per_thread_)
+{
+    return zmq::trace_start (events_per_thread_);
+}
+
+int zmq_trace_stop ()
+{
+    return zmq::trace_stop ();
+}
+
+int zmq_trace_dump (zmq_trace_event_t *events_, size_t *count_)
+{
+    return zmq::trace_dump (events_, count_);
+}
+
 int zmq_bind (void *s_, const char *addr_)
 {
     if (!s_ || !((zmq::socket_base_t*) s_)->check_tag ()) {
@@ -364,13 +426,13 @@ int zmq_send (void *s_, const void *buf_, size_t len_, int flags_)
         errno = ENOTSOCK;
         return -1;
     }
+    zmq::socket_base_t *s = (zmq::socket_base_t *) s_;
     zmq_msg_t msg;
-    int rc = zmq_msg_init_size (&msg, len_);
+    int rc = s->init_msg ((zmq::msg_t *) &msg, len_);
     if (rc != 0)
         return -1;
     memcpy (zmq_msg_data (&msg), buf_, len_);
 
-    zmq::socket_base_t *s = (zmq::socket_base_t *) s_;
     rc = s_sendmsg (s, &msg, flags_);
     if (unlikely (rc < 0)) {
         int err = errno;
@@ -645,17 +707,27 @@ int zmq_msg_get (zmq_msg_t *msg_, int property_)
         case ZMQ_SHARED:
             return (((zmq::msg_t*) msg_)->is_cmsg ()) ||
                    (((zmq::msg_t*) msg_)->flags () & zmq::msg_t::shared)? 1: 0;
+        case ZMQ_PRIORITY:
+            return (((zmq::msg_t*) msg_)->flags () & zmq::msg_t::priority)? 1: 0;
         default:
             errno = EINVAL;
             return -1;
     }
 }
 
-int zmq_msg_set (zmq_msg_t *, int, int)
+int zmq_msg_set (zmq_msg_t *msg_, int property_, int optval_)
 {
-    //  No properties supported at present
-    errno = EINVAL;
-    return -1;
+    switch (property_) {
+        case ZMQ_PRIORITY:
+            if (optval_)
+                ((zmq::msg_t*) msg_)->set_flags (zmq::msg_t::priority);
+            else
+                ((zmq::msg_t*) msg_)->reset_flags (zmq::msg_t::priority);
+            return 0;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
 }
 
 int zmq_msg_set_routing_id (zmq_msg_t *msg_, uint32_t routing_id_)
@@ -0,0 +1,152 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+//  Fills a message of size_ bytes with a pattern depending on seq_.
+static void fill (unsigned char *data_, size_t size_, int seq_)
+{
+    for (size_t i = 0; i != size_; i++)
+        data_ [i] = (unsigned char) (seq_ + i);
+}
+
+static void send_seq (void *socket_, size_t size_, int seq_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init_size (&msg, size_);
+    assert (rc == 0);
+    fill ((unsigned char *) zmq_msg_data (&msg), size_, seq_);
+    rc = zmq_msg_send (&msg, socket_, 0);
+    assert (rc == (int) size_);
+}
+
+static void recv_seq (void *socket_, size_t size_, int seq_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&msg, socket_, 0);
+    assert (rc == (int) size_);
+    unsigned char *data = (unsigned char *) zmq_msg_data (&msg);
+    for (size_t i = 0; i != size_; i++)
+        assert (data [i] == (unsigned char) (seq_ + i));
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+}
+
+static void set_int (void *socket_, int option_, int value_)
+{
+    int rc = zmq_setsockopt (socket_, option_, &value_, sizeof (value_));
+    assert (rc == 0);
+}
+
+static int get_int (void *socket_, int option_)
+{
+    int value;
+    size_t size = sizeof (value);
+    int rc = zmq_getsockopt (socket_, option_, &value, &size);
+    assert (rc == 0);
+    return value;
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  The I/O threads' event batch can be set before they are launched.
+    assert (zmq_ctx_get (ctx, ZMQ_IO_EVENTS) == 256);
+    int rc = zmq_ctx_set (ctx, ZMQ_IO_EVENTS, 0);
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_ctx_set (ctx, ZMQ_IO_EVENTS, 4);
+    assert (rc == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_IO_EVENTS) == 4);
+
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+
+    //  Defaults and invalid values of the socket options.
+    assert (get_int (pull, ZMQ_INBOUND_POLL_RATE) == 100);
+    assert (get_int (pull, ZMQ_MAX_COMMAND_DELAY) == 3000000);
+    assert (get_int (pull, ZMQ_ADAPTIVE_BATCH) == 0);
+    int value = 0;
+    rc = zmq_setsockopt (pull, ZMQ_INBOUND_POLL_RATE, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+    value = -1;
+    rc = zmq_setsockopt (pull, ZMQ_MAX_COMMAND_DELAY, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+    value = 2;
+    rc = zmq_setsockopt (pull, ZMQ_ADAPTIVE_BATCH, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+
+    set_int (pull, ZMQ_INBOUND_POLL_RATE, 10);
+    assert (get_int (pull, ZMQ_INBOUND_POLL_RATE) == 10);
+    set_int (push, ZMQ_MAX_COMMAND_DELAY, 0);
+    assert (get_int (push, ZMQ_MAX_COMMAND_DELAY) == 0);
+
+    //  Adaptive batches on both ends, starting small so that they grow
+    //  and shrink a lot.
+    set_int (pull, ZMQ_ADAPTIVE_BATCH, 1);
+    assert (get_int (pull, ZMQ_ADAPTIVE_BATCH) == 1);
+    set_int (push, ZMQ_ADAPTIVE_BATCH, 1);
+    set_int (pull, ZMQ_TCP_RECV_BUFFER, 256);
+    set_int (push, ZMQ_TCP_SEND_BUFFER, 256);
+    set_int (pull, ZMQ_RCVHWM, 0);
+    set_int (push, ZMQ_SNDHWM, 0);
+
+    rc = zmq_bind (pull, "tcp://127.0.0.1:5601");
+    assert (rc == 0);
+    rc = zmq_connect (push, "tcp://127.0.0.1:5601");
+    assert (rc == 0);
+
+    //  Sparse, sustained, sparse again and sustained with large messages:
+    //  every message arrives intact whatever the batch sizes.
+    for (int round = 0; round != 2; round++) {
+        for (int i = 0; i != 20; i++) {
+            send_seq (push, 1 + i * 7, i);
+            recv_seq (pull, 1 + i * 7, i);
+        }
+        const int count = round == 0 ? 10000 : 2000;
+        const size_t max_size = round == 0 ? 300 : 20000;
+        for (int i = 0; i != count; i++)
+            send_seq (push, 1 + i % max_size, i);
+        for (int i = 0; i != count; i++)
+            recv_seq (pull, 1 + i % max_size, i);
+    }
+
+    close_zero_linger (push);
+    close_zero_linger (pull);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
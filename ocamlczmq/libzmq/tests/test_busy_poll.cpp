@@ -0,0 +1,89 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    void *sb = zmq_socket (ctx, ZMQ_REP);
+    assert (sb);
+    void *sc = zmq_socket (ctx, ZMQ_REQ);
+    assert (sc);
+
+    //  Default is off, negative values are rejected
+    int value;
+    size_t size = sizeof (value);
+    int rc = zmq_getsockopt (sb, ZMQ_BUSY_POLL, &value, &size);
+    assert (rc == 0);
+    assert (value == 0);
+    value = -1;
+    rc = zmq_setsockopt (sb, ZMQ_BUSY_POLL, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+
+    value = 50;
+    rc = zmq_setsockopt (sb, ZMQ_BUSY_POLL, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_setsockopt (sc, ZMQ_BUSY_POLL, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_getsockopt (sc, ZMQ_BUSY_POLL, &value, &size);
+    assert (rc == 0);
+    assert (value == 50);
+
+    rc = zmq_bind (sb, "inproc://a");
+    assert (rc == 0);
+    rc = zmq_connect (sc, "inproc://a");
+    assert (rc == 0);
+
+    for (int i = 0; i != 100; i++)
+        bounce (sb, sc);
+
+    //  Receive timeout is still honoured while busy-polling
+    int timeout = 100;
+    rc = zmq_setsockopt (sb, ZMQ_RCVTIMEO, &timeout, sizeof (timeout));
+    assert (rc == 0);
+    void *watch = zmq_stopwatch_start ();
+    char buffer [16];
+    rc = zmq_recv (sb, buffer, sizeof (buffer), 0);
+    assert (rc == -1 && errno == EAGAIN);
+    unsigned long elapsed = zmq_stopwatch_stop (watch) / 1000;
+    assert (elapsed >= 90);
+
+    rc = zmq_close (sc);
+    assert (rc == 0);
+    rc = zmq_close (sb);
+    assert (rc == 0);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
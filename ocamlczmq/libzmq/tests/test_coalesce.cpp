@@ -0,0 +1,140 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+static void set_int (void *socket_, int option_, int value_)
+{
+    int rc = zmq_setsockopt (socket_, option_, &value_, sizeof (value_));
+    assert (rc == 0);
+}
+
+static int get_int (void *socket_, int option_)
+{
+    int value;
+    size_t size = sizeof (value);
+    int rc = zmq_getsockopt (socket_, option_, &value, &size);
+    assert (rc == 0);
+    return value;
+}
+
+static uint64_t write_calls (void *socket_)
+{
+    zmq_socket_stats_t stats;
+    int rc = zmq_socket_stats (socket_, &stats);
+    assert (rc == 0);
+    return stats.write_calls;
+}
+
+//  Connects a PUSH socket coalescing its output to a PULL socket and
+//  waits for the connection to be up.
+static void connect_pair (void *ctx_, const char *endpoint_, int ivl_,
+    int bytes_, void **push_, void **pull_)
+{
+    *pull_ = zmq_socket (ctx_, ZMQ_PULL);
+    assert (*pull_);
+    *push_ = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (*push_);
+    set_int (*push_, ZMQ_COALESCE_IVL, ivl_);
+    set_int (*push_, ZMQ_COALESCE_BYTES, bytes_);
+    set_int (*pull_, ZMQ_RCVTIMEO, 5000);
+
+    int rc = zmq_bind (*pull_, endpoint_);
+    assert (rc == 0);
+    rc = zmq_connect (*push_, endpoint_);
+    assert (rc == 0);
+    char buffer [1000];
+    memset (buffer, 'X', sizeof (buffer));
+    rc = zmq_send (*push_, buffer, sizeof (buffer), 0);
+    assert (rc == (int) sizeof (buffer));
+    rc = zmq_recv (*pull_, buffer, sizeof (buffer), 0);
+    assert (rc == (int) sizeof (buffer));
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  Defaults and invalid values.
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+    assert (get_int (push, ZMQ_COALESCE_IVL) == 0);
+    assert (get_int (push, ZMQ_COALESCE_BYTES) == 0);
+    int value = -1;
+    int rc = zmq_setsockopt (push, ZMQ_COALESCE_IVL, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_setsockopt (push, ZMQ_COALESCE_BYTES, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_close (push);
+    assert (rc == 0);
+
+    //  A burst of small messages is held back for the interval and then
+    //  goes out in a single write.
+    void *pull;
+    connect_pair (ctx, "tcp://127.0.0.1:5606", 200, 0, &push, &pull);
+    uint64_t writes = write_calls (push);
+    void *watch = zmq_stopwatch_start ();
+    for (int i = 0; i != 10; i++)
+        s_send_seq (push, "log", SEQ_END);
+    for (int i = 0; i != 10; i++)
+        s_recv_seq (pull, "log", SEQ_END);
+    unsigned long elapsed = zmq_stopwatch_stop (watch);
+    assert (elapsed >= 100000);
+    assert (write_calls (push) - writes <= 2);
+    close_zero_linger (push);
+    close_zero_linger (pull);
+
+    //  Once ZMQ_COALESCE_BYTES are queued they are written straight away,
+    //  well before the interval. Each message takes 12 bytes on the wire.
+    connect_pair (ctx, "tcp://127.0.0.1:5607", 60000, 64, &push, &pull);
+    watch = zmq_stopwatch_start ();
+    for (int i = 0; i != 6; i++)
+        s_send_seq (push, "0123456789", SEQ_END);
+    for (int i = 0; i != 6; i++)
+        s_recv_seq (pull, "0123456789", SEQ_END);
+    elapsed = zmq_stopwatch_stop (watch);
+    assert (elapsed < 5000000);
+
+    //  So are messages that fill a batch on their own.
+    char buffer [10000];
+    memset (buffer, 'Y', sizeof (buffer));
+    rc = zmq_send (push, buffer, sizeof (buffer), 0);
+    assert (rc == (int) sizeof (buffer));
+    rc = zmq_recv (pull, buffer, sizeof (buffer), 0);
+    assert (rc == (int) sizeof (buffer));
+    close_zero_linger (push);
+    close_zero_linger (pull);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
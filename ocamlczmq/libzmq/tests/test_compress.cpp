@@ -0,0 +1,228 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+static uint32_t seed = 1;
+
+static uint32_t next_random ()
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+//  Fills data_ with text looking like serialized terms, which compresses
+//  well, or with random bytes, which doesn't compress at all.
+static void fill (unsigned char *data_, size_t size_, bool text_)
+{
+    static const char *words [] = {
+        "(and ", "(or ", "(not ", "(= ", "(>= ", "(+ ", "x_", "y_", "state",
+        ") ", "true ", "false ", "1 ", "0 "};
+    size_t pos = 0;
+    while (pos < size_) {
+        if (!text_) {
+            data_ [pos++] = (unsigned char) next_random ();
+            continue;
+        }
+        const char *word = words [next_random () % 14];
+        for (; *word && pos < size_; word++)
+            data_ [pos++] = *word;
+        if (pos < size_)
+            data_ [pos++] = (unsigned char) ('0' + next_random () % 10);
+    }
+}
+
+//  Sends a message of parts_ frames of size_ bytes and checks that it
+//  arrives intact.
+static void bounce (void *push_, void *pull_, size_t size_, bool text_,
+    int parts_ = 1)
+{
+    unsigned char *data = (unsigned char *) malloc (size_ * parts_);
+    assert (data);
+    fill (data, size_ * parts_, text_);
+    for (int i = 0; i != parts_; i++) {
+        int rc = zmq_send (push_, data + i * size_, size_,
+            i + 1 < parts_ ? ZMQ_SNDMORE : 0);
+        assert (rc == (int) size_);
+    }
+
+    for (int i = 0; i != parts_; i++) {
+        zmq_msg_t msg;
+        int rc = zmq_msg_init (&msg);
+        assert (rc == 0);
+        rc = zmq_msg_recv (&msg, pull_, 0);
+        assert (rc == (int) size_);
+        assert (memcmp (zmq_msg_data (&msg), data + i * size_, size_) == 0);
+        assert (zmq_msg_more (&msg) == (i + 1 < parts_));
+        rc = zmq_msg_close (&msg);
+        assert (rc == 0);
+    }
+    free (data);
+}
+
+static void set_int (void *socket_, int option_, int value_)
+{
+    int rc = zmq_setsockopt (socket_, option_, &value_, sizeof (value_));
+    assert (rc == 0);
+}
+
+static uint64_t wire_bytes_out (void *socket_)
+{
+    zmq_socket_stats_t stats;
+    int rc = zmq_socket_stats (socket_, &stats);
+    assert (rc == 0);
+    return stats.wire_bytes_out;
+}
+
+//  Sends frames of all kinds through the pair and returns the bytes that
+//  went on the wire for the text frames, whose payload totals 300000
+//  bytes.
+static uint64_t run (void *push_, void *pull_)
+{
+    //  A first frame makes sure the handshake is done.
+    bounce (push_, pull_, 10, true);
+
+    uint64_t before = wire_bytes_out (push_);
+    bounce (push_, pull_, 100000, true, 3);
+    uint64_t text_bytes = wire_bytes_out (push_) - before;
+
+    //  Below the threshold, incompressible, and long runs of one byte.
+    bounce (push_, pull_, 255, true);
+    bounce (push_, pull_, 70000, false);
+    zmq_msg_t msg;
+    int rc = zmq_msg_init_size (&msg, 200000);
+    assert (rc == 0);
+    memset (zmq_msg_data (&msg), 'z', 200000);
+    rc = zmq_msg_send (&msg, push_, 0);
+    assert (rc == 200000);
+    rc = zmq_msg_init (&msg);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&msg, pull_, 0);
+    assert (rc == 200000);
+    for (int i = 0; i != 200000; i++)
+        assert (((char *) zmq_msg_data (&msg)) [i] == 'z');
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+
+    //  Every size around the threshold and the codec's limits.
+    for (size_t size = 250; size != 300; size++)
+        bounce (push_, pull_, size, true);
+    return text_bytes;
+}
+
+static void connect_pair (void *ctx_, const char *endpoint_,
+    int push_threshold_, int pull_threshold_, void **push_, void **pull_)
+{
+    *pull_ = zmq_socket (ctx_, ZMQ_PULL);
+    assert (*pull_);
+    *push_ = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (*push_);
+    set_int (*push_, ZMQ_COMPRESS_THRESHOLD, push_threshold_);
+    set_int (*pull_, ZMQ_COMPRESS_THRESHOLD, pull_threshold_);
+    int rc = zmq_bind (*pull_, endpoint_);
+    assert (rc == 0);
+    rc = zmq_connect (*push_, endpoint_);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  Default and invalid value.
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+    int value;
+    size_t size = sizeof (value);
+    int rc = zmq_getsockopt (push, ZMQ_COMPRESS_THRESHOLD, &value, &size);
+    assert (rc == 0 && value == 0);
+    value = -1;
+    rc = zmq_setsockopt (push, ZMQ_COMPRESS_THRESHOLD, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_close (push);
+    assert (rc == 0);
+
+    //  Frames are compressed only when both ends set the option.
+    void *pull;
+    connect_pair (ctx, "tcp://127.0.0.1:5612", 256, 0, &push, &pull);
+    uint64_t plain_bytes = run (push, pull);
+    assert (plain_bytes >= 300000);
+    close_zero_linger (push);
+    close_zero_linger (pull);
+
+    connect_pair (ctx, "tcp://127.0.0.1:5613", 256, 256, &push, &pull);
+    uint64_t compressed_bytes = run (push, pull);
+    assert (compressed_bytes < plain_bytes * 3 / 4);
+    close_zero_linger (push);
+    close_zero_linger (pull);
+
+    //  Compression survives encryption.
+    if (zmq_has ("curve")) {
+        char public_key [41];
+        char secret_key [41];
+        rc = zmq_curve_keypair (public_key, secret_key);
+        assert (rc == 0);
+        pull = zmq_socket (ctx, ZMQ_PULL);
+        assert (pull);
+        set_int (pull, ZMQ_CURVE_SERVER, 1);
+        rc = zmq_setsockopt (pull, ZMQ_CURVE_SECRETKEY, secret_key, 41);
+        assert (rc == 0);
+        set_int (pull, ZMQ_COMPRESS_THRESHOLD, 256);
+        rc = zmq_bind (pull, "tcp://127.0.0.1:5614");
+        assert (rc == 0);
+
+        char client_public [41];
+        char client_secret [41];
+        rc = zmq_curve_keypair (client_public, client_secret);
+        assert (rc == 0);
+        push = zmq_socket (ctx, ZMQ_PUSH);
+        assert (push);
+        rc = zmq_setsockopt (push, ZMQ_CURVE_SERVERKEY, public_key, 41);
+        assert (rc == 0);
+        rc = zmq_setsockopt (push, ZMQ_CURVE_PUBLICKEY, client_public, 41);
+        assert (rc == 0);
+        rc = zmq_setsockopt (push, ZMQ_CURVE_SECRETKEY, client_secret, 41);
+        assert (rc == 0);
+        set_int (push, ZMQ_COMPRESS_THRESHOLD, 256);
+        rc = zmq_connect (push, "tcp://127.0.0.1:5614");
+        assert (rc == 0);
+
+        compressed_bytes = run (push, pull);
+        assert (compressed_bytes < plain_bytes * 3 / 4);
+        close_zero_linger (push);
+        close_zero_linger (pull);
+    }
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
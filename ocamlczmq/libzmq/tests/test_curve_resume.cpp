@@ -0,0 +1,256 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+static char client_public [41];
+static char client_secret [41];
+static char server_public [41];
+static char server_secret [41];
+
+//  Secret key not matching client_public, with which only a resumed session
+//  can be established.
+static char wrong_secret [41];
+
+//  Number of ZAP requests handled.
+static int zap_requests = 0;
+
+static void zap_handler (void *handler)
+{
+    while (true) {
+        char *version = s_recv (handler);
+        if (!version)
+            break;          //  Terminating
+
+        char *sequence = s_recv (handler);
+        char *domain = s_recv (handler);
+        char *address = s_recv (handler);
+        char *identity = s_recv (handler);
+        char *mechanism = s_recv (handler);
+        uint8_t client_key [32];
+        int size = zmq_recv (handler, client_key, 32, 0);
+        assert (size == 32);
+        zap_requests++;
+
+        char client_key_text [41];
+        zmq_z85_encode (client_key_text, client_key, 32);
+        assert (streq (mechanism, "CURVE"));
+
+        s_sendmore (handler, version);
+        s_sendmore (handler, sequence);
+        if (streq (client_key_text, client_public)) {
+            s_sendmore (handler, "200");
+            s_sendmore (handler, "OK");
+            s_sendmore (handler, "anonymous");
+            s_send     (handler, "");
+        }
+        else {
+            s_sendmore (handler, "400");
+            s_sendmore (handler, "Invalid client public key");
+            s_sendmore (handler, "");
+            s_send     (handler, "");
+        }
+        free (version);
+        free (sequence);
+        free (domain);
+        free (address);
+        free (identity);
+        free (mechanism);
+    }
+    zmq_close (handler);
+}
+
+static void *new_server (void *ctx, const char *endpoint, int resume)
+{
+    void *server = zmq_socket (ctx, ZMQ_ROUTER);
+    assert (server);
+    int as_server = 1;
+    int rc = zmq_setsockopt (server, ZMQ_CURVE_SERVER, &as_server, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_CURVE_SECRETKEY, server_secret, 41);
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_CURVE_RESUME, &resume, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_bind (server, endpoint);
+    assert (rc == 0);
+    return server;
+}
+
+static void *new_client (void *ctx, const char *endpoint,
+    const char *secret, int resume)
+{
+    void *client = zmq_socket (ctx, ZMQ_DEALER);
+    assert (client);
+    int rc = zmq_setsockopt (client, ZMQ_CURVE_SERVERKEY, server_public, 41);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_PUBLICKEY, client_public, 41);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_SECRETKEY, secret, 41);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_RESUME, &resume, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_connect (client, endpoint);
+    assert (rc == 0);
+    return client;
+}
+
+//  Bounces a message off the server, checking that the client was
+//  authenticated with ZAP and the ticket is not exposed as metadata.
+static void echo (void *server, void *client)
+{
+    s_send (client, "Hello");
+
+    zmq_msg_t identity;
+    int rc = zmq_msg_init (&identity);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&identity, server, 0);
+    assert (rc > 0);
+    zmq_msg_t msg;
+    rc = zmq_msg_init (&msg);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&msg, server, 0);
+    assert (rc == 5);
+    assert (streq (zmq_msg_gets (&msg, "User-Id"), "anonymous"));
+    rc = zmq_msg_send (&identity, server, ZMQ_SNDMORE);
+    assert (rc > 0);
+    rc = zmq_msg_send (&msg, server, 0);
+    assert (rc == 5);
+
+    rc = zmq_msg_recv (&msg, client, 0);
+    assert (rc == 5);
+    assert (zmq_msg_gets (&msg, "Resume-Ticket") == NULL);
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+
+    close_zero_linger (client);
+}
+
+//  Checks that no session is established between the client and server.
+static void expect_no_echo (void *server, void *client)
+{
+    s_send (client, "Hello");
+
+    int timeout = 250;
+    int rc = zmq_setsockopt (server, ZMQ_RCVTIMEO, &timeout, sizeof (int));
+    assert (rc == 0);
+    char buffer [32];
+    rc = zmq_recv (server, buffer, sizeof buffer, 0);
+    assert (rc == -1 && zmq_errno () == EAGAIN);
+    timeout = -1;
+    rc = zmq_setsockopt (server, ZMQ_RCVTIMEO, &timeout, sizeof (int));
+    assert (rc == 0);
+
+    close_zero_linger (client);
+}
+
+int main (void)
+{
+#ifndef HAVE_LIBSODIUM
+    printf ("libsodium not installed, skipping CURVE test\n");
+    return 0;
+#endif
+
+    int rc = zmq_curve_keypair (client_public, client_secret);
+    assert (rc == 0);
+    rc = zmq_curve_keypair (server_public, server_secret);
+    assert (rc == 0);
+    char unused_public [41];
+    rc = zmq_curve_keypair (unused_public, wrong_secret);
+    assert (rc == 0);
+
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    void *handler = zmq_socket (ctx, ZMQ_REP);
+    assert (handler);
+    rc = zmq_bind (handler, "inproc://zeromq.zap.01");
+    assert (rc == 0);
+    void *zap_thread = zmq_threadstart (&zap_handler, handler);
+
+    //  The option is validated.
+    void *server = zmq_socket (ctx, ZMQ_ROUTER);
+    assert (server);
+    int resume = -1;
+    rc = zmq_setsockopt (server, ZMQ_CURVE_RESUME, &resume, sizeof (int));
+    assert (rc == -1 && errno == EINVAL);
+    size_t size = sizeof (int);
+    rc = zmq_getsockopt (server, ZMQ_CURVE_RESUME, &resume, &size);
+    assert (rc == 0 && resume == 0);
+    rc = zmq_close (server);
+    assert (rc == 0);
+
+    //  Servers with resumption on, with long and short lived tickets, and
+    //  one with resumption off. All have the same key.
+    server = new_server (ctx, "tcp://127.0.0.1:5621", 60000);
+    void *short_lived = new_server (ctx, "tcp://127.0.0.1:5622", 100);
+    void *no_resume = new_server (ctx, "tcp://127.0.0.1:5623", 0);
+
+    //  The full handshake gets the client a ticket.
+    echo (server, new_client (ctx, "tcp://127.0.0.1:5621",
+        client_secret, 60000));
+    assert (zap_requests == 1);
+
+    //  The session is resumed with it, without the client proving its
+    //  key anew. The client is still authenticated with ZAP.
+    echo (server, new_client (ctx, "tcp://127.0.0.1:5621",
+        wrong_secret, 60000));
+    assert (zap_requests == 2);
+
+    //  Without resumption the same client fails the full handshake.
+    expect_no_echo (server, new_client (ctx, "tcp://127.0.0.1:5621",
+        wrong_secret, 0));
+
+    //  The resumed session got the client another ticket, which the server
+    //  with short lived tickets redeems too, issuing one that expires.
+    echo (short_lived, new_client (ctx, "tcp://127.0.0.1:5622",
+        wrong_secret, 60000));
+    msleep (300);
+    expect_no_echo (short_lived, new_client (ctx, "tcp://127.0.0.1:5622",
+        wrong_secret, 60000));
+
+    //  A server not resuming sessions turns the ticket down and the client
+    //  falls back to the full handshake, which uses the ticket up.
+    echo (server, new_client (ctx, "tcp://127.0.0.1:5621",
+        client_secret, 60000));
+    echo (no_resume, new_client (ctx, "tcp://127.0.0.1:5623",
+        client_secret, 60000));
+    expect_no_echo (server, new_client (ctx, "tcp://127.0.0.1:5621",
+        wrong_secret, 60000));
+
+    close_zero_linger (server);
+    close_zero_linger (short_lived);
+    close_zero_linger (no_resume);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    zmq_threadclose (zap_thread);
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    void *pub = zmq_socket (ctx, ZMQ_PUB);
+    assert (pub);
+
+    //  Default is off, negative values are rejected
+    int value;
+    size_t size = sizeof (value);
+    int rc = zmq_getsockopt (pub, ZMQ_GATHER_THRESHOLD, &value, &size);
+    assert (rc == 0);
+    assert (value == 0);
+    value = -1;
+    rc = zmq_setsockopt (pub, ZMQ_GATHER_THRESHOLD, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+
+    value = 1024;
+    rc = zmq_setsockopt (pub, ZMQ_GATHER_THRESHOLD, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_getsockopt (pub, ZMQ_GATHER_THRESHOLD, &value, &size);
+    assert (rc == 0);
+    assert (value == 1024);
+    rc = zmq_bind (pub, "tcp://127.0.0.1:*");
+    assert (rc == 0);
+    char endpoint [256];
+    size = sizeof (endpoint);
+    rc = zmq_getsockopt (pub, ZMQ_LAST_ENDPOINT, endpoint, &size);
+    assert (rc == 0);
+
+    //  Several subscribers share every message buffer
+    void *subs [3];
+    for (int i = 0; i != 3; i++) {
+        subs [i] = zmq_socket (ctx, ZMQ_SUB);
+        assert (subs [i]);
+        rc = zmq_setsockopt (subs [i], ZMQ_SUBSCRIBE, "", 0);
+        assert (rc == 0);
+        rc = zmq_connect (subs [i], endpoint);
+        assert (rc == 0);
+    }
+    msleep (SETTLE_TIME);
+
+    //  Mix bodies below and above the threshold, including bodies larger
+    //  than the output batch, and check they all arrive intact and in order
+    const size_t sizes [] = {0, 10, 1023, 1024, 5000, 8192, 100000, 20, 300000};
+    const int count = sizeof (sizes) / sizeof (sizes [0]);
+    for (int i = 0; i != count; i++) {
+        zmq_msg_t msg;
+        rc = zmq_msg_init_size (&msg, sizes [i]);
+        assert (rc == 0);
+        unsigned char *data = (unsigned char *) zmq_msg_data (&msg);
+        for (size_t j = 0; j != sizes [i]; j++)
+            data [j] = (unsigned char) (i + j);
+        rc = zmq_msg_send (&msg, pub, i % 2 ? ZMQ_SNDMORE : 0);
+        assert (rc == (int) sizes [i]);
+    }
+    for (int s = 0; s != 3; s++)
+        for (int i = 0; i != count; i++) {
+            zmq_msg_t msg;
+            rc = zmq_msg_init (&msg);
+            assert (rc == 0);
+            rc = zmq_msg_recv (&msg, subs [s], 0);
+            assert (rc == (int) sizes [i]);
+            assert (zmq_msg_more (&msg) == i % 2);
+            unsigned char *data = (unsigned char *) zmq_msg_data (&msg);
+            for (size_t j = 0; j != sizes [i]; j++)
+                assert (data [j] == (unsigned char) (i + j));
+            rc = zmq_msg_close (&msg);
+            assert (rc == 0);
+        }
+
+    for (int i = 0; i != 3; i++) {
+        rc = zmq_close (subs [i]);
+        assert (rc == 0);
+    }
+    rc = zmq_close (pub);
+    assert (rc == 0);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
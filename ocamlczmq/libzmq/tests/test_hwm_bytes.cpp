@@ -0,0 +1,275 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+#if defined ZMQ_HAVE_LINUX
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+//  Resident set size of the process in bytes, 0 where it isn't known.
+static size_t resident_size ()
+{
+#if defined ZMQ_HAVE_LINUX
+    FILE *f = fopen ("/proc/self/statm", "r");
+    if (!f)
+        return 0;
+    unsigned long pages = 0;
+    unsigned long resident = 0;
+    int rc = fscanf (f, "%lu %lu", &pages, &resident);
+    fclose (f);
+    if (rc != 2)
+        return 0;
+    return (size_t) resident * sysconf (_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+//  Sends messages of the given size without blocking until the socket
+//  refuses them. Returns the number of messages sent.
+static int flood (void *socket_, const char *data_, size_t size_)
+{
+    //  Have the socket process the acknowledgements its peers have sent,
+    //  which sending without blocking only does now and then
+    int events;
+    size_t events_size = sizeof (events);
+    int rc = zmq_getsockopt (socket_, ZMQ_EVENTS, &events, &events_size);
+    assert (rc == 0);
+
+    int count = 0;
+    while (zmq_send (socket_, data_, size_, ZMQ_DONTWAIT) == (int) size_)
+        count++;
+    assert (errno == EAGAIN);
+    return count;
+}
+
+//  Receives without blocking until the socket has nothing left.
+static int drain (void *socket_, char *data_, size_t size_)
+{
+    int count = 0;
+    while (zmq_recv (socket_, data_, size_, ZMQ_DONTWAIT) != -1)
+        count++;
+    assert (errno == EAGAIN);
+    return count;
+}
+
+static void test_options ()
+{
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  Defaults are off, negative values are rejected
+    assert (zmq_ctx_get (ctx, ZMQ_MEMORY_BUDGET) == 0);
+    int rc = zmq_ctx_set (ctx, ZMQ_MEMORY_BUDGET, -1);
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_ctx_set (ctx, ZMQ_MEMORY_BUDGET, 4096);
+    assert (rc == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_MEMORY_BUDGET) == 4096);
+
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+    const int options [] = {ZMQ_SNDHWM_BYTES, ZMQ_RCVHWM_BYTES};
+    for (int i = 0; i != 2; i++) {
+        int64_t value;
+        size_t size = sizeof (value);
+        rc = zmq_getsockopt (push, options [i], &value, &size);
+        assert (rc == 0);
+        assert (value == 0);
+        value = -1;
+        rc = zmq_setsockopt (push, options [i], &value, sizeof (value));
+        assert (rc == -1 && errno == EINVAL);
+        value = 1 << 20;
+        rc = zmq_setsockopt (push, options [i], &value, sizeof (value));
+        assert (rc == 0);
+        rc = zmq_getsockopt (push, options [i], &value, &size);
+        assert (rc == 0);
+        assert (value == 1 << 20);
+    }
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+}
+
+static void test_inproc (char *buffer_)
+{
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+    int64_t value = 1 << 20;
+    int rc = zmq_setsockopt (push, ZMQ_SNDHWM_BYTES, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_bind (push, "inproc://hwm_bytes");
+    assert (rc == 0);
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    rc = zmq_connect (pull, "inproc://hwm_bytes");
+    assert (rc == 0);
+
+    //  Four 256kB messages fill the 1MB limit, far below the message HWM
+    const size_t size = 256 * 1024;
+    assert (flood (push, buffer_, size) == 4);
+
+    //  Once the reader has caught up, the writer can go on
+    assert (drain (pull, buffer_, size) == 4);
+    assert (flood (push, buffer_, size) == 4);
+    assert (drain (pull, buffer_, size) == 4);
+
+    //  Small messages are stopped by the byte limit just the same
+    assert (flood (push, buffer_, 1024) == 1024);
+    assert (drain (pull, buffer_, 1024) == 1024);
+
+    rc = zmq_close (pull);
+    assert (rc == 0);
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+}
+
+static void test_tcp_flood (char *buffer_)
+{
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  Without the byte limits the default HWMs would let 2GB be queued
+    const size_t size = 1024 * 1024;
+    const int64_t value = 2 * size;
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+    int rc = zmq_setsockopt (push, ZMQ_SNDHWM_BYTES, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_bind (push, "tcp://127.0.0.1:5597");
+    assert (rc == 0);
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    rc = zmq_setsockopt (pull, ZMQ_RCVHWM_BYTES, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_connect (pull, "tcp://127.0.0.1:5597");
+    assert (rc == 0);
+    msleep (SETTLE_TIME);
+
+    //  Keep sending while the I/O threads move the data on, until
+    //  everything on the way is full
+    const size_t rss_before = resident_size ();
+    int sent = 0;
+    for (int idle = 0; idle != 5; ) {
+        const int count = flood (push, buffer_, size);
+        sent += count;
+        idle = count ? 0 : idle + 1;
+        msleep (SETTLE_TIME);
+    }
+    const size_t rss_after = resident_size ();
+
+    //  Both pipes hold 2MB and one more message, the rest is in the
+    //  kernel's socket buffers
+    assert (sent < 64);
+    assert (rss_after < rss_before + 64 * size);
+
+    int received = 0;
+    while (received != sent) {
+        rc = zmq_recv (pull, buffer_, size, 0);
+        assert (rc == (int) size);
+        received++;
+    }
+
+    rc = zmq_close (pull);
+    assert (rc == 0);
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+}
+
+static void test_memory_budget (char *buffer_)
+{
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+    int rc = zmq_ctx_set (ctx, ZMQ_MEMORY_BUDGET, 1024);
+    assert (rc == 0);
+
+    void *push [4];
+    void *pull [4];
+    for (int i = 0; i != 4; i++) {
+        char endpoint [32];
+        sprintf (endpoint, "inproc://budget-%d", i);
+        push [i] = zmq_socket (ctx, ZMQ_PUSH);
+        assert (push [i]);
+        rc = zmq_bind (push [i], endpoint);
+        assert (rc == 0);
+        pull [i] = zmq_socket (ctx, ZMQ_PULL);
+        assert (pull [i]);
+        rc = zmq_connect (pull [i], endpoint);
+        assert (rc == 0);
+    }
+
+    //  The first pipe takes the whole 1MB budget, the others can still
+    //  move one message each
+    const size_t size = 256 * 1024;
+    assert (flood (push [0], buffer_, size) == 4);
+    for (int i = 1; i != 4; i++)
+        assert (flood (push [i], buffer_, size) == 1);
+
+    //  Draining pipes gives their share of the budget back. With 512kB
+    //  left in use, the first pipe can take two messages again
+    assert (drain (pull [0], buffer_, size) == 4);
+    assert (drain (pull [1], buffer_, size) == 1);
+    assert (flood (push [0], buffer_, size) == 2);
+
+    for (int i = 0; i != 4; i++) {
+        drain (pull [i], buffer_, size);
+        rc = zmq_close (pull [i]);
+        assert (rc == 0);
+        rc = zmq_close (push [i]);
+        assert (rc == 0);
+    }
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    char *buffer = (char *) malloc (1024 * 1024);
+    assert (buffer);
+    memset (buffer, 0, 1024 * 1024);
+
+    test_options ();
+    test_inproc (buffer);
+    test_tcp_flood (buffer);
+    test_memory_budget (buffer);
+
+    free (buffer);
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+//  Pairs of PUSH/PULL sockets over TCP. The pairs with an even index carry
+//  a lot more traffic, so that the I/O threads get unevenly loaded and the
+//  engines are moved around while messages flow.
+const int pairs = 4;
+const int heavy_count = 200000;
+const int light_count = 2000;
+
+struct pair_t
+{
+    void *push;
+    void *pull;
+    int count;
+};
+
+static void sender (void *arg_)
+{
+    pair_t *pair = (pair_t *) arg_;
+    for (int i = 0; i != pair->count; i++) {
+        int rc = zmq_send (pair->push, &i, sizeof (i), 0);
+        assert (rc == sizeof (i));
+    }
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  Default is off, negative values are rejected
+    assert (zmq_ctx_get (ctx, ZMQ_IO_REBALANCE_IVL) == 0);
+    int rc = zmq_ctx_set (ctx, ZMQ_IO_REBALANCE_IVL, -1);
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_ctx_set (ctx, ZMQ_IO_REBALANCE_IVL, 5);
+    assert (rc == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_IO_REBALANCE_IVL) == 5);
+    rc = zmq_ctx_set (ctx, ZMQ_IO_THREADS, 3);
+    assert (rc == 0);
+
+    pair_t pair [pairs];
+    void *threads [pairs];
+    for (int i = 0; i != pairs; i++) {
+        char endpoint [32];
+        sprintf (endpoint, "tcp://127.0.0.1:%d", 5590 + i);
+        pair [i].pull = zmq_socket (ctx, ZMQ_PULL);
+        assert (pair [i].pull);
+        pair [i].push = zmq_socket (ctx, ZMQ_PUSH);
+        assert (pair [i].push);
+
+        //  Heartbeats keep a timer running in the engines
+        int ivl = 20;
+        rc = zmq_setsockopt (pair [i].push, ZMQ_HEARTBEAT_IVL, &ivl,
+            sizeof (ivl));
+        assert (rc == 0);
+        int timeout = 10000;
+        rc = zmq_setsockopt (pair [i].push, ZMQ_HEARTBEAT_TIMEOUT, &timeout,
+            sizeof (timeout));
+        assert (rc == 0);
+
+        rc = zmq_bind (pair [i].pull, endpoint);
+        assert (rc == 0);
+        rc = zmq_connect (pair [i].push, endpoint);
+        assert (rc == 0);
+        pair [i].count = i % 2 ? light_count : heavy_count;
+    }
+    for (int i = 0; i != pairs; i++)
+        threads [i] = zmq_threadstart (&sender, &pair [i]);
+
+    //  Every message arrives exactly once and in order
+    int received [pairs];
+    memset (received, 0, sizeof (received));
+    zmq_pollitem_t items [pairs];
+    for (int i = 0; i != pairs; i++) {
+        items [i].socket = pair [i].pull;
+        items [i].fd = 0;
+        items [i].events = ZMQ_POLLIN;
+        items [i].revents = 0;
+    }
+    int done = 0;
+    while (done != pairs) {
+        rc = zmq_poll (items, pairs, -1);
+        assert (rc > 0);
+        for (int i = 0; i != pairs; i++) {
+            while (received [i] != pair [i].count) {
+                int value;
+                rc = zmq_recv (pair [i].pull, &value, sizeof (value),
+                    ZMQ_DONTWAIT);
+                if (rc == -1) {
+                    assert (errno == EAGAIN);
+                    break;
+                }
+                assert (rc == sizeof (value));
+                assert (value == received [i]);
+                if (++received [i] == pair [i].count)
+                    done++;
+            }
+        }
+    }
+
+    for (int i = 0; i != pairs; i++) {
+        zmq_threadclose (threads [i]);
+        rc = zmq_close (pair [i].push);
+        assert (rc == 0);
+        rc = zmq_close (pair [i].pull);
+        assert (rc == 0);
+    }
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+#if defined ZMQ_HAVE_LINUX
+#include <sched.h>
+#include <dirent.h>
+#include <stdio.h>
+
+//  Returns the first CPU the process may run on.
+static int allowed_cpu ()
+{
+    cpu_set_t cpus;
+    int rc = sched_getaffinity (0, sizeof (cpus), &cpus);
+    assert (rc == 0);
+    for (int cpu = 0; cpu != CPU_SETSIZE; cpu++)
+        if (CPU_ISSET (cpu, &cpus))
+            return cpu;
+    assert (false);
+    return -1;
+}
+
+//  Returns the number of the process's threads allowed to run on the
+//  given CPU only.
+static int threads_on (int cpu_)
+{
+    char expected [32];
+    sprintf (expected, "Cpus_allowed_list:\t%d\n", cpu_);
+    int count = 0;
+    DIR *tasks = opendir ("/proc/self/task");
+    assert (tasks);
+    struct dirent *task;
+    while ((task = readdir (tasks)) != NULL) {
+        if (task->d_name [0] == '.')
+            continue;
+        char path [300];
+        sprintf (path, "/proc/self/task/%s/status", task->d_name);
+        FILE *status = fopen (path, "r");
+        if (!status)
+            continue;
+        char line [256];
+        while (fgets (line, sizeof (line), status))
+            if (strcmp (line, expected) == 0)
+                count++;
+        fclose (status);
+    }
+    closedir (tasks);
+    return count;
+}
+#endif
+
+static void set_affinity_fails (void *ctx_, const char *value_)
+{
+    int rc = zmq_ctx_set_ext (ctx_, ZMQ_IO_THREAD_AFFINITY, value_,
+        strlen (value_));
+    assert (rc == -1 && errno == EINVAL);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+
+    int rc = zmq_ctx_set_ext (NULL, ZMQ_IO_THREAD_AFFINITY, "0", 1);
+    assert (rc == -1 && errno == EFAULT);
+
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  No I/O thread is pinned by default.
+    char value [64];
+    size_t size = sizeof (value);
+    rc = zmq_ctx_get_ext (ctx, ZMQ_IO_THREAD_AFFINITY, value, &size);
+    assert (rc == 0 && size == 1 && value [0] == 0);
+
+    //  Malformed CPU lists are rejected.
+    set_affinity_fails (ctx, "x");
+    set_affinity_fails (ctx, "0,");
+    set_affinity_fails (ctx, ",0");
+    set_affinity_fails (ctx, "3-1");
+    set_affinity_fails (ctx, "0-");
+    set_affinity_fails (ctx, "0;1 ");
+    set_affinity_fails (ctx, "1024");
+    rc = zmq_ctx_set_ext (ctx, ZMQ_MAX_SOCKETS, "1", 1);
+    assert (rc == -1 && errno == EINVAL);
+
+    //  Lists are kept as they were set.
+    const char *lists = "0-1,4;;2";
+    rc = zmq_ctx_set_ext (ctx, ZMQ_IO_THREAD_AFFINITY, lists, strlen (lists));
+    assert (rc == 0);
+    size = sizeof (value);
+    rc = zmq_ctx_get_ext (ctx, ZMQ_IO_THREAD_AFFINITY, value, &size);
+    assert (rc == 0 && size == strlen (lists) + 1);
+    assert (strcmp (value, lists) == 0);
+    size = 3;
+    rc = zmq_ctx_get_ext (ctx, ZMQ_IO_THREAD_AFFINITY, value, &size);
+    assert (rc == -1 && errno == EINVAL);
+
+    //  Pin both I/O threads to a CPU the process may use, and pass
+    //  messages through each of them.
+#if defined ZMQ_HAVE_LINUX
+    const int cpu = allowed_cpu ();
+#else
+    const int cpu = 0;
+#endif
+    char pinned [32];
+    sprintf (pinned, "%d;%d", cpu, cpu);
+    rc = zmq_ctx_set_ext (ctx, ZMQ_IO_THREAD_AFFINITY, pinned, strlen (pinned));
+    assert (rc == 0);
+    rc = zmq_ctx_set (ctx, ZMQ_IO_THREADS, 2);
+    assert (rc == 0);
+
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    rc = zmq_bind (pull, "tcp://127.0.0.1:5604");
+    assert (rc == 0);
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+    rc = zmq_connect (push, "tcp://127.0.0.1:5604");
+    assert (rc == 0);
+    for (int i = 0; i != 10; i++)
+        s_send_seq (push, "data", SEQ_END);
+    for (int i = 0; i != 10; i++)
+        s_recv_seq (pull, "data", SEQ_END);
+
+#if defined ZMQ_HAVE_LINUX
+    assert (threads_on (cpu) >= 2);
+#endif
+
+    close_zero_linger (push);
+    close_zero_linger (pull);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
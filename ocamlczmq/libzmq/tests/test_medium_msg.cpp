@@ -0,0 +1,285 @@
+/*
+    Copyright (c) 2007-2016 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+//  Small enough to be stored inline, medium, and too large for the slots.
+static const size_t sizes [] = {20, 100, 1024, 2000};
+static const int size_count = sizeof (sizes) / sizeof (sizes [0]);
+
+static void fill (unsigned char *data_, size_t size_, int seed_)
+{
+    for (size_t i = 0; i != size_; i++)
+        data_ [i] = (unsigned char) (seed_ + i);
+}
+
+static void verify (zmq_msg_t *msg_, size_t size_, int seed_)
+{
+    assert (zmq_msg_size (msg_) == size_);
+    unsigned char *data = (unsigned char*) zmq_msg_data (msg_);
+    for (size_t i = 0; i != size_; i++)
+        assert (data [i] == (unsigned char) (seed_ + i));
+}
+
+static void send_sized (void *socket_, size_t size_, int seed_)
+{
+    unsigned char buf [2000];
+    assert (size_ <= sizeof buf);
+    fill (buf, size_, seed_);
+    int rc = zmq_send (socket_, buf, size_, 0);
+    assert (rc == (int) size_);
+}
+
+static void recv_sized (void *socket_, size_t size_, int seed_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&msg, socket_, 0);
+    assert (rc == (int) size_);
+    verify (&msg, size_, seed_);
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+}
+
+static void set_medium_size (void *socket_, int size_)
+{
+    int rc = zmq_setsockopt (socket_, ZMQ_MEDIUM_MSG_SIZE, &size_,
+        sizeof size_);
+    assert (rc == 0);
+}
+
+static zmq_socket_stats_t get_stats (void *socket_)
+{
+    zmq_socket_stats_t stats;
+    int rc = zmq_socket_stats (socket_, &stats);
+    assert (rc == 0);
+    return stats;
+}
+
+static void test_option (void *ctx_)
+{
+    void *socket = zmq_socket (ctx_, ZMQ_PAIR);
+    assert (socket);
+
+    int value = -1;
+    size_t size = sizeof value;
+    int rc = zmq_getsockopt (socket, ZMQ_MEDIUM_MSG_SIZE, &value, &size);
+    assert (rc == 0 && value == 0);
+
+    value = -1;
+    rc = zmq_setsockopt (socket, ZMQ_MEDIUM_MSG_SIZE, &value, sizeof value);
+    assert (rc == -1 && errno == EINVAL);
+    value = 8193;
+    rc = zmq_setsockopt (socket, ZMQ_MEDIUM_MSG_SIZE, &value, sizeof value);
+    assert (rc == -1 && errno == EINVAL);
+
+    set_medium_size (socket, 1024);
+    rc = zmq_getsockopt (socket, ZMQ_MEDIUM_MSG_SIZE, &value, &size);
+    assert (rc == 0 && value == 1024);
+
+    rc = zmq_close (socket);
+    assert (rc == 0);
+}
+
+static void test_inproc (void *ctx_)
+{
+    void *sender = zmq_socket (ctx_, ZMQ_PAIR);
+    assert (sender);
+    set_medium_size (sender, 1024);
+    //  The sender's buffer has a slot for twice as many messages as its
+    //  high water mark, fewer than the pipe to the receiver holds.
+    int hwm = 100;
+    int rc = zmq_setsockopt (sender, ZMQ_SNDHWM, &hwm, sizeof hwm);
+    assert (rc == 0);
+    rc = zmq_bind (sender, "inproc://medium");
+    assert (rc == 0);
+    void *receiver = zmq_socket (ctx_, ZMQ_PAIR);
+    assert (receiver);
+    rc = zmq_connect (receiver, "inproc://medium");
+    assert (rc == 0);
+
+    //  Only the medium sizes are carved from the buffer.
+    for (int i = 0; i != size_count; i++)
+        send_sized (sender, sizes [i], i);
+    for (int i = 0; i != size_count; i++)
+        recv_sized (receiver, sizes [i], i);
+    zmq_socket_stats_t stats = get_stats (sender);
+    assert (stats.medium_msgs == 2);
+    assert (stats.medium_misses == 0);
+
+    //  With more messages queued than the buffer has slots, the rest go
+    //  to the heap. All arrive intact.
+    for (int i = 0; i != 1000; i++)
+        send_sized (sender, 1024, i);
+    for (int i = 0; i != 1000; i++)
+        recv_sized (receiver, 1024, i);
+    stats = get_stats (sender);
+    assert (stats.medium_msgs > 2);
+    assert (stats.medium_misses > 0);
+    assert (stats.medium_msgs + stats.medium_misses == 1002);
+
+    //  A copy keeps the content alive after the original is closed, and
+    //  messages outlive the sockets and the buffer's owner.
+    send_sized (sender, 100, 7);
+    send_sized (sender, 100, 8);
+    zmq_msg_t msg, copy, held;
+    rc = zmq_msg_init (&msg);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&msg, receiver, 0);
+    assert (rc == 100);
+    rc = zmq_msg_init (&copy);
+    assert (rc == 0);
+    rc = zmq_msg_copy (&copy, &msg);
+    assert (rc == 0);
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+    rc = zmq_msg_init (&held);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&held, receiver, 0);
+    assert (rc == 100);
+
+    rc = zmq_close (receiver);
+    assert (rc == 0);
+    rc = zmq_close (sender);
+    assert (rc == 0);
+    msleep (SETTLE_TIME);
+
+    verify (&copy, 100, 7);
+    verify (&held, 100, 8);
+    rc = zmq_msg_close (&copy);
+    assert (rc == 0);
+    rc = zmq_msg_close (&held);
+    assert (rc == 0);
+}
+
+static void test_fan_out (void *ctx_)
+{
+    //  The same medium message is queued to every subscriber.
+    void *pub = zmq_socket (ctx_, ZMQ_PUB);
+    assert (pub);
+    set_medium_size (pub, 1024);
+    int rc = zmq_bind (pub, "inproc://medium-pub");
+    assert (rc == 0);
+
+    void *subs [3];
+    for (int i = 0; i != 3; i++) {
+        subs [i] = zmq_socket (ctx_, ZMQ_SUB);
+        assert (subs [i]);
+        rc = zmq_setsockopt (subs [i], ZMQ_SUBSCRIBE, "", 0);
+        assert (rc == 0);
+        rc = zmq_connect (subs [i], "inproc://medium-pub");
+        assert (rc == 0);
+    }
+    msleep (SETTLE_TIME);
+
+    for (int i = 0; i != 100; i++)
+        send_sized (pub, 500, i);
+    for (int s = 0; s != 3; s++)
+        for (int i = 0; i != 100; i++)
+            recv_sized (subs [s], 500, i);
+
+    for (int i = 0; i != 3; i++) {
+        rc = zmq_close (subs [i]);
+        assert (rc == 0);
+    }
+    rc = zmq_close (pub);
+    assert (rc == 0);
+}
+
+static void test_tcp (void *ctx_)
+{
+    //  The decoder of the connection carves medium messages that don't fit
+    //  in its read buffer from its own buffer, whichever way the sender
+    //  built them. Messages within the read buffer reference it instead.
+    void *pull = zmq_socket (ctx_, ZMQ_PULL);
+    assert (pull);
+    set_medium_size (pull, 1024);
+    int recv_buffer = 512;
+    int rc = zmq_setsockopt (pull, ZMQ_TCP_RECV_BUFFER, &recv_buffer,
+        sizeof recv_buffer);
+    assert (rc == 0);
+    rc = zmq_bind (pull, "tcp://127.0.0.1:5631");
+    assert (rc == 0);
+    void *push = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (push);
+    rc = zmq_connect (push, "tcp://127.0.0.1:5631");
+    assert (rc == 0);
+
+    for (int round = 0; round != 20; round++) {
+        for (int i = 0; i != size_count; i++) {
+            zmq_msg_t msg;
+            rc = zmq_msg_init_size (&msg, sizes [i]);
+            assert (rc == 0);
+            fill ((unsigned char*) zmq_msg_data (&msg), sizes [i], round + i);
+            rc = zmq_msg_send (&msg, push, 0);
+            assert (rc == (int) sizes [i]);
+        }
+        for (int i = 0; i != size_count; i++)
+            recv_sized (pull, sizes [i], round + i);
+    }
+    zmq_socket_stats_t stats = get_stats (pull);
+    //  The engine's counters may lag a little behind the messages.
+    assert (stats.medium_msgs > 0);
+
+    //  A message received last is still readable once the connection and
+    //  its buffer are gone.
+    send_sized (push, 100, 9);
+    zmq_msg_t held;
+    rc = zmq_msg_init (&held);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&held, pull, 0);
+    assert (rc == 100);
+
+    close_zero_linger (push);
+    close_zero_linger (pull);
+    msleep (SETTLE_TIME);
+
+    verify (&held, 100, 9);
+    rc = zmq_msg_close (&held);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    test_option (ctx);
+    test_inproc (ctx);
+    test_fan_out (ctx);
+    test_tcp (ctx);
+
+    int rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
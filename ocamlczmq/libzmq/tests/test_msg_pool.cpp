@@ -0,0 +1,136 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+//  Sizes straddling the pool's size classes, including one too large to
+//  be pooled.
+static const size_t sizes [] = {34, 100, 1000, 4000, 17000, 70000};
+static const int size_count = sizeof (sizes) / sizeof (sizes [0]);
+
+static void fill (zmq_msg_t *msg_, int seed_)
+{
+    unsigned char *data = (unsigned char*) zmq_msg_data (msg_);
+    for (size_t i = 0; i != zmq_msg_size (msg_); i++)
+        data [i] = (unsigned char) (seed_ + i);
+}
+
+static void verify (zmq_msg_t *msg_, int seed_)
+{
+    unsigned char *data = (unsigned char*) zmq_msg_data (msg_);
+    for (size_t i = 0; i != zmq_msg_size (msg_); i++)
+        assert (data [i] == (unsigned char) (seed_ + i));
+}
+
+//  Allocates messages and exits before they are closed, so that they are
+//  freed after their owning thread is gone.
+static void orphan_thread (void *msgs_)
+{
+    zmq_msg_t *msgs = (zmq_msg_t*) msgs_;
+    for (int i = 0; i != size_count; i++) {
+        int rc = zmq_msg_init_size (&msgs [i], sizes [i]);
+        assert (rc == 0);
+        fill (&msgs [i], i);
+    }
+    //  A few blocks freed locally stay in the thread's free lists.
+    zmq_msg_t msg;
+    int rc = zmq_msg_init_size (&msg, 500);
+    assert (rc == 0);
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    assert (zmq_ctx_get (ctx, ZMQ_MSG_POOL) == 0);
+    int rc = zmq_ctx_set (ctx, ZMQ_MSG_POOL, 1);
+    assert (rc == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_MSG_POOL) == 1);
+
+    //  Messages cross the application and I/O threads in both directions:
+    //  sent messages are freed by the I/O thread, received ones are carved
+    //  out of decoder buffers allocated by the I/O thread.
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+    rc = zmq_bind (push, "tcp://127.0.0.1:5598");
+    assert (rc == 0);
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    rc = zmq_connect (pull, "tcp://127.0.0.1:5598");
+    assert (rc == 0);
+
+    for (int round = 0; round != 50; round++) {
+        for (int i = 0; i != size_count; i++) {
+            zmq_msg_t msg;
+            rc = zmq_msg_init_size (&msg, sizes [i]);
+            assert (rc == 0);
+            fill (&msg, round + i);
+            rc = zmq_msg_send (&msg, push, 0);
+            assert (rc == (int) sizes [i]);
+        }
+        for (int i = 0; i != size_count; i++) {
+            zmq_msg_t msg;
+            rc = zmq_msg_init (&msg);
+            assert (rc == 0);
+            rc = zmq_msg_recv (&msg, pull, 0);
+            assert (rc == (int) sizes [i]);
+            verify (&msg, round + i);
+            rc = zmq_msg_close (&msg);
+            assert (rc == 0);
+        }
+    }
+
+    zmq_msg_t msgs [size_count];
+    void *thread = zmq_threadstart (&orphan_thread, msgs);
+    zmq_threadclose (thread);
+    for (int i = 0; i != size_count; i++) {
+        verify (&msgs [i], i);
+        rc = zmq_msg_close (&msgs [i]);
+        assert (rc == 0);
+    }
+
+    rc = zmq_close (pull);
+    assert (rc == 0);
+    rc = zmq_close (push);
+    assert (rc == 0);
+
+    rc = zmq_ctx_set (ctx, ZMQ_MSG_POOL, 0);
+    assert (rc == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_MSG_POOL) == 0);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
@@ -101,6 +101,9 @@ int main (void)
 
     rc = zmq_getsockopt (bowl, ZMQ_FD, &fd, &fd_size);
     assert (rc == 0);
+    //  The socket's own FD can be polled while the socket is registered
+    rc = zmq_poller_add (poller, bowl, NULL, 0);
+    assert (rc == 0);
     rc = zmq_poller_add_fd (poller, fd, bowl, ZMQ_POLLIN);
     assert (rc == 0);
     rc = zmq_poller_wait (poller, &event, 500);
@@ -109,6 +112,8 @@ int main (void)
     assert (event.fd == fd);
     assert (event.user_data == bowl);
     zmq_poller_remove_fd (poller, fd);
+    rc = zmq_poller_remove (poller, bowl);
+    assert (rc == 0);
 
     //  Polling on thread safe sockets
     rc = zmq_poller_add (poller, server, NULL, ZMQ_POLLIN);
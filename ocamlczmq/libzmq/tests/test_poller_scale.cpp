@@ -0,0 +1,198 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+//  Registers many sockets with a poller of which only a few ever become
+//  ready, and checks that readiness caused by the application's own
+//  calls is reported as well as readiness caused by peers.
+
+#define SOCKET_COUNT 500
+
+static void test_many_sockets (void *ctx_)
+{
+    void *sinks [SOCKET_COUNT];
+    void *poller = zmq_poller_new ();
+    assert (poller);
+
+    char endpoint [32];
+    for (int i = 0; i != SOCKET_COUNT; i++) {
+        sinks [i] = zmq_socket (ctx_, ZMQ_PULL);
+        assert (sinks [i]);
+        sprintf (endpoint, "inproc://sink-%d", i);
+        int rc = zmq_bind (sinks [i], endpoint);
+        assert (rc == 0);
+        rc = zmq_poller_add (poller, sinks [i], &sinks [i], ZMQ_POLLIN);
+        assert (rc == 0);
+    }
+
+    //  Nothing is ready.
+    zmq_poller_event_t event;
+    int rc = zmq_poller_wait (poller, &event, 0);
+    assert (rc == -1 && errno == ETIMEDOUT);
+
+    const int active [3] = {7, SOCKET_COUNT / 2, SOCKET_COUNT - 1};
+    void *vents [3];
+    for (int i = 0; i != 3; i++) {
+        vents [i] = zmq_socket (ctx_, ZMQ_PUSH);
+        assert (vents [i]);
+        sprintf (endpoint, "inproc://sink-%d", active [i]);
+        rc = zmq_connect (vents [i], endpoint);
+        assert (rc == 0);
+    }
+
+    //  Each active sink is reported until it is drained, and no other.
+    for (int round = 0; round != 10; round++) {
+        for (int i = 0; i != 3; i++) {
+            rc = zmq_send (vents [i], "x", 1, 0);
+            assert (rc == 1);
+        }
+        int seen = 0;
+        for (int i = 0; i != 3; i++) {
+            rc = zmq_poller_wait (poller, &event, 1000);
+            assert (rc == 0);
+            assert (event.events == ZMQ_POLLIN);
+            const int index = (int) ((void**) event.user_data - sinks);
+            assert (index == active [0] || index == active [1] ||
+                index == active [2]);
+            assert (event.socket == sinks [index]);
+            seen |= 1 << (index == active [0] ? 0 :
+                index == active [1] ? 1 : 2);
+            char buffer [1];
+            rc = zmq_recv (event.socket, buffer, 1, 0);
+            assert (rc == 1);
+        }
+        assert (seen == 7);
+        rc = zmq_poller_wait (poller, &event, 0);
+        assert (rc == -1 && errno == ETIMEDOUT);
+    }
+
+    //  A removed socket is not reported even with a message waiting.
+    rc = zmq_send (vents [1], "x", 1, 0);
+    assert (rc == 1);
+    msleep (SETTLE_TIME);
+    rc = zmq_poller_remove (poller, sinks [active [1]]);
+    assert (rc == 0);
+    rc = zmq_poller_wait (poller, &event, 100);
+    assert (rc == -1 && errno == ETIMEDOUT);
+
+    rc = zmq_poller_close (poller);
+    assert (rc == 0);
+    for (int i = 0; i != 3; i++)
+        close_zero_linger (vents [i]);
+    for (int i = 0; i != SOCKET_COUNT; i++)
+        close_zero_linger (sinks [i]);
+}
+
+static void test_ready_after_call (void *ctx_)
+{
+    void *rep = zmq_socket (ctx_, ZMQ_REP);
+    assert (rep);
+    int rc = zmq_bind (rep, "inproc://ready_after_call");
+    assert (rc == 0);
+    void *req = zmq_socket (ctx_, ZMQ_REQ);
+    assert (req);
+    rc = zmq_connect (req, "inproc://ready_after_call");
+    assert (rc == 0);
+
+    void *poller = zmq_poller_new ();
+    assert (poller);
+    rc = zmq_poller_add (poller, req, NULL, ZMQ_POLLIN | ZMQ_POLLOUT);
+    assert (rc == 0);
+
+    zmq_poller_event_t event;
+    rc = zmq_poller_wait (poller, &event, 1000);
+    assert (rc == 0);
+    assert (event.socket == req && event.events == ZMQ_POLLOUT);
+
+    //  Once the request is sent, REQ can do nothing until the reply.
+    rc = zmq_send (req, "A", 1, 0);
+    assert (rc == 1);
+    rc = zmq_poller_wait (poller, &event, 0);
+    assert (rc == -1 && errno == ETIMEDOUT);
+
+    char buffer [1];
+    rc = zmq_recv (rep, buffer, 1, 0);
+    assert (rc == 1);
+    rc = zmq_send (rep, "B", 1, 0);
+    assert (rc == 1);
+    rc = zmq_poller_wait (poller, &event, 1000);
+    assert (rc == 0);
+    assert (event.socket == req && event.events == ZMQ_POLLIN);
+
+    rc = zmq_recv (req, buffer, 1, 0);
+    assert (rc == 1);
+    rc = zmq_poller_wait (poller, &event, 0);
+    assert (rc == 0);
+    assert (event.socket == req && event.events == ZMQ_POLLOUT);
+
+    //  This time the reply is received without asking the poller first.
+    //  REQ consumes the command announcing the reply itself and becomes
+    //  writable again, so the poller learns about it only from REQ.
+    rc = zmq_send (req, "A", 1, 0);
+    assert (rc == 1);
+    rc = zmq_poller_wait (poller, &event, 0);
+    assert (rc == -1 && errno == ETIMEDOUT);
+    rc = zmq_recv (rep, buffer, 1, 0);
+    assert (rc == 1);
+    rc = zmq_send (rep, "B", 1, 0);
+    assert (rc == 1);
+    rc = zmq_recv (req, buffer, 1, 0);
+    assert (rc == 1);
+    rc = zmq_poller_wait (poller, &event, 0);
+    assert (rc == 0);
+    assert (event.socket == req && event.events == ZMQ_POLLOUT);
+
+    //  Asking for no events silences the socket.
+    rc = zmq_poller_modify (poller, req, 0);
+    assert (rc == 0);
+    rc = zmq_poller_wait (poller, &event, 0);
+    assert (rc == -1 && errno == ETIMEDOUT);
+
+    rc = zmq_poller_close (poller);
+    assert (rc == 0);
+    close_zero_linger (req);
+    close_zero_linger (rep);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+    int rc = zmq_ctx_set (ctx, ZMQ_MAX_SOCKETS, SOCKET_COUNT + 16);
+    assert (rc == 0);
+
+    test_many_sockets (ctx);
+    test_ready_after_call (ctx);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+static void send_priority (void *socket_, const char *data_, int flags_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init_size (&msg, strlen (data_));
+    assert (rc == 0);
+    memcpy (zmq_msg_data (&msg), data_, strlen (data_));
+    rc = zmq_msg_set (&msg, ZMQ_PRIORITY, 1);
+    assert (rc == 0);
+    rc = zmq_msg_send (&msg, socket_, flags_);
+    assert (rc == (int) strlen (data_));
+}
+
+//  Receives a message part and checks its content and whether it was
+//  flagged as priority.
+static void recv_part (void *socket_, const char *data_, int priority_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&msg, socket_, 0);
+    assert (rc == (int) strlen (data_));
+    assert (memcmp (zmq_msg_data (&msg), data_, strlen (data_)) == 0);
+    assert (zmq_msg_get (&msg, ZMQ_PRIORITY) == priority_);
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+}
+
+//  Queues ordinary messages, then a priority message of two parts, and
+//  checks the priority message is received first and whole.
+static void test_overtake (void *ctx_, const char *endpoint_)
+{
+    void *pull = zmq_socket (ctx_, ZMQ_PULL);
+    assert (pull);
+    //  Over TCP the flag is only sent to peers that ask for it.
+    int priority = 1;
+    int rc = zmq_setsockopt (pull, ZMQ_RCVPRIORITY, &priority,
+        sizeof (priority));
+    assert (rc == 0);
+    rc = zmq_bind (pull, endpoint_);
+    assert (rc == 0);
+    void *push = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (push);
+    rc = zmq_connect (push, endpoint_);
+    assert (rc == 0);
+
+    for (int i = 0; i != 10; i++) {
+        rc = zmq_send (push, "data", 4, 0);
+        assert (rc == 4);
+    }
+    send_priority (push, "stop", ZMQ_SNDMORE);
+    rc = zmq_send (push, "now", 3, 0);
+    assert (rc == 3);
+    msleep (SETTLE_TIME);
+
+    recv_part (pull, "stop", 1);
+    recv_part (pull, "now", 0);
+    for (int i = 0; i != 10; i++)
+        recv_part (pull, "data", 0);
+
+    close_zero_linger (push);
+    close_zero_linger (pull);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  The priority property can be set and cleared.
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    assert (rc == 0);
+    assert (zmq_msg_get (&msg, ZMQ_PRIORITY) == 0);
+    rc = zmq_msg_set (&msg, ZMQ_PRIORITY, 1);
+    assert (rc == 0);
+    assert (zmq_msg_get (&msg, ZMQ_PRIORITY) == 1);
+    rc = zmq_msg_set (&msg, ZMQ_PRIORITY, 0);
+    assert (rc == 0);
+    assert (zmq_msg_get (&msg, ZMQ_PRIORITY) == 0);
+    rc = zmq_msg_set (&msg, ZMQ_MORE, 1);
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+
+    //  Priority messages overtake queued messages within a connection.
+    test_overtake (ctx, "inproc://overtake");
+    test_overtake (ctx, "tcp://127.0.0.1:5595");
+
+    //  With ZMQ_RCVPRIORITY they also overtake messages waiting on the
+    //  socket's other connections.
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    int priority = 1;
+    rc = zmq_setsockopt (pull, ZMQ_RCVPRIORITY, &priority, sizeof (priority));
+    assert (rc == 0);
+    priority = 0;
+    size_t size = sizeof (priority);
+    rc = zmq_getsockopt (pull, ZMQ_RCVPRIORITY, &priority, &size);
+    assert (rc == 0 && priority == 1);
+    rc = zmq_bind (pull, "inproc://fair");
+    assert (rc == 0);
+
+    void *pushes [4];
+    for (int i = 0; i != 4; i++) {
+        pushes [i] = zmq_socket (ctx, ZMQ_PUSH);
+        assert (pushes [i]);
+        rc = zmq_connect (pushes [i], "inproc://fair");
+        assert (rc == 0);
+    }
+    for (int i = 0; i != 4; i++) {
+        rc = zmq_send (pushes [i], "data", 4, 0);
+        assert (rc == 4);
+    }
+    send_priority (pushes [2], "stop", 0);
+    recv_part (pull, "stop", 1);
+    for (int i = 0; i != 4; i++)
+        recv_part (pull, "data", 0);
+
+    //  A priority message sent just before the sender goes away is
+    //  still delivered.
+    send_priority (pushes [3], "last", 0);
+    rc = zmq_close (pushes [3]);
+    assert (rc == 0);
+    recv_part (pull, "last", 1);
+
+    for (int i = 0; i != 3; i++)
+        close_zero_linger (pushes [i]);
+    close_zero_linger (pull);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
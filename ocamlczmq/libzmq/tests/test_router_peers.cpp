@@ -0,0 +1,140 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+//  Connects many peers to a ROUTER, disconnects every third one and
+//  checks that messages are routed to exactly the remaining peers.
+
+#define PEER_COUNT 600
+
+static size_t make_identity (char *identity_, int peer_)
+{
+    return sprintf (identity_, "peer-%d", peer_);
+}
+
+static int send_to (void *router_, int peer_)
+{
+    char identity [32];
+    size_t size = make_identity (identity, peer_);
+    int rc = zmq_send (router_, identity, size, ZMQ_SNDMORE | ZMQ_DONTWAIT);
+    if (rc < 0)
+        return rc;
+    return zmq_send (router_, &peer_, sizeof (peer_), ZMQ_DONTWAIT);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+    int rc = zmq_ctx_set (ctx, ZMQ_MAX_SOCKETS, PEER_COUNT + 16);
+    assert (rc == 0);
+
+    void *router = zmq_socket (ctx, ZMQ_ROUTER);
+    assert (router);
+    int mandatory = 1;
+    rc = zmq_setsockopt (router, ZMQ_ROUTER_MANDATORY, &mandatory,
+        sizeof (mandatory));
+    assert (rc == 0);
+    rc = zmq_bind (router, "inproc://router_peers");
+    assert (rc == 0);
+
+    void *peers [PEER_COUNT];
+    char identity [32];
+    for (int i = 0; i != PEER_COUNT; i++) {
+        peers [i] = zmq_socket (ctx, ZMQ_DEALER);
+        assert (peers [i]);
+        size_t size = make_identity (identity, i);
+        rc = zmq_setsockopt (peers [i], ZMQ_IDENTITY, identity, size);
+        assert (rc == 0);
+        rc = zmq_connect (peers [i], "inproc://router_peers");
+        assert (rc == 0);
+    }
+
+    //  Every peer is reachable once the ROUTER has attached it.
+    int value;
+    for (int i = 0; i != PEER_COUNT; i++) {
+        while (send_to (router, i) < 0) {
+            assert (errno == EHOSTUNREACH);
+            msleep (SETTLE_TIME / 10);
+        }
+        rc = zmq_recv (peers [i], &value, sizeof (value), 0);
+        assert (rc == sizeof (value));
+        assert (value == i);
+    }
+
+    //  Drop every third peer and wait until the ROUTER has forgotten it.
+    //  The ROUTER releases a pipe once it has read the peer's delimiter,
+    //  so keep it reading meanwhile.
+    for (int i = 0; i < PEER_COUNT; i += 3) {
+        rc = zmq_close (peers [i]);
+        assert (rc == 0);
+        peers [i] = NULL;
+    }
+    for (int i = 0; i < PEER_COUNT; i += 3)
+        while (send_to (router, i) == 0 || errno != EHOSTUNREACH) {
+            rc = zmq_recv (router, &value, sizeof (value), ZMQ_DONTWAIT);
+            assert (rc == -1 && errno == EAGAIN);
+            msleep (SETTLE_TIME / 10);
+        }
+
+    //  The remaining peers still get their messages, in both orders.
+    for (int i = 0; i != PEER_COUNT; i++) {
+        rc = send_to (router, i);
+        if (i % 3 == 0) {
+            assert (rc == -1 && errno == EHOSTUNREACH);
+            continue;
+        }
+        assert (rc == sizeof (i));
+        rc = zmq_recv (peers [i], &value, sizeof (value), 0);
+        assert (rc == sizeof (value));
+        assert (value == i);
+    }
+    for (int i = PEER_COUNT - 1; i >= 0; i--) {
+        if (!peers [i])
+            continue;
+        rc = send_to (router, i);
+        assert (rc == sizeof (i));
+        rc = zmq_recv (peers [i], &value, sizeof (value), 0);
+        assert (rc == sizeof (value));
+        assert (value == i);
+    }
+
+    for (int i = 0; i != PEER_COUNT; i++)
+        if (peers [i]) {
+            rc = zmq_close (peers [i]);
+            assert (rc == 0);
+        }
+    rc = zmq_close (router);
+    assert (rc == 0);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
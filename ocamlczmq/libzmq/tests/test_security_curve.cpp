@@ -72,7 +72,7 @@ static void zap_handler (void *handler)
 
         assert (streq (version, "1.0"));
         assert (streq (mechanism, "CURVE"));
-        assert (streq (identity, "IDENT"));
+        assert (streq (identity, "IDENT") || strlen (identity) == 255);
 
         s_sendmore (handler, version);
         s_sendmore (handler, sequence);
@@ -99,6 +99,77 @@ static void zap_handler (void *handler)
     zmq_close (handler);
 }
 
+//  Checks the handshake metadata fits with a 255-byte identity on both
+//  sides and every optional property announced, in a full handshake and
+//  a resumed one.
+static void test_long_identity (void *ctx_)
+{
+    char identity [255];
+    memset (identity, 'I', sizeof identity);
+    int priority = 1;
+    int threshold = 1;
+    int resume = 60000;
+
+    void *server = zmq_socket (ctx_, ZMQ_DEALER);
+    assert (server);
+    int as_server = 1;
+    int rc = zmq_setsockopt (server, ZMQ_CURVE_SERVER, &as_server, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_CURVE_SECRETKEY, server_secret, 41);
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_IDENTITY, identity, sizeof identity);
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_RCVPRIORITY, &priority, sizeof priority);
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_COMPRESS_THRESHOLD, &threshold,
+        sizeof threshold);
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_CURVE_RESUME, &resume, sizeof resume);
+    assert (rc == 0);
+    rc = zmq_bind (server, "tcp://127.0.0.1:*");
+    assert (rc == 0);
+    char endpoint [256];
+    size_t size = sizeof endpoint;
+    rc = zmq_getsockopt (server, ZMQ_LAST_ENDPOINT, endpoint, &size);
+    assert (rc == 0);
+
+    //  The second client has a secret key not matching its public key, so
+    //  it only gets through by resuming with the ticket of the first.
+    char unused_public [41];
+    char wrong_secret [41];
+    rc = zmq_curve_keypair (unused_public, wrong_secret);
+    assert (rc == 0);
+    const char *secrets [] = {client_secret, wrong_secret};
+
+    for (int i = 0; i != 2; i++) {
+        void *client = zmq_socket (ctx_, ZMQ_DEALER);
+        assert (client);
+        rc = zmq_setsockopt (client, ZMQ_CURVE_SERVERKEY, server_public, 41);
+        assert (rc == 0);
+        rc = zmq_setsockopt (client, ZMQ_CURVE_PUBLICKEY, client_public, 41);
+        assert (rc == 0);
+        rc = zmq_setsockopt (client, ZMQ_CURVE_SECRETKEY, secrets [i], 41);
+        assert (rc == 0);
+        rc = zmq_setsockopt (client, ZMQ_IDENTITY, identity, sizeof identity);
+        assert (rc == 0);
+        rc = zmq_setsockopt (client, ZMQ_RCVPRIORITY, &priority,
+            sizeof priority);
+        assert (rc == 0);
+        rc = zmq_setsockopt (client, ZMQ_COMPRESS_THRESHOLD, &threshold,
+            sizeof threshold);
+        assert (rc == 0);
+        rc = zmq_setsockopt (client, ZMQ_CURVE_RESUME, &resume, sizeof resume);
+        assert (rc == 0);
+        rc = zmq_connect (client, endpoint);
+        assert (rc == 0);
+        bounce (server, client);
+        rc = zmq_close (client);
+        assert (rc == 0);
+    }
+
+    rc = zmq_close (server);
+    assert (rc == 0);
+}
 
 int main (void)
 {
@@ -154,6 +225,9 @@ int main (void)
     rc = zmq_close (client);
     assert (rc == 0);
 
+    //  Check CURVE security with the longest metadata
+    test_long_identity (ctx);
+
     //  Check CURVE security with a garbage server key
     //  This will be caught by the curve_server class, not passed to ZAP
     char garbage_key [] = "0000111122223333444455556666777788889999";
@@ -0,0 +1,130 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+    int rc = zmq_bind (push, "inproc://data");
+    assert (rc == 0);
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    rc = zmq_connect (pull, "inproc://data");
+    assert (rc == 0);
+
+    //  The capture socket can only be reached by the reader up to the
+    //  combined high water mark of 2 messages.
+    void *capture = zmq_socket (ctx, ZMQ_PUSH);
+    assert (capture);
+    int hwm = 1;
+    rc = zmq_setsockopt (capture, ZMQ_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = zmq_bind (capture, "inproc://capture");
+    assert (rc == 0);
+    void *reader = zmq_socket (ctx, ZMQ_PULL);
+    assert (reader);
+    rc = zmq_setsockopt (reader, ZMQ_RCVHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = zmq_connect (reader, "inproc://capture");
+    assert (rc == 0);
+
+    //  Invalid arguments are rejected.
+    rc = zmq_socket_capture (NULL, capture, ZMQ_CAPTURE_SEND);
+    assert (rc == -1 && errno == ENOTSOCK);
+    rc = zmq_socket_capture (push, ctx, ZMQ_CAPTURE_SEND);
+    assert (rc == -1 && errno == ENOTSOCK);
+    rc = zmq_socket_capture (push, push, ZMQ_CAPTURE_SEND);
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_socket_capture (push, capture, 0);
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_socket_capture (push, capture, 4);
+    assert (rc == -1 && errno == EINVAL);
+
+    //  Sent messages are copied part by part, large ones included.
+    rc = zmq_socket_capture (push, capture, ZMQ_CAPTURE_SEND);
+    assert (rc == 0);
+    char large [1000];
+    memset (large, 'L', sizeof (large));
+    s_send_seq (push, "A", "BB", SEQ_END);
+    rc = zmq_send (push, large, sizeof (large), 0);
+    assert (rc == (int) sizeof (large));
+    s_recv_seq (pull, "A", "BB", SEQ_END);
+    s_recv_seq (reader, "A", "BB", SEQ_END);
+    char buffer [1000];
+    rc = zmq_recv (pull, buffer, sizeof (buffer), 0);
+    assert (rc == (int) sizeof (large));
+    rc = zmq_recv (reader, buffer, sizeof (buffer), 0);
+    assert (rc == (int) sizeof (large));
+    assert (memcmp (buffer, large, sizeof (large)) == 0);
+
+    //  Nothing is captured once capturing is stopped.
+    rc = zmq_socket_capture (push, NULL, 0);
+    assert (rc == 0);
+    s_send_seq (push, "C", SEQ_END);
+    s_recv_seq (pull, "C", SEQ_END);
+    rc = zmq_recv (reader, buffer, sizeof (buffer), ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EAGAIN);
+
+    //  Received messages are copied as they are handed to the application.
+    rc = zmq_socket_capture (pull, capture, ZMQ_CAPTURE_RECV);
+    assert (rc == 0);
+    s_send_seq (push, "D", "EE", SEQ_END);
+    rc = zmq_recv (reader, buffer, sizeof (buffer), ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EAGAIN);
+    s_recv_seq (pull, "D", "EE", SEQ_END);
+    s_recv_seq (reader, "D", "EE", SEQ_END);
+
+    //  A capture socket that is not read never blocks the captured socket;
+    //  the copies beyond its high water mark are dropped.
+    for (int i = 0; i != 10; i++)
+        s_send_seq (push, "F", SEQ_END);
+    for (int i = 0; i != 10; i++)
+        s_recv_seq (pull, "F", SEQ_END);
+    int captured = 0;
+    while (zmq_recv (reader, buffer, sizeof (buffer), ZMQ_DONTWAIT) != -1)
+        captured++;
+    assert (captured >= 1 && captured < 10);
+
+    rc = zmq_socket_capture (pull, NULL, 0);
+    assert (rc == 0);
+
+    close_zero_linger (push);
+    close_zero_linger (pull);
+    close_zero_linger (capture);
+    close_zero_linger (reader);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
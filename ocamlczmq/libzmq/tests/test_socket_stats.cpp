@@ -0,0 +1,176 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+static void test_push_pull_tcp (void *ctx)
+{
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    int rc = zmq_bind (pull, "tcp://127.0.0.1:5599");
+    assert (rc == 0);
+    rc = zmq_connect (push, "tcp://127.0.0.1:5599");
+    assert (rc == 0);
+
+    char buffer [100];
+    memset (buffer, 'x', sizeof buffer);
+    for (int i = 0; i != 10; i++) {
+        rc = zmq_send (push, buffer, sizeof buffer, 0);
+        assert (rc == sizeof buffer);
+    }
+    for (int i = 0; i != 10; i++) {
+        rc = zmq_recv (pull, buffer, sizeof buffer, 0);
+        assert (rc == sizeof buffer);
+    }
+
+    zmq_socket_stats_t stats;
+    rc = zmq_socket_stats (push, &stats);
+    assert (rc == 0);
+    assert (stats.msgs_out == 10);
+    assert (stats.bytes_out == 1000);
+    assert (stats.msgs_in == 0);
+    assert (stats.pipes == 1);
+    assert (stats.drops == 0);
+    assert (stats.write_calls > 0);
+    assert (stats.wire_bytes_out > 1000);
+
+    rc = zmq_socket_stats (pull, &stats);
+    assert (rc == 0);
+    assert (stats.msgs_in == 10);
+    assert (stats.bytes_in == 1000);
+    assert (stats.msgs_out == 0);
+    assert (stats.queued_in == 0);
+    assert (stats.read_calls > 0);
+    assert (stats.wire_bytes_in > 1000);
+    assert (stats.decoder_bytes == 0);
+
+    //  Engine counters survive the connection going away
+    rc = zmq_disconnect (push, "tcp://127.0.0.1:5599");
+    assert (rc == 0);
+    msleep (SETTLE_TIME);
+    uint64_t wire_bytes_out = stats.wire_bytes_out;
+    rc = zmq_socket_stats (push, &stats);
+    assert (rc == 0);
+    assert (stats.wire_bytes_out >= wire_bytes_out);
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_close (pull);
+    assert (rc == 0);
+}
+
+static void test_pub_drops (void *ctx)
+{
+    void *pub = zmq_socket (ctx, ZMQ_PUB);
+    assert (pub);
+    void *sub = zmq_socket (ctx, ZMQ_SUB);
+    assert (sub);
+
+    int hwm = 5;
+    int rc = zmq_setsockopt (pub, ZMQ_SNDHWM, &hwm, sizeof hwm);
+    assert (rc == 0);
+    rc = zmq_setsockopt (sub, ZMQ_RCVHWM, &hwm, sizeof hwm);
+    assert (rc == 0);
+    rc = zmq_setsockopt (sub, ZMQ_SUBSCRIBE, "", 0);
+    assert (rc == 0);
+    rc = zmq_bind (pub, "inproc://stats");
+    assert (rc == 0);
+    rc = zmq_connect (sub, "inproc://stats");
+    assert (rc == 0);
+
+    //  Let the subscription arrive
+    msleep (SETTLE_TIME);
+
+    //  Nobody reads, so all but the first HWM messages are dropped
+    for (int i = 0; i != 100; i++) {
+        rc = zmq_send (pub, "abc", 3, 0);
+        assert (rc == 3);
+    }
+
+    zmq_socket_stats_t stats;
+    rc = zmq_socket_stats (pub, &stats);
+    assert (rc == 0);
+    assert (stats.msgs_out == 100);
+    assert (stats.drops > 0);
+    assert (stats.drops + stats.queued_out == 100);
+
+    rc = zmq_socket_stats (sub, &stats);
+    assert (rc == 0);
+    assert (stats.queued_in > 0);
+    assert (stats.queued_in <= 100 - 50);
+
+    rc = zmq_close (pub);
+    assert (rc == 0);
+    rc = zmq_close (sub);
+    assert (rc == 0);
+}
+
+static void test_hwm_stalls (void *ctx)
+{
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+
+    //  Without any peer each send hits the HWM
+    int rc = zmq_send (push, "abc", 3, ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EAGAIN);
+    rc = zmq_send (push, "abc", 3, ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EAGAIN);
+
+    zmq_socket_stats_t stats;
+    rc = zmq_socket_stats (push, &stats);
+    assert (rc == 0);
+    assert (stats.hwm_stalls == 2);
+    assert (stats.msgs_out == 0);
+
+    rc = zmq_socket_stats (push, NULL);
+    assert (rc == -1 && errno == EFAULT);
+    rc = zmq_socket_stats (NULL, &stats);
+    assert (rc == -1 && errno == ENOTSOCK);
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    test_push_pull_tcp (ctx);
+    test_pub_drops (ctx);
+    test_hwm_stalls (ctx);
+
+    int rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+//  Reads one event from the monitor, returns -1 if there's none pending.
+static int get_monitor_event (void *monitor_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    assert (rc == 0);
+    if (zmq_msg_recv (&msg, monitor_, ZMQ_DONTWAIT) == -1) {
+        assert (errno == EAGAIN);
+        return -1;
+    }
+    assert (zmq_msg_more (&msg));
+    const uint16_t event = *(uint16_t *) zmq_msg_data (&msg);
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+
+    rc = zmq_msg_init (&msg);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&msg, monitor_, 0);
+    assert (rc != -1);
+    assert (!zmq_msg_more (&msg));
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+    return event;
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+    int rc = zmq_ctx_set (ctx, ZMQ_IO_THREADS, 4);
+    assert (rc == 0);
+
+    void *router = zmq_socket (ctx, ZMQ_ROUTER);
+    assert (router);
+
+    //  Default is off, only booleans are accepted
+    int value;
+    size_t size = sizeof (value);
+    rc = zmq_getsockopt (router, ZMQ_TCP_SHARDED_ACCEPT, &value, &size);
+    assert (rc == 0);
+    assert (value == 0);
+    value = 2;
+    rc = zmq_setsockopt (router, ZMQ_TCP_SHARDED_ACCEPT, &value,
+        sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+    value = 1;
+    rc = zmq_setsockopt (router, ZMQ_TCP_SHARDED_ACCEPT, &value,
+        sizeof (value));
+    assert (rc == 0);
+    rc = zmq_getsockopt (router, ZMQ_TCP_SHARDED_ACCEPT, &value, &size);
+    assert (rc == 0);
+    assert (value == 1);
+
+    rc = zmq_socket_monitor (router, "inproc://monitor-router",
+        ZMQ_EVENT_LISTENING);
+    assert (rc == 0);
+    void *monitor = zmq_socket (ctx, ZMQ_PAIR);
+    assert (monitor);
+    rc = zmq_connect (monitor, "inproc://monitor-router");
+    assert (rc == 0);
+
+    //  A wildcard bind picks one port for all the listeners
+    rc = zmq_bind (router, "tcp://127.0.0.1:*");
+    assert (rc == 0);
+    char endpoint [256];
+    size = sizeof (endpoint);
+    rc = zmq_getsockopt (router, ZMQ_LAST_ENDPOINT, endpoint, &size);
+    assert (rc == 0);
+
+    //  Where SO_REUSEPORT is supported there's a listener per I/O thread
+    int listeners = 0;
+    while (get_monitor_event (monitor) == ZMQ_EVENT_LISTENING)
+        listeners++;
+#if defined ZMQ_HAVE_LINUX
+    assert (listeners == 4);
+#else
+    assert (listeners >= 1);
+#endif
+
+    //  Connections through any of the listeners reach the socket
+    const int count = 100;
+    void *dealers [count];
+    for (int i = 0; i != count; i++) {
+        dealers [i] = zmq_socket (ctx, ZMQ_DEALER);
+        assert (dealers [i]);
+        rc = zmq_connect (dealers [i], endpoint);
+        assert (rc == 0);
+        rc = zmq_send (dealers [i], &i, sizeof (i), 0);
+        assert (rc == sizeof (i));
+    }
+    bool seen [count] = {false};
+    for (int i = 0; i != count; i++) {
+        char identity [256];
+        const int identity_size =
+            zmq_recv (router, identity, sizeof (identity), 0);
+        assert (identity_size > 0);
+        int sender;
+        rc = zmq_recv (router, &sender, sizeof (sender), 0);
+        assert (rc == sizeof (sender));
+        assert (sender >= 0 && sender < count && !seen [sender]);
+        seen [sender] = true;
+
+        //  Replies go out through the connection's own I/O thread
+        rc = zmq_send (router, identity, identity_size, ZMQ_SNDMORE);
+        assert (rc == identity_size);
+        rc = zmq_send (router, &sender, sizeof (sender), 0);
+        assert (rc == sizeof (sender));
+    }
+    for (int i = 0; i != count; i++) {
+        int reply;
+        rc = zmq_recv (dealers [i], &reply, sizeof (reply), 0);
+        assert (rc == sizeof (reply));
+        assert (reply == i);
+        rc = zmq_close (dealers [i]);
+        assert (rc == 0);
+    }
+
+    //  Unbinding closes all the listeners, so the port can be bound again
+    rc = zmq_unbind (router, endpoint);
+    assert (rc == 0);
+    msleep (SETTLE_TIME);
+    void *other = zmq_socket (ctx, ZMQ_ROUTER);
+    assert (other);
+    rc = zmq_bind (other, endpoint);
+    assert (rc == 0);
+
+    rc = zmq_close (other);
+    assert (rc == 0);
+    rc = zmq_close (monitor);
+    assert (rc == 0);
+    rc = zmq_close (router);
+    assert (rc == 0);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+static size_t count_point (const zmq_trace_event_t *events_, size_t count_,
+    uint32_t point_)
+{
+    size_t n = 0;
+    for (size_t i = 0; i != count_; i++)
+        if (events_ [i].point == point_)
+            n++;
+    return n;
+}
+
+//  Time of the index_-th event of the given kind.
+static uint64_t point_time (const zmq_trace_event_t *events_, size_t count_,
+    uint32_t point_, size_t index_)
+{
+    for (size_t i = 0; i != count_; i++)
+        if (events_ [i].point == point_ && index_-- == 0)
+            return events_ [i].time;
+    assert (false);
+    return 0;
+}
+
+int main (void)
+{
+    setup_test_environment ();
+
+    int rc = zmq_trace_start (0);
+    if (rc == -1 && errno == ENOTSUP)
+        return 0;
+    assert (rc == -1 && errno == EINVAL);
+
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    rc = zmq_bind (pull, "tcp://127.0.0.1:5619");
+    assert (rc == 0);
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+    rc = zmq_connect (push, "tcp://127.0.0.1:5619");
+    assert (rc == 0);
+
+    //  Nothing is recorded before tracing is started, handshakes included.
+    s_send_seq (push, "warm-up", SEQ_END);
+    s_recv_seq (pull, "warm-up", SEQ_END);
+
+    rc = zmq_trace_start (1000);
+    assert (rc == 0);
+    const int parts = 10;
+    for (int i = 0; i != parts; i++) {
+        rc = zmq_send (push, "ABC", 3, 0);
+        assert (rc == 3);
+        char buffer [3];
+        rc = zmq_recv (pull, buffer, sizeof (buffer), 0);
+        assert (rc == 3);
+    }
+    rc = zmq_trace_stop ();
+    assert (rc == 0);
+
+    //  Nothing is recorded once tracing is stopped.
+    s_send_seq (push, "after", SEQ_END);
+    s_recv_seq (pull, "after", SEQ_END);
+
+    size_t count = 0;
+    rc = zmq_trace_dump (NULL, &count);
+    assert (rc == 0);
+    zmq_trace_event_t *events = new zmq_trace_event_t [count];
+    rc = zmq_trace_dump (events, &count);
+    assert (rc == 0);
+
+    //  Each part passes every point once, and the events are in order.
+    for (size_t i = 1; i < count; i++)
+        assert (events [i - 1].time <= events [i].time);
+    assert (count_point (events, count, ZMQ_TRACE_SEND) == parts);
+    assert (count_point (events, count, ZMQ_TRACE_ENCODE) == parts);
+    assert (count_point (events, count, ZMQ_TRACE_DECODE) == parts);
+    assert (count_point (events, count, ZMQ_TRACE_RECV) == parts);
+    assert (count_point (events, count, ZMQ_TRACE_WRITE) >= parts);
+    assert (count_point (events, count, ZMQ_TRACE_READ) >= parts);
+    for (int i = 0; i != parts; i++) {
+        const uint64_t sent = point_time (events, count, ZMQ_TRACE_SEND, i);
+        const uint64_t encoded =
+            point_time (events, count, ZMQ_TRACE_ENCODE, i);
+        const uint64_t decoded =
+            point_time (events, count, ZMQ_TRACE_DECODE, i);
+        const uint64_t received =
+            point_time (events, count, ZMQ_TRACE_RECV, i);
+        assert (sent <= encoded && encoded <= decoded && decoded <= received);
+    }
+    for (size_t i = 0; i != count; i++)
+        if (events [i].point == ZMQ_TRACE_SEND
+        ||  events [i].point == ZMQ_TRACE_RECV)
+            assert (events [i].value == 3);
+    delete [] events;
+
+    //  A full ring keeps the latest events of its thread.
+    rc = zmq_trace_start (1);
+    assert (rc == 0);
+    s_send_seq (push, "ABC", SEQ_END);
+    s_recv_seq (pull, "ABC", SEQ_END);
+    rc = zmq_trace_stop ();
+    assert (rc == 0);
+    zmq_trace_event_t last [64];
+    count = 64;
+    rc = zmq_trace_dump (last, &count);
+    assert (rc == 0);
+    assert (count_point (last, count, ZMQ_TRACE_RECV) == 1);
+    assert (count_point (last, count, ZMQ_TRACE_SEND) == 0);
+
+    rc = zmq_trace_dump (last, NULL);
+    assert (rc == -1 && errno == EFAULT);
+
+    close_zero_linger (push);
+    close_zero_linger (pull);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
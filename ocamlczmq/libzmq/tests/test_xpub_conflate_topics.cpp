@@ -0,0 +1,177 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+static const char *topics [] = {"progress", "stats", "status"};
+static const int topic_count = 3;
+static const int round_count = 100;
+
+//  Publishes round_count rounds of updates, one per topic, each as a
+//  topic part followed by the round number.
+static void publish (void *pub_)
+{
+    for (int round = 0; round != round_count; round++)
+        for (int i = 0; i != topic_count; i++) {
+            int rc = zmq_send (pub_, topics [i], strlen (topics [i]),
+                ZMQ_SNDMORE);
+            assert (rc == (int) strlen (topics [i]));
+            rc = zmq_send (pub_, &round, sizeof (round), 0);
+            assert (rc == sizeof (round));
+        }
+}
+
+//  Receives until the subscriber has nothing more to read, letting the
+//  publisher process the subscriber's acknowledgements in between. Checks
+//  that the updates of each topic arrive in order and returns the number
+//  of updates received; last_ is set to the last round of each topic.
+static int drain (void *pub_, void *sub_, int *last_)
+{
+    for (int i = 0; i != topic_count; i++)
+        last_ [i] = -1;
+    int received = 0;
+    int idle = 0;
+    while (idle < 100) {
+        char topic [16];
+        int rc = zmq_recv (sub_, topic, sizeof (topic), ZMQ_DONTWAIT);
+        if (rc == -1) {
+            assert (errno == EAGAIN);
+            int events;
+            size_t events_size = sizeof (events);
+            rc = zmq_getsockopt (pub_, ZMQ_EVENTS, &events, &events_size);
+            assert (rc == 0);
+            msleep (1);
+            idle++;
+            continue;
+        }
+        idle = 0;
+        int i = 0;
+        while (i != topic_count && ((int) strlen (topics [i]) != rc ||
+              memcmp (topic, topics [i], rc) != 0))
+            i++;
+        assert (i != topic_count);
+        int more;
+        size_t more_size = sizeof (more);
+        rc = zmq_getsockopt (sub_, ZMQ_RCVMORE, &more, &more_size);
+        assert (rc == 0 && more);
+        int round;
+        rc = zmq_recv (sub_, &round, sizeof (round), 0);
+        assert (rc == sizeof (round));
+        assert (round > last_ [i]);
+        last_ [i] = round;
+        received++;
+    }
+    return received;
+}
+
+static void test_conflation (void *ctx_, bool conflate_)
+{
+    void *pub = zmq_socket (ctx_, ZMQ_PUB);
+    assert (pub);
+    int hwm = 1;
+    int rc = zmq_setsockopt (pub, ZMQ_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    int conflate = conflate_ ? 1 : 0;
+    rc = zmq_setsockopt (pub, ZMQ_XPUB_CONFLATE_TOPICS, &conflate,
+        sizeof (conflate));
+    assert (rc == 0);
+    //  The endpoint of a closed socket is released asynchronously, so each
+    //  run uses its own.
+    const char *endpoint =
+        conflate_ ? "inproc://conflated" : "inproc://dropped";
+    rc = zmq_bind (pub, endpoint);
+    assert (rc == 0);
+
+    void *sub = zmq_socket (ctx_, ZMQ_SUB);
+    assert (sub);
+    rc = zmq_setsockopt (sub, ZMQ_RCVHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = zmq_setsockopt (sub, ZMQ_SUBSCRIBE, "", 0);
+    assert (rc == 0);
+    rc = zmq_connect (sub, endpoint);
+    assert (rc == 0);
+
+    //  Let the publisher take the subscription on.
+    int events;
+    size_t events_size = sizeof (events);
+    rc = zmq_getsockopt (pub, ZMQ_EVENTS, &events, &events_size);
+    assert (rc == 0);
+
+    publish (pub);
+    int last [topic_count];
+    int received = drain (pub, sub, last);
+
+    if (conflate_) {
+        //  The updates that fit under the high water mark, then only the
+        //  latest update of each topic.
+        assert (received <= 2 + topic_count);
+        for (int i = 0; i != topic_count; i++)
+            assert (last [i] == round_count - 1);
+    }
+    else {
+        //  Only the updates that fit under the high water mark.
+        assert (received == 2);
+        assert (last [0] == 0 && last [1] == 0 && last [2] == -1);
+    }
+
+    //  A subscriber going away with updates held for it.
+    publish (pub);
+    rc = zmq_close (sub);
+    assert (rc == 0);
+    rc = zmq_getsockopt (pub, ZMQ_EVENTS, &events, &events_size);
+    assert (rc == 0);
+    publish (pub);
+
+    rc = zmq_close (pub);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  Invalid values are rejected.
+    void *pub = zmq_socket (ctx, ZMQ_PUB);
+    assert (pub);
+    int value = -1;
+    int rc = zmq_setsockopt (pub, ZMQ_XPUB_CONFLATE_TOPICS, &value,
+        sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_close (pub);
+    assert (rc == 0);
+
+    test_conflation (ctx, false);
+    test_conflation (ctx, true);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+    Copyright (c) 2007-2014 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+//  Exercises subscription tries with overlapping prefixes, so that nodes
+//  get split, merged and pruned as topics come and go.
+
+static void subscribe (void *sub_, const char *topic_, bool on_)
+{
+    int rc = zmq_setsockopt (sub_, on_ ? ZMQ_SUBSCRIBE : ZMQ_UNSUBSCRIBE,
+        topic_, strlen (topic_));
+    assert (rc == 0);
+}
+
+static void publish (void *pub_, const char *topic_)
+{
+    int rc = zmq_send (pub_, topic_, strlen (topic_), 0);
+    assert (rc == (int) strlen (topic_));
+}
+
+static int drain (void *sub_)
+{
+    msleep (SETTLE_TIME);
+    int count = 0;
+    char buffer [32];
+    while (zmq_recv (sub_, buffer, sizeof (buffer), ZMQ_DONTWAIT) >= 0)
+        count++;
+    assert (errno == EAGAIN);
+    return count;
+}
+
+//  Receive a (un)subscription on the XPUB socket and check it matches.
+static void expect_subscription (void *pub_, bool on_, const char *topic_)
+{
+    char buffer [32];
+    int rc = zmq_recv (pub_, buffer, sizeof (buffer), 0);
+    assert (rc == (int) strlen (topic_) + 1);
+    assert (buffer [0] == (on_ ? 1 : 0));
+    assert (memcmp (buffer + 1, topic_, rc - 1) == 0);
+}
+
+static void expect_no_subscription (void *pub_)
+{
+    char buffer [32];
+    int rc = zmq_recv (pub_, buffer, sizeof (buffer), ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EAGAIN);
+}
+
+int main (void)
+{
+    setup_test_environment();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    void *pub = zmq_socket (ctx, ZMQ_XPUB);
+    assert (pub);
+    int timeout = 250;
+    int rc = zmq_setsockopt (pub, ZMQ_RCVTIMEO, &timeout, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_bind (pub, "inproc://prefixes");
+    assert (rc == 0);
+
+    void *sub1 = zmq_socket (ctx, ZMQ_SUB);
+    assert (sub1);
+    rc = zmq_connect (sub1, "inproc://prefixes");
+    assert (rc == 0);
+
+    void *sub2 = zmq_socket (ctx, ZMQ_SUB);
+    assert (sub2);
+    rc = zmq_connect (sub2, "inproc://prefixes");
+    assert (rc == 0);
+
+    //  Subscriptions sharing prefixes at different depths.
+    subscribe (sub1, "CONTROL", true);
+    subscribe (sub1, "CON", true);
+    subscribe (sub1, "RELAY", true);
+    expect_subscription (pub, true, "CONTROL");
+    expect_subscription (pub, true, "CON");
+    expect_subscription (pub, true, "RELAY");
+
+    subscribe (sub2, "CONTROLLER", true);
+    subscribe (sub2, "C", true);
+    subscribe (sub2, "RELAY", true);
+    expect_subscription (pub, true, "CONTROLLER");
+    expect_subscription (pub, true, "C");
+
+    //  RELAY is a duplicate and is not forwarded again.
+    expect_no_subscription (pub);
+
+    publish (pub, "CONTROLLER-1");
+    publish (pub, "COFFEE");
+    publish (pub, "RELAY");
+    publish (pub, "REL");
+    assert (drain (sub1) == 2);
+    assert (drain (sub2) == 3);
+
+    //  Removing a short prefix leaves the longer ones intact.
+    subscribe (sub2, "C", false);
+    expect_subscription (pub, false, "C");
+    subscribe (sub1, "CON", false);
+    expect_subscription (pub, false, "CON");
+
+    publish (pub, "COFFEE");
+    publish (pub, "CONSOLE");
+    publish (pub, "CONTROL");
+    publish (pub, "CONTROLLER");
+    assert (drain (sub1) == 2);
+    assert (drain (sub2) == 1);
+
+    //  Closing a subscriber unsubscribes the topics nobody else holds.
+    rc = zmq_close (sub1);
+    assert (rc == 0);
+    expect_subscription (pub, false, "CONTROL");
+    expect_no_subscription (pub);
+
+    publish (pub, "CONTROL");
+    publish (pub, "CONTROLLER");
+    publish (pub, "RELAY");
+    assert (drain (sub2) == 2);
+
+    //  Re-adding a topic that was pruned works as before.
+    subscribe (sub2, "CON", true);
+    expect_subscription (pub, true, "CON");
+    publish (pub, "CONSOLE");
+    assert (drain (sub2) == 1);
+
+    //  Clean up.
+    rc = zmq_close (pub);
+    assert (rc == 0);
+    rc = zmq_close (sub2);
+    assert (rc == 0);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
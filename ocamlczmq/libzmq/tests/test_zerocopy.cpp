@@ -0,0 +1,143 @@
+/*
+    Copyright (c) 2007-2015 Contributors as noted in the AUTHORS file
+
+    This file is part of libzmq, the ZeroMQ core engine in C++.
+
+    libzmq is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License (LGPL) as published
+    by the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, the Contributors give you permission to link
+    this library with independent modules to produce an executable,
+    regardless of the license terms of these independent modules, and to
+    copy and distribute the resulting executable under terms of your choice,
+    provided that you also meet, for each linked independent module, the
+    terms and conditions of the license of that module. An independent
+    module is a module which is not derived from or based on this library.
+    If you modify this library, you must extend this exception to your
+    version of the library.
+
+    libzmq is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+    License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+static void *freed;
+
+static void free_body (void *data_, void *)
+{
+    free (data_);
+    zmq_atomic_counter_inc (freed);
+}
+
+//  Sends a message of the given size filled with a pattern. Large bodies
+//  are handed over to 0MQ, to be freed once they are no longer used.
+static void send_body (void *socket_, size_t size_, int seed_, int flags_)
+{
+    unsigned char *data = (unsigned char *) malloc (size_ ? size_ : 1);
+    assert (data);
+    for (size_t i = 0; i != size_; i++)
+        data [i] = (unsigned char) (seed_ + i * 7);
+    zmq_msg_t msg;
+    int rc = zmq_msg_init_data (&msg, data, size_, free_body, NULL);
+    assert (rc == 0);
+    rc = zmq_msg_send (&msg, socket_, flags_);
+    assert (rc == (int) size_);
+}
+
+static void recv_body (void *socket_, size_t size_, int seed_)
+{
+    zmq_msg_t msg;
+    int rc = zmq_msg_init (&msg);
+    assert (rc == 0);
+    rc = zmq_msg_recv (&msg, socket_, 0);
+    assert (rc == (int) size_);
+    const unsigned char *data = (const unsigned char *) zmq_msg_data (&msg);
+    for (size_t i = 0; i != size_; i++)
+        assert (data [i] == (unsigned char) (seed_ + i * 7));
+    rc = zmq_msg_close (&msg);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+    freed = zmq_atomic_counter_new ();
+    assert (freed);
+
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+
+    //  Default is off, negative values are rejected
+    int value;
+    size_t size = sizeof (value);
+    int rc = zmq_getsockopt (push, ZMQ_ZEROCOPY_THRESHOLD, &value, &size);
+    assert (rc == 0);
+    assert (value == 0);
+    value = -1;
+    rc = zmq_setsockopt (push, ZMQ_ZEROCOPY_THRESHOLD, &value,
+        sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+
+    value = 65536;
+    rc = zmq_setsockopt (push, ZMQ_ZEROCOPY_THRESHOLD, &value,
+        sizeof (value));
+    assert (rc == 0);
+    rc = zmq_getsockopt (push, ZMQ_ZEROCOPY_THRESHOLD, &value, &size);
+    assert (rc == 0);
+    assert (value == 65536);
+    rc = zmq_bind (push, "tcp://127.0.0.1:5596");
+    assert (rc == 0);
+
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    rc = zmq_connect (pull, "tcp://127.0.0.1:5596");
+    assert (rc == 0);
+
+    //  Mix bodies below and above the threshold, some in multi-part
+    //  messages, and check they all arrive intact and in order
+    const size_t sizes [] = {
+        10, 70000, 1024 * 1024, 100, 4 * 1024 * 1024, 65536, 0, 3000000};
+    const int count = sizeof (sizes) / sizeof (sizes [0]);
+    for (int round = 0; round != 4; round++)
+        for (int i = 0; i != count; i++)
+            send_body (push, sizes [i], round * count + i,
+                i % 3 == 2 ? ZMQ_SNDMORE : 0);
+    for (int round = 0; round != 4; round++)
+        for (int i = 0; i != count; i++)
+            recv_body (pull, sizes [i], round * count + i);
+
+    //  Every body is released once the kernel is done sending it
+    for (int i = 0; i != 100; i++) {
+        if (zmq_atomic_counter_value (freed) == 4 * count)
+            break;
+        msleep (10);
+    }
+    assert (zmq_atomic_counter_value (freed) == 4 * count);
+
+    //  Bodies still being sent when the socket is closed arrive intact
+    for (int i = 0; i != 4; i++)
+        send_body (push, 8 * 1024 * 1024, i, 0);
+    rc = zmq_close (push);
+    assert (rc == 0);
+    for (int i = 0; i != 4; i++)
+        recv_body (pull, 8 * 1024 * 1024, i);
+
+    rc = zmq_close (pull);
+    assert (rc == 0);
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    assert (zmq_atomic_counter_value (freed) == 4 * count + 4);
+    zmq_atomic_counter_destroy (&freed);
+
+    return 0;
+}
@@ -5,6 +5,7 @@
 /* direct tweetnacl usage */
 #include "tweetnacl_base.h"
 #endif
+#include "xsalsa20poly1305.h"
 
 #define FOR(i,n) for (i = 0;i < n;++i)
 #define sv static void
@@ -251,26 +252,17 @@ int crypto_onetimeauth_verify(const u8 *h,const u8 *m,u64 n,const u8 *k)
   return crypto_verify_16(h,x);
 }
 
+/* The reference crypto_stream_xor and crypto_onetimeauth above are too
+   slow for encrypting every message; see xsalsa20poly1305.c. */
+
 int crypto_secretbox(u8 *c,const u8 *m,u64 d,const u8 *n,const u8 *k)
 {
-  int i;
-  if (d < 32) return -1;
-  crypto_stream_xor(c,m,d,n,k);
-  crypto_onetimeauth(c + 16,c + 32,d - 32,c);
-  FOR(i,16) c[i] = 0;
-  return 0;
+  return xsalsa20poly1305(c,m,d,n,k);
 }
 
 int crypto_secretbox_open(u8 *m,const u8 *c,u64 d,const u8 *n,const u8 *k)
 {
-  int i;
-  u8 x[32];
-  if (d < 32) return -1;
-  crypto_stream(x,32,n,k);
-  if (crypto_onetimeauth_verify(c + 16,c + 32,d - 32,x) != 0) return -1;
-  crypto_stream_xor(m,c,d,n,k);
-  FOR(i,32) m[i] = 0;
-  return 0;
+  return xsalsa20poly1305_open(m,c,d,n,k);
 }
 
 sv set25519(gf r, const gf a)
@@ -0,0 +1,449 @@
+/* XSalsa20 + Poly1305 (crypto_secretbox) for the tweetnacl build.
+
+   tweetnacl computes Salsa20 a byte at a time and Poly1305 in 8-bit
+   limbs, which makes it the bottleneck of CURVE on every message. This
+   implementation computes Salsa20 on 32-bit words, several blocks at
+   once with SSE2 and, where the CPU supports it, AVX2, and Poly1305 in
+   26-bit limbs. Results are identical to the reference. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "xsalsa20poly1305.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define XSP_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(XSP_SSE2) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define XSP_AVX2
+#include <immintrin.h>
+#endif
+
+#define ROTL32(v,c) (((v) << (c)) | ((v) >> (32 - (c))))
+
+static uint32_t ld32(const uint8_t *x)
+{
+  return (uint32_t) x[0] | ((uint32_t) x[1] << 8) |
+    ((uint32_t) x[2] << 16) | ((uint32_t) x[3] << 24);
+}
+
+static void st32(uint8_t *x,uint32_t u)
+{
+  x[0] = (uint8_t) u;
+  x[1] = (uint8_t) (u >> 8);
+  x[2] = (uint8_t) (u >> 16);
+  x[3] = (uint8_t) (u >> 24);
+}
+
+/* Salsa20 */
+
+/* "expand 32-byte k" */
+static const uint32_t sigma[4] = {
+  0x61707865, 0x3320646e, 0x79622d32, 0x6b206574
+};
+
+static void salsa20_init(uint32_t s[16],const uint8_t *k,const uint8_t *in)
+{
+  int i;
+  s[0] = sigma[0];
+  s[5] = sigma[1];
+  s[10] = sigma[2];
+  s[15] = sigma[3];
+  for (i = 0; i < 4; i++) {
+    s[1 + i] = ld32(k + 4 * i);
+    s[11 + i] = ld32(k + 16 + 4 * i);
+    s[6 + i] = ld32(in + 4 * i);
+  }
+}
+
+#define QR(a,b,c,d) \
+  b ^= ROTL32(a + d, 7); \
+  c ^= ROTL32(b + a, 9); \
+  d ^= ROTL32(c + b, 13); \
+  a ^= ROTL32(d + c, 18);
+
+static void salsa20_rounds(uint32_t x[16])
+{
+  int i;
+  for (i = 0; i < 20; i += 2) {
+    QR(x[0], x[4], x[8], x[12])
+    QR(x[5], x[9], x[13], x[1])
+    QR(x[10], x[14], x[2], x[6])
+    QR(x[15], x[3], x[7], x[11])
+    QR(x[0], x[1], x[2], x[3])
+    QR(x[5], x[6], x[7], x[4])
+    QR(x[10], x[11], x[8], x[9])
+    QR(x[15], x[12], x[13], x[14])
+  }
+}
+
+/* Key stream block for the counter in s. */
+static void salsa20_block(uint8_t out[64],const uint32_t s[16])
+{
+  uint32_t x[16];
+  int i;
+  memcpy(x, s, sizeof x);
+  salsa20_rounds(x);
+  for (i = 0; i < 16; i++)
+    st32(out + 4 * i, x[i] + s[i]);
+}
+
+static void salsa20_advance(uint32_t s[16],uint64_t blocks)
+{
+  uint64_t counter = ((uint64_t) s[9] << 32 | s[8]) + blocks;
+  s[8] = (uint32_t) counter;
+  s[9] = (uint32_t) (counter >> 32);
+}
+
+#ifdef XSP_SSE2
+
+#define VROTL(v,c) _mm_or_si128(_mm_slli_epi32(v, c), _mm_srli_epi32(v, 32 - c))
+#define VQR(a,b,c,d) \
+  b = _mm_xor_si128(b, VROTL(_mm_add_epi32(a, d), 7)); \
+  c = _mm_xor_si128(c, VROTL(_mm_add_epi32(b, a), 9)); \
+  d = _mm_xor_si128(d, VROTL(_mm_add_epi32(c, b), 13)); \
+  a = _mm_xor_si128(a, VROTL(_mm_add_epi32(d, c), 18));
+
+/* Encrypts 4 blocks, each lane of the vectors computing one of them. */
+static void salsa20_xor4_sse2(uint8_t *c,const uint8_t *m,const uint32_t s[16])
+{
+  __m128i x[16], o[16];
+  uint32_t lo[4], hi[4];
+  uint64_t counter = (uint64_t) s[9] << 32 | s[8];
+  int i, g, b;
+
+  for (i = 0; i < 4; i++) {
+    lo[i] = (uint32_t) (counter + i);
+    hi[i] = (uint32_t) ((counter + i) >> 32);
+  }
+  for (i = 0; i < 16; i++)
+    o[i] = _mm_set1_epi32((int) s[i]);
+  o[8] = _mm_loadu_si128((const __m128i *) lo);
+  o[9] = _mm_loadu_si128((const __m128i *) hi);
+  for (i = 0; i < 16; i++)
+    x[i] = o[i];
+
+  for (i = 0; i < 20; i += 2) {
+    VQR(x[0], x[4], x[8], x[12])
+    VQR(x[5], x[9], x[13], x[1])
+    VQR(x[10], x[14], x[2], x[6])
+    VQR(x[15], x[3], x[7], x[11])
+    VQR(x[0], x[1], x[2], x[3])
+    VQR(x[5], x[6], x[7], x[4])
+    VQR(x[10], x[11], x[8], x[9])
+    VQR(x[15], x[12], x[13], x[14])
+  }
+
+  /* Transpose each group of 4 words from one block per lane to one
+     block per vector. */
+  for (g = 0; g < 4; g++) {
+    __m128i t0 = _mm_add_epi32(x[4 * g], o[4 * g]);
+    __m128i t1 = _mm_add_epi32(x[4 * g + 1], o[4 * g + 1]);
+    __m128i t2 = _mm_add_epi32(x[4 * g + 2], o[4 * g + 2]);
+    __m128i t3 = _mm_add_epi32(x[4 * g + 3], o[4 * g + 3]);
+    __m128i u0 = _mm_unpacklo_epi32(t0, t1);
+    __m128i u1 = _mm_unpacklo_epi32(t2, t3);
+    __m128i u2 = _mm_unpackhi_epi32(t0, t1);
+    __m128i u3 = _mm_unpackhi_epi32(t2, t3);
+    __m128i r[4];
+    r[0] = _mm_unpacklo_epi64(u0, u1);
+    r[1] = _mm_unpackhi_epi64(u0, u1);
+    r[2] = _mm_unpacklo_epi64(u2, u3);
+    r[3] = _mm_unpackhi_epi64(u2, u3);
+    for (b = 0; b < 4; b++) {
+      const int offset = 64 * b + 16 * g;
+      __m128i in = _mm_loadu_si128((const __m128i *) (m + offset));
+      _mm_storeu_si128((__m128i *) (c + offset), _mm_xor_si128(in, r[b]));
+    }
+  }
+}
+
+#endif
+
+#ifdef XSP_AVX2
+
+#define VROTL8(v,c) \
+  _mm256_or_si256(_mm256_slli_epi32(v, c), _mm256_srli_epi32(v, 32 - c))
+#define VQR8(a,b,c,d) \
+  b = _mm256_xor_si256(b, VROTL8(_mm256_add_epi32(a, d), 7)); \
+  c = _mm256_xor_si256(c, VROTL8(_mm256_add_epi32(b, a), 9)); \
+  d = _mm256_xor_si256(d, VROTL8(_mm256_add_epi32(c, b), 13)); \
+  a = _mm256_xor_si256(a, VROTL8(_mm256_add_epi32(d, c), 18));
+
+/* Encrypts 8 blocks, each lane of the vectors computing one of them. */
+__attribute__((target("avx2")))
+static void salsa20_xor8_avx2(uint8_t *c,const uint8_t *m,const uint32_t s[16])
+{
+  __m256i x[16], o[16];
+  uint32_t lo[8], hi[8];
+  uint64_t counter = (uint64_t) s[9] << 32 | s[8];
+  int i, g, b;
+
+  for (i = 0; i < 8; i++) {
+    lo[i] = (uint32_t) (counter + i);
+    hi[i] = (uint32_t) ((counter + i) >> 32);
+  }
+  for (i = 0; i < 16; i++)
+    o[i] = _mm256_set1_epi32((int) s[i]);
+  o[8] = _mm256_loadu_si256((const __m256i *) lo);
+  o[9] = _mm256_loadu_si256((const __m256i *) hi);
+  for (i = 0; i < 16; i++)
+    x[i] = o[i];
+
+  for (i = 0; i < 20; i += 2) {
+    VQR8(x[0], x[4], x[8], x[12])
+    VQR8(x[5], x[9], x[13], x[1])
+    VQR8(x[10], x[14], x[2], x[6])
+    VQR8(x[15], x[3], x[7], x[11])
+    VQR8(x[0], x[1], x[2], x[3])
+    VQR8(x[5], x[6], x[7], x[4])
+    VQR8(x[10], x[11], x[8], x[9])
+    VQR8(x[15], x[12], x[13], x[14])
+  }
+
+  /* The unpacks work within 128-bit halves, so vector b ends up holding
+     block b in its low half and block b + 4 in its high half. */
+  for (g = 0; g < 4; g++) {
+    __m256i t0 = _mm256_add_epi32(x[4 * g], o[4 * g]);
+    __m256i t1 = _mm256_add_epi32(x[4 * g + 1], o[4 * g + 1]);
+    __m256i t2 = _mm256_add_epi32(x[4 * g + 2], o[4 * g + 2]);
+    __m256i t3 = _mm256_add_epi32(x[4 * g + 3], o[4 * g + 3]);
+    __m256i u0 = _mm256_unpacklo_epi32(t0, t1);
+    __m256i u1 = _mm256_unpacklo_epi32(t2, t3);
+    __m256i u2 = _mm256_unpackhi_epi32(t0, t1);
+    __m256i u3 = _mm256_unpackhi_epi32(t2, t3);
+    __m256i r[4];
+    r[0] = _mm256_unpacklo_epi64(u0, u1);
+    r[1] = _mm256_unpackhi_epi64(u0, u1);
+    r[2] = _mm256_unpacklo_epi64(u2, u3);
+    r[3] = _mm256_unpackhi_epi64(u2, u3);
+    for (b = 0; b < 4; b++) {
+      const int low = 64 * b + 16 * g;
+      const int high = low + 256;
+      __m128i in = _mm_loadu_si128((const __m128i *) (m + low));
+      _mm_storeu_si128((__m128i *) (c + low),
+        _mm_xor_si128(in, _mm256_castsi256_si128(r[b])));
+      in = _mm_loadu_si128((const __m128i *) (m + high));
+      _mm_storeu_si128((__m128i *) (c + high),
+        _mm_xor_si128(in, _mm256_extracti128_si256(r[b], 1)));
+    }
+  }
+}
+
+static int have_avx2(void)
+{
+  static int supported = -1;
+  if (supported < 0) {
+    __builtin_cpu_init();
+    supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+  }
+  return supported;
+}
+
+#endif
+
+/* Encrypts d bytes, starting at the counter in s and advancing it. */
+static void salsa20_xor(uint8_t *c,const uint8_t *m,uint64_t d,uint32_t s[16])
+{
+  uint8_t block[64];
+  uint64_t i;
+
+#ifdef XSP_AVX2
+  if (d >= 512 && have_avx2()) {
+    while (d >= 512) {
+      salsa20_xor8_avx2(c, m, s);
+      salsa20_advance(s, 8);
+      c += 512;
+      m += 512;
+      d -= 512;
+    }
+  }
+#endif
+#ifdef XSP_SSE2
+  while (d >= 256) {
+    salsa20_xor4_sse2(c, m, s);
+    salsa20_advance(s, 4);
+    c += 256;
+    m += 256;
+    d -= 256;
+  }
+#endif
+  while (d > 0) {
+    const uint64_t n = d < 64 ? d : 64;
+    salsa20_block(block, s);
+    salsa20_advance(s, 1);
+    for (i = 0; i < n; i++)
+      c[i] = m[i] ^ block[i];
+    c += n;
+    m += n;
+    d -= n;
+  }
+}
+
+/* XSalsa20: Salsa20 keyed by the HSalsa20 of the first 16 bytes of the
+   nonce, with the last 8 bytes of the nonce. */
+static void xsalsa20_init(uint32_t s[16],const uint8_t *n,const uint8_t *k)
+{
+  uint32_t x[16];
+  uint8_t subkey[32];
+  uint8_t in[16];
+  int i;
+
+  salsa20_init(x, k, n);
+  salsa20_rounds(x);
+  st32(subkey, x[0]);
+  st32(subkey + 4, x[5]);
+  st32(subkey + 8, x[10]);
+  st32(subkey + 12, x[15]);
+  for (i = 0; i < 4; i++)
+    st32(subkey + 16 + 4 * i, x[6 + i]);
+
+  memcpy(in, n + 16, 8);
+  memset(in + 8, 0, 8);
+  salsa20_init(s, subkey, in);
+}
+
+/* Poly1305 */
+
+static void poly1305(uint8_t out[16],const uint8_t *m,uint64_t n,
+  const uint8_t key[32])
+{
+  const uint32_t r0 = ld32(key) & 0x3ffffff;
+  const uint32_t r1 = (ld32(key + 3) >> 2) & 0x3ffff03;
+  const uint32_t r2 = (ld32(key + 6) >> 4) & 0x3ffc0ff;
+  const uint32_t r3 = (ld32(key + 9) >> 6) & 0x3f03fff;
+  const uint32_t r4 = (ld32(key + 12) >> 8) & 0x00fffff;
+  const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+  /* Read the pad first; out may overlap the key. */
+  const uint32_t pad0 = ld32(key + 16), pad1 = ld32(key + 20);
+  const uint32_t pad2 = ld32(key + 24), pad3 = ld32(key + 28);
+  uint32_t h0 = 0, h1 = 0, h2 = 0, h3 = 0, h4 = 0;
+  uint32_t g0, g1, g2, g3, g4, c, mask;
+  uint64_t d0, d1, d2, d3, d4, f;
+  uint8_t last[16];
+  uint32_t hibit = 1 << 24;
+
+  while (n > 0) {
+    const uint8_t *p = m;
+    if (n < 16) {
+      /* The final partial block is padded with 1 then zeros, in place
+         of the high bit. */
+      memset(last, 0, sizeof last);
+      memcpy(last, m, (size_t) n);
+      last[n] = 1;
+      p = last;
+      hibit = 0;
+      n = 16;
+    }
+    h0 += ld32(p) & 0x3ffffff;
+    h1 += (ld32(p + 3) >> 2) & 0x3ffffff;
+    h2 += (ld32(p + 6) >> 4) & 0x3ffffff;
+    h3 += (ld32(p + 9) >> 6) & 0x3ffffff;
+    h4 += (ld32(p + 12) >> 8) | hibit;
+
+    d0 = (uint64_t) h0 * r0 + (uint64_t) h1 * s4 + (uint64_t) h2 * s3 +
+      (uint64_t) h3 * s2 + (uint64_t) h4 * s1;
+    d1 = (uint64_t) h0 * r1 + (uint64_t) h1 * r0 + (uint64_t) h2 * s4 +
+      (uint64_t) h3 * s3 + (uint64_t) h4 * s2;
+    d2 = (uint64_t) h0 * r2 + (uint64_t) h1 * r1 + (uint64_t) h2 * r0 +
+      (uint64_t) h3 * s4 + (uint64_t) h4 * s3;
+    d3 = (uint64_t) h0 * r3 + (uint64_t) h1 * r2 + (uint64_t) h2 * r1 +
+      (uint64_t) h3 * r0 + (uint64_t) h4 * s4;
+    d4 = (uint64_t) h0 * r4 + (uint64_t) h1 * r3 + (uint64_t) h2 * r2 +
+      (uint64_t) h3 * r1 + (uint64_t) h4 * r0;
+
+    c = (uint32_t) (d0 >> 26); h0 = (uint32_t) d0 & 0x3ffffff;
+    d1 += c; c = (uint32_t) (d1 >> 26); h1 = (uint32_t) d1 & 0x3ffffff;
+    d2 += c; c = (uint32_t) (d2 >> 26); h2 = (uint32_t) d2 & 0x3ffffff;
+    d3 += c; c = (uint32_t) (d3 >> 26); h3 = (uint32_t) d3 & 0x3ffffff;
+    d4 += c; c = (uint32_t) (d4 >> 26); h4 = (uint32_t) d4 & 0x3ffffff;
+    h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+    h1 += c;
+
+    m += 16;
+    n -= 16;
+  }
+
+  /* Fully carry h. */
+  c = h1 >> 26; h1 &= 0x3ffffff;
+  h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+  h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+  h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+  h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+  h1 += c;
+
+  /* Compute h - p and select it if it is not negative, in constant
+     time. */
+  g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+  g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+  g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+  g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+  g4 = h4 + c - (1 << 26);
+
+  mask = (g4 >> 31) - 1;
+  g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+  mask = ~mask;
+  h0 = (h0 & mask) | g0;
+  h1 = (h1 & mask) | g1;
+  h2 = (h2 & mask) | g2;
+  h3 = (h3 & mask) | g3;
+  h4 = (h4 & mask) | g4;
+
+  /* out = (h + pad) % 2^128 */
+  h0 = h0 | (h1 << 26);
+  h1 = (h1 >> 6) | (h2 << 20);
+  h2 = (h2 >> 12) | (h3 << 14);
+  h3 = (h3 >> 18) | (h4 << 8);
+
+  f = (uint64_t) h0 + pad0; st32(out, (uint32_t) f);
+  f = (uint64_t) h1 + pad1 + (f >> 32); st32(out + 4, (uint32_t) f);
+  f = (uint64_t) h2 + pad2 + (f >> 32); st32(out + 8, (uint32_t) f);
+  f = (uint64_t) h3 + pad3 + (f >> 32); st32(out + 12, (uint32_t) f);
+}
+
+static int verify16(const uint8_t *x,const uint8_t *y)
+{
+  uint32_t d = 0;
+  int i;
+  for (i = 0; i < 16; i++)
+    d |= x[i] ^ y[i];
+  return (1 & ((d - 1) >> 8)) - 1;
+}
+
+/* crypto_secretbox */
+
+int xsalsa20poly1305(unsigned char *c,const unsigned char *m,
+  unsigned long long d,const unsigned char *n,const unsigned char *k)
+{
+  uint32_t s[16];
+  if (d < 32) return -1;
+  xsalsa20_init(s, n, k);
+
+  /* The first 32 bytes of the message are zeros, so the first 32 bytes
+     of the ciphertext are the key stream, which keys Poly1305. */
+  salsa20_xor(c, m, d, s);
+  poly1305(c + 16, c + 32, d - 32, c);
+  memset(c, 0, 16);
+  return 0;
+}
+
+int xsalsa20poly1305_open(unsigned char *m,const unsigned char *c,
+  unsigned long long d,const unsigned char *n,const unsigned char *k)
+{
+  uint32_t s[16];
+  uint8_t block[64];
+  uint8_t tag[16];
+  if (d < 32) return -1;
+  xsalsa20_init(s, n, k);
+
+  salsa20_block(block, s);
+  poly1305(tag, c + 32, d - 32, block);
+  if (verify16(tag, c + 16) != 0) return -1;
+  salsa20_xor(m, c, d, s);
+  memset(m, 0, 32);
+  return 0;
+}
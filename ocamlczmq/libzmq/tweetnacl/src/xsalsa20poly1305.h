@@ -0,0 +1,21 @@
+#ifndef XSALSA20POLY1305_H
+#define XSALSA20POLY1305_H
+
+/* Performance-oriented XSalsa20 + Poly1305, used by tweetnacl for
+   crypto_secretbox and thus for crypto_box_afternm on every CURVE
+   message. Same interface and results as the tweetnacl reference. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int xsalsa20poly1305(unsigned char *c,const unsigned char *m,
+  unsigned long long d,const unsigned char *n,const unsigned char *k);
+int xsalsa20poly1305_open(unsigned char *m,const unsigned char *c,
+  unsigned long long d,const unsigned char *n,const unsigned char *k);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif